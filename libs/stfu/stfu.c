@@ -32,51 +32,74 @@
 #pragma warning(disable: 4706)
 #endif
 
-struct stfu_queue {
-	struct stfu_frame *array;
-	struct stfu_frame int_frame;
-	uint32_t array_size;
-	uint32_t array_len;	
-	uint32_t wr_len;
-	uint32_t last_index;
-};
-typedef struct stfu_queue stfu_queue_t;
-
+/*
+ * The buffer is a ring of frames indexed by timestamp: the frame expected next sits at head and a frame
+ * (ts - next_ts) / interval frames ahead of it sits that many slots further on, so both eating and reading are O(1).
+ * A free slot has was_read set.
+ */
 struct stfu_instance {
-	struct stfu_queue a_queue;
-	struct stfu_queue b_queue;
-	struct stfu_queue *in_queue;
-	struct stfu_queue *out_queue;
-	uint32_t last_ts;
+	struct stfu_frame *ring;
+	struct stfu_frame *measure;
+	struct stfu_frame plc_frame;
+	uint32_t size;
+	uint32_t qlen;
+	uint32_t target;
+	uint32_t max_target;
 	uint32_t interval;
+	uint32_t head;
+	uint32_t next_ts;
+	uint32_t span;
+	uint32_t count;
+	uint32_t measure_len;
+	uint32_t last_index;
+	uint32_t last_ts;
 	uint32_t miss_count;
+	uint32_t reads;
+	uint32_t last_late;
+	uint32_t last_stall;
+	uint32_t over;
+	uint8_t based;
 	uint8_t running;
+	stfu_report_t stats;
 };
 
 
-static stfu_status_t stfu_n_resize_aqueue(stfu_queue_t *queue, uint32_t qlen)
+static void stfu_n_clear_ring(stfu_instance_t *i)
 {
-    unsigned char *m;
+	uint32_t index;
 
-    if (qlen <= queue->array_size) {
-        return STFU_IT_FAILED;;
-    }
+	for (index = 0; index < i->size; index++) {
+		i->ring[index].was_read = 1;
+		i->ring[index].dlen = 0;
+	}
 
-	m = realloc(queue->array, qlen * sizeof(struct stfu_frame));
-    assert(m);
-    memset(m + queue->array_size, 0, qlen * sizeof(struct stfu_frame) - queue->array_size);
-    queue->array = (struct stfu_frame *) m;
-	queue->array_size = qlen;
-	return STFU_IT_WORKED;
+	i->head = 0;
+	i->span = 0;
+	i->count = 0;
+	i->miss_count = 0;
+	i->over = 0;
+	i->based = 0;
+	i->running = 0;
 }
 
-static void stfu_n_init_aqueue(stfu_queue_t *queue, uint32_t qlen)
+static void stfu_n_set_size(stfu_instance_t *i, uint32_t qlen)
 {
-	queue->array = calloc(qlen, sizeof(struct stfu_frame));
-	assert(queue->array != NULL);
-	memset(queue->array, 0, sizeof(struct stfu_frame) * qlen);	
-	queue->array_size = qlen;
-	queue->int_frame.plc = 1;
+	i->qlen = qlen;
+	i->size = qlen * 2;
+
+	if (i->size < 4) {
+		i->size = 4;
+	}
+
+	i->max_target = i->size - 2;
+
+	if (i->target < qlen) {
+		i->target = qlen;
+	}
+
+	if (i->target > i->max_target) {
+		i->target = i->max_target;
+	}
 }
 
 void stfu_n_destroy(stfu_instance_t **i)
@@ -86,30 +109,55 @@ void stfu_n_destroy(stfu_instance_t **i)
 	if (i && *i) {
 		ii = *i;
 		*i = NULL;
-		free(ii->a_queue.array);
-		free(ii->b_queue.array);
+		free(ii->ring);
+		free(ii->measure);
 		free(ii);
 	}
 }
 
 void stfu_n_report(stfu_instance_t *i, stfu_report_t *r)
 {
-    assert(i);
-    r->in_len = i->in_queue->array_len;
-    r->in_size = i->in_queue->array_size;
-    r->out_len = i->out_queue->array_len;
-    r->out_size = i->out_queue->array_size;
+	assert(i);
+	*r = i->stats;
+	r->in_len = i->count;
+	r->in_size = i->size;
+	r->out_len = i->span;
+	r->out_size = i->target;
+	r->interval = i->interval;
 }
 
 stfu_status_t stfu_n_resize(stfu_instance_t *i, uint32_t qlen) 
 {
-    stfu_status_t s;
+	struct stfu_frame *ring, *old = i->ring;
+	uint32_t index, old_size = i->size, old_head = i->head;
+
+	if (qlen * 2 <= i->size) {
+		return STFU_IT_FAILED;
+	}
+
+	stfu_n_set_size(i, qlen);
+	ring = calloc(i->size, sizeof(struct stfu_frame));
+	assert(ring);
+
+	for (index = 0; index < i->size; index++) {
+		ring[index].was_read = 1;
+	}
+
+	/* keep every frame at the same distance from the playout point */
+	for (index = 0; index < old_size; index++) {
+		struct stfu_frame *frame = &old[(old_head + index) % old_size];
+
+		if (!frame->was_read) {
+			memcpy(&ring[index], frame, sizeof(*frame));
+		}
+	}
+
+	i->ring = ring;
+	i->head = 0;
+	i->last_index = 0;
+	free(old);
 
-    if ((s = stfu_n_resize_aqueue(&i->a_queue, qlen)) == STFU_IT_WORKED) {
-        s = stfu_n_resize_aqueue(&i->b_queue, qlen);
-    }
-    
-    return s;
+	return STFU_IT_WORKED;
 }
 
 stfu_instance_t *stfu_n_init(uint32_t qlen)
@@ -121,198 +169,337 @@ stfu_instance_t *stfu_n_init(uint32_t qlen)
 		return NULL;
 	}
 	memset(i, 0, sizeof(*i));
-	stfu_n_init_aqueue(&i->a_queue, qlen);
-	stfu_n_init_aqueue(&i->b_queue, qlen);
-	i->in_queue = &i->a_queue;
-	i->out_queue = &i->b_queue;
+
+	if (!qlen) {
+		qlen = 1;
+	}
+
+	stfu_n_set_size(i, qlen);
+	i->ring = calloc(i->size, sizeof(struct stfu_frame));
+	assert(i->ring != NULL);
+	stfu_n_clear_ring(i);
+	i->plc_frame.plc = 1;
+
 	return i;
 }
 
 void stfu_n_reset(stfu_instance_t *i)
 {
-	i->in_queue = &i->a_queue;
-	i->out_queue = &i->b_queue;
-	i->in_queue->array_len = 0;
-	i->out_queue->array_len = 0;
-	i->out_queue->wr_len = 0;
-	i->out_queue->last_index = 0;
-	i->miss_count = 0;	
-	i->last_ts = 0;
-	i->running = 0;
-	i->miss_count = 0;
-	i->interval = 0;
+	/* the interval survives a reset, a new talk spurt keeps the packetization */
+	stfu_n_clear_ring(i);
+	i->measure_len = 0;
+	i->stats.resets++;
 }
 
-static int32_t stfu_n_measure_interval(stfu_queue_t *queue)
+static void stfu_n_copy_frame(stfu_frame_t *frame, uint32_t ts, uint32_t pt, void *data, size_t datalen)
 {
-	uint32_t index;
-	int32_t d, most = 0, last = 0, this, track[STFU_MAX_TRACK] = {0};
+	size_t cplen;
 
-	for(index = 0; index < queue->array_len; index++) {
-		this = queue->array[index].ts;
-		if (last) {
+	if ((cplen = datalen) > sizeof(frame->data)) {
+		cplen = sizeof(frame->data);
+	}
 
-			if ((d = this - last) > 0 && d / 10 < STFU_MAX_TRACK) {
-				track[(d/10)]++;
-			}
+	memcpy(frame->data, data, cplen);
+	frame->pt = pt;
+	frame->ts = ts;
+	frame->dlen = cplen;
+	frame->was_read = 0;
+}
+
+static uint32_t stfu_n_measure_interval(stfu_frame_t *frames, uint32_t len)
+{
+	uint32_t index, index2, best = 0, best_hits = 0;
+	int32_t d;
+
+	/* the most common gap between consecutive arrivals, the smallest on a tie */
+	for (index = 1; index < len; index++) {
+		uint32_t hits = 0;
+
+		if ((d = (int32_t) (frames[index].ts - frames[index - 1].ts)) <= 0) {
+			continue;
 		}
 
-		last = this;
-	}
+		for (index2 = 1; index2 < len; index2++) {
+			if ((int32_t) (frames[index2].ts - frames[index2 - 1].ts) == d) {
+				hits++;
+			}
+		}
 
-	for(index = 0; index < STFU_MAX_TRACK; index++) {
-		if (track[index] > track[most]) {
-			most = index;
+		if (hits > best_hits || (hits == best_hits && (uint32_t) d < best)) {
+			best = (uint32_t) d;
+			best_hits = hits;
 		}
 	}
 
-	return most * 10;
+	return best;
 }
 
-static int16_t stfu_n_process(stfu_instance_t *i, stfu_queue_t *queue)
+static stfu_status_t stfu_n_place(stfu_instance_t *i, uint32_t ts, uint32_t pt, void *data, size_t datalen);
+
+static stfu_status_t stfu_n_measure(stfu_instance_t *i, uint32_t ts, uint32_t pt, void *data, size_t datalen)
 {
-	if (!i->interval && !(i->interval = stfu_n_measure_interval(queue))) {
-		return -1;
+	stfu_frame_t *frames;
+	uint32_t len, index, want = i->qlen < STFU_MEASURE_FRAMES ? (i->qlen < 2 ? 2 : i->qlen) : STFU_MEASURE_FRAMES;
+
+	if (!i->measure) {
+		i->measure = calloc(STFU_MEASURE_FRAMES, sizeof(struct stfu_frame));
+		assert(i->measure);
+	}
+
+	stfu_n_copy_frame(&i->measure[i->measure_len++], ts, pt, data, datalen);
+
+	if (i->measure_len < want) {
+		return STFU_IT_WORKED;
+	}
+
+	if (!(i->interval = stfu_n_measure_interval(i->measure, i->measure_len))) {
+		/* nothing usable yet, start over from the newest frame */
+		memcpy(&i->measure[0], &i->measure[i->measure_len - 1], sizeof(struct stfu_frame));
+		i->measure_len = 1;
+		return STFU_IT_WORKED;
+	}
+
+	stfu_n_clear_ring(i);
+
+	/* take the frames off the instance first, placing one can start a new measurement that needs i->measure */
+	frames = i->measure;
+	len = i->measure_len;
+	i->measure = NULL;
+	i->measure_len = 0;
+
+	for (index = 0; index < len; index++) {
+		stfu_frame_t *frame = &frames[index];
+
+		if (i->interval) {
+			stfu_n_place(i, frame->ts, frame->pt, frame->data, frame->dlen);
+		} else {
+			/* the interval did not hold, the rest goes to the new measurement */
+			stfu_n_measure(i, frame->ts, frame->pt, frame->data, frame->dlen);
+		}
 	}
 
-	return 0;
+	free(frames);
+
+	return STFU_IT_WORKED;
 }
 
-stfu_status_t stfu_n_add_data(stfu_instance_t *i, uint32_t ts, uint32_t pt, void *data, size_t datalen, int last)
+static stfu_status_t stfu_n_place(stfu_instance_t *i, uint32_t ts, uint32_t pt, void *data, size_t datalen)
 {
-	uint32_t index;
+	int32_t diff, d;
 	stfu_frame_t *frame;
-	size_t cplen = 0;
+	uint32_t slot;
 
-	if (last || i->in_queue->array_len == i->in_queue->array_size) {
-		stfu_queue_t *other_queue;
+	if (!i->based) {
+		i->next_ts = ts;
+		i->based = 1;
+	}
 
-		if (i->out_queue->wr_len < i->out_queue->array_len) {
-			return STFU_IT_FAILED;
-		}
+	diff = (int32_t) (ts - i->next_ts);
 
-		other_queue = i->in_queue;
-		i->in_queue = i->out_queue;
-		i->out_queue = other_queue;
+	if (diff % (int32_t) i->interval) {
+		/* the packetization changed, measure it again */
+		stfu_n_reset(i);
+		i->interval = 0;
+		return stfu_n_measure(i, ts, pt, data, datalen);
+	}
 
-		i->in_queue->array_len = 0;
-		i->out_queue->wr_len = 0;
-		i->out_queue->last_index = 0;
-		i->miss_count = 0;
+	d = diff / (int32_t) i->interval;
+
+	if (d < 0) {
+		if (!i->running && (uint32_t) -d + i->span < i->size) {
+			/* still filling, an earlier frame moves the playout point back */
+			i->head = (i->head + i->size - (uint32_t) -d) % i->size;
+			i->next_ts = ts;
+			i->span += (uint32_t) -d;
+			d = 0;
+		} else if ((uint32_t) -d < i->size) {
+			frame = &i->ring[(i->head + i->size - (uint32_t) -d) % i->size];
+
+			if (frame->ts == ts && frame->dlen) {
+				i->stats.duplicate++;
+			} else {
+				/* it missed its turn, the buffer is too shallow */
+				i->stats.late++;
+				i->last_late = i->reads;
+
+				if (i->target < i->max_target) {
+					i->target++;
+				}
+			}
+			return STFU_IT_WORKED;
+		} else {
+			stfu_n_reset(i);
+			return stfu_n_place(i, ts, pt, data, datalen);
+		}
+	}
 
-		if (stfu_n_process(i, i->out_queue) < 0) {
-            if (i->in_queue->array_len == i->in_queue->array_size && i->out_queue->array_len == i->out_queue->array_size) {
-                stfu_n_resize(i, i->out_queue->array_size * 2);
-            }
-			//return STFU_IT_FAILED;
+	if ((uint32_t) d >= i->size) {
+		uint32_t slide;
+
+		if (!i->running || (uint32_t) d >= i->size * 2) {
+			/* a jump in the timestamps, start filling again from here */
+			stfu_n_reset(i);
+			return stfu_n_place(i, ts, pt, data, datalen);
 		}
-		for(index = 0; index < i->out_queue->array_len; index++) {
-			i->out_queue->array[index].was_read = 0;
+
+		/* nobody is reading fast enough, drop the oldest frames to make room */
+		for (slide = (uint32_t) d - i->size + 1; slide; slide--) {
+			frame = &i->ring[i->head];
+
+			if (!frame->was_read) {
+				frame->was_read = 1;
+				i->count--;
+				i->stats.dropped++;
+			}
+
+			i->head = (i->head + 1) % i->size;
+			i->next_ts += i->interval;
+			if (i->span) {
+				i->span--;
+			}
 		}
+
+		d = (int32_t) i->size - 1;
+	}
+
+	slot = (i->head + (uint32_t) d) % i->size;
+	frame = &i->ring[slot];
+
+	if (!frame->was_read) {
+		i->stats.duplicate++;
+		return STFU_IT_WORKED;
 	}
 
+	stfu_n_copy_frame(frame, ts, pt, data, datalen);
+	i->count++;
+
+	if ((uint32_t) d + 1 > i->span) {
+		i->span = (uint32_t) d + 1;
+	}
+
+	if (!i->running && i->span > i->target) {
+		i->running = 1;
+		i->last_stall = i->reads;
+	}
+
+	return STFU_IT_WORKED;
+}
+
+stfu_status_t stfu_n_add_data(stfu_instance_t *i, uint32_t ts, uint32_t pt, void *data, size_t datalen, int last)
+{
 	if (last) {
+		/* drain what is there without waiting for the buffer to fill */
+		if (i->count) {
+			i->running = 1;
+		}
 		return STFU_IM_DONE;
 	}
 
-	index = i->in_queue->array_len++;
-	frame = &i->in_queue->array[index];
+	i->stats.packets_in++;
 
-	if ((cplen = datalen) > sizeof(frame->data)) {
-		cplen = sizeof(frame->data);
+	if (!i->interval) {
+		return stfu_n_measure(i, ts, pt, data, datalen);
 	}
 
-	memcpy(frame->data, data, cplen);
-    frame->pt = pt;
-	frame->ts = ts;
-	frame->dlen = cplen;
-	frame->was_read = 0;	
+	return stfu_n_place(i, ts, pt, data, datalen);
+}
 
-	return STFU_IT_WORKED;
+static void stfu_n_advance(stfu_instance_t *i)
+{
+	i->head = (i->head + 1) % i->size;
+	i->next_ts += i->interval;
+
+	if (i->span) {
+		i->span--;
+	}
 }
 
 stfu_frame_t *stfu_n_read_a_frame(stfu_instance_t *i)
 {
-	uint32_t index, index2;
-	uint32_t should_have = 0;
-	stfu_frame_t *frame = NULL, *rframe = NULL;
+	stfu_frame_t *frame, *rframe = NULL;
 
-	if (((i->out_queue->wr_len == i->out_queue->array_len) || !i->out_queue->array_len)) {
+	if (!i->interval || !i->running) {
 		return NULL;
 	}
 
-	if (i->running) {
-		should_have = i->last_ts + i->interval;
-	} else {
-		should_have = i->out_queue->array[0].ts;
-	}
+	i->reads++;
 
-	for(index = 0; index < i->out_queue->array_len; index++) {
-		if (i->out_queue->array[index].was_read) {
-			continue;
+	if (!i->count) {
+		/* ran dry, fill up to the target again before playing */
+		i->stats.underruns++;
+		i->running = 0;
+		i->last_late = i->reads;
+		if (i->target < i->max_target) {
+			i->target++;
 		}
+		return NULL;
+	}
 
-		frame = &i->out_queue->array[index];
+	if (i->reads - i->last_late >= STFU_ADAPT_FRAMES) {
+		/* a quiet spell lets the target depth creep back toward what was asked for */
+		if (i->target > i->qlen) {
+			i->target--;
+		}
+		i->last_late = i->reads;
+	}
 
-		if (frame->ts != should_have) {
-			unsigned int tried = 0;
-			for (index2 = 0; index2 < i->out_queue->array_len; index2++) {
-				if (i->out_queue->array[index2].was_read) {
-					continue;
-				}
-				tried++;
-				if (i->out_queue->array[index2].ts == should_have) {
-					rframe = &i->out_queue->array[index2];
-					i->out_queue->last_index = index2;
-					goto done;
-				}
-			}
-			for (index2 = 0; index2 < i->in_queue->array_len; index2++) {
-				if (i->in_queue->array[index2].was_read) {
-					continue;
-				}
-				tried++;
-				if (i->in_queue->array[index2].ts == should_have) {
-					rframe = &i->in_queue->array[index2];
-					goto done;
-				}
-			}
+	if (i->span <= i->target && i->target > i->qlen && i->reads - i->last_stall >= STFU_STALL_FRAMES) {
+		/* hold the playout point for one frame to let the buffer deepen */
+		i->last_stall = i->reads;
+		return NULL;
+	}
 
-			i->miss_count++;
+	if (i->span > i->target + 2) {
+		if (++i->over >= STFU_ADAPT_FRAMES) {
+			frame = &i->ring[i->head];
 
-			if (i->miss_count > 10 || (i->in_queue->array_len == i->in_queue->array_size) || tried >= i->in_queue->array_size) {
-				i->running = 0;
-				i->interval = 0;
-				i->out_queue->wr_len = i->out_queue->array_size;
-				return NULL;
+			if (!frame->was_read) {
+				frame->was_read = 1;
+				i->count--;
+				i->stats.dropped++;
 			}
 
-			i->last_ts = should_have;
-			rframe = &i->out_queue->int_frame;
-			rframe->dlen = i->out_queue->array[i->out_queue->last_index].dlen;
-			/* poor man's plc..  Copy the last frame, but we flag it so you can use a better one if you wish */
-			memcpy(rframe->data, i->out_queue->array[i->out_queue->last_index].data, rframe->dlen);
-			rframe->ts = should_have;
-			i->out_queue->wr_len++;
-			i->running = 1;
-			return rframe;			
-		} else {
-			rframe = &i->out_queue->array[index];
-			i->out_queue->last_index = index;
-			goto done;
+			stfu_n_advance(i);
+			i->over = 0;
 		}
+	} else {
+		i->over = 0;
 	}
 
-done:
+	frame = &i->ring[i->head];
 
-	if (rframe) {
-		i->out_queue->wr_len++;
-		i->last_ts = rframe->ts;
+	if (!frame->was_read && frame->ts == i->next_ts) {
+		rframe = frame;
 		rframe->was_read = 1;
-		i->running = 1;
+		i->count--;
+		i->last_index = i->head;
+		i->last_ts = rframe->ts;
 		i->miss_count = 0;
+		i->stats.packets_out++;
+		stfu_n_advance(i);
+		return rframe;
 	}
 
+	if (++i->miss_count > STFU_MAX_MISS) {
+		i->running = 0;
+		i->miss_count = 0;
+		return NULL;
+	}
+
+	rframe = &i->plc_frame;
+	frame = &i->ring[i->last_index];
+
+	/* poor man's plc..  Copy the last frame, but we flag it so you can use a better one if you wish */
+	if (frame->ts == i->last_ts && frame->dlen) {
+		rframe->dlen = frame->dlen;
+		rframe->pt = frame->pt;
+		memcpy(rframe->data, frame->data, rframe->dlen);
+	}
+
+	rframe->ts = i->next_ts;
+	i->stats.plc++;
+	stfu_n_advance(i);
+
 	return rframe;
 }
 
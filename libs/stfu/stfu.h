@@ -65,6 +65,10 @@ typedef unsigned long   in_addr_t;
 #define STFU_DATALEN 16384
 #define STFU_QLEN 300
 #define STFU_MAX_TRACK 256
+#define STFU_MEASURE_FRAMES 4
+#define STFU_MAX_MISS 10
+#define STFU_ADAPT_FRAMES 500
+#define STFU_STALL_FRAMES 50
 
 typedef enum {
 	STFU_IT_FAILED,
@@ -86,14 +90,23 @@ struct stfu_instance;
 typedef struct stfu_instance stfu_instance_t;
 
 typedef struct {
+	/* frames buffered and slots in the ring */
 	uint32_t in_len;
 	uint32_t in_size;
+	/* frames between the playout point and the newest frame, and the depth the buffer aims for */
 	uint32_t out_len;
 	uint32_t out_size;
-
+	uint32_t interval;
+	uint32_t packets_in;
+	uint32_t packets_out;
+	uint32_t plc;
+	uint32_t late;
+	uint32_t duplicate;
+	uint32_t dropped;
+	uint32_t underruns;
+	uint32_t resets;
 } stfu_report_t;
 
-
 void stfu_n_report(stfu_instance_t *i, stfu_report_t *r);
 void stfu_n_destroy(stfu_instance_t **i);
 stfu_instance_t *stfu_n_init(uint32_t qlen);
@@ -0,0 +1,164 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * bench_acl.c -- network list (acl) build and lookup cost at 100, 10k and 1M prefixes
+ *
+ * Every size is also looked up with the linear longest prefix scan the lists used before the trie, on the same
+ * addresses, and the allow/deny answers of the two are compared.
+ */
+#include "fs_bench.h"
+
+#define BENCH_LOOKUPS 1000000
+/* the linear scan gets about this many prefix tests per size */
+#define BENCH_LINEAR_TESTS 200000000ULL
+
+typedef struct {
+	uint32_t ip;
+	uint32_t mask;
+	uint32_t bits;
+} bench_prefix_t;
+
+static switch_bool_t linear_lookup(bench_prefix_t *prefixes, uint32_t count, uint32_t ip)
+{
+	int best = -1;
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		/* >= so that a later entry of the same length wins, like a re-added prefix does in the list */
+		if (switch_test_subnet(ip, prefixes[i].ip, prefixes[i].mask) && (best < 0 || prefixes[i].bits >= prefixes[best].bits)) {
+			best = i;
+		}
+	}
+
+	return best < 0 ? SWITCH_FALSE : (best & 1) ? SWITCH_FALSE : SWITCH_TRUE;
+}
+
+static int run(switch_memory_pool_t *parent, uint32_t count)
+{
+	switch_memory_pool_t *pool = NULL;
+	switch_network_list_t *list = NULL;
+	bench_prefix_t *prefixes;
+	uint32_t *ips, i, seed = 0x5eed0000 ^ count, linear, mismatches = 0, allowed = 0;
+	uint8_t *answers;
+	char cidr[32], name[64];
+	uint64_t start, ns;
+
+	apr_pool_create(&pool, parent);
+	prefixes = switch_core_alloc(pool, count * sizeof(*prefixes));
+	ips = switch_core_alloc(pool, BENCH_LOOKUPS * sizeof(*ips));
+	answers = switch_core_alloc(pool, BENCH_LOOKUPS);
+	switch_network_list_create(&list, "bench", SWITCH_FALSE, pool);
+
+	ns = 0;
+	for (i = 0; i < count; i++) {
+		uint32_t ip = fs_bench_rand(&seed), bits = 16 + fs_bench_rand(&seed) % 17;
+
+		switch_snprintf(cidr, sizeof(cidr), "%u.%u.%u.%u/%u", ip >> 24, (ip >> 16) & 0xff, (ip >> 8) & 0xff, ip & 0xff, bits);
+		switch_parse_cidr(cidr, &prefixes[i].ip, &prefixes[i].mask, &prefixes[i].bits);
+
+		/* odd entries deny, so the answer says which entry matched */
+		start = fs_bench_ns();
+		switch_network_list_add_cidr(list, cidr, (i & 1) ? SWITCH_FALSE : SWITCH_TRUE);
+		ns += fs_bench_ns() - start;
+	}
+
+	switch_snprintf(name, sizeof(name), "acl %u prefixes: add", count);
+	fs_bench_report(name, ns, count, "prefix");
+
+	/* half of the addresses fall inside a listed prefix, the other half are random */
+	for (i = 0; i < BENCH_LOOKUPS; i++) {
+		if (i & 1) {
+			ips[i] = fs_bench_rand(&seed);
+		} else {
+			bench_prefix_t *p = &prefixes[fs_bench_rand(&seed) % count];
+			ips[i] = (p->ip & p->mask) | (fs_bench_rand(&seed) & ~p->mask);
+		}
+	}
+
+	start = fs_bench_ns();
+	for (i = 0; i < BENCH_LOOKUPS; i++) {
+		allowed += switch_network_list_validate_ip_token(list, ips[i], NULL);
+	}
+	ns = fs_bench_ns() - start;
+
+	switch_snprintf(name, sizeof(name), "acl %u prefixes: trie lookup", count);
+	fs_bench_report(name, ns, BENCH_LOOKUPS, "lookup");
+
+	if ((linear = (uint32_t) (BENCH_LINEAR_TESTS / count)) > BENCH_LOOKUPS) {
+		linear = BENCH_LOOKUPS;
+	}
+
+	start = fs_bench_ns();
+	for (i = 0; i < linear; i++) {
+		answers[i] = (uint8_t) linear_lookup(prefixes, count, ips[i]);
+	}
+	ns = fs_bench_ns() - start;
+
+	switch_snprintf(name, sizeof(name), "acl %u prefixes: linear scan", count);
+	fs_bench_report(name, ns, linear, "lookup");
+
+	for (i = 0; i < linear; i++) {
+		if (switch_network_list_validate_ip_token(list, ips[i], NULL) != (switch_bool_t) answers[i]) {
+			mismatches++;
+		}
+	}
+
+	printf("acl %u prefixes: %u of %u addresses allowed, %u of %u answers differ from the linear scan\n",
+		   count, allowed, BENCH_LOOKUPS, mismatches, linear);
+
+	apr_pool_destroy(pool);
+
+	return mismatches ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	switch_memory_pool_t *pool = fs_bench_pool();
+	uint32_t sizes[] = { 100, 10000, 1000000 };
+	int i, ret = 0;
+
+	for (i = 0; i < (int) (sizeof(sizes) / sizeof(sizes[0])); i++) {
+		ret |= run(pool, sizes[i]);
+	}
+
+	apr_pool_destroy(pool);
+	apr_terminate();
+
+	return ret;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
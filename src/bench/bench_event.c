@@ -0,0 +1,158 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * bench_event.c -- switch_event_get_header and switch_event_expand_headers with and without the header index
+ *
+ * An event with N channel variable style headers is timed as built, then again with its index detached so
+ * switch_event_get_header falls back to the linked list walk it used before the index existed.
+ */
+#include "fs_bench.h"
+
+#define BENCH_LOOKUPS 2000000
+#define BENCH_EXPANDS 200000
+#define BENCH_MAX_HEADERS 300
+
+static char names[BENCH_MAX_HEADERS][32];
+
+static uint64_t time_get_header(switch_event_t *event, uint32_t count)
+{
+	uint64_t start = fs_bench_ns();
+	uint32_t n, found = 0;
+
+	for (n = 0; n < BENCH_LOOKUPS; n++) {
+		found += switch_event_get_header(event, names[(n * 7) % count]) != NULL;
+	}
+
+	if (found != BENCH_LOOKUPS) {
+		printf("%u of %u lookups missed\n", BENCH_LOOKUPS - found, BENCH_LOOKUPS);
+		exit(1);
+	}
+
+	return fs_bench_ns() - start;
+}
+
+static uint64_t time_expand(switch_event_t *event, const char *tpl, char **result)
+{
+	uint64_t start = fs_bench_ns();
+	uint32_t n;
+
+	for (n = 0; n < BENCH_EXPANDS; n++) {
+		char *expanded = switch_event_expand_headers(event, tpl);
+
+		if (n + 1 == BENCH_EXPANDS) {
+			*result = expanded;
+		} else if (expanded != tpl) {
+			free(expanded);
+		}
+	}
+
+	return fs_bench_ns() - start;
+}
+
+static int run(uint32_t count)
+{
+	switch_event_t *event = NULL;
+	switch_event_header_t **index;
+	char tpl[512], what[80], *indexed = NULL, *listed = NULL;
+	uint32_t i, v[8];
+	int ret = 0;
+
+	switch_event_create(&event, SWITCH_EVENT_CLONE);
+
+	for (i = 0; i < count; i++) {
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, names[i], "value of header %u", i);
+	}
+
+	/* eight references spread over the event, like a dialstring built from channel variables */
+	for (i = 0; i < 8; i++) {
+		v[i] = (i * count) / 8 + count / 16;
+	}
+
+	switch_snprintf(tpl, sizeof(tpl), "{origination_caller_id_number=${%s},sip_h_X-A=${%s}}sofia/${%s}/${%s}@${%s}:${%s};transport=${%s}|${%s}",
+					names[v[0]], names[v[1]], names[v[2]], names[v[3]], names[v[4]], names[v[5]], names[v[6]], names[v[7]]);
+
+	if (event->index) {
+		switch_snprintf(what, sizeof(what), "get_header, %u headers (index)", count);
+		fs_bench_report(what, time_get_header(event, count), BENCH_LOOKUPS, "call");
+		switch_snprintf(what, sizeof(what), "expand_headers x8, %u headers (index)", count);
+		fs_bench_report(what, time_expand(event, tpl, &indexed), BENCH_EXPANDS, "call");
+	}
+
+	/* switch_event_get_header only walks the list when there is no index */
+	index = event->index;
+	event->index = NULL;
+
+	switch_snprintf(what, sizeof(what), "get_header, %u headers (list)", count);
+	fs_bench_report(what, time_get_header(event, count), BENCH_LOOKUPS, "call");
+	switch_snprintf(what, sizeof(what), "expand_headers x8, %u headers (list)", count);
+	fs_bench_report(what, time_expand(event, tpl, &listed), BENCH_EXPANDS, "call");
+
+	event->index = index;
+
+	if (indexed && strcmp(indexed, listed)) {
+		printf("%u headers: the expansions differ\n", count);
+		ret = 1;
+	}
+
+	switch_safe_free(indexed);
+	switch_safe_free(listed);
+	switch_event_destroy(&event);
+
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	switch_memory_pool_t *pool = fs_bench_pool();
+	uint32_t sizes[] = { 10, 30, 100, 300 }, i;
+	int ret = 0;
+
+	for (i = 0; i < BENCH_MAX_HEADERS; i++) {
+		switch_snprintf(names[i], sizeof(names[i]), "variable_bench_var_%u", i);
+	}
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		ret |= run(sizes[i]);
+	}
+
+	apr_pool_destroy(pool);
+	apr_terminate();
+
+	return ret;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
@@ -0,0 +1,213 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * bench_locate.c -- uuid to session locates from 1, 4 and 16 threads, one locked table against the partitions
+ *
+ * switch_core_session_locate cannot be called here, a session only gets into the table through
+ * switch_core_session_request which needs a started core.  So the lookup it does is rebuilt from the same pieces:
+ * a switch_core_hash keyed by uuid, the table lock, then a read lock on the session that the caller releases.  The
+ * old way is one mutex around one table, the new way is session_partition() over SWITCH_SESSION_TABLE_PARTITIONS
+ * tables each behind a rwlock.
+ */
+#include "fs_bench.h"
+#include "private/switch_core_pvt.h"
+
+#define BENCH_SESSIONS 10000
+#define BENCH_LOCATES 1000000
+#define BENCH_MAX_THREADS 16
+
+typedef struct {
+	char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
+	switch_thread_rwlock_t *rwlock;
+} bench_session_t;
+
+typedef struct {
+	uint32_t seed;
+	uint32_t found;
+} bench_worker_t;
+
+static bench_session_t sessions[BENCH_SESSIONS];
+
+static switch_mutex_t *global_mutex;
+static switch_hash_t *global_table;
+static switch_session_partition_t partitions[SWITCH_SESSION_TABLE_PARTITIONS];
+
+static switch_session_partition_t *bench_partition(const char *uuid_str)
+{
+	switch_ssize_t len = (switch_ssize_t) strlen(uuid_str);
+	unsigned int hash = switch_ci_hashfunc_default(uuid_str, &len);
+
+	return &partitions[(hash ^ (hash >> 16)) & (SWITCH_SESSION_TABLE_PARTITIONS - 1)];
+}
+
+static bench_session_t *locate_global(const char *uuid_str)
+{
+	bench_session_t *session;
+
+	switch_mutex_lock(global_mutex);
+	if ((session = switch_core_hash_find(global_table, uuid_str))) {
+		switch_thread_rwlock_rdlock(session->rwlock);
+	}
+	switch_mutex_unlock(global_mutex);
+
+	return session;
+}
+
+static bench_session_t *locate_partitioned(const char *uuid_str)
+{
+	switch_session_partition_t *part = bench_partition(uuid_str);
+	bench_session_t *session;
+
+	switch_thread_rwlock_rdlock(part->rwlock);
+	if ((session = switch_core_hash_find(part->table, uuid_str))) {
+		switch_thread_rwlock_rdlock(session->rwlock);
+	}
+	switch_thread_rwlock_unlock(part->rwlock);
+
+	return session;
+}
+
+static void *SWITCH_THREAD_FUNC global_worker(switch_thread_t *thread, void *obj)
+{
+	bench_worker_t *worker = (bench_worker_t *) obj;
+	bench_session_t *session;
+	uint32_t n;
+
+	for (n = 0; n < BENCH_LOCATES; n++) {
+		if ((session = locate_global(sessions[fs_bench_rand(&worker->seed) % BENCH_SESSIONS].uuid_str))) {
+			worker->found++;
+			switch_thread_rwlock_unlock(session->rwlock);
+		}
+	}
+
+	return NULL;
+}
+
+static void *SWITCH_THREAD_FUNC partitioned_worker(switch_thread_t *thread, void *obj)
+{
+	bench_worker_t *worker = (bench_worker_t *) obj;
+	bench_session_t *session;
+	uint32_t n;
+
+	for (n = 0; n < BENCH_LOCATES; n++) {
+		if ((session = locate_partitioned(sessions[fs_bench_rand(&worker->seed) % BENCH_SESSIONS].uuid_str))) {
+			worker->found++;
+			switch_thread_rwlock_unlock(session->rwlock);
+		}
+	}
+
+	return NULL;
+}
+
+static int run(switch_memory_pool_t *pool, const char *how, switch_thread_start_t func, uint32_t count)
+{
+	switch_thread_t *threads[BENCH_MAX_THREADS];
+	bench_worker_t workers[BENCH_MAX_THREADS];
+	switch_threadattr_t *attr = NULL;
+	switch_status_t st;
+	uint64_t start;
+	uint32_t i, found = 0;
+	char what[80];
+
+	switch_threadattr_create(&attr, pool);
+
+	start = fs_bench_ns();
+	for (i = 0; i < count; i++) {
+		workers[i].seed = 0x5eed0000 + i;
+		workers[i].found = 0;
+		switch_thread_create(&threads[i], attr, func, &workers[i], pool);
+	}
+
+	for (i = 0; i < count; i++) {
+		switch_thread_join(&st, threads[i]);
+		found += workers[i].found;
+	}
+
+	/* wall time over every locate of every thread, so it drops as long as the threads do not serialize */
+	switch_snprintf(what, sizeof(what), "locate, %u sessions, %u threads (%s)", BENCH_SESSIONS, count, how);
+	fs_bench_report(what, fs_bench_ns() - start, (uint64_t) BENCH_LOCATES * count, "locate");
+
+	if (found != BENCH_LOCATES * count) {
+		printf("%u of %u locates missed\n", BENCH_LOCATES * count - found, BENCH_LOCATES * count);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	switch_memory_pool_t *pool = fs_bench_pool();
+	uint32_t counts[] = { 1, 4, 16 }, i, seed = 0x5eed10c;
+	int ret = 0;
+
+	switch_mutex_init(&global_mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&global_table, pool);
+
+	for (i = 0; i < SWITCH_SESSION_TABLE_PARTITIONS; i++) {
+		switch_thread_rwlock_create(&partitions[i].rwlock, pool);
+		switch_core_hash_init(&partitions[i].table, pool);
+	}
+
+	for (i = 0; i < BENCH_SESSIONS; i++) {
+		bench_session_t *session = &sessions[i];
+
+		switch_snprintf(session->uuid_str, sizeof(session->uuid_str), "%08x-%04x-%04x-%04x-%04x%08x",
+						fs_bench_rand(&seed), fs_bench_rand(&seed) & 0xffff, fs_bench_rand(&seed) & 0xffff,
+						fs_bench_rand(&seed) & 0xffff, fs_bench_rand(&seed) & 0xffff, fs_bench_rand(&seed));
+		switch_thread_rwlock_create(&session->rwlock, pool);
+		switch_core_hash_insert(global_table, session->uuid_str, session);
+		switch_core_hash_insert(bench_partition(session->uuid_str)->table, session->uuid_str, session);
+	}
+
+	for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+		ret |= run(pool, "one mutex", global_worker, counts[i]);
+		ret |= run(pool, "partitions", partitioned_worker, counts[i]);
+	}
+
+	for (i = 0; i < SWITCH_SESSION_TABLE_PARTITIONS; i++) {
+		switch_core_hash_destroy(&partitions[i].table);
+	}
+	switch_core_hash_destroy(&global_table);
+
+	apr_pool_destroy(pool);
+	apr_terminate();
+
+	return ret;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
@@ -0,0 +1,181 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * bench_mix.c -- one conference mix frame for 10, 100 and 500 members with a few of them talking
+ *
+ * The per member loop mod_conference used to run, a scalar mix-minus for every member, is timed next to the
+ * conference_mix.h kernels driven the way conference_mix_write_member drives them: one listen frame shared by
+ * everybody who did not speak and a mix-minus for the speakers only.  Copying the result stands in for the write to
+ * the member's mux buffer, and every member's output is compared between the two.
+ */
+#include "fs_bench.h"
+#include "conference_mix.h"
+
+/* 20ms at 16kHz */
+#define BENCH_SAMPLES 320
+#define BENCH_FRAMES 10000
+#define BENCH_SPEAKERS 3
+#define BENCH_MAX_MEMBERS 500
+
+typedef struct {
+	int16_t frame[BENCH_SAMPLES];
+	int16_t out[BENCH_SAMPLES];
+	uint32_t read;
+	int has_audio;
+} bench_member_t;
+
+static bench_member_t members[BENCH_MAX_MEMBERS];
+static int16_t ref[BENCH_MAX_MEMBERS][BENCH_SAMPLES];
+static int32_t main_frame[BENCH_SAMPLES];
+static int16_t write_frame[BENCH_SAMPLES], listen_frame[BENCH_SAMPLES];
+
+static void mix_scalar(uint32_t count)
+{
+	uint32_t i, x;
+	int32_t z;
+
+	memset(main_frame, 0, sizeof(main_frame));
+
+	for (i = 0; i < count; i++) {
+		if (members[i].has_audio) {
+			for (x = 0; x < members[i].read / 2; x++) {
+				main_frame[x] += (int32_t) members[i].frame[x];
+			}
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		bench_member_t *m = &members[i];
+
+		for (x = 0; x < BENCH_SAMPLES; x++) {
+			z = main_frame[x];
+			if (m->has_audio && x < m->read / 2) {
+				z -= (int32_t) m->frame[x];
+			}
+			switch_normalize_to_16bit(z);
+			write_frame[x] = (int16_t) z;
+		}
+		memcpy(m->out, write_frame, sizeof(write_frame));
+	}
+}
+
+static void mix_shared(uint32_t count)
+{
+	uint32_t i;
+
+	memset(main_frame, 0, sizeof(main_frame));
+
+	for (i = 0; i < count; i++) {
+		if (members[i].has_audio) {
+			conference_mix_add(main_frame, members[i].frame, members[i].read / 2);
+		}
+	}
+
+	conference_mix_out(listen_frame, main_frame, NULL, BENCH_SAMPLES);
+
+	for (i = 0; i < count; i++) {
+		bench_member_t *m = &members[i];
+
+		if (m->has_audio) {
+			conference_mix_out(write_frame, main_frame, m->frame, m->read / 2);
+			memcpy(m->out, write_frame, sizeof(write_frame));
+		} else {
+			memcpy(m->out, listen_frame, sizeof(listen_frame));
+		}
+	}
+}
+
+static int run(uint32_t count)
+{
+	uint32_t i, n;
+	uint64_t start;
+	char what[80];
+	int ret = 0;
+
+	start = fs_bench_ns();
+	for (n = 0; n < BENCH_FRAMES; n++) {
+		mix_scalar(count);
+		fs_bench_clobber(members);
+	}
+	switch_snprintf(what, sizeof(what), "mix, %u members, %u talking (per member)", count, BENCH_SPEAKERS);
+	fs_bench_report(what, fs_bench_ns() - start, BENCH_FRAMES, "frame");
+
+	for (i = 0; i < count; i++) {
+		memcpy(ref[i], members[i].out, sizeof(ref[i]));
+	}
+
+	start = fs_bench_ns();
+	for (n = 0; n < BENCH_FRAMES; n++) {
+		mix_shared(count);
+		fs_bench_clobber(members);
+	}
+	switch_snprintf(what, sizeof(what), "mix, %u members, %u talking (listen frame)", count, BENCH_SPEAKERS);
+	fs_bench_report(what, fs_bench_ns() - start, BENCH_FRAMES, "frame");
+
+	for (i = 0; i < count; i++) {
+		if (memcmp(ref[i], members[i].out, sizeof(ref[i]))) {
+			printf("%u members: member %u hears something else\n", count, i);
+			ret = 1;
+			break;
+		}
+	}
+
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t counts[] = { 10, 100, 500 }, i, x, seed = 0x5eedc0f;
+	int ret = 0;
+
+	/* loud enough that three talkers together clip now and then */
+	for (i = 0; i < BENCH_MAX_MEMBERS; i++) {
+		members[i].read = BENCH_SAMPLES * 2;
+		members[i].has_audio = i < BENCH_SPEAKERS;
+		for (x = 0; x < BENCH_SAMPLES; x++) {
+			members[i].frame[x] = (int16_t) ((int32_t) (int16_t) fs_bench_rand(&seed) / 2);
+		}
+	}
+
+	for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+		ret |= run(counts[i]);
+	}
+
+	return ret;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
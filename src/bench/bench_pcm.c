@@ -0,0 +1,298 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * bench_pcm.c -- ns per frame of the G.711 codecs and the bulk PCM helpers
+ *
+ * The G.711 codecs are timed through the implementations CORE_PCM_MODULE registers, the helpers through the
+ * switch_resample.h calls, so whatever kernel the cpu dispatch picks is what gets measured.  Each one is run next to
+ * the plain scalar loop it replaced and the outputs are compared.
+ */
+#include "fs_bench.h"
+#include <g711.h>
+
+#define BENCH_FRAMES 200000
+#define BENCH_MAX_SAMPLES 960
+
+extern switch_loadable_module_function_table_t CORE_PCM_MODULE_module_interface;
+
+static int16_t pcm_in[BENCH_MAX_SAMPLES * 2], pcm_other[BENCH_MAX_SAMPLES], pcm_out[BENCH_MAX_SAMPLES * 2], pcm_ref[BENCH_MAX_SAMPLES * 2];
+static uint8_t g711_out[BENCH_MAX_SAMPLES], g711_ref[BENCH_MAX_SAMPLES];
+static float float_out[BENCH_MAX_SAMPLES], float_ref[BENCH_MAX_SAMPLES];
+static int failed;
+
+static void report(const char *what, uint32_t samples, const char *how, uint64_t ns)
+{
+	char name[80];
+
+	switch_snprintf(name, sizeof(name), "%s, %u samples (%s)", what, samples, how);
+	fs_bench_report(name, ns, BENCH_FRAMES, "frame");
+}
+
+static void compare(const char *what, uint32_t samples, const void *a, const void *b, size_t len)
+{
+	if (memcmp(a, b, len)) {
+		printf("%s, %u samples: output differs from the scalar loop\n", what, samples);
+		failed++;
+	}
+}
+
+static const switch_codec_implementation_t *find_implementation(switch_loadable_module_interface_t *mod, const char *name, uint32_t samples)
+{
+	switch_codec_interface_t *ci;
+	const switch_codec_implementation_t *impl;
+
+	for (ci = mod->codec_interface; ci; ci = ci->next) {
+		if (!strcmp(ci->interface_name, name)) {
+			for (impl = ci->implementations; impl; impl = impl->next) {
+				if (impl->samples_per_packet == samples) {
+					return impl;
+				}
+			}
+		}
+	}
+
+	fprintf(stderr, "%s has no %u sample implementation\n", name, samples);
+	exit(1);
+}
+
+static void bench_g711(switch_loadable_module_interface_t *mod, const char *name, uint32_t samples)
+{
+	const switch_codec_implementation_t *impl = find_implementation(mod, name, samples);
+	int ulaw = !strcmp(name, "G.711 ulaw");
+	switch_codec_t codec = { 0 };
+	uint32_t i, n, len, rate;
+	unsigned int flag = 0;
+	char what[64];
+	uint64_t start;
+
+	codec.implementation = impl;
+
+	switch_snprintf(what, sizeof(what), "%s encode", name);
+	start = fs_bench_ns();
+	for (n = 0; n < BENCH_FRAMES; n++) {
+		impl->encode(&codec, NULL, pcm_in, samples * 2, 8000, g711_out, &len, &rate, &flag);
+		fs_bench_clobber(g711_out);
+	}
+	report(what, samples, "table", fs_bench_ns() - start);
+
+	start = fs_bench_ns();
+	for (n = 0; n < BENCH_FRAMES; n++) {
+		for (i = 0; i < samples; i++) {
+			g711_ref[i] = ulaw ? linear_to_ulaw(pcm_in[i]) : linear_to_alaw(pcm_in[i]);
+		}
+		fs_bench_clobber(g711_ref);
+	}
+	report(what, samples, "g711.h", fs_bench_ns() - start);
+	compare(what, samples, g711_out, g711_ref, samples);
+
+	switch_snprintf(what, sizeof(what), "%s decode", name);
+	start = fs_bench_ns();
+	for (n = 0; n < BENCH_FRAMES; n++) {
+		impl->decode(&codec, NULL, g711_ref, samples, 8000, pcm_out, &len, &rate, &flag);
+		fs_bench_clobber(pcm_out);
+	}
+	report(what, samples, "table", fs_bench_ns() - start);
+
+	start = fs_bench_ns();
+	for (n = 0; n < BENCH_FRAMES; n++) {
+		for (i = 0; i < samples; i++) {
+			pcm_ref[i] = ulaw ? ulaw_to_linear(g711_ref[i]) : alaw_to_linear(g711_ref[i]);
+		}
+		fs_bench_clobber(pcm_ref);
+	}
+	report(what, samples, "g711.h", fs_bench_ns() - start);
+	compare(what, samples, pcm_out, pcm_ref, samples * 2);
+}
+
+/* the in place helpers get a fresh copy of the input every frame, the scalar loops too so the copy cancels out */
+static void bench_helpers(uint32_t samples)
+{
+	uint32_t i, j, n;
+	int32_t z;
+	uint64_t start;
+
+	start = fs_bench_ns();
+	for (n = 0; n < BENCH_FRAMES; n++) {
+		memcpy(pcm_out, pcm_in, samples * 2);
+		switch_change_sln_volume(pcm_out, samples, 2);
+		fs_bench_clobber(pcm_out);
+	}
+	report("switch_change_sln_volume +2", samples, "library", fs_bench_ns() - start);
+
+	start = fs_bench_ns();
+	for (n = 0; n < BENCH_FRAMES; n++) {
+		/* switch_change_sln_volume turns a level of 2 into a factor of 3 * 1.3 */
+		double newrate = 3 * 1.3;
+
+		memcpy(pcm_ref, pcm_in, samples * 2);
+		for (i = 0; i < samples; i++) {
+			z = (int32_t) (pcm_ref[i] * newrate);
+			switch_normalize_to_16bit(z);
+			pcm_ref[i] = (int16_t) z;
+		}
+		fs_bench_clobber(pcm_ref);
+	}
+	report("switch_change_sln_volume +2", samples, "scalar", fs_bench_ns() - start);
+	compare("switch_change_sln_volume +2", samples, pcm_out, pcm_ref, samples * 2);
+
+	start = fs_bench_ns();
+	for (n = 0; n < BENCH_FRAMES; n++) {
+		memcpy(pcm_out, pcm_in, samples * 2);
+		switch_merge_sln(pcm_out, samples, pcm_other, samples);
+		fs_bench_clobber(pcm_out);
+	}
+	report("switch_merge_sln", samples, "library", fs_bench_ns() - start);
+
+	start = fs_bench_ns();
+	for (n = 0; n < BENCH_FRAMES; n++) {
+		memcpy(pcm_ref, pcm_in, samples * 2);
+		for (i = 0; i < samples; i++) {
+			z = pcm_ref[i] + pcm_other[i];
+			switch_normalize_to_16bit(z);
+			pcm_ref[i] = (int16_t) z;
+		}
+		fs_bench_clobber(pcm_ref);
+	}
+	report("switch_merge_sln", samples, "scalar", fs_bench_ns() - start);
+	compare("switch_merge_sln", samples, pcm_out, pcm_ref, samples * 2);
+
+	start = fs_bench_ns();
+	for (n = 0; n < BENCH_FRAMES; n++) {
+		memcpy(pcm_out, pcm_in, samples * 4);
+		switch_mux_channels(pcm_out, samples, 2);
+		fs_bench_clobber(pcm_out);
+	}
+	report("switch_mux_channels stereo", samples, "library", fs_bench_ns() - start);
+
+	start = fs_bench_ns();
+	for (n = 0; n < BENCH_FRAMES; n++) {
+		memcpy(pcm_ref, pcm_in, samples * 4);
+		for (i = 0; i < samples; i++) {
+			int16_t out = 0;
+
+			for (j = 0; j < 2; j++) {
+				z = out + pcm_ref[i * 2 + j];
+				switch_normalize_to_16bit(z);
+				out = (int16_t) z;
+			}
+			pcm_ref[i] = out;
+		}
+		fs_bench_clobber(pcm_ref);
+	}
+	report("switch_mux_channels stereo", samples, "scalar", fs_bench_ns() - start);
+	compare("switch_mux_channels stereo", samples, pcm_out, pcm_ref, samples * 2);
+
+	start = fs_bench_ns();
+	for (n = 0; n < BENCH_FRAMES; n++) {
+		switch_short_to_float(pcm_in, float_out, samples);
+		fs_bench_clobber(float_out);
+	}
+	report("switch_short_to_float", samples, "library", fs_bench_ns() - start);
+
+	start = fs_bench_ns();
+	for (n = 0; n < BENCH_FRAMES; n++) {
+		for (i = 0; i < samples; i++) {
+			float_ref[i] = (float) (pcm_in[i]) / (float) 0x8000;
+		}
+		fs_bench_clobber(float_ref);
+	}
+	report("switch_short_to_float", samples, "scalar", fs_bench_ns() - start);
+	compare("switch_short_to_float", samples, float_out, float_ref, samples * sizeof(float));
+
+	/* the seed comes from the clock, so only the time is compared here */
+	start = fs_bench_ns();
+	for (n = 0; n < BENCH_FRAMES; n++) {
+		switch_generate_sln_silence(pcm_out, samples, 400);
+		fs_bench_clobber(pcm_out);
+	}
+	report("switch_generate_sln_silence /400", samples, "library", fs_bench_ns() - start);
+
+	start = fs_bench_ns();
+	for (n = 0; n < BENCH_FRAMES; n++) {
+		int16_t rnd2 = (int16_t) n;
+
+		for (i = 0; i < samples; i++) {
+			int sum_rnd = 0;
+
+			for (j = 0; j < 6; j++) {
+				rnd2 = rnd2 * 31821U + 13849U;
+				sum_rnd += rnd2;
+			}
+			pcm_ref[i] = (int16_t) ((int16_t) sum_rnd / 400);
+		}
+		fs_bench_clobber(pcm_ref);
+	}
+	report("switch_generate_sln_silence /400", samples, "scalar", fs_bench_ns() - start);
+}
+
+int main(int argc, char *argv[])
+{
+	switch_memory_pool_t *pool = fs_bench_pool();
+	switch_loadable_module_interface_t *mod = NULL;
+	uint32_t i, seed = 0x5eed711;
+
+	if (CORE_PCM_MODULE_module_interface.load(&mod, pool) != SWITCH_STATUS_SUCCESS || !mod) {
+		fprintf(stderr, "cannot load CORE_PCM_MODULE\n");
+		return 1;
+	}
+
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	printf("cpu: avx2 %s, sse2 %s\n", __builtin_cpu_supports("avx2") ? "yes" : "no", __builtin_cpu_supports("sse2") ? "yes" : "no");
+#endif
+
+	for (i = 0; i < BENCH_MAX_SAMPLES * 2; i++) {
+		pcm_in[i] = (int16_t) fs_bench_rand(&seed);
+	}
+
+	for (i = 0; i < BENCH_MAX_SAMPLES; i++) {
+		pcm_other[i] = (int16_t) fs_bench_rand(&seed);
+	}
+
+	/* 20ms at 8kHz and at 48kHz */
+	bench_g711(mod, "G.711 ulaw", 160);
+	bench_g711(mod, "G.711 alaw", 160);
+	bench_helpers(160);
+	bench_helpers(960);
+
+	apr_pool_destroy(pool);
+	apr_terminate();
+
+	return failed ? 1 : 0;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
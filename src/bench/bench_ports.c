@@ -0,0 +1,213 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * bench_ports.c -- RTP port requests as the range fills up, bitmap allocator against the old track array
+ *
+ * An even port range of 8192 pairs is filled to a given occupancy, then every step requests a port and frees a
+ * random one that is held so the occupancy stays put.  Each request is timed on its own since the complaint about
+ * the old allocator was the tail near exhaustion, not the average.  The old allocator is rebuilt below from
+ * what switch_core_port_allocator_request_port used to do: one mutex, srand on every call, a random index and a
+ * walk up an int8 track until a free entry turns up.  Quarantine is off in a core that was never started, so both
+ * give a released port back at once.
+ */
+#include "fs_bench.h"
+
+#define BENCH_START 16384
+#define BENCH_END 32766
+#define BENCH_PAIRS ((BENCH_END - BENCH_START) / 2 + 1)
+#define BENCH_STEPS 200000
+
+typedef struct {
+	int8_t track[BENCH_PAIRS];
+	uint32_t track_used;
+	switch_mutex_t *mutex;
+} bench_old_allocator_t;
+
+static bench_old_allocator_t old_alloc;
+static switch_core_port_allocator_t *alloc;
+static switch_port_t held[BENCH_PAIRS];
+static uint64_t took[BENCH_STEPS];
+
+static int cmp_ns(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static switch_status_t old_request_port(switch_port_t *port_ptr)
+{
+	switch_status_t status = SWITCH_STATUS_FALSE;
+	uint32_t index, tries;
+
+	switch_mutex_lock(old_alloc.mutex);
+	srand((unsigned) ((unsigned) (intptr_t) port_ptr + (unsigned) (intptr_t) switch_thread_self() + switch_time_now()));
+
+	/* a released entry counts up from -4 on every walk past it, so a nearly full track takes several walks */
+	while (status != SWITCH_STATUS_SUCCESS && old_alloc.track_used < BENCH_PAIRS) {
+		index = rand() % BENCH_PAIRS;
+
+		for (tries = 0; old_alloc.track[index] && tries < BENCH_PAIRS; tries++) {
+			if (old_alloc.track[index] < 0) {
+				old_alloc.track[index]++;
+			}
+			if (++index >= BENCH_PAIRS) {
+				index = 0;
+			}
+		}
+
+		if (tries < BENCH_PAIRS) {
+			old_alloc.track[index] = 1;
+			old_alloc.track_used++;
+			*port_ptr = (switch_port_t) (BENCH_START + index * 2);
+			status = SWITCH_STATUS_SUCCESS;
+		}
+	}
+
+	switch_mutex_unlock(old_alloc.mutex);
+
+	return status;
+}
+
+static switch_status_t old_free_port(switch_port_t port)
+{
+	switch_status_t status = SWITCH_STATUS_FALSE;
+	uint32_t index = (port - BENCH_START) / 2;
+
+	switch_mutex_lock(old_alloc.mutex);
+	if (old_alloc.track[index] > 0) {
+		old_alloc.track[index] = -4;
+		old_alloc.track_used--;
+		status = SWITCH_STATUS_SUCCESS;
+	}
+	switch_mutex_unlock(old_alloc.mutex);
+
+	return status;
+}
+
+static switch_status_t new_request_port(switch_port_t *port_ptr)
+{
+	return switch_core_port_allocator_request_port(alloc, port_ptr);
+}
+
+static switch_status_t new_free_port(switch_port_t port)
+{
+	return switch_core_port_allocator_free_port(alloc, port);
+}
+
+static int run(const char *how, switch_status_t (*request_port) (switch_port_t *), switch_status_t (*free_port) (switch_port_t),
+			   uint32_t permille)
+{
+	uint32_t count = (uint32_t) (((uint64_t) BENCH_PAIRS * permille) / 1000), i, n, seed = 0x5eed9047;
+	uint64_t start, total = 0;
+	char what[80];
+	int ret = 0;
+
+	for (i = 0; i < count; i++) {
+		if (request_port(&held[i]) != SWITCH_STATUS_SUCCESS) {
+			printf("%s: filling to %u of %u failed\n", how, count, BENCH_PAIRS);
+			return 1;
+		}
+	}
+
+	for (n = 0; n < BENCH_STEPS; n++) {
+		switch_port_t port;
+		uint32_t victim = fs_bench_rand(&seed) % count;
+
+		start = fs_bench_ns();
+		if (request_port(&port) != SWITCH_STATUS_SUCCESS) {
+			printf("%s: request %u at %u of %u failed\n", how, n, count, BENCH_PAIRS);
+			ret = 1;
+			break;
+		}
+		took[n] = fs_bench_ns() - start;
+		total += took[n];
+
+		if (port < BENCH_START || port > BENCH_END || (port % 2) || free_port(held[victim]) != SWITCH_STATUS_SUCCESS) {
+			printf("%s: bad port %u or could not free %u\n", how, port, held[victim]);
+			ret = 1;
+			break;
+		}
+		held[victim] = port;
+	}
+
+	switch_snprintf(what, sizeof(what), "request_port, %u.%u%% of %u pairs in use (%s)", permille / 10, permille % 10, BENCH_PAIRS, how);
+	fs_bench_report(what, total, n, "request");
+	if (n) {
+		qsort(took, n, sizeof(took[0]), cmp_ns);
+		printf("    p99 %llu ns, worst %llu ns\n", (unsigned long long) took[n * 99 / 100], (unsigned long long) took[n - 1]);
+	}
+
+	for (i = 0; i < count; i++) {
+		free_port(held[i]);
+	}
+
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	switch_memory_pool_t *pool = fs_bench_pool();
+	uint32_t levels[] = { 500, 900, 990, 999 }, i, total = 0, used = 0, quarantined = 0;
+	int ret = 0;
+
+	switch_mutex_init(&old_alloc.mutex, SWITCH_MUTEX_NESTED, pool);
+
+	if (switch_core_port_allocator_new(BENCH_START, BENCH_END, SPF_EVEN, &alloc) != SWITCH_STATUS_SUCCESS) {
+		fprintf(stderr, "cannot create the port allocator\n");
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+		ret |= run("track array", old_request_port, old_free_port, levels[i]);
+		ret |= run("bitmap", new_request_port, new_free_port, levels[i]);
+	}
+
+	switch_core_port_allocator_get_stats(alloc, &total, &used, &quarantined);
+	if (total != BENCH_PAIRS || used || quarantined) {
+		printf("stats after the run: total %u used %u quarantined %u\n", total, used, quarantined);
+		ret = 1;
+	}
+
+	switch_core_port_allocator_destroy(&alloc);
+	apr_pool_destroy(pool);
+	apr_terminate();
+
+	return ret;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
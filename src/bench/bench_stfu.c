@@ -0,0 +1,182 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * bench_stfu.c -- replay synthetic loss and reorder traces through the stfu jitter buffer
+ *
+ * A trace is one entry per 20ms tick in arrival order.  Every tick eats the packet that arrived, if any, and reads
+ * one frame, the way read_rtp_packet drives the buffer.  stfu is not exported by libfreeswitch so it is built in.
+ */
+#include "fs_bench.h"
+#include <stfu.h>
+
+#define BENCH_PACKETS 1000000
+#define BENCH_SAMPLES 160
+
+typedef struct {
+	const char *name;
+	/* all in units of 1/1000 */
+	uint32_t loss;
+	uint32_t burst;
+	uint32_t reorder;
+	uint32_t duplicate;
+} bench_trace_t;
+
+static const bench_trace_t traces[] = {
+	{"clean", 0, 0, 0, 0},
+	{"2% loss", 20, 0, 0, 0},
+	{"5% reorder", 0, 0, 50, 0},
+	{"5% loss, 5% reorder", 50, 0, 50, 0},
+	{"10% loss, 10% reorder, 1% dup", 100, 0, 100, 10},
+	{"1% bursts of 5 lost", 0, 10, 0, 0}
+};
+
+typedef struct {
+	/* -1 is a tick with nothing on the wire */
+	int32_t seq;
+	/* a duplicate shows up in the same tick as the packet before it */
+	uint8_t same_tick;
+} bench_arrival_t;
+
+static uint32_t build_trace(const bench_trace_t *t, bench_arrival_t *arrivals, uint32_t seed)
+{
+	uint32_t k, n = 0, lose = 0;
+
+	for (k = 0; k < BENCH_PACKETS; k++) {
+		arrivals[n].same_tick = 0;
+
+		if (lose || fs_bench_rand(&seed) % 1000 < t->loss) {
+			arrivals[n++].seq = -1;
+			if (lose) {
+				lose--;
+			}
+			continue;
+		}
+
+		if (fs_bench_rand(&seed) % 1000 < t->burst) {
+			arrivals[n++].seq = -1;
+			lose = 4;
+			continue;
+		}
+
+		arrivals[n++].seq = (int32_t) k;
+
+		if (fs_bench_rand(&seed) % 1000 < t->duplicate) {
+			arrivals[n].seq = (int32_t) k;
+			arrivals[n++].same_tick = 1;
+		}
+	}
+
+	/* a reordered packet trades places with one of the next three arrivals */
+	for (k = 0; k + 3 < n; k++) {
+		if (!arrivals[k].same_tick && fs_bench_rand(&seed) % 1000 < t->reorder) {
+			uint32_t j = k + 1 + fs_bench_rand(&seed) % 3;
+			int32_t seq = arrivals[k].seq;
+
+			if (!arrivals[j].same_tick) {
+				arrivals[k].seq = arrivals[j].seq;
+				arrivals[j].seq = seq;
+			}
+		}
+	}
+
+	return n;
+}
+
+static void replay(const bench_trace_t *t, bench_arrival_t *arrivals, uint32_t qlen)
+{
+	static uint8_t payload[BENCH_SAMPLES];
+	stfu_instance_t *jb = stfu_n_init(qlen);
+	stfu_frame_t *frame;
+	stfu_report_t r;
+	uint32_t k, n, ticks = 0, backwards = 0, last_ts = 0, played = 0;
+	uint64_t start, ns;
+	char name[80];
+
+	n = build_trace(t, arrivals, 0x5eed0000 ^ (uint32_t) (t - traces));
+
+	start = fs_bench_ns();
+	for (k = 0; k < n; k++) {
+		if (arrivals[k].seq >= 0) {
+			stfu_n_eat(jb, (uint32_t) arrivals[k].seq * BENCH_SAMPLES, 0, payload, sizeof(payload));
+		}
+
+		if (k + 1 < n && arrivals[k + 1].same_tick) {
+			continue;
+		}
+
+		ticks++;
+
+		if ((frame = stfu_n_read_a_frame(jb)) && !frame->plc) {
+			if (played && frame->ts <= last_ts) {
+				backwards++;
+			}
+			last_ts = frame->ts;
+			played++;
+		}
+	}
+	ns = fs_bench_ns() - start;
+
+	stfu_n_report(jb, &r);
+	stfu_n_destroy(&jb);
+
+	switch_snprintf(name, sizeof(name), "stfu qlen %u, %s", qlen, t->name);
+	fs_bench_report(name, ns, ticks, "tick");
+	printf("    in %u out %u plc %u late %u dup %u dropped %u underruns %u resets %u, target depth %u, %u out of order\n",
+		   r.packets_in, r.packets_out, r.plc, r.late, r.duplicate, r.dropped, r.underruns, r.resets, r.out_size, backwards);
+}
+
+int main(int argc, char *argv[])
+{
+	bench_arrival_t *arrivals = malloc(BENCH_PACKETS * 2 * sizeof(*arrivals));
+	uint32_t qlens[] = { 5, 50 }, q, x;
+
+	if (!arrivals) {
+		return 1;
+	}
+
+	for (q = 0; q < sizeof(qlens) / sizeof(qlens[0]); q++) {
+		for (x = 0; x < sizeof(traces) / sizeof(traces[0]); x++) {
+			replay(&traces[x], arrivals, qlens[q]);
+		}
+	}
+
+	free(arrivals);
+
+	return 0;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
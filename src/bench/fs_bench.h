@@ -0,0 +1,94 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * fs_bench.h -- helpers shared by the benchmark programs (make bench)
+ *
+ * The benchmarks link against libfreeswitch but never start the core, they only create an apr pool.  A core
+ * that was never initialized has a hard log level of SWITCH_LOG_CONSOLE, so the code under test logs nothing.
+ */
+#ifndef FS_BENCH_H
+#define FS_BENCH_H
+
+#include <switch.h>
+#include <apr_general.h>
+#include <apr_pools.h>
+#include <time.h>
+
+static inline uint64_t fs_bench_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/* xorshift32, the same seed gives the same workload on every run */
+static inline uint32_t fs_bench_rand(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+/* keeps the compiler from dropping or merging the iterations of a loop whose result lands in p */
+static inline void fs_bench_clobber(void *p)
+{
+	__asm__ __volatile__("" : : "g"(p) : "memory");
+}
+
+static inline switch_memory_pool_t *fs_bench_pool(void)
+{
+	apr_pool_t *pool = NULL;
+
+	if (apr_initialize() != APR_SUCCESS || apr_pool_create(&pool, NULL) != APR_SUCCESS) {
+		fprintf(stderr, "cannot create a memory pool\n");
+		exit(1);
+	}
+
+	return pool;
+}
+
+static inline void fs_bench_report(const char *name, uint64_t ns, uint64_t ops, const char *unit)
+{
+	printf("%-56s %12.1f ns/%s  (n=%llu)\n", name, ops ? (double) ns / (double) ops : 0.0, unit, (unsigned long long) ops);
+}
+
+#endif
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
@@ -104,6 +104,8 @@ struct switch_core_session {
 	switch_size_t id;
 	switch_session_flag_t flags;
 	int thread_running;
+	/* set while a pooled session is idle without a thread, see switch_core_session_run_yield */
+	volatile uint32_t dormant;
 	switch_channel_t *channel;
 
 	switch_io_event_hooks_t event_hooks;
@@ -227,17 +229,40 @@ struct switch_runtime {
 	switch_profile_timer_t *profile_timer;
 	double profile_time;
 	double min_idle_time;
+	uint32_t cpu_count;
+	int32_t resample_quality;
+	uint32_t resample_pool_size;
+	uint32_t port_quarantine_ms;
 };
 
 extern struct switch_runtime runtime;
 
 
+/* the session table is split by uuid hash so locates on different calls do not contend, must be a power of 2 */
+#define SWITCH_SESSION_TABLE_PARTITIONS 64
+
+typedef struct {
+	switch_thread_rwlock_t *rwlock;
+	switch_hash_t *table;
+} switch_session_partition_t;
+
 struct switch_session_manager {
 	switch_memory_pool_t *memory_pool;
-	switch_hash_t *session_table;
+	switch_session_partition_t session_table[SWITCH_SESSION_TABLE_PARTITIONS];
 	uint32_t session_count;
 	uint32_t session_limit;
 	switch_size_t session_id;
+	/* optional pool of reusable threads for session and helper threads */
+	switch_bool_t thread_pool;
+	uint32_t thread_pool_idle_min;
+	switch_mutex_t *thread_pool_mutex;
+	switch_thread_cond_t *thread_pool_cond;
+	struct switch_session_job *thread_pool_jobs;
+	struct switch_session_job *thread_pool_jobs_tail;
+	uint32_t thread_pool_pending;
+	uint32_t thread_pool_idle;
+	uint32_t thread_pool_running;
+	switch_bool_t thread_pool_stopping;
 };
 
 extern struct switch_session_manager session_manager;
@@ -246,8 +271,16 @@ extern struct switch_session_manager session_manager;
 
 switch_status_t switch_core_sqldb_start(switch_memory_pool_t *pool, switch_bool_t manage);
 void switch_core_sqldb_stop(void);
+void switch_core_registry_init(switch_memory_pool_t *pool);
+void switch_core_registry_shutdown(void);
+void switch_core_registry_event(switch_event_t *event);
 void switch_core_session_init(switch_memory_pool_t *pool);
 void switch_core_session_uninit(void);
+void switch_core_session_thread_pool_stop(void);
+void switch_core_session_resume(switch_core_session_t *session);
+switch_bool_t switch_core_session_run_yield(switch_core_session_t *session);
 void switch_core_state_machine_init(switch_memory_pool_t *pool);
+void switch_resample_pool_init(switch_memory_pool_t *pool);
+void switch_resample_pool_shutdown(void);
 switch_memory_pool_t *switch_core_memory_init(void);
 void switch_core_memory_stop(void);
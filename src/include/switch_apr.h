@@ -512,6 +512,75 @@ SWITCH_DECLARE(switch_status_t) switch_thread_cond_destroy(switch_thread_cond_t
 
 /** @} */
 
+/**
+ * @defgroup switch_atomic Atomic Operations
+ * @ingroup switch_apr
+ * @{
+ */
+
+/**
+ * atomically read a uint32_t from memory
+ * @param mem pointer to the value
+ */
+SWITCH_DECLARE(uint32_t) switch_atomic_read(volatile uint32_t *mem);
+
+/**
+ * atomically set a uint32_t in memory
+ * @param mem pointer to the value
+ * @param val value to store
+ */
+SWITCH_DECLARE(void) switch_atomic_set(volatile uint32_t *mem, uint32_t val);
+
+/**
+ * atomically add 'val' to a uint32_t
+ * @param mem pointer to the value
+ * @param val amount to add
+ * @return the old value of *mem
+ */
+SWITCH_DECLARE(uint32_t) switch_atomic_add(volatile uint32_t *mem, uint32_t val);
+
+/**
+ * atomically increment a uint32_t by 1
+ * @param mem pointer to the value
+ * @return the old value of *mem
+ */
+SWITCH_DECLARE(uint32_t) switch_atomic_inc(volatile uint32_t *mem);
+
+/**
+ * atomically decrement a uint32_t by 1
+ * @param mem pointer to the value
+ * @return zero if the value becomes zero on decrement, otherwise non-zero
+ */
+SWITCH_DECLARE(int) switch_atomic_dec(volatile uint32_t *mem);
+
+/**
+ * compare a uint32_t's value with 'cmp', if they are the same swap the value with 'with'
+ * @param mem pointer to the value
+ * @param with what to swap it with
+ * @param cmp the value to compare it to
+ * @return the old value of *mem
+ */
+SWITCH_DECLARE(uint32_t) switch_atomic_cas(volatile uint32_t *mem, uint32_t with, uint32_t cmp);
+
+/**
+ * exchange a uint32_t's value with 'val'
+ * @param mem pointer to the value
+ * @param val what to swap it with
+ * @return the old value of *mem
+ */
+SWITCH_DECLARE(uint32_t) switch_atomic_xchg(volatile uint32_t *mem, uint32_t val);
+
+/**
+ * compare the pointer's value with cmp, if they are the same swap the value with 'with'
+ * @param mem pointer to the pointer
+ * @param with what to swap it with
+ * @param cmp the value to compare it to
+ * @return the old value of the pointer
+ */
+SWITCH_DECLARE(void *) switch_atomic_casptr(volatile void **mem, void *with, const void *cmp);
+
+/** @} */
+
 /**
  * @defgroup switch_UUID UUID Handling
  * @ingroup switch_apr
@@ -1135,6 +1204,28 @@ SWITCH_DECLARE(switch_status_t) switch_socket_recvfrom(switch_sockaddr_t *from,
 
 SWITCH_DECLARE(switch_status_t) switch_socket_atmark(switch_socket_t *sock, int *atmark);
 
+/**
+ * Get the native descriptor behind a socket
+ * @param sock The socket
+ * @return the os descriptor or -1
+ */
+SWITCH_DECLARE(int) switch_socket_fd_get(switch_socket_t *sock);
+
+/**
+ * Get the native sockaddr behind an apr_sockaddr_t
+ * @param sa The address
+ * @param len Filled with the length of the native address
+ */
+SWITCH_DECLARE(const void *) switch_sockaddr_raw_get(switch_sockaddr_t *sa, uint32_t *len);
+
+/**
+ * Fill an apr_sockaddr_t from a native sockaddr (as returned by recvmmsg and friends)
+ * @param sa The address to fill in
+ * @param raw The native sockaddr
+ * @param len The length of the native sockaddr
+ */
+SWITCH_DECLARE(switch_status_t) switch_sockaddr_raw_set(switch_sockaddr_t *sa, const void *raw, uint32_t len);
+
 /**
  * Read data from a network.
  * @param sock The socket to read the data from.
@@ -300,6 +300,16 @@ SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_request_port(_In_ swi
 */
 SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_free_port(_In_ switch_core_port_allocator_t *alloc, _In_ switch_port_t port);
 
+/*!
+  \brief Get the occupancy of the port allocator
+  \param alloc the allocator object
+  \param total the number of ports (or port pairs) it manages
+  \param used the number of ports handed out
+  \param quarantined the number of released ports still resting before reuse
+*/
+SWITCH_DECLARE(void) switch_core_port_allocator_get_stats(_In_ switch_core_port_allocator_t *alloc, _Out_opt_ uint32_t *total, _Out_opt_ uint32_t *used,
+														  _Out_opt_ uint32_t *quarantined);
+
 /*!
   \brief destroythe port allocator
   \param alloc the allocator object
@@ -1976,10 +1986,23 @@ SWITCH_DECLARE(void) switch_time_set_monotonic(switch_bool_t enable);
 SWITCH_DECLARE(void) switch_time_set_nanosleep(switch_bool_t enable);
 SWITCH_DECLARE(void) switch_time_set_matrix(switch_bool_t enable);
 SWITCH_DECLARE(void) switch_time_set_cond_yield(switch_bool_t enable);
+/*!
+  \brief Get the total number of times a timer thread woke up and how many of those were early
+  \param wakeups the total wakeups
+  \param spurious the wakeups that found their tick not yet due
+*/
+SWITCH_DECLARE(void) switch_time_get_wakeup_stats(uint64_t *wakeups, uint64_t *spurious);
+/*!
+  \brief Write the per interval timer wakeup counters to a stream
+  \param stream the stream to write to
+  \param delim the column delimiter
+*/
+SWITCH_DECLARE(void) switch_time_dump_timer_stats(switch_stream_handle_t *stream, const char *delim);
 SWITCH_DECLARE(uint32_t) switch_core_min_dtmf_duration(uint32_t duration);
 SWITCH_DECLARE(uint32_t) switch_core_max_dtmf_duration(uint32_t duration);
 SWITCH_DECLARE(double) switch_core_min_idle_cpu(double new_limit);
 SWITCH_DECLARE(double) switch_core_idle_cpu(void);
+SWITCH_DECLARE(uint32_t) switch_core_cpu_count(void);
 SWITCH_DECLARE(uint32_t) switch_core_default_dtmf_duration(uint32_t duration);
 SWITCH_DECLARE(switch_status_t) switch_console_set_complete(const char *string);
 SWITCH_DECLARE(switch_status_t) switch_console_set_alias(const char *string);
@@ -2076,6 +2099,31 @@ SWITCH_DECLARE(switch_status_t) switch_cache_db_execute_sql_callback(switch_cach
 																	 switch_core_db_callback_func_t callback, void *pdata, char **err);
 
 SWITCH_DECLARE(void) switch_cache_db_status(switch_stream_handle_t *stream);
+
+/*!
+  \brief Take a sorted copy of the live channel or call registry
+  \param snapshot the new snapshot
+  \param table channels, calls or channels that are not the b leg of a bridge joined with the call they originated
+  \param column the column to match against or NULL to match uuid, name, caller id name and number
+  \param match an sql style like pattern or NULL for every row
+  \param sort the row order
+  \return SWITCH_STATUS_SUCCESS if the snapshot was taken
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_registry_snapshot(switch_registry_snapshot_t **snapshot, switch_registry_table_t table,
+															   const char *column, const char *match, switch_registry_sort_t sort);
+SWITCH_DECLARE(uint32_t) switch_core_registry_snapshot_size(switch_registry_snapshot_t *snapshot);
+/*!
+  \brief Step through a snapshot, rows and column names are laid out like an sql result
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_registry_snapshot_next(switch_registry_snapshot_t *snapshot, int *argc, char ***argv, char ***columns);
+SWITCH_DECLARE(void) switch_core_registry_snapshot_destroy(switch_registry_snapshot_t **snapshot);
+/*!
+  \brief Run a callback over a registry snapshot the way switch_cache_db_execute_sql_callback runs one over a query
+  \return the number of rows visited or -1 on error
+*/
+SWITCH_DECLARE(int) switch_core_registry_execute_callback(switch_registry_table_t table, const char *column, const char *match,
+														  switch_registry_sort_t sort, switch_core_db_callback_func_t callback, void *pArg);
+SWITCH_DECLARE(uint32_t) switch_core_registry_count(switch_registry_table_t table);
 SWITCH_DECLARE(switch_status_t) _switch_core_db_handle(switch_cache_db_handle_t ** dbh, const char *file, const char *func, int line);
 #define switch_core_db_handle(_a) _switch_core_db_handle(_a, __FILE__, __SWITCH_FUNC__, __LINE__)
 
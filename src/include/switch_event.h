@@ -70,8 +70,19 @@ SWITCH_BEGIN_EXTERN_C
 	/*! hash of the header name */
 	unsigned long hash;
 	struct switch_event_header *next;
+	/*! where the header storage lives (switch_event_header_flag_t) */
+	uint32_t flags;
 };
 
+typedef enum {
+	/*! the header and its value were carved from the event arena and go away with it */
+	EHF_ARENA = (1 << 0),
+	/*! the header name is a shared constant and must not be freed */
+	EHF_INTERNED = (1 << 1)
+} switch_event_header_flag_t;
+
+struct switch_event_arena_block;
+
 /*! \brief Representation of an event */
 struct switch_event {
 	/*! the event id (descriptor) */
@@ -96,10 +107,24 @@ struct switch_event {
 	unsigned long key;
 	struct switch_event *next;
 	int flags;
+	/*! number of headers on the list */
+	uint32_t header_count;
+	/*! open addressing index of the first header of each name, built once the event grows large */
+	switch_event_header_t **index;
+	/*! number of slots in the index (always a power of 2) */
+	uint32_t index_size;
+	/*! number of used slots in the index */
+	uint32_t index_count;
+	/*! bump allocator the headers are carved from, released in one shot on destroy */
+	struct switch_event_arena_block *arena;
+	/*! number of headers that were allocated on the heap instead of the arena */
+	uint32_t heap_headers;
 };
 
 typedef enum {
-	EF_UNIQ_HEADERS = (1 << 0)
+	EF_UNIQ_HEADERS = (1 << 0),
+	/*! headers have been deleted so the event is being used as a variable store, allocate new headers on the heap */
+	EF_HEAP_HEADERS = (1 << 1)
 } switch_event_flag_t;
 
 
@@ -120,6 +145,14 @@ SWITCH_DECLARE(switch_status_t) switch_event_init(switch_memory_pool_t *pool);
 */
 SWITCH_DECLARE(switch_status_t) switch_event_shutdown(void);
 
+/*!
+  \brief Move event dispatch onto the sharded event bus
+  \param shards the number of shards, each with its own lock-free ring and dispatch thread (0 for one per cpu)
+  \return SWITCH_STATUS_SUCCESS if the bus was started
+  \note events carrying a Unique-ID are always dispatched by the same shard so a call's events stay in order
+*/
+SWITCH_DECLARE(switch_status_t) switch_event_bus_start(uint32_t shards);
+
 /*!
   \brief Create an event
   \param event a NULL pointer on which to create the event
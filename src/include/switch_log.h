@@ -67,6 +67,7 @@ SWITCH_BEGIN_EXTERN_C
 } switch_log_node_t;
 
 typedef switch_status_t (*switch_log_function_t) (const switch_log_node_t *node, switch_log_level_t level);
+typedef void (*switch_log_flush_function_t) (void);
 
 
 /*! 
@@ -125,6 +126,14 @@ SWITCH_DECLARE(void) switch_log_vprintf(_In_ switch_text_channel_t channel, _In_
 SWITCH_DECLARE(switch_status_t) switch_log_bind_logger(_In_ switch_log_function_t function, _In_ switch_log_level_t level, _In_ switch_bool_t is_console);
 SWITCH_DECLARE(switch_status_t) switch_log_unbind_logger(_In_ switch_log_function_t function);
 
+/*!
+  \brief Attach a flush callback to a bound logger
+  \param function the logger function passed to switch_log_bind_logger
+  \param flush called by the log thread each time it runs out of queued lines
+  \note lets a logger buffer the lines of a burst and write them out together
+*/
+SWITCH_DECLARE(switch_status_t) switch_log_bind_flush(_In_ switch_log_function_t function, _In_ switch_log_flush_function_t flush);
+
 /*! 
   \brief Return the name of the specified log level
   \param level the level
@@ -83,6 +83,18 @@
 /* Define to 1 if you have the `pselect' function. */
 #cmakedefine HAVE_PSELECT
 
+/* Define to 1 if you have the `timerfd_create' function. */
+#cmakedefine HAVE_TIMERFD_CREATE
+
+/* Define to 1 if you have the `epoll_create' function. */
+#cmakedefine HAVE_EPOLL_CREATE
+
+/* Define to 1 if you have the `recvmmsg' function. */
+#cmakedefine HAVE_RECVMMSG
+
+/* Define to 1 if you have the `sendmmsg' function. */
+#cmakedefine HAVE_SENDMMSG
+
 /* RLIMIT_MEMLOCK constant for setrlimit */
 #cmakedefine HAVE_RLIMIT_MEMLOCK
 
@@ -49,6 +49,23 @@ SWITCH_DECLARE(int) switch_regex_copy_substring(const char *subject, int *ovecto
 
 SWITCH_DECLARE(void) switch_regex_free(void *data);
 
+/*!
+ \brief Compile an expression the way switch_regex_perform does, including the /pattern/flags and _ast forms
+ \param expression The expression to compile
+ \return The compiled regex (free with switch_regex_safe_free) or NULL if it could not be compiled
+*/
+SWITCH_DECLARE(switch_regex_t *) switch_regex_compile_expression(const char *expression);
+
+/*!
+ \brief Run a compiled regex against a string
+ \param re The compiled regex
+ \param field The string to match
+ \param ovector Vector for substring offsets
+ \param olen Number of elements in ovector
+ \return The match count, 0 when nothing matched
+*/
+SWITCH_DECLARE(int) switch_regex_exec(switch_regex_t *re, const char *field, int *ovector, uint32_t olen);
+
 SWITCH_DECLARE(int) switch_regex_perform(const char *field, const char *expression, switch_regex_t **new_re, int *ovector, uint32_t olen);
 SWITCH_DECLARE(void) switch_perform_substitution(switch_regex_t *re, int match_count, const char *data, const char *field_data,
 												 char *substituted, switch_size_t len, int *ovector);
@@ -42,7 +42,12 @@
 
 #ifndef SWITCH_RESAMPLE_H
 #define SWITCH_RESAMPLE_H
-#define SWITCH_RESAMPLE_QUALITY 2
+/*! use the quality configured with resample-quality in switch.conf */
+#define SWITCH_RESAMPLE_QUALITY -1
+/*! integer 2:1 / 1:2 conversion for mono octave rate changes (8k <-> 16k etc), speex quality 0 otherwise */
+#define SWITCH_RESAMPLE_QUALITY_FAST -2
+/*! quality used when none is configured */
+#define SWITCH_RESAMPLE_DEFAULT_QUALITY 2
 #include <switch.h>
 SWITCH_BEGIN_EXTERN_C
 /*!
@@ -66,7 +71,17 @@ SWITCH_BEGIN_EXTERN_C
 	uint32_t to_len;
 	/*! the total size of the to buffer */
 	uint32_t to_size;
-
+	/*! the quality the handle was created with */
+	int quality;
+	/*! the number of interleaved channels */
+	uint32_t channels;
+	/*! 1 to double or -1 to halve the rate with the integer path instead of speex, 0 otherwise */
+	int fast;
+	/*! filter history for the integer path */
+	int16_t fast_hist[2];
+	int fast_pending;
+	/*! next idle handle while parked in the resampler pool */
+	void *pool_next;
 } switch_audio_resampler_t;
 
 /*!
@@ -74,8 +89,9 @@ SWITCH_BEGIN_EXTERN_C
   \param new_resampler NULL pointer to aim at the new handle
   \param from_rate the rate to transfer from in hz
   \param to_rate the rate to transfer to in hz
-  \param quality the quality desired
+  \param quality the speex quality 0-10, SWITCH_RESAMPLE_QUALITY for the configured default or SWITCH_RESAMPLE_QUALITY_FAST
   \return SWITCH_STATUS_SUCCESS if the handle was created
+  \note handles come from a pool keyed by rate, channels and quality so the filter state is not rebuilt on every call
  */
 SWITCH_DECLARE(switch_status_t) switch_resample_perform_create(switch_audio_resampler_t **new_resampler,
 															   uint32_t from_rate, uint32_t to_rate, uint32_t to_size,
@@ -85,7 +101,7 @@ SWITCH_DECLARE(switch_status_t) switch_resample_perform_create(switch_audio_resa
 #define switch_resample_create(_n, _fr, _tr, _ts, _q, _c) switch_resample_perform_create(_n, _fr, _tr, _ts, _q, _c, __FILE__, __SWITCH_FUNC__, __LINE__)
 
 /*!
-  \brief Destroy an existing resampler handle
+  \brief Destroy an existing resampler handle, returning it to the pool when there is room
   \param resampler the resampler handle to destroy
  */
 SWITCH_DECLARE(void) switch_resample_destroy(switch_audio_resampler_t **resampler);
@@ -112,6 +112,11 @@ SWITCH_DECLARE(switch_port_t) switch_rtp_set_end_port(switch_port_t port);
 */
 SWITCH_DECLARE(switch_port_t) switch_rtp_request_port(const char *ip);
 SWITCH_DECLARE(void) switch_rtp_release_port(const char *ip, switch_port_t port);
+/*!
+  \brief Write the rtp port occupancy of every local address to a stream
+  \param stream the stream to write to
+*/
+SWITCH_DECLARE(void) switch_rtp_port_usage(switch_stream_handle_t *stream);
 
 SWITCH_DECLARE(switch_status_t) switch_rtp_set_interval(switch_rtp_t *rtp_session, uint32_t ms_per_packet, uint32_t samples_per_interval);
 
@@ -247,7 +247,8 @@ typedef enum {
 	SCF_EARLY_HANGUP = (1 << 7),
 	SCF_CALIBRATE_CLOCK = (1 << 8),
 	SCF_USE_HEAVY_TIMING = (1 << 9),
-	SCF_USE_CLOCK_RT = (1 << 10)
+	SCF_USE_CLOCK_RT = (1 << 10),
+	SCF_NO_CHANNEL_SQL = (1 << 11)
 } switch_core_flag_enum_t;
 typedef uint32_t switch_core_flag_t;
 
@@ -502,6 +503,7 @@ typedef enum {
 	SWITCH_RTP_FLAG_BUGGY_2833    - Emulate the bug in cisco equipment to allow interop
 	SWITCH_RTP_FLAG_PASS_RFC2833  - Pass 2833 (ignore it)
 	SWITCH_RTP_FLAG_AUTO_CNG      - Generate outbound CNG frames when idle    
+	SWITCH_RTP_FLAG_BATCH_IO      - Move socket IO to the shared recvmmsg/sendmmsg engine (timed sessions only)
 </pre>
  */
 typedef enum {
@@ -534,7 +536,8 @@ typedef enum {
 	SWITCH_ZRTP_FLAG_SECURE_MITM_RECV = (1 << 26),
 	SWITCH_RTP_FLAG_DEBUG_RTP_READ = (1 << 27),
 	SWITCH_RTP_FLAG_DEBUG_RTP_WRITE = (1 << 28),
-	SWITCH_RTP_FLAG_VIDEO = (1 << 29)
+	SWITCH_RTP_FLAG_VIDEO = (1 << 29),
+	SWITCH_RTP_FLAG_BATCH_IO = (1 << 30)
 } switch_rtp_flag_enum_t;
 typedef uint32_t switch_rtp_flag_t;
 
@@ -1615,6 +1618,21 @@ typedef struct HashElem switch_hash_index_t;
 struct switch_network_list;
 typedef struct switch_network_list switch_network_list_t;
 
+typedef enum {
+	SWITCH_REGISTRY_CHANNELS,
+	SWITCH_REGISTRY_CALLS,
+	SWITCH_REGISTRY_DISTINCT_CHANNELS
+} switch_registry_table_t;
+
+typedef enum {
+	SWITCH_REGISTRY_SORT_CREATED,
+	SWITCH_REGISTRY_SORT_UUID,
+	SWITCH_REGISTRY_SORT_NAME
+} switch_registry_sort_t;
+
+struct switch_registry_snapshot;
+typedef struct switch_registry_snapshot switch_registry_snapshot_t;
+
 
 #define SWITCH_API_VERSION 4
 #define SWITCH_MODULE_LOAD_ARGS (switch_loadable_module_interface_t **module_interface, switch_memory_pool_t *pool)
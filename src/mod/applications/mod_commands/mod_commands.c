@@ -1405,6 +1405,7 @@ SWITCH_STANDARD_API(status_function)
 	switch_core_time_duration_t duration = { 0 };
 	char *http = NULL;
 	int sps = 0, last_sps = 0;
+	uint64_t wakeups = 0, spurious = 0;
 	const char *var;
 
 	switch_core_measure_time(switch_core_uptime(), &duration);
@@ -1440,6 +1441,9 @@ SWITCH_STANDARD_API(status_function)
 	stream->write_function(stream, "%d session(s) %d/%d\n", switch_core_session_count(), last_sps, sps);
 	stream->write_function(stream, "%d session(s) max\n", switch_core_session_limit(0));
 	stream->write_function(stream, "min idle cpu %0.2f/%0.2f\n", switch_core_min_idle_cpu(-1.0), switch_core_idle_cpu());
+	switch_time_get_wakeup_stats(&wakeups, &spurious);
+	stream->write_function(stream, "%" SWITCH_UINT64_T_FMT " timer wakeup(s) %" SWITCH_UINT64_T_FMT " early\n", wakeups, spurious);
+	switch_rtp_port_usage(stream);
 
 	if (html) {
 		stream->write_function(stream, "</b>\n");
@@ -3222,20 +3226,17 @@ SWITCH_STANDARD_API(alias_function)
 SWITCH_STANDARD_API(show_function)
 {
 	char sql[1024];
-	char *errmsg;
-	switch_cache_db_handle_t *db;
+	char *errmsg = NULL;
+	switch_cache_db_handle_t *db = NULL;
 	struct holder holder = { 0 };
 	int help = 0;
 	char *mydata = NULL, *argv[6] = { 0 };
 	int argc;
 	char *command = NULL, *as = NULL;
-	switch_core_flag_t cflags = switch_core_flags();
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
-
-	if (switch_core_db_handle(&db) != SWITCH_STATUS_SUCCESS) {
-		stream->write_function(stream, "%s", "-ERR Databse Error!\n");
-		return SWITCH_STATUS_SUCCESS;
-	}
+	switch_registry_table_t registry = SWITCH_REGISTRY_CHANNELS;
+	int use_registry = 0;
+	char *match = NULL;
 
 	holder.justcount = 0;
 
@@ -3264,11 +3265,6 @@ SWITCH_STANDARD_API(show_function)
 
 	holder.print_title = 1;
 
-	if (!(cflags & SCF_USE_SQL) && command && !strcasecmp(command, "channels")) {
-		stream->write_function(stream, "-ERR SQL DISABLED NO CHANNEL DATA AVAILABLE!\n");
-		goto end;
-	}
-
 	/* If you change the field qty or order of any of these select */
 	/* statements, you must also change show_callback and friends to match! */
 	if (!command) {
@@ -3305,7 +3301,8 @@ SWITCH_STANDARD_API(show_function)
 			sprintf(sql, "select name, description, syntax, ikey from interfaces where type = '%s' and description != '' order by type,name", command);
 		}
 	} else if (!strcasecmp(command, "calls")) {
-		sprintf(sql, "select * from calls order by call_created_epoch");
+		registry = SWITCH_REGISTRY_CALLS;
+		use_registry = 1;
 		if (argv[1] && !strcasecmp(argv[1], "count")) {
 			holder.justcount = 1;
 			if (argv[3] && !strcasecmp(argv[2], "as")) {
@@ -3313,32 +3310,20 @@ SWITCH_STANDARD_API(show_function)
 			}
 		}
 	} else if (!strcasecmp(command, "channels") && argv[1] && !strcasecmp(argv[1], "like")) {
+		use_registry = 1;
 		if (argv[2]) {
-			char *p;
-			for (p = argv[2]; p && *p; p++) {
-				if (*p == '\'' || *p == ';') {
-					*p = ' ';
-				}
-			}
 			if (strchr(argv[2], '%')) {
-				sprintf(sql,
-						"select * from channels where uuid like '%s' or name like '%s' or cid_name like '%s' or cid_num like '%s' order by created_epoch",
-						argv[2], argv[2], argv[2], argv[2]);
+				match = strdup(argv[2]);
 			} else {
-				sprintf(sql,
-						"select * from channels where uuid like '%%%s%%' or name like '%%%s%%' or cid_name like '%%%s%%' or cid_num like '%%%s%%' order by created_epoch",
-						argv[2], argv[2], argv[2], argv[2]);
-
+				match = switch_mprintf("%%%s%%", argv[2]);
 			}
 
 			if (argv[4] && !strcasecmp(argv[3], "as")) {
 				as = argv[4];
 			}
-		} else {
-			sprintf(sql, "select * from channels order by created_epoch");
 		}
 	} else if (!strcasecmp(command, "channels")) {
-		sprintf(sql, "select * from channels order by created_epoch");
+		use_registry = 1;
 		if (argv[1] && !strcasecmp(argv[1], "count")) {
 			holder.justcount = 1;
 			if (argv[3] && !strcasecmp(argv[2], "as")) {
@@ -3346,8 +3331,8 @@ SWITCH_STANDARD_API(show_function)
 			}
 		}
 	} else if (!strcasecmp(command, "distinct_channels")) {
-		sprintf(sql, "select * from channels left join calls on "
-				"channels.uuid=calls.caller_uuid where channels.uuid not in (select callee_uuid from calls) order by created_epoch");
+		registry = SWITCH_REGISTRY_DISTINCT_CHANNELS;
+		use_registry = 1;
 		if (argv[2] && !strcasecmp(argv[1], "as")) {
 			as = argv[2];
 		}
@@ -3379,6 +3364,11 @@ SWITCH_STANDARD_API(show_function)
 		goto end;
 	}
 
+	if (!use_registry && switch_core_db_handle(&db) != SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "%s", "-ERR Databse Error!\n");
+		goto end;
+	}
+
 	holder.stream = stream;
 	holder.count = 0;
 
@@ -3399,7 +3389,11 @@ SWITCH_STANDARD_API(show_function)
 				holder.delim = ",";
 			}
 		}
-		switch_cache_db_execute_sql_callback(db, sql, show_callback, &holder, &errmsg);
+		if (use_registry) {
+			switch_core_registry_execute_callback(registry, NULL, match, SWITCH_REGISTRY_SORT_CREATED, show_callback, &holder);
+		} else {
+			switch_cache_db_execute_sql_callback(db, sql, show_callback, &holder, &errmsg);
+		}
 		if (holder.http) {
 			holder.stream->write_function(holder.stream, "</table>");
 		}
@@ -3413,9 +3407,17 @@ SWITCH_STANDARD_API(show_function)
 				stream->write_function(stream, "-ERR No such command.\n");
 		} else {
 			stream->write_function(stream, "\n%u total.\n", holder.count);
+			if (!strcasecmp(command, "timer")) {
+				stream->write_function(stream, "\n");
+				switch_time_dump_timer_stats(stream, holder.delim);
+			}
 		}
 	} else if (!strcasecmp(as, "xml")) {
-		switch_cache_db_execute_sql_callback(db, sql, show_as_xml_callback, &holder, &errmsg);
+		if (use_registry) {
+			switch_core_registry_execute_callback(registry, NULL, match, SWITCH_REGISTRY_SORT_CREATED, show_as_xml_callback, &holder);
+		} else {
+			switch_cache_db_execute_sql_callback(db, sql, show_as_xml_callback, &holder, &errmsg);
+		}
 
 		if (errmsg) {
 			stream->write_function(stream, "-ERR SQL Error [%s]\n", errmsg);
@@ -3448,6 +3450,7 @@ SWITCH_STANDARD_API(show_function)
   end:
 
 	switch_safe_free(mydata);
+	switch_safe_free(match);
 
 	if (db) {
 		switch_cache_db_release_db_handle(&db);
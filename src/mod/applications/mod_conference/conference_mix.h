@@ -0,0 +1,138 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * conference_mix.h -- mixing kernels of mod_conference
+ *
+ * Kept out of mod_conference.c so the mix benchmark (make bench) times the same code the module runs.
+ */
+#ifndef CONFERENCE_MIX_H
+#define CONFERENCE_MIX_H
+
+#include <switch.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CONF_MIX_NEON
+#endif
+
+/* Mixing kernels
+   The mix is kept in 32 bit so the sum is exact, the vector paths do the widening add and the saturating narrow
+   (which is the same clamp as switch_normalize_to_16bit) several samples at a time.
+*/
+static inline void conference_mix_add(int32_t *mix, const int16_t *in, uint32_t samples)
+{
+	uint32_t x = 0;
+
+#if defined(__AVX2__)
+	for (; x + 8 <= samples; x += 8) {
+		__m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (in + x)));
+		_mm256_storeu_si256((__m256i *) (mix + x), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) (mix + x)), v));
+	}
+#elif defined(__SSE2__)
+	for (; x + 8 <= samples; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (in + x));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		_mm_storeu_si128((__m128i *) (mix + x), _mm_add_epi32(_mm_loadu_si128((const __m128i *) (mix + x)), lo));
+		_mm_storeu_si128((__m128i *) (mix + x + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i *) (mix + x + 4)), hi));
+	}
+#elif defined(CONF_MIX_NEON)
+	for (; x + 8 <= samples; x += 8) {
+		int16x8_t v = vld1q_s16(in + x);
+		vst1q_s32(mix + x, vaddw_s16(vld1q_s32(mix + x), vget_low_s16(v)));
+		vst1q_s32(mix + x + 4, vaddw_s16(vld1q_s32(mix + x + 4), vget_high_s16(v)));
+	}
+#endif
+
+	for (; x < samples; x++) {
+		mix[x] += (int32_t) in[x];
+	}
+}
+
+/* out = mix - own (own may be NULL) clamped to 16 bit */
+static inline void conference_mix_out(int16_t *out, const int32_t *mix, const int16_t *own, uint32_t samples)
+{
+	uint32_t x = 0;
+	int32_t z;
+
+#if defined(__AVX2__)
+	for (; x + 8 <= samples; x += 8) {
+		__m256i m = _mm256_loadu_si256((const __m256i *) (mix + x));
+		if (own) {
+			m = _mm256_sub_epi32(m, _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (own + x))));
+		}
+		_mm_storeu_si128((__m128i *) (out + x), _mm_packs_epi32(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1)));
+	}
+#elif defined(__SSE2__)
+	for (; x + 8 <= samples; x += 8) {
+		__m128i lo = _mm_loadu_si128((const __m128i *) (mix + x));
+		__m128i hi = _mm_loadu_si128((const __m128i *) (mix + x + 4));
+		if (own) {
+			__m128i v = _mm_loadu_si128((const __m128i *) (own + x));
+			lo = _mm_sub_epi32(lo, _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+			hi = _mm_sub_epi32(hi, _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+		}
+		_mm_storeu_si128((__m128i *) (out + x), _mm_packs_epi32(lo, hi));
+	}
+#elif defined(CONF_MIX_NEON)
+	for (; x + 8 <= samples; x += 8) {
+		int32x4_t lo = vld1q_s32(mix + x);
+		int32x4_t hi = vld1q_s32(mix + x + 4);
+		if (own) {
+			int16x8_t v = vld1q_s16(own + x);
+			lo = vsubw_s16(lo, vget_low_s16(v));
+			hi = vsubw_s16(hi, vget_high_s16(v));
+		}
+		vst1q_s16(out + x, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+	}
+#endif
+
+	for (; x < samples; x++) {
+		z = mix[x];
+		if (own) {
+			z -= (int32_t) own[x];
+		}
+		switch_normalize_to_16bit(z);
+		out[x] = (int16_t) z;
+	}
+}
+
+#endif
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
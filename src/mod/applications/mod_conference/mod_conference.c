@@ -35,6 +35,7 @@
  *
  */
 #include <switch.h>
+#include "conference_mix.h"
 //#define INTENSE_DEBUG
 SWITCH_MODULE_LOAD_FUNCTION(mod_conference_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_conference_shutdown);
@@ -55,6 +56,9 @@ static int EC = 0;
 #define CONF_DBUFFER_SIZE CONF_BUFFER_SIZE
 #define CONF_DBUFFER_MAX 0
 #define CONF_CHAT_PROTO "conf"
+#define CONF_MIX_MAX_THREADS 64
+/* below this many members handing the frame to the mix threads costs more than it saves */
+#define CONF_MIX_PARALLEL_MIN 64
 
 #ifndef MIN
 #define MIN(a, b) ((a)<(b)?(a):(b))
@@ -176,7 +180,8 @@ typedef enum {
 	CFLAG_BRIDGE_TO = (1 << 6),
 	CFLAG_WAIT_MOD = (1 << 7),
 	CFLAG_VID_FLOOR = (1 << 8),
-	CFLAG_WASTE_BANDWIDTH = (1 << 9)
+	CFLAG_WASTE_BANDWIDTH = (1 << 9),
+	CFLAG_SHARED_ENCODE = (1 << 10)
 } conf_flag_t;
 
 typedef enum {
@@ -237,6 +242,19 @@ typedef struct conf_xml_cfg {
 	switch_xml_t controls;
 } conf_xml_cfg_t;
 
+/* Shared encoder for listeners on the same codec */
+typedef struct conference_encode_group {
+	const switch_codec_implementation_t *impl;
+	switch_codec_t codec;
+	uint8_t frame[SWITCH_RECOMMENDED_BUFFER_SIZE];
+	uint32_t frame_len;
+	uint32_t frame_id;
+	switch_mutex_t *mutex;
+	struct conference_encode_group *next;
+} conference_encode_group_t;
+
+struct conference_mixer;
+
 /* Conference Object */
 typedef struct conference_obj {
 	char *name;
@@ -299,8 +317,50 @@ typedef struct conference_obj {
 	uint32_t verbose_events;
 	int end_count;
 	uint32_t relationship_total;
+	conference_encode_group_t *encode_groups;
+	uint32_t mix_frame;
+	uint32_t mix_threads;
+	struct conference_mixer *mixer;
 } conference_obj_t;
 
+typedef enum {
+	CONF_MIX_READ,
+	CONF_MIX_SUM,
+	CONF_MIX_WRITE
+} conference_mix_phase_t;
+
+/* One slice of the member list, shard 0 runs on the conference thread itself */
+typedef struct conference_mix_shard {
+	struct conference_mixer *mixer;
+	switch_thread_t *thread;
+	uint32_t id;
+	uint32_t ready;
+	uint32_t video;
+	switch_size_t ok;
+	int32_t partial[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+	int16_t write_frame[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+} conference_mix_shard_t;
+
+/* Parallel mixer, the conference thread keeps the timer and hands each phase of the frame to the shards */
+typedef struct conference_mixer {
+	conference_obj_t *conference;
+	conference_mix_shard_t *shards;
+	uint32_t shard_count;
+	struct conference_member **members;
+	uint32_t member_count;
+	uint32_t member_alloc;
+	conference_mix_phase_t phase;
+	uint32_t bytes;
+	int32_t *main_frame;
+	int16_t *listen_frame;
+	uint32_t generation;
+	uint32_t pending;
+	int running;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	switch_thread_cond_t *done_cond;
+} conference_mixer_t;
+
 /* Relationship with another member */
 typedef struct conference_relationship {
 	uint32_t id;
@@ -347,6 +407,8 @@ struct conference_member {
 	switch_speech_handle_t lsh;
 	switch_speech_handle_t *sh;
 	uint32_t verbose_events;
+	conference_encode_group_t *encode_group;
+	switch_buffer_t *enc_buffer;
 	struct conference_member *next;
 };
 
@@ -971,6 +1033,382 @@ static void *SWITCH_THREAD_FUNC conference_video_thread_run(switch_thread_t *thr
 	return NULL;
 }
 
+/* A member's frames come from the shared encoder only while it is not speaking and from its own encoder otherwise,
+   so neither encoder sees every frame.  That is only safe for codecs that keep no state between frames.
+*/
+static switch_bool_t conference_encode_stateless(const switch_codec_implementation_t *impl)
+{
+	return (!strcasecmp(impl->iananame, "PCMU") || !strcasecmp(impl->iananame, "PCMA") || !strcasecmp(impl->iananame, "L16")) ?
+		SWITCH_TRUE : SWITCH_FALSE;
+}
+
+/* Find or create the shared encoder for a codec implementation, conference->mutex must be held.
+   Only stateless codecs running at the conference rate and interval qualify so the mix can be encoded as is.
+*/
+static conference_encode_group_t *conference_get_encode_group(conference_obj_t *conference, const switch_codec_implementation_t *impl)
+{
+	conference_encode_group_t *group;
+
+	if (!impl || impl->number_of_channels != 1 || impl->actual_samples_per_second != conference->rate ||
+		impl->microseconds_per_packet != conference->interval * 1000 || !conference_encode_stateless(impl)) {
+		return NULL;
+	}
+
+	for (group = conference->encode_groups; group; group = group->next) {
+		if (group->impl == impl) {
+			return group;
+		}
+	}
+
+	group = switch_core_alloc(conference->pool, sizeof(*group));
+
+	if (switch_core_codec_init(&group->codec, impl->iananame, impl->fmtp, impl->samples_per_second, impl->microseconds_per_packet / 1000,
+							   1, SWITCH_CODEC_FLAG_ENCODE | SWITCH_CODEC_FLAG_DECODE, NULL, conference->pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Cannot activate shared encoder %s@%uhz for conference %s\n",
+						  impl->iananame, impl->actual_samples_per_second, conference->name);
+		return NULL;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Shared encoder %s@%uhz %dms activated for conference %s\n",
+					  impl->iananame, impl->actual_samples_per_second, impl->microseconds_per_packet / 1000, conference->name);
+
+	switch_mutex_init(&group->mutex, SWITCH_MUTEX_NESTED, conference->pool);
+	group->impl = impl;
+	group->frame_id = conference->mix_frame - 1;
+	group->next = conference->encode_groups;
+	conference->encode_groups = group;
+
+	return group;
+}
+
+/* Pull one frame of input from a member, returns 1 when it has audio this frame */
+static uint32_t conference_mix_read_member(conference_member_t *imember, uint32_t bytes, uint32_t *video)
+{
+	uint32_t buf_read = 0, ready = 0;
+
+	imember->read = 0;
+
+	if (imember->session && switch_channel_test_flag(switch_core_session_get_channel(imember->session), CF_VIDEO)) {
+		(*video)++;
+	}
+
+	switch_clear_flag_locked(imember, MFLAG_HAS_AUDIO);
+	switch_mutex_lock(imember->audio_in_mutex);
+
+	if (switch_buffer_inuse(imember->audio_buffer) >= bytes
+		&& (buf_read = (uint32_t) switch_buffer_read(imember->audio_buffer, imember->frame, bytes))) {
+		imember->read = buf_read;
+		switch_set_flag_locked(imember, MFLAG_HAS_AUDIO);
+		ready++;
+	}
+	switch_mutex_unlock(imember->audio_in_mutex);
+
+	return ready;
+}
+
+/* Create write frame once per member who is not deaf for each sample in the main frame
+   check if our audio is involved and if so, subtract it from the sample so we don't hear ourselves.
+   Since main frame was 32 bit int, we did not lose any detail, now that we have to convert to 16 bit we can
+   cut it off at the min and max range if need be and write the frame to the output buffer.
+   Without relationships everybody who did not speak this frame hears exactly the same thing (listen_frame)
+   so only the speakers get their own mix-minus. The caller passes a NULL listen_frame when the frame has to be
+   mixed with relationships, so the decision is made once per frame.
+   Returns 0 when the member's output buffer could not take the frame.
+*/
+static switch_size_t conference_mix_write_member(conference_obj_t *conference, conference_member_t *omember,
+												 int32_t *main_frame, int16_t *write_frame, int16_t *listen_frame, uint32_t bytes)
+{
+	conference_member_t *imember;
+	int16_t *bptr, *out_frame;
+	switch_size_t ok = 1;
+	uint32_t x;
+	int32_t z;
+
+	if (!switch_test_flag(omember, MFLAG_RUNNING)) {
+		return ok;
+	}
+
+	if (!switch_test_flag(omember, MFLAG_CAN_HEAR) && !switch_test_flag(omember, MFLAG_WASTE_BANDWIDTH)
+		&& !switch_test_flag(conference, CFLAG_WASTE_BANDWIDTH)) {
+		return ok;
+	}
+
+	if (listen_frame) {
+		if (switch_test_flag(omember, MFLAG_HAS_AUDIO)) {
+			uint32_t own = MIN(bytes, omember->read) / 2;
+
+			/* only subtract what this member actually read, the rest of the frame is the plain mix */
+			conference_mix_out(write_frame, main_frame, (int16_t *) omember->frame, own);
+			if (own < bytes / 2) {
+				conference_mix_out(write_frame + own, main_frame + own, NULL, bytes / 2 - own);
+			}
+			out_frame = write_frame;
+		} else {
+			out_frame = listen_frame;
+		}
+		goto write_out;
+	}
+
+	bptr = (int16_t *) omember->frame;
+	for (x = 0; x < bytes / 2; x++) {
+		z = main_frame[x];
+		/* bptr[x] represents my own contribution to this audio sample */
+		if (switch_test_flag(omember, MFLAG_HAS_AUDIO) && x <= omember->read / 2) {
+			z -= (int32_t) bptr[x];
+		}
+
+		/* when there are relationships, we have to do more work by scouring all the members to see if there are any 
+		   reasons why we should not be hearing a paticular member, and if not, delete their samples as well.
+		 */
+		for (imember = conference->members; imember; imember = imember->next) {
+			conference_relationship_t *rel;
+			for (rel = imember->relationships; rel; rel = rel->next) {
+				if (imember != omember && switch_test_flag(imember, MFLAG_HAS_AUDIO)) {
+					int16_t *rptr = (int16_t *) imember->frame;
+					if ((rel->id == omember->id || rel->id == 0) && !switch_test_flag(rel, RFLAG_CAN_SPEAK)) {
+						z -= (int32_t) rptr[x];
+					}
+					if ((rel->id == imember->id || rel->id == 0) && !switch_test_flag(rel, RFLAG_CAN_HEAR)) {
+						z -= (int32_t) rptr[x];
+					}
+				}
+
+			}
+		}
+
+		/* Now we can convert to 16 bit. */
+		switch_normalize_to_16bit(z);
+		write_frame[x] = (int16_t) z;
+	}
+	out_frame = write_frame;
+
+  write_out:
+	switch_mutex_lock(omember->audio_out_mutex);
+	ok = switch_buffer_write(omember->mux_buffer, out_frame, bytes);
+
+	/* members with a shared encoder get one record per mixed frame, the encoded listener frame or an empty one */
+	if (ok && omember->encode_group) {
+		conference_encode_group_t *group = omember->encode_group;
+		uint32_t enc_len = 0;
+
+		switch_mutex_lock(group->mutex);
+		if (out_frame == listen_frame) {
+			if (group->frame_id != conference->mix_frame) {
+				uint32_t enc_rate = conference->rate;
+				unsigned int enc_flag = 0;
+
+				group->frame_len = sizeof(group->frame);
+				if (switch_core_codec_encode(&group->codec, NULL, listen_frame, bytes, conference->rate,
+											 group->frame, &group->frame_len, &enc_rate, &enc_flag) != SWITCH_STATUS_SUCCESS) {
+					group->frame_len = 0;
+				}
+				group->frame_id = conference->mix_frame;
+			}
+			enc_len = group->frame_len;
+		}
+
+		switch_buffer_write(omember->enc_buffer, &enc_len, sizeof(enc_len));
+		if (enc_len) {
+			switch_buffer_write(omember->enc_buffer, group->frame, enc_len);
+		}
+		switch_mutex_unlock(group->mutex);
+	}
+	switch_mutex_unlock(omember->audio_out_mutex);
+
+	return ok;
+}
+
+static void conference_mix_shard_run(conference_mixer_t *mixer, conference_mix_shard_t *shard)
+{
+	conference_member_t *member;
+	uint32_t x, start, stop;
+
+	start = (uint32_t) (((uint64_t) shard->id * mixer->member_count) / mixer->shard_count);
+	stop = (uint32_t) (((uint64_t) (shard->id + 1) * mixer->member_count) / mixer->shard_count);
+
+	switch (mixer->phase) {
+	case CONF_MIX_READ:
+		shard->ready = shard->video = 0;
+		for (x = start; x < stop; x++) {
+			shard->ready += conference_mix_read_member(mixer->members[x], mixer->bytes, &shard->video);
+		}
+		break;
+	case CONF_MIX_SUM:
+		memset(shard->partial, 0, mixer->bytes * 2);
+		for (x = start; x < stop; x++) {
+			member = mixer->members[x];
+			if (switch_test_flag(member, MFLAG_RUNNING) && switch_test_flag(member, MFLAG_HAS_AUDIO)) {
+				conference_mix_add(shard->partial, (int16_t *) member->frame, member->read / 2);
+			}
+		}
+		break;
+	case CONF_MIX_WRITE:
+		shard->ok = 1;
+		for (x = start; x < stop; x++) {
+			if (!(shard->ok = conference_mix_write_member(mixer->conference, mixer->members[x], mixer->main_frame,
+														  shard->write_frame, mixer->listen_frame, mixer->bytes))) {
+				break;
+			}
+		}
+		break;
+	}
+}
+
+static void *SWITCH_THREAD_FUNC conference_mix_thread_run(switch_thread_t *thread, void *obj)
+{
+	conference_mix_shard_t *shard = (conference_mix_shard_t *) obj;
+	conference_mixer_t *mixer = shard->mixer;
+	uint32_t generation = 0;
+
+	switch_mutex_lock(mixer->mutex);
+	while (mixer->running) {
+		if (mixer->generation == generation) {
+			switch_thread_cond_wait(mixer->cond, mixer->mutex);
+			continue;
+		}
+		generation = mixer->generation;
+		switch_mutex_unlock(mixer->mutex);
+
+		conference_mix_shard_run(mixer, shard);
+
+		switch_mutex_lock(mixer->mutex);
+		if (!--mixer->pending) {
+			switch_thread_cond_signal(mixer->done_cond);
+		}
+	}
+	switch_mutex_unlock(mixer->mutex);
+
+	return NULL;
+}
+
+/* Run one phase on every shard and wait for all of them, the conference thread does shard 0 */
+static void conference_mix_dispatch(conference_mixer_t *mixer, conference_mix_phase_t phase)
+{
+	switch_mutex_lock(mixer->mutex);
+	mixer->phase = phase;
+	mixer->pending = mixer->shard_count - 1;
+	mixer->generation++;
+	switch_thread_cond_broadcast(mixer->cond);
+	switch_mutex_unlock(mixer->mutex);
+
+	conference_mix_shard_run(mixer, &mixer->shards[0]);
+
+	switch_mutex_lock(mixer->mutex);
+	while (mixer->pending) {
+		switch_thread_cond_wait(mixer->done_cond, mixer->mutex);
+	}
+	switch_mutex_unlock(mixer->mutex);
+}
+
+/* Snapshot the member list for this frame, returns 0 when the room is too small to be worth splitting */
+static int conference_mix_prepare(conference_obj_t *conference, uint32_t bytes)
+{
+	conference_mixer_t *mixer = conference->mixer;
+	conference_member_t *member;
+	uint32_t count = 0;
+
+	if (!mixer) {
+		return 0;
+	}
+
+	for (member = conference->members; member; member = member->next) {
+		count++;
+	}
+
+	if (count < CONF_MIX_PARALLEL_MIN) {
+		return 0;
+	}
+
+	if (count > mixer->member_alloc) {
+		conference_member_t **members = realloc(mixer->members, sizeof(*members) * count * 2);
+
+		if (!members) {
+			return 0;
+		}
+		mixer->members = members;
+		mixer->member_alloc = count * 2;
+	}
+
+	mixer->member_count = 0;
+	for (member = conference->members; member; member = member->next) {
+		mixer->members[mixer->member_count++] = member;
+	}
+
+	mixer->bytes = bytes;
+
+	return 1;
+}
+
+static void conference_mixer_stop(conference_obj_t *conference)
+{
+	conference_mixer_t *mixer = conference->mixer;
+	switch_status_t st;
+	uint32_t x;
+
+	if (!mixer) {
+		return;
+	}
+
+	switch_mutex_lock(mixer->mutex);
+	mixer->running = 0;
+	switch_thread_cond_broadcast(mixer->cond);
+	switch_mutex_unlock(mixer->mutex);
+
+	for (x = 1; x < mixer->shard_count; x++) {
+		switch_thread_join(&st, mixer->shards[x].thread);
+	}
+
+	switch_safe_free(mixer->members);
+	conference->mixer = NULL;
+}
+
+static void conference_mixer_start(conference_obj_t *conference)
+{
+	conference_mixer_t *mixer;
+	switch_threadattr_t *thd_attr = NULL;
+	uint32_t x;
+
+	if (conference->mix_threads < 2) {
+		return;
+	}
+
+	mixer = switch_core_alloc(conference->pool, sizeof(*mixer));
+	mixer->conference = conference;
+	mixer->shard_count = conference->mix_threads;
+	mixer->shards = switch_core_alloc(conference->pool, sizeof(*mixer->shards) * mixer->shard_count);
+	mixer->running = 1;
+	switch_mutex_init(&mixer->mutex, SWITCH_MUTEX_NESTED, conference->pool);
+	switch_thread_cond_create(&mixer->cond, conference->pool);
+	switch_thread_cond_create(&mixer->done_cond, conference->pool);
+
+	for (x = 0; x < mixer->shard_count; x++) {
+		conference_mix_shard_t *shard = &mixer->shards[x];
+
+		shard->mixer = mixer;
+		shard->id = x;
+
+		if (x) {
+			switch_threadattr_create(&thd_attr, conference->pool);
+			switch_threadattr_detach_set(thd_attr, 0);
+			switch_threadattr_priority_increase(thd_attr);
+			switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+			if (switch_thread_create(&shard->thread, thd_attr, conference_mix_thread_run, shard, conference->pool) != SWITCH_STATUS_SUCCESS) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Conference %s cannot start mixer thread %u, mixing inline\n",
+								  conference->name, x);
+				/* only the shards started so far have to be joined */
+				mixer->shard_count = x;
+				conference->mixer = mixer;
+				conference_mixer_stop(conference);
+				return;
+			}
+		}
+	}
+
+	conference->mixer = mixer;
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Conference %s mixing on %u threads\n", conference->name, mixer->shard_count);
+}
+
 /* Main monitor thread (1 per distinct conference room) */
 static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, void *obj)
 {
@@ -978,14 +1416,13 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 	conference_member_t *imember, *omember;
 	uint32_t samples = switch_samples_per_packet(conference->rate, conference->interval);
 	uint32_t bytes = samples * 2;
-	uint8_t ready = 0, total = 0;
+	uint32_t ready = 0, total = 0;
 	switch_timer_t timer = { 0 };
 	switch_event_t *event;
 	uint8_t *file_frame;
 	uint8_t *async_file_frame;
 	int16_t *bptr;
 	int x;
-	int32_t z = 0;
 
 	file_frame = switch_core_alloc(conference->pool, SWITCH_RECOMMENDED_BUFFER_SIZE);
 	async_file_frame = switch_core_alloc(conference->pool, SWITCH_RECOMMENDED_BUFFER_SIZE);
@@ -1003,10 +1440,13 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 
 	conference->is_recording = 0;
 
+	conference_mixer_start(conference);
+
 	while (globals.running && !switch_test_flag(conference, CFLAG_DESTRUCT)) {
 		switch_size_t file_sample_len = samples;
 		switch_size_t file_data_len = samples * 2;
-		int has_file_data = 0, members_with_video = 0;
+		int has_file_data = 0, parallel = 0;
+		uint32_t members_with_video = 0;
 
 		/* Sync the conference to a single timing source */
 		if (switch_core_timer_next(&timer) != SWITCH_STATUS_SUCCESS) {
@@ -1024,25 +1464,18 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 		}
 
 		/* Read one frame of audio from each member channel and save it for redistribution */
-		for (imember = conference->members; imember; imember = imember->next) {
-			uint32_t buf_read = 0;
-			total++;
-			imember->read = 0;
-
-			if (imember->session && switch_channel_test_flag(switch_core_session_get_channel(imember->session), CF_VIDEO)) {
-				members_with_video++;
+		if ((parallel = conference_mix_prepare(conference, bytes))) {
+			conference_mix_dispatch(conference->mixer, CONF_MIX_READ);
+			for (x = 0; x < (int) conference->mixer->shard_count; x++) {
+				ready += conference->mixer->shards[x].ready;
+				members_with_video += conference->mixer->shards[x].video;
 			}
-
-			switch_clear_flag_locked(imember, MFLAG_HAS_AUDIO);
-			switch_mutex_lock(imember->audio_in_mutex);
-
-			if (switch_buffer_inuse(imember->audio_buffer) >= bytes
-				&& (buf_read = (uint32_t) switch_buffer_read(imember->audio_buffer, imember->frame, bytes))) {
-				imember->read = buf_read;
-				switch_set_flag_locked(imember, MFLAG_HAS_AUDIO);
-				ready++;
+			total = conference->mixer->member_count;
+		} else {
+			for (imember = conference->members; imember; imember = imember->next) {
+				total++;
+				ready += conference_mix_read_member(imember, bytes, &members_with_video);
 			}
-			switch_mutex_unlock(imember->audio_in_mutex);
 		}
 
 		/* Start recording if there's more than one participant. */
@@ -1157,8 +1590,13 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 
 		if (ready || has_file_data) {
 			/* Use more bits in the main_frame to preserve the exact sum of the audio samples. */
-			int main_frame[SWITCH_RECOMMENDED_BUFFER_SIZE / 2] = { 0 };
+			int32_t main_frame[SWITCH_RECOMMENDED_BUFFER_SIZE / 2] = { 0 };
 			int16_t write_frame[SWITCH_RECOMMENDED_BUFFER_SIZE / 2] = { 0 };
+			int16_t listen_frame[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+			int16_t *listen = NULL;
+			uint32_t y;
+
+			conference->mix_frame++;
 
 
 			/* Init the main frame with file data if there is any. */
@@ -1173,74 +1611,45 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 				}
 			}
 
-			/* Copy audio from every member known to be producing audio into the main frame. */
-			for (omember = conference->members; omember; omember = omember->next) {
-				if (!(switch_test_flag(omember, MFLAG_RUNNING) && switch_test_flag(omember, MFLAG_HAS_AUDIO))) {
-					continue;
+			/* Copy audio from every member known to be producing audio into the main frame.
+			   In parallel mode each shard sums its slice and the partials are added in shard order,
+			   integer sums so the result is exactly the serial one. */
+			if (parallel) {
+				conference_mix_dispatch(conference->mixer, CONF_MIX_SUM);
+				for (y = 0; y < conference->mixer->shard_count; y++) {
+					for (x = 0; x < bytes / 2; x++) {
+						main_frame[x] += conference->mixer->shards[y].partial[x];
+					}
 				}
-				bptr = (int16_t *) omember->frame;
-				for (x = 0; x < omember->read / 2; x++) {
-					main_frame[x] += (int32_t) bptr[x];
+			} else {
+				for (omember = conference->members; omember; omember = omember->next) {
+					if (!(switch_test_flag(omember, MFLAG_RUNNING) && switch_test_flag(omember, MFLAG_HAS_AUDIO))) {
+						continue;
+					}
+					conference_mix_add(main_frame, (int16_t *) omember->frame, omember->read / 2);
 				}
 			}
 
-			/* Create write frame once per member who is not deaf for each sample in the main frame
-			   check if our audio is involved and if so, subtract it from the sample so we don't hear ourselves.
-			   Since main frame was 32 bit int, we did not lose any detail, now that we have to convert to 16 bit we can
-			   cut it off at the min and max range if need be and write the frame to the output buffer.
-			 */
-			for (omember = conference->members; omember; omember = omember->next) {
-				switch_size_t ok = 1;
-
-				if (!switch_test_flag(omember, MFLAG_RUNNING)) {
-					continue;
-				}
-
-				if (!switch_test_flag(omember, MFLAG_CAN_HEAR) && !switch_test_flag(omember, MFLAG_WASTE_BANDWIDTH)
-					&& !switch_test_flag(conference, CFLAG_WASTE_BANDWIDTH)) {
-					continue;
-				}
-
-				bptr = (int16_t *) omember->frame;
-				for (x = 0; x < bytes / 2; x++) {
-					z = main_frame[x];
-					/* bptr[x] represents my own contribution to this audio sample */
-					if (switch_test_flag(omember, MFLAG_HAS_AUDIO) && x <= omember->read / 2) {
-						z -= (int32_t) bptr[x];
-					}
-
-					/* when there are relationships, we have to do more work by scouring all the members to see if there are any 
-					   reasons why we should not be hearing a paticular member, and if not, delete their samples as well.
-					 */
-					if (conference->relationship_total) {
-						for (imember = conference->members; imember; imember = imember->next) {
-							conference_relationship_t *rel;
-							for (rel = imember->relationships; rel; rel = rel->next) {
-								if (imember != omember && switch_test_flag(imember, MFLAG_HAS_AUDIO)) {
-									int16_t *rptr = (int16_t *) imember->frame;
-									if ((rel->id == omember->id || rel->id == 0) && !switch_test_flag(rel, RFLAG_CAN_SPEAK)) {
-										z -= (int32_t) rptr[x];
-									}
-									if ((rel->id == imember->id || rel->id == 0) && !switch_test_flag(rel, RFLAG_CAN_HEAR)) {
-										z -= (int32_t) rptr[x];
-									}
-								}
+			/* read relationship_total once, the write pass must agree with whether listen_frame was filled */
+			if (!conference->relationship_total) {
+				conference_mix_out(listen_frame, main_frame, NULL, bytes / 2);
+				listen = listen_frame;
+			}
 
-							}
-						}
+			if (parallel) {
+				conference->mixer->main_frame = main_frame;
+				conference->mixer->listen_frame = listen;
+				conference_mix_dispatch(conference->mixer, CONF_MIX_WRITE);
+				for (y = 0; y < conference->mixer->shard_count; y++) {
+					if (!conference->mixer->shards[y].ok) {
+						goto end;
 					}
-
-					/* Now we can convert to 16 bit. */
-					switch_normalize_to_16bit(z);
-					write_frame[x] = (int16_t) z;
 				}
-
-				switch_mutex_lock(omember->audio_out_mutex);
-				ok = switch_buffer_write(omember->mux_buffer, write_frame, bytes);
-				switch_mutex_unlock(omember->audio_out_mutex);
-
-				if (!ok) {
-					goto end;
+			} else {
+				for (omember = conference->members; omember; omember = omember->next) {
+					if (!conference_mix_write_member(conference, omember, main_frame, write_frame, listen, bytes)) {
+						goto end;
+					}
 				}
 			}
 		}
@@ -1343,6 +1752,8 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 	switch_mutex_unlock(conference->member_mutex);
 	switch_mutex_unlock(conference->mutex);
 
+	conference_mixer_stop(conference);
+
 	if (conference->video_running == 1) {
 		conference->video_running = -1;
 		while (conference->video_running) {
@@ -1365,6 +1776,12 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 
 		switch_ivr_digit_stream_parser_destroy(conference->dtmf_parser);
 
+		while (conference->encode_groups) {
+			conference_encode_group_t *group = conference->encode_groups;
+			conference->encode_groups = group->next;
+			switch_core_codec_destroy(&group->codec);
+		}
+
 		if (conference->sh) {
 			switch_speech_flag_t flags = SWITCH_SPEECH_FLAG_NONE;
 			switch_core_speech_close(&conference->lsh, &flags);
@@ -2153,7 +2570,7 @@ static void conference_loop_output(conference_member_t *member)
 {
 	switch_channel_t *channel;
 	switch_frame_t write_frame = { 0 };
-	uint8_t *data = NULL;
+	uint8_t *data = NULL, *enc_data = NULL;
 	switch_timer_t timer = { 0 };
 	uint32_t interval;
 	uint32_t samples;
@@ -2205,10 +2622,31 @@ static void conference_loop_output(conference_member_t *member)
 	if (!restarting) {
 		write_frame.data = data = switch_core_session_alloc(member->session, SWITCH_RECOMMENDED_BUFFER_SIZE);
 		write_frame.buflen = SWITCH_RECOMMENDED_BUFFER_SIZE;
+		enc_data = switch_core_session_alloc(member->session, SWITCH_RECOMMENDED_BUFFER_SIZE);
 	}
 
 	write_frame.codec = &member->write_codec;
 
+	/* Listeners on the same codec can share one encode of the common mix */
+	switch_mutex_lock(member->conference->mutex);
+	switch_mutex_lock(member->audio_out_mutex);
+	member->encode_group = NULL;
+	if (switch_test_flag(member->conference, CFLAG_SHARED_ENCODE) && interval == member->conference->interval &&
+		(member->enc_buffer || switch_buffer_create_dynamic(&member->enc_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, 0) == SWITCH_STATUS_SUCCESS)) {
+		switch_codec_t *session_write_codec = switch_core_session_get_write_codec(member->session);
+
+		if (session_write_codec && session_write_codec->implementation) {
+			member->encode_group = conference_get_encode_group(member->conference, session_write_codec->implementation);
+		}
+	}
+	/* the encoded records must line up with the mixed frames so start both from empty */
+	switch_buffer_zero(member->mux_buffer);
+	if (member->enc_buffer) {
+		switch_buffer_zero(member->enc_buffer);
+	}
+	switch_mutex_unlock(member->audio_out_mutex);
+	switch_mutex_unlock(member->conference->mutex);
+
 	if (!switch_test_flag(member->conference, CFLAG_ANSWERED)) {
 		switch_channel_answer(channel);
 	}
@@ -2389,7 +2827,31 @@ static void conference_loop_output(conference_member_t *member)
 			use_buffer = member->mux_buffer;
 			low_count = 0;
 			if ((write_frame.datalen = (uint32_t) switch_buffer_read(use_buffer, write_frame.data, bytes))) {
-				if (write_frame.datalen) {
+				uint32_t enc_len = 0;
+
+				if (member->encode_group) {
+					if (switch_buffer_read(member->enc_buffer, &enc_len, sizeof(enc_len)) != sizeof(enc_len)) {
+						enc_len = 0;
+					} else if (enc_len && (enc_len > SWITCH_RECOMMENDED_BUFFER_SIZE ||
+										   switch_buffer_read(member->enc_buffer, enc_data, enc_len) != enc_len)) {
+						enc_len = 0;
+					}
+				}
+
+				if (enc_len && write_frame.datalen == bytes && switch_test_flag(member, MFLAG_CAN_HEAR) &&
+					!member->volume_out_level && !member->fnode) {
+					/* nothing of our own to add, send the shared encode as is */
+					switch_frame_t enc_frame = { 0 };
+
+					enc_frame.codec = &member->encode_group->codec;
+					enc_frame.data = enc_data;
+					enc_frame.datalen = enc_len;
+					enc_frame.buflen = SWITCH_RECOMMENDED_BUFFER_SIZE;
+					enc_frame.samples = write_frame.datalen / 2;
+					enc_frame.rate = member->conference->rate;
+					enc_frame.timestamp = timer.samplecount;
+					switch_core_session_write_frame(member->session, &enc_frame, SWITCH_IO_FLAG_NONE, 0);
+				} else if (write_frame.datalen) {
                write_frame.samples = write_frame.datalen / 2;
 				   
 				   if( !switch_test_flag(member, MFLAG_CAN_HEAR)) {
@@ -2436,6 +2898,9 @@ static void conference_loop_output(conference_member_t *member)
 			if (switch_buffer_inuse(member->mux_buffer)) {
 				switch_mutex_lock(member->audio_out_mutex);
 				switch_buffer_zero(member->mux_buffer);
+				if (member->enc_buffer) {
+					switch_buffer_zero(member->enc_buffer);
+				}
 				switch_mutex_unlock(member->audio_out_mutex);
 			}
 			switch_clear_flag_locked(member, MFLAG_FLUSH_BUFFER);
@@ -4857,6 +5322,8 @@ static void set_cflags(const char *flags, uint32_t *f)
 				*f |= CFLAG_VID_FLOOR;
 			} else if (!strcasecmp(argv[i], "waste-bandwidth")) {
 				*f |= CFLAG_WASTE_BANDWIDTH;
+			} else if (!strcasecmp(argv[i], "shared-encode")) {
+				*f |= CFLAG_SHARED_ENCODE;
 			}
 		}
 
@@ -5507,6 +5974,9 @@ SWITCH_STANDARD_APP(conference_function)
 	switch_buffer_destroy(&member.resample_buffer);
 	switch_buffer_destroy(&member.audio_buffer);
 	switch_buffer_destroy(&member.mux_buffer);
+	if (member.enc_buffer) {
+		switch_buffer_destroy(&member.enc_buffer);
+	}
 	if (conference && member.dtmf_parser != conference->dtmf_parser) {
 		switch_ivr_digit_stream_parser_destroy(member.dtmf_parser);
 	}
@@ -5788,6 +6258,7 @@ static conference_obj_t *conference_new(char *name, conf_xml_cfg_t cfg, switch_m
 	uint32_t announce_count = 0;
 	char *maxmember_sound = NULL;
 	uint32_t rate = 8000, interval = 20;
+	uint32_t mix_threads = 0;
 	switch_status_t status;
 	int comfort_noise_level = 0;
 	char *suppress_events = NULL;
@@ -5835,6 +6306,17 @@ static conference_obj_t *conference_new(char *name, conf_xml_cfg_t cfg, switch_m
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING,
 									  "Interval must be multipe of 10 and less than %d, Using default of 20\n", SWITCH_MAX_INTERVAL);
 				}
+			} else if (!strcasecmp(var, "mix-threads") && !zstr(val)) {
+				int tmp = atoi(val);
+				if (tmp < 0) {
+					/* negative means one per cpu */
+					mix_threads = switch_core_cpu_count();
+				} else {
+					mix_threads = (uint32_t) tmp;
+				}
+				if (mix_threads > CONF_MIX_MAX_THREADS) {
+					mix_threads = CONF_MIX_MAX_THREADS;
+				}
 			} else if (!strcasecmp(var, "timer-name") && !zstr(val)) {
 				timer_name = val;
 			} else if (!strcasecmp(var, "tts-engine") && !zstr(val)) {
@@ -5974,6 +6456,7 @@ static conference_obj_t *conference_new(char *name, conf_xml_cfg_t cfg, switch_m
 	}
 
 	conference->comfort_noise_level = comfort_noise_level;
+	conference->mix_threads = mix_threads;
 	conference->caller_id_name = switch_core_strdup(conference->pool, caller_id_name);
 	conference->caller_id_number = switch_core_strdup(conference->pool, caller_id_number);
 
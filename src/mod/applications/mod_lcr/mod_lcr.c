@@ -32,7 +32,7 @@
 
 #include <switch.h>
 
-#define LCR_SYNTAX "lcr <digits> [<lcr profile>] [caller_id] [intrastate] [as xml]"
+#define LCR_SYNTAX "lcr <digits> [<lcr profile>] [caller_id] [intrastate] [as xml]|reload"
 #define LCR_ADMIN_SYNTAX "lcr_admin show profiles"
 
 /* SQL Query places */
@@ -112,6 +112,50 @@ typedef lcr_obj_t *lcr_route;
 typedef struct max_obj max_obj_t;
 typedef max_obj_t *max_len;
 
+/* rate columns held by the route cache, picked per lookup like ${lcr_rate_field} */
+#define LCR_CACHE_RATE 0
+#define LCR_CACHE_INTRASTATE_RATE 1
+#define LCR_CACHE_INTRALATA_RATE 2
+#define LCR_CACHE_RATES 3
+
+/* extra columns selected when loading the route cache, after the LCR_QUERY_COLS - 1 regular ones */
+#define LCR_CACHE_QUALITY_PLACE 11
+#define LCR_CACHE_RELIABILITY_PLACE 12
+#define LCR_CACHE_INTRASTATE_PLACE 13
+#define LCR_CACHE_INTRALATA_PLACE 14
+#define LCR_CACHE_DATE_START_PLACE 15
+#define LCR_CACHE_DATE_END_PLACE 16
+#define LCR_CACHE_COLS 17
+
+/* order_by keys the route cache can sort on */
+#define LCR_SORT_RATE 1
+#define LCR_SORT_QUALITY 2
+#define LCR_SORT_RELIABILITY 3
+#define LCR_SORT_MAX 4
+
+/* one row of the lcr table, rows sharing the same digits are chained together */
+struct lcr_cache_row {
+	char *argv[LCR_QUERY_COLS];
+	char *rate_str[LCR_CACHE_RATES];
+	float rate[LCR_CACHE_RATES];
+	float quality;
+	float reliability;
+	/* validity window, 0 when the column could not be parsed */
+	switch_time_t date_start;
+	switch_time_t date_end;
+	struct lcr_cache_row *next;
+};
+typedef struct lcr_cache_row lcr_cache_row_t;
+
+/* in memory copy of a profile's routes keyed by digits, replaced as a whole on reload */
+struct lcr_cache {
+	switch_memory_pool_t *pool;
+	switch_hash_t *digits_hash;
+	uint32_t rows;
+	int refs;
+};
+typedef struct lcr_cache lcr_cache_t;
+
 struct profile_obj {
 	char *name;
 	uint16_t id;
@@ -126,6 +170,11 @@ struct profile_obj {
 	switch_bool_t reorder_by_rate;
 	switch_bool_t quote_in_list;
 	switch_bool_t info_in_headers;
+
+	switch_bool_t route_cache;
+	lcr_cache_t *cache;
+	int sort_keys[LCR_SORT_MAX];
+	int sort_count;
 };
 typedef struct profile_obj profile_t;
 
@@ -664,6 +713,230 @@ static int route_add_callback(void *pArg, int argc, char **argv, char **columnNa
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static int cache_row_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	lcr_cache_t *cache = (lcr_cache_t *) pArg;
+	lcr_cache_row_t *row;
+	int i;
+
+	if (argc < LCR_CACHE_COLS || zstr(argv[LCR_DIGITS_PLACE])) {
+		return 0;
+	}
+
+	row = switch_core_alloc(cache->pool, sizeof(*row));
+
+	for (i = 0; i < LCR_QUERY_COLS - 1; i++) {
+		row->argv[i] = switch_core_strdup(cache->pool, switch_str_nil(argv[i]));
+	}
+
+	row->rate_str[LCR_CACHE_RATE] = row->argv[LCR_RATE_PLACE];
+	row->rate_str[LCR_CACHE_INTRASTATE_RATE] = switch_core_strdup(cache->pool, switch_str_nil(argv[LCR_CACHE_INTRASTATE_PLACE]));
+	row->rate_str[LCR_CACHE_INTRALATA_RATE] = switch_core_strdup(cache->pool, switch_str_nil(argv[LCR_CACHE_INTRALATA_PLACE]));
+
+	for (i = 0; i < LCR_CACHE_RATES; i++) {
+		row->rate[i] = (float) atof(row->rate_str[i]);
+	}
+
+	row->quality = (float) atof(switch_str_nil(argv[LCR_CACHE_QUALITY_PLACE]));
+	row->reliability = (float) atof(switch_str_nil(argv[LCR_CACHE_RELIABILITY_PLACE]));
+	row->date_start = zstr(argv[LCR_CACHE_DATE_START_PLACE]) ? 0 : switch_str_time(argv[LCR_CACHE_DATE_START_PLACE]);
+	row->date_end = zstr(argv[LCR_CACHE_DATE_END_PLACE]) ? 0 : switch_str_time(argv[LCR_CACHE_DATE_END_PLACE]);
+
+	row->next = switch_core_hash_find(cache->digits_hash, row->argv[LCR_DIGITS_PLACE]);
+	switch_core_hash_insert(cache->digits_hash, row->argv[LCR_DIGITS_PLACE], row);
+	cache->rows++;
+
+	return 0;
+}
+
+static void lcr_cache_release(lcr_cache_t *cache)
+{
+	int refs;
+
+	if (!cache) {
+		return;
+	}
+
+	switch_mutex_lock(globals.mutex);
+	refs = --cache->refs;
+	switch_mutex_unlock(globals.mutex);
+
+	if (!refs) {
+		switch_memory_pool_t *pool = cache->pool;
+		switch_core_hash_destroy(&cache->digits_hash);
+		switch_core_destroy_memory_pool(&pool);
+	}
+}
+
+static lcr_cache_t *lcr_cache_acquire(profile_t *profile)
+{
+	lcr_cache_t *cache;
+
+	switch_mutex_lock(globals.mutex);
+	if ((cache = profile->cache)) {
+		cache->refs++;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	return cache;
+}
+
+/* pull the profile's whole route table into a fresh cache and swap it in, lookups in flight keep the old one */
+static switch_status_t lcr_cache_load(profile_t *profile)
+{
+	switch_stream_handle_t sql_stream = { 0 };
+	switch_memory_pool_t *pool = NULL;
+	lcr_cache_t *cache, *old;
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+	switch_core_new_memory_pool(&pool);
+	cache = switch_core_alloc(pool, sizeof(*cache));
+	cache->pool = pool;
+	cache->refs = 1;
+	switch_core_hash_init(&cache->digits_hash, pool);
+
+	SWITCH_STANDARD_STREAM(sql_stream);
+	sql_stream.write_function(&sql_stream,
+							  "SELECT l.digits, c.carrier_name, l.rate, cg.prefix AS gw_prefix, cg.suffix AS gw_suffix, l.lead_strip, l.trail_strip, l.prefix, l.suffix, %s, %s, "
+							  "l.quality, l.reliability, %s, %s, l.date_start, l.date_end "
+							  "FROM lcr l JOIN carriers c ON l.carrier_id=c.id JOIN carrier_gateway cg ON c.id=cg.carrier_id WHERE c.enabled = '1' AND cg.enabled = '1' AND l.enabled = '1' "
+							  "AND l.date_end >= CURRENT_TIMESTAMP",
+							  db_check("SELECT codec from carrier_gateway limit 1") == SWITCH_TRUE ? "cg.codec" : "''",
+							  db_check("SELECT cid from lcr limit 1") == SWITCH_TRUE ? "l.cid" : "''",
+							  profile->profile_has_intrastate == SWITCH_TRUE ? "l.intrastate_rate" : "l.rate",
+							  profile->profile_has_intralata == SWITCH_TRUE ? "l.intralata_rate" : "l.rate");
+	if (profile->id > 0) {
+		sql_stream.write_function(&sql_stream, " AND lcr_profile=%d", profile->id);
+	}
+	sql_stream.write_function(&sql_stream, ";");
+
+	if (lcr_execute_sql_callback((char *) sql_stream.data, cache_row_callback, cache) != SWITCH_TRUE) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to load the route cache for profile %s\n", profile->name);
+		lcr_cache_release(cache);
+		status = SWITCH_STATUS_FALSE;
+	} else {
+		switch_mutex_lock(globals.mutex);
+		old = profile->cache;
+		profile->cache = cache;
+		switch_mutex_unlock(globals.mutex);
+
+		lcr_cache_release(old);
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Loaded %u routes into the route cache for profile %s\n", cache->rows, profile->name);
+	}
+
+	switch_safe_free(sql_stream.data);
+
+	return status;
+}
+
+typedef struct {
+	lcr_cache_row_t *row;
+	float rate;
+	int rnd;
+	const profile_t *profile;
+} lcr_cache_hit_t;
+
+/* the same order the profile's ORDER BY gives, with a random tie break standing in for the db random() */
+static int lcr_cache_hit_cmp(const void *a, const void *b)
+{
+	const lcr_cache_hit_t *ha = (const lcr_cache_hit_t *) a;
+	const lcr_cache_hit_t *hb = (const lcr_cache_hit_t *) b;
+	int i;
+
+	for (i = 0; i < ha->profile->sort_count; i++) {
+		switch (ha->profile->sort_keys[i]) {
+		case LCR_SORT_RATE:
+			if (ha->rate != hb->rate) {
+				return ha->rate < hb->rate ? -1 : 1;
+			}
+			break;
+		case LCR_SORT_QUALITY:
+			if (ha->row->quality != hb->row->quality) {
+				return ha->row->quality > hb->row->quality ? -1 : 1;
+			}
+			break;
+		case LCR_SORT_RELIABILITY:
+			if (ha->row->reliability != hb->row->reliability) {
+				return ha->row->reliability > hb->row->reliability ? -1 : 1;
+			}
+			break;
+		}
+	}
+
+	return ha->rnd - hb->rnd;
+}
+
+/* the cache holds rows that start in the future too, the date window is checked per call like the live query does */
+static switch_bool_t lcr_cache_row_current(const lcr_cache_row_t *row, switch_time_t now)
+{
+	if (row->date_start && now < row->date_start) {
+		return SWITCH_FALSE;
+	}
+
+	if (row->date_end && now > row->date_end) {
+		return SWITCH_FALSE;
+	}
+
+	return SWITCH_TRUE;
+}
+
+/* walk the prefixes longest first like ORDER BY digits DESC and feed each row to route_add_callback */
+static switch_bool_t lcr_cache_lookup(lcr_cache_t *cache, callback_t *cb_struct, const char *digits, int rate_idx)
+{
+	char *prefix = switch_core_strdup(cb_struct->pool, digits);
+	switch_time_t now = switch_micro_time_now();
+	size_t n;
+
+	for (n = strlen(prefix); n > 0; n--) {
+		lcr_cache_row_t *row, *head;
+		lcr_cache_hit_t *hits;
+		int count = 0, i;
+
+		prefix[n] = '\0';
+
+		if (!(head = switch_core_hash_find(cache->digits_hash, prefix))) {
+			continue;
+		}
+
+		for (row = head; row; row = row->next) {
+			if (lcr_cache_row_current(row, now)) {
+				count++;
+			}
+		}
+
+		if (!count) {
+			continue;
+		}
+
+		hits = switch_core_alloc(cb_struct->pool, sizeof(*hits) * count);
+		for (row = head, i = 0; row; row = row->next) {
+			if (!lcr_cache_row_current(row, now)) {
+				continue;
+			}
+			hits[i].row = row;
+			hits[i].rate = row->rate[rate_idx];
+			hits[i].rnd = rand();
+			hits[i].profile = cb_struct->profile;
+			i++;
+		}
+
+		qsort(hits, count, sizeof(*hits), lcr_cache_hit_cmp);
+
+		for (i = 0; i < count; i++) {
+			char *argv[LCR_QUERY_COLS - 1];
+
+			memcpy(argv, hits[i].row->argv, sizeof(argv));
+			argv[LCR_RATE_PLACE] = hits[i].row->rate_str[rate_idx];
+
+			if (route_add_callback(cb_struct, LCR_QUERY_COLS - 1, argv, NULL) != SWITCH_STATUS_SUCCESS) {
+				return SWITCH_FALSE;
+			}
+		}
+	}
+
+	return SWITCH_TRUE;
+}
+
 static int intrastatelata_callback(void *pArg, int argc, char **argv, char **columnNames)
 {
 	int count = 0;
@@ -729,7 +1002,7 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 	switch_stream_handle_t sql_stream = { 0 };
 	char *digits = cb_struct->lookup_number;
 	char *digits_copy;
-	char *digits_expanded;
+	char *digits_expanded = NULL;
 	profile_t *profile = cb_struct->profile;
 	switch_bool_t lookup_status;
 	switch_channel_t *channel;
@@ -737,6 +1010,8 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 	char *safe_sql = NULL;
 	char *rate_field = NULL;
 	char *user_rate_field = NULL;
+	int rate_idx = LCR_CACHE_RATE;
+	lcr_cache_t *cache;
 
 	switch_assert(cb_struct->lookup_number != NULL);
 
@@ -751,7 +1026,10 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 		return SWITCH_STATUS_GENERR;
 	}
 
-	digits_expanded = expand_digits(cb_struct->pool, digits_copy, cb_struct->profile->quote_in_list);
+	/* the IN list is only needed by the sql, the route cache walks the prefixes itself */
+	if (!(cache = lcr_cache_acquire(profile))) {
+		digits_expanded = expand_digits(cb_struct->pool, digits_copy, cb_struct->profile->quote_in_list);
+	}
 
 	if (profile->profile_has_npanxx == SWITCH_TRUE) {
 		is_intrastatelata(cb_struct);
@@ -761,9 +1039,11 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 	if (cb_struct->intralata == SWITCH_TRUE && profile->profile_has_intralata == SWITCH_TRUE) {
 		rate_field = switch_core_strdup(cb_struct->pool, "intralata_rate");
 		user_rate_field = switch_core_strdup(cb_struct->pool, "user_intralata_rate");
+		rate_idx = LCR_CACHE_INTRALATA_RATE;
 	} else if (cb_struct->intrastate == SWITCH_TRUE && profile->profile_has_intrastate == SWITCH_TRUE) {
 		rate_field = switch_core_strdup(cb_struct->pool, "intrastate_rate");
 		user_rate_field = switch_core_strdup(cb_struct->pool, "user_intrastate_rate");
+		rate_idx = LCR_CACHE_INTRASTATE_RATE;
 	} else {
 		rate_field = switch_core_strdup(cb_struct->pool, "rate");
 		user_rate_field = switch_core_strdup(cb_struct->pool, "user_rate");
@@ -780,7 +1060,9 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 			switch_channel_set_variable_var_check(channel, "lcr_query_digits", digits_copy, SWITCH_FALSE);
 			id_str = switch_core_sprintf(cb_struct->pool, "%d", cb_struct->profile->id);
 			switch_channel_set_variable_var_check(channel, "lcr_query_profile", id_str, SWITCH_FALSE);
-			switch_channel_set_variable_var_check(channel, "lcr_query_expanded_digits", digits_expanded, SWITCH_FALSE);
+			if (digits_expanded) {
+				switch_channel_set_variable_var_check(channel, "lcr_query_expanded_digits", digits_expanded, SWITCH_FALSE);
+			}
 		}
 	}
 	if (cb_struct->event) {
@@ -790,7 +1072,17 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 		switch_event_add_header_string(cb_struct->event, SWITCH_STACK_BOTTOM, "lcr_query_digits", digits_copy);
 		id_str = switch_core_sprintf(cb_struct->pool, "%d", cb_struct->profile->id);
 		switch_event_add_header_string(cb_struct->event, SWITCH_STACK_BOTTOM, "lcr_query_profile", id_str);
-		switch_event_add_header_string(cb_struct->event, SWITCH_STACK_BOTTOM, "lcr_query_expanded_digits", digits_expanded);
+		if (digits_expanded) {
+			switch_event_add_header_string(cb_struct->event, SWITCH_STACK_BOTTOM, "lcr_query_expanded_digits", digits_expanded);
+		}
+	}
+
+	if (cache) {
+		lookup_status = lcr_cache_lookup(cache, cb_struct, digits_copy, rate_idx);
+		lcr_cache_release(cache);
+		switch_event_safe_destroy(&cb_struct->event);
+		switch_core_hash_destroy(&cb_struct->dedup_hash);
+		return lookup_status ? SWITCH_STATUS_SUCCESS : SWITCH_STATUS_GENERR;
 	}
 
 	/* set up the query to be executed */
@@ -844,6 +1136,13 @@ static switch_bool_t test_profile(char *lcr_profile)
 	return (lcr_do_lookup(&routes) == SWITCH_STATUS_SUCCESS) ? SWITCH_TRUE : SWITCH_FALSE;
 }
 
+static void add_sort_key(int *sort_keys, int *sort_count, int key)
+{
+	if (*sort_count > -1 && *sort_count < LCR_SORT_MAX) {
+		sort_keys[(*sort_count)++] = key;
+	}
+}
+
 static switch_status_t lcr_load_config()
 {
 	char *cf = "lcr.conf";
@@ -903,7 +1202,11 @@ static switch_status_t lcr_load_config()
 			char *reorder_by_rate = NULL;
 			char *quote_in_list = NULL;
 			char *info_in_headers = NULL;
+			char *route_cache = NULL;
+			switch_bool_t default_sql = SWITCH_FALSE;
 			char *id_s = NULL;
+			int sort_keys[LCR_SORT_MAX] = { 0 };
+			int sort_count = 0;
 			char *custom_sql = NULL;
 			int argc, x = 0;
 			char *argv[4] = { 0 };
@@ -925,12 +1228,16 @@ static switch_status_t lcr_load_config()
 							if (!zstr(argv[x])) {
 								if (!strcasecmp(argv[x], "quality")) {
 									thisorder->write_function(thisorder, "%s quality DESC", comma);
+									add_sort_key(sort_keys, &sort_count, LCR_SORT_QUALITY);
 								} else if (!strcasecmp(argv[x], "reliability")) {
 									thisorder->write_function(thisorder, "%s reliability DESC", comma);
+									add_sort_key(sort_keys, &sort_count, LCR_SORT_RELIABILITY);
 								} else if (!strcasecmp(argv[x], "rate")) {
 									thisorder->write_function(thisorder, "%s ${lcr_rate_field}", comma);
+									add_sort_key(sort_keys, &sort_count, LCR_SORT_RATE);
 								} else {
 									thisorder->write_function(thisorder, "%s %s", comma, argv[x]);
+									sort_count = -1;
 								}
 							} else {
 								switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "arg #%d is empty\n", x);
@@ -939,10 +1246,13 @@ static switch_status_t lcr_load_config()
 					} else {
 						if (!strcasecmp(val, "quality")) {
 							thisorder->write_function(thisorder, "%s quality DESC", comma);
+							add_sort_key(sort_keys, &sort_count, LCR_SORT_QUALITY);
 						} else if (!strcasecmp(val, "reliability")) {
 							thisorder->write_function(thisorder, "%s reliability DESC", comma);
+							add_sort_key(sort_keys, &sort_count, LCR_SORT_RELIABILITY);
 						} else {
 							thisorder->write_function(thisorder, "%s %s", comma, val);
+							sort_count = -1;
 						}
 					}
 				} else if (!strcasecmp(var, "id") && !zstr(val)) {
@@ -955,6 +1265,8 @@ static switch_status_t lcr_load_config()
 					info_in_headers = val;
 				} else if (!strcasecmp(var, "quote_in_list") && !zstr(val)) {
 					quote_in_list = val;
+				} else if (!strcasecmp(var, "route_cache") && !zstr(val)) {
+					route_cache = val;
 				}
 			}
 
@@ -1009,6 +1321,7 @@ static switch_status_t lcr_load_config()
 					sql_stream.write_function(&sql_stream, ";");
 
 					custom_sql = sql_stream.data;
+					default_sql = SWITCH_TRUE;
 				}
 
 
@@ -1049,6 +1362,23 @@ static switch_status_t lcr_load_config()
 					profile->quote_in_list = switch_true(quote_in_list);
 				}
 
+				if (!zstr(route_cache) && switch_true(route_cache)) {
+					if (!default_sql) {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "route_cache is not supported with custom_sql, disabled for profile %s\n", profile->name);
+					} else if (sort_count < 0) {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING,
+										  "route_cache only orders by rate, quality and reliability, disabled for profile %s\n", profile->name);
+					} else {
+						if (!sort_count) {
+							add_sort_key(sort_keys, &sort_count, LCR_SORT_RATE);
+						}
+						memcpy(profile->sort_keys, sort_keys, sizeof(sort_keys));
+						profile->sort_count = sort_count;
+						profile->route_cache = SWITCH_TRUE;
+						lcr_cache_load(profile);
+					}
+				}
+
 				switch_core_hash_insert(globals.profile_hash, profile->name, profile);
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Loaded lcr profile %s.\n", profile->name);
 				/* test the profile */
@@ -1274,6 +1604,48 @@ SWITCH_STANDARD_APP(lcr_app_function)
 	}
 }
 
+/* rebuild the route cache of every profile that uses one, each swap is atomic to running lookups */
+static void lcr_cache_reload(switch_stream_handle_t *stream)
+{
+	switch_hash_index_t *hi;
+	void *val;
+	profile_t **profiles = NULL;
+	int total = 0, i, count = 0, failed = 0;
+
+	/* collect the profiles under the lock, the loads themselves run without it so lookups are not held up by the db */
+	switch_mutex_lock(globals.mutex);
+	for (hi = switch_hash_first(NULL, globals.profile_hash); hi; hi = switch_hash_next(hi)) {
+		total++;
+	}
+	if (total) {
+		switch_zmalloc(profiles, sizeof(*profiles) * total);
+		total = 0;
+		for (hi = switch_hash_first(NULL, globals.profile_hash); hi; hi = switch_hash_next(hi)) {
+			switch_hash_this(hi, NULL, NULL, &val);
+			if (((profile_t *) val)->route_cache) {
+				profiles[total++] = (profile_t *) val;
+			}
+		}
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	for (i = 0; i < total; i++) {
+		if (lcr_cache_load(profiles[i]) == SWITCH_STATUS_SUCCESS) {
+			count++;
+		} else {
+			failed++;
+		}
+	}
+
+	switch_safe_free(profiles);
+
+	if (failed) {
+		stream->write_function(stream, "-ERR %d route cache(s) failed to reload\n", failed);
+	} else {
+		stream->write_function(stream, "+OK reloaded %d route cache(s)\n", count);
+	}
+}
+
 static void write_data(switch_stream_handle_t *stream, switch_bool_t as_xml, const char *key, const char *data, int indent, int maxlen)
 {
 	if (as_xml) {
@@ -1307,6 +1679,11 @@ SWITCH_STANDARD_API(dialplan_lcr_function)
 
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "data passed to lcr is [%s]\n", cmd);
 
+	if (!strcasecmp(cmd, "reload")) {
+		lcr_cache_reload(stream);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
 	if (session) {
 		pool = switch_core_session_get_pool(session);
 		cb_struct.session = session;
@@ -1500,6 +1877,15 @@ SWITCH_STANDARD_API(dialplan_lcr_admin_function)
 				stream->write_function(stream, " Reorder rate:\t%s\n", profile->reorder_by_rate ? "enabled" : "disabled");
 				stream->write_function(stream, " Info in headers:\t%s\n", profile->info_in_headers ? "enabled" : "disabled");
 				stream->write_function(stream, " Quote IN() List:\t%s\n", profile->quote_in_list ? "enabled" : "disabled");
+				if (profile->route_cache) {
+					/* hold a reference, a reload running meanwhile may drop the cache we are reading */
+					lcr_cache_t *cache = lcr_cache_acquire(profile);
+
+					stream->write_function(stream, " Route cache:\t%u routes\n", cache ? cache->rows : 0);
+					lcr_cache_release(cache);
+				} else {
+					stream->write_function(stream, " Route cache:\tdisabled\n");
+				}
 				stream->write_function(stream, "\n");
 			}
 		} else {
@@ -1552,6 +1938,16 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lcr_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_lcr_shutdown)
 {
+	switch_hash_index_t *hi;
+	void *val;
+	profile_t *profile;
+
+	for (hi = switch_hash_first(NULL, globals.profile_hash); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		profile = (profile_t *) val;
+		lcr_cache_release(profile->cache);
+		profile->cache = NULL;
+	}
 
 	switch_core_hash_destroy(&globals.profile_hash);
 
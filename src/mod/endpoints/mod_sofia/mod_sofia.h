@@ -40,6 +40,9 @@
 #define SQL_CACHE_TIMEOUT 300
 #define DEFAULT_NONCE_TTL 60
 #define IREG_SECONDS 30
+#define SOFIA_REG_WHEEL_SLOTS 1024
+#define SOFIA_REG_FLUSH_LOOPS 100
+#define SOFIA_REG_FLUSH_ROWS 1000
 #define GATEWAY_SECONDS 1
 #define SOFIA_QUEUE_SIZE 50000
 #define HAVE_APR
@@ -208,6 +211,7 @@ typedef enum {
 	PFLAG_TRACK_CALLS,
 	PFLAG_DESTROY,
 	PFLAG_EXTENDED_INFO_PARSING,
+	PFLAG_RTP_BATCH_IO,
 	/* No new flags below this line */
 	PFLAG_MAX
 } PFLAGS;
@@ -427,6 +431,62 @@ typedef enum {
 	CID_TYPE_NONE
 } sofia_cid_type_t;
 
+typedef enum {
+	SOFIA_REG_COL_CALL_ID,
+	SOFIA_REG_COL_SIP_USER,
+	SOFIA_REG_COL_SIP_HOST,
+	SOFIA_REG_COL_PRESENCE_HOSTS,
+	SOFIA_REG_COL_CONTACT,
+	SOFIA_REG_COL_STATUS,
+	SOFIA_REG_COL_RPID,
+	SOFIA_REG_COL_USER_AGENT,
+	SOFIA_REG_COL_SERVER_USER,
+	SOFIA_REG_COL_SERVER_HOST,
+	SOFIA_REG_COL_PROFILE_NAME,
+	SOFIA_REG_COL_HOSTNAME,
+	SOFIA_REG_COL_NETWORK_IP,
+	SOFIA_REG_COL_NETWORK_PORT,
+	SOFIA_REG_COL_SIP_USERNAME,
+	SOFIA_REG_COL_SIP_REALM,
+	SOFIA_REG_COL_MWI_USER,
+	SOFIA_REG_COL_MWI_HOST,
+	SOFIA_REG_COL_ORIG_SERVER_HOST,
+	SOFIA_REG_COL_ORIG_HOSTNAME,
+	SOFIA_REG_COL_MAX
+} sofia_reg_col_t;
+
+/* which rows a REGISTER replaces, mirrors the multi-reg settings */
+typedef enum {
+	SOFIA_REG_KEY_USER_HOST,
+	SOFIA_REG_KEY_CALL_ID,
+	SOFIA_REG_KEY_CONTACT
+} sofia_reg_key_t;
+
+typedef enum {
+	SOFIA_REG_DIRTY_EXPIRES = (1 << 0),
+	SOFIA_REG_DIRTY_ROW = (1 << 1),
+	SOFIA_REG_DIRTY_DEAD = (1 << 2)
+} sofia_reg_dirty_t;
+
+typedef struct sofia_reg_contact sofia_reg_contact_t;
+
+/* one row of sip_registrations owned by this host, the db table is written behind it */
+struct sofia_reg_contact {
+	char *col[SOFIA_REG_COL_MAX];
+	char *user_host;
+	long expires;
+	sofia_reg_key_t key_type;
+	uint32_t dirty;
+	uint8_t persisted;
+	int wheel_slot;
+	sofia_reg_contact_t *next;
+	sofia_reg_contact_t *cid_next;
+	sofia_reg_contact_t *wheel_prev;
+	sofia_reg_contact_t *wheel_next;
+	sofia_reg_contact_t *dirty_next;
+	sofia_reg_contact_t *reap_next;
+};
+
 struct sofia_profile {
 	int debug;
 	char *name;
@@ -509,6 +569,13 @@ struct sofia_profile {
 	char *odbc_pass;
 	//  switch_odbc_handle_t *master_odbc;
 	switch_queue_t *sql_queue;
+	switch_hash_t *reg_hash;
+	switch_hash_t *reg_cid_hash;
+	sofia_reg_contact_t *reg_wheel[SOFIA_REG_WHEEL_SLOTS];
+	time_t reg_wheel_tick;
+	sofia_reg_contact_t *reg_dirty;
+	uint32_t reg_dirty_count;
+	uint32_t reg_contact_count;
 	char *acl[SOFIA_MAX_ACL];
 	uint32_t acl_count;
 	char *proxy_acl[SOFIA_MAX_ACL];
@@ -806,6 +873,11 @@ void sofia_glue_actually_execute_sql(sofia_profile_t *profile, char *sql, switch
 void sofia_glue_actually_execute_sql_trans(sofia_profile_t *profile, char *sql, switch_mutex_t *mutex);
 void sofia_glue_execute_sql_now(sofia_profile_t *profile, char **sqlp, switch_bool_t sql_already_dynamic);
 void sofia_reg_check_expire(sofia_profile_t *profile, time_t now, int reboot);
+void sofia_reg_store_load(sofia_profile_t *profile);
+void sofia_reg_store_tick(sofia_profile_t *profile, time_t now);
+void sofia_reg_store_flush(sofia_profile_t *profile);
+void sofia_reg_store_destroy(sofia_profile_t *profile);
+void sofia_reg_store_expire_user(sofia_profile_t *profile, const char *user, const char *host, time_t expires);
 void sofia_reg_check_gateway(sofia_profile_t *profile, time_t now);
 void sofia_sub_check_gateway(sofia_profile_t *profile, time_t now);
 void sofia_reg_unregister(sofia_profile_t *profile);
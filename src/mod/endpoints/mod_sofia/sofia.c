@@ -1171,6 +1171,7 @@ void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread
 	sofia_profile_t *profile = (sofia_profile_t *) obj;
 	uint32_t ireg_loops = 0;
 	uint32_t gateway_loops = 0;
+	uint32_t reg_flush_loops = 0;
 	int loops = 0;
 	uint32_t qsize;
 	void *pop;
@@ -1185,6 +1186,8 @@ void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread
 	ireg_loops = IREG_SECONDS;
 	gateway_loops = GATEWAY_SECONDS;
 
+	sofia_reg_store_load(profile);
+
 	sofia_set_pflag_locked(profile, PFLAG_WORKER_RUNNING);
 
 	switch_queue_create(&profile->sql_queue, SOFIA_QUEUE_SIZE, profile->pool);
@@ -1241,9 +1244,17 @@ void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread
 			}
 		}
 
+		if (profile->reg_dirty_count && (profile->reg_dirty_count >= SOFIA_REG_FLUSH_ROWS || ++reg_flush_loops >= SOFIA_REG_FLUSH_LOOPS)) {
+			sofia_reg_store_flush(profile);
+			reg_flush_loops = 0;
+		}
+
 		if (++loops >= 1000) {
+			time_t now = switch_epoch_time_now(NULL);
+
+			sofia_reg_store_tick(profile, now);
+
 			if (++ireg_loops >= IREG_SECONDS) {
-				time_t now = switch_epoch_time_now(NULL);
 				sofia_reg_check_expire(profile, now, 0);
 				ireg_loops = 0;
 			}
@@ -1267,6 +1278,8 @@ void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread
 	}
 	switch_mutex_unlock(profile->ireg_mutex);
 
+	sofia_reg_store_destroy(profile);
+
 	sofia_clear_pflag_locked(profile, PFLAG_WORKER_RUNNING);
 	switch_safe_free(sqlbuf);
 
@@ -2394,6 +2407,12 @@ switch_status_t reconfig_sofia(sofia_profile_t *profile)
 						} else {
 							sofia_clear_pflag(profile, PFLAG_AUTOFLUSH);
 						}
+					} else if (!strcasecmp(var, "rtp-batch-io")) {
+						if (switch_true(val)) {
+							sofia_set_pflag(profile, PFLAG_RTP_BATCH_IO);
+						} else {
+							sofia_clear_pflag(profile, PFLAG_RTP_BATCH_IO);
+						}
 					} else if (!strcasecmp(var, "rtp-autofix-timing")) {
 						if (switch_true(val)) {
 							sofia_set_pflag(profile, PFLAG_AUTOFIX_TIMING);
@@ -3099,6 +3118,12 @@ switch_status_t config_sofia(int reload, char *profile_name)
 						} else {
 							sofia_clear_pflag(profile, PFLAG_AUTOFLUSH);
 						}
+					} else if (!strcasecmp(var, "rtp-batch-io")) {
+						if (switch_true(val)) {
+							sofia_set_pflag(profile, PFLAG_RTP_BATCH_IO);
+						} else {
+							sofia_clear_pflag(profile, PFLAG_RTP_BATCH_IO);
+						}
 					} else if (!strcasecmp(var, "rtp-autofix-timing")) {
 						if (switch_true(val)) {
 							sofia_set_pflag(profile, PFLAG_AUTOFIX_TIMING);
@@ -3615,14 +3640,11 @@ static void sofia_handle_sip_r_options(switch_core_session_t *session, int statu
 		sofia_reg_release_gateway(gateway);
 		gateway->pinging = 0;
 	} else if (sofia_test_pflag(profile, PFLAG_UNREG_OPTIONS_FAIL) && status != 200 && sip && sip->sip_to) {
-		char *sql;
 		time_t now = switch_epoch_time_now(NULL);
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "Expire registration '%s@%s' due to options failure\n",
 						  sip->sip_to->a_url->url_user, sip->sip_to->a_url->url_host);
 
-		sql = switch_mprintf("update sip_registrations set expires=%ld where sip_user='%s' and sip_host='%s'",
-							 (long) now, sip->sip_to->a_url->url_user, sip->sip_to->a_url->url_host);
-		sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
+		sofia_reg_store_expire_user(profile, sip->sip_to->a_url->url_user, sip->sip_to->a_url->url_host, now);
 	}
 }
 
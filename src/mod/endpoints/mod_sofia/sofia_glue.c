@@ -2558,6 +2558,11 @@ switch_status_t sofia_glue_activate_rtp(private_object_t *tech_pvt, switch_rtp_f
 		flags |= SWITCH_RTP_FLAG_AUTOFLUSH;
 	}
 
+	if (sofia_test_pflag(tech_pvt->profile, PFLAG_RTP_BATCH_IO)
+		|| ((val = switch_channel_get_variable(tech_pvt->channel, "rtp_batch_io")) && switch_true(val))) {
+		flags |= SWITCH_RTP_FLAG_BATCH_IO;
+	}
+
 	if (!(sofia_test_pflag(tech_pvt->profile, PFLAG_REWRITE_TIMESTAMPS) ||
 		  ((val = switch_channel_get_variable(tech_pvt->channel, "rtp_rewrite_timestamps")) && !switch_true(val)))) {
 		flags |= SWITCH_RTP_FLAG_RAW_WRITE;
@@ -529,12 +529,628 @@ int sofia_reg_del_callback(void *pArg, int argc, char **argv, char **columnNames
 	return 0;
 }
 
+/*
+ * Registration store: every contact registered on this host lives in profile->reg_hash keyed by user@host
+ * and in profile->reg_cid_hash keyed by call-id, expiry is driven by a one second timer wheel.
+ * Refreshes that only move the expiry are written behind to sip_registrations in batches, anything readers
+ * of the table can see (a new or changed contact, an unregister) is flushed before the request returns.
+ * When the store is not running (worker stopped) the table is written directly as before.
+ * All of it is protected by profile->ireg_mutex.
+ */
+
+static char *reg_store_where_cols(sofia_reg_key_t key_type, const char **col)
+{
+	switch (key_type) {
+	case SOFIA_REG_KEY_CALL_ID:
+		return switch_mprintf("call_id='%q'", col[SOFIA_REG_COL_CALL_ID]);
+	case SOFIA_REG_KEY_CONTACT:
+		return switch_mprintf("sip_user='%q' and sip_host='%q' and contact='%q'",
+							  col[SOFIA_REG_COL_SIP_USER], col[SOFIA_REG_COL_SIP_HOST], col[SOFIA_REG_COL_CONTACT]);
+	default:
+		return switch_mprintf("sip_user='%q' and sip_host='%q'", col[SOFIA_REG_COL_SIP_USER], col[SOFIA_REG_COL_SIP_HOST]);
+	}
+}
+
+#define reg_store_where(_c) reg_store_where_cols((_c)->key_type, (const char **) (_c)->col)
+
+/* the statements that replace the row(s) a registration keys on */
+static char *reg_store_row_sql(sofia_reg_key_t key_type, const char **col, long expires)
+{
+	char *where = reg_store_where_cols(key_type, col);
+	char *sql;
+
+	sql = switch_mprintf("delete from sip_registrations where %s;\n"
+						 "insert into sip_registrations "
+						 "(call_id,sip_user,sip_host,presence_hosts,contact,status,rpid,expires,"
+						 "user_agent,server_user,server_host,profile_name,hostname,network_ip,network_port,sip_username,sip_realm,"
+						 "mwi_user,mwi_host, orig_server_host, orig_hostname) "
+						 "values ('%q','%q', '%q','%q','%q','%q', '%q', %ld, '%q', '%q', '%q', '%q', '%q', '%q', '%q','%q','%q','%q','%q','%q','%q');\n",
+						 where,
+						 col[SOFIA_REG_COL_CALL_ID], col[SOFIA_REG_COL_SIP_USER], col[SOFIA_REG_COL_SIP_HOST],
+						 col[SOFIA_REG_COL_PRESENCE_HOSTS], col[SOFIA_REG_COL_CONTACT], col[SOFIA_REG_COL_STATUS],
+						 col[SOFIA_REG_COL_RPID], expires, col[SOFIA_REG_COL_USER_AGENT], col[SOFIA_REG_COL_SERVER_USER],
+						 col[SOFIA_REG_COL_SERVER_HOST], col[SOFIA_REG_COL_PROFILE_NAME], col[SOFIA_REG_COL_HOSTNAME],
+						 col[SOFIA_REG_COL_NETWORK_IP], col[SOFIA_REG_COL_NETWORK_PORT], col[SOFIA_REG_COL_SIP_USERNAME],
+						 col[SOFIA_REG_COL_SIP_REALM], col[SOFIA_REG_COL_MWI_USER], col[SOFIA_REG_COL_MWI_HOST],
+						 col[SOFIA_REG_COL_ORIG_SERVER_HOST], col[SOFIA_REG_COL_ORIG_HOSTNAME]);
+
+	switch_safe_free(where);
+
+	return sql;
+}
+
+static char *reg_store_dup(const char *s)
+{
+	char *r = strdup(s ? s : "");
+	switch_assert(r);
+	return r;
+}
+
+static void reg_store_free_contact(sofia_reg_contact_t *c)
+{
+	int i;
+
+	for (i = 0; i < SOFIA_REG_COL_MAX; i++) {
+		switch_safe_free(c->col[i]);
+	}
+	switch_safe_free(c->user_host);
+	free(c);
+}
+
+static void reg_store_wheel_del(sofia_profile_t *profile, sofia_reg_contact_t *c)
+{
+	if (c->wheel_slot < 0) {
+		return;
+	}
+
+	if (c->wheel_prev) {
+		c->wheel_prev->wheel_next = c->wheel_next;
+	} else {
+		profile->reg_wheel[c->wheel_slot] = c->wheel_next;
+	}
+
+	if (c->wheel_next) {
+		c->wheel_next->wheel_prev = c->wheel_prev;
+	}
+
+	c->wheel_prev = c->wheel_next = NULL;
+	c->wheel_slot = -1;
+}
+
+static void reg_store_wheel_add(sofia_profile_t *profile, sofia_reg_contact_t *c)
+{
+	time_t when = c->expires;
+
+	/* expires=0 never expires */
+	if (c->expires <= 0) {
+		return;
+	}
+
+	/* anything already due goes in the next slot the wheel visits */
+	if (profile->reg_wheel_tick && when <= profile->reg_wheel_tick) {
+		when = profile->reg_wheel_tick + 1;
+	}
+
+	c->wheel_slot = (int) (when % SOFIA_REG_WHEEL_SLOTS);
+	c->wheel_prev = NULL;
+	c->wheel_next = profile->reg_wheel[c->wheel_slot];
+
+	if (c->wheel_next) {
+		c->wheel_next->wheel_prev = c;
+	}
+
+	profile->reg_wheel[c->wheel_slot] = c;
+}
+
+static void reg_store_mark(sofia_profile_t *profile, sofia_reg_contact_t *c, uint32_t flag)
+{
+	if (!c->dirty) {
+		c->dirty_next = profile->reg_dirty;
+		profile->reg_dirty = c;
+		profile->reg_dirty_count++;
+	}
+
+	c->dirty |= flag;
+}
+
+static void reg_store_cid_link(sofia_profile_t *profile, sofia_reg_contact_t *c)
+{
+	c->cid_next = (sofia_reg_contact_t *) switch_core_hash_find(profile->reg_cid_hash, c->col[SOFIA_REG_COL_CALL_ID]);
+	switch_core_hash_insert(profile->reg_cid_hash, c->col[SOFIA_REG_COL_CALL_ID], c);
+}
+
+static void reg_store_cid_unlink(sofia_profile_t *profile, sofia_reg_contact_t *c)
+{
+	sofia_reg_contact_t *cp, *last = NULL;
+
+	for (cp = (sofia_reg_contact_t *) switch_core_hash_find(profile->reg_cid_hash, c->col[SOFIA_REG_COL_CALL_ID]); cp; cp = cp->cid_next) {
+		if (cp == c) {
+			if (last) {
+				last->cid_next = c->cid_next;
+			} else if (c->cid_next) {
+				switch_core_hash_insert(profile->reg_cid_hash, c->col[SOFIA_REG_COL_CALL_ID], c->cid_next);
+			} else {
+				switch_core_hash_delete(profile->reg_cid_hash, c->col[SOFIA_REG_COL_CALL_ID]);
+			}
+			break;
+		}
+		last = cp;
+	}
+
+	c->cid_next = NULL;
+}
+
+static sofia_reg_contact_t *reg_store_add(sofia_profile_t *profile, const char **col, long expires, sofia_reg_key_t key_type)
+{
+	sofia_reg_contact_t *c;
+	int i;
+
+	switch_zmalloc(c, sizeof(*c));
+
+	for (i = 0; i < SOFIA_REG_COL_MAX; i++) {
+		c->col[i] = reg_store_dup(col[i]);
+	}
+
+	c->user_host = switch_mprintf("%s@%s", c->col[SOFIA_REG_COL_SIP_USER], c->col[SOFIA_REG_COL_SIP_HOST]);
+	c->expires = expires;
+	c->key_type = key_type;
+	c->wheel_slot = -1;
+
+	c->next = (sofia_reg_contact_t *) switch_core_hash_find(profile->reg_hash, c->user_host);
+	switch_core_hash_insert(profile->reg_hash, c->user_host, c);
+	reg_store_cid_link(profile, c);
+	reg_store_wheel_add(profile, c);
+	profile->reg_contact_count++;
+
+	return c;
+}
+
+/* drop a contact from the hash and the wheel, the flush deletes its row and frees it */
+static void reg_store_unlink(sofia_profile_t *profile, sofia_reg_contact_t *c)
+{
+	sofia_reg_contact_t *head, *cp, *last = NULL;
+
+	if ((head = (sofia_reg_contact_t *) switch_core_hash_find(profile->reg_hash, c->user_host))) {
+		for (cp = head; cp; cp = cp->next) {
+			if (cp == c) {
+				if (last) {
+					last->next = c->next;
+				} else if (c->next) {
+					switch_core_hash_insert(profile->reg_hash, c->user_host, c->next);
+				} else {
+					switch_core_hash_delete(profile->reg_hash, c->user_host);
+				}
+				break;
+			}
+			last = cp;
+		}
+	}
+
+	c->next = NULL;
+	reg_store_cid_unlink(profile, c);
+	reg_store_wheel_del(profile, c);
+	profile->reg_contact_count--;
+	reg_store_mark(profile, c, SOFIA_REG_DIRTY_DEAD);
+}
+
+static void reg_store_expire_contact(sofia_profile_t *profile, sofia_reg_contact_t *c, int reboot)
+{
+	char expires[32];
+	char reboot_str[4];
+	char *argv[13];
+
+	switch_snprintf(expires, sizeof(expires), "%ld", c->expires);
+	switch_snprintf(reboot_str, sizeof(reboot_str), "%d", reboot);
+
+	/* same layout as the select sofia_reg_del_callback was written for */
+	argv[0] = c->col[SOFIA_REG_COL_CALL_ID];
+	argv[1] = c->col[SOFIA_REG_COL_SIP_USER];
+	argv[2] = c->col[SOFIA_REG_COL_SIP_HOST];
+	argv[3] = c->col[SOFIA_REG_COL_CONTACT];
+	argv[4] = c->col[SOFIA_REG_COL_STATUS];
+	argv[5] = c->col[SOFIA_REG_COL_RPID];
+	argv[6] = expires;
+	argv[7] = c->col[SOFIA_REG_COL_USER_AGENT];
+	argv[8] = c->col[SOFIA_REG_COL_SERVER_USER];
+	argv[9] = c->col[SOFIA_REG_COL_SERVER_HOST];
+	argv[10] = c->col[SOFIA_REG_COL_PROFILE_NAME];
+	argv[11] = c->col[SOFIA_REG_COL_NETWORK_IP];
+	argv[12] = reboot_str;
+
+	sofia_reg_del_callback(profile, 13, argv, NULL);
+	reg_store_unlink(profile, c);
+}
+
+/* chain every contact matching call_id, user@host or just host (any may be NULL) on reap_next */
+static sofia_reg_contact_t *reg_store_collect(sofia_profile_t *profile, const char *call_id, const char *user, const char *host)
+{
+	switch_hash_index_t *hi;
+	void *val;
+	sofia_reg_contact_t *c, *reap = NULL;
+
+	for (hi = switch_hash_first(NULL, profile->reg_hash); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		for (c = (sofia_reg_contact_t *) val; c; c = c->next) {
+			int hit = 0;
+
+			if (!call_id && !host) {
+				hit = 1;
+			} else if (call_id && !strcmp(c->col[SOFIA_REG_COL_CALL_ID], call_id)) {
+				hit = 1;
+			} else if (host && !strcmp(c->col[SOFIA_REG_COL_SIP_HOST], host)) {
+				hit = zstr(user) || !strcmp(c->col[SOFIA_REG_COL_SIP_USER], user);
+			}
+
+			if (hit) {
+				c->reap_next = reap;
+				reap = c;
+			}
+		}
+	}
+
+	return reap;
+}
+
+static void reg_store_register(sofia_profile_t *profile, sofia_reg_key_t key_type, const char **col, long expires)
+{
+	sofia_reg_contact_t *c, *next, *match = NULL;
+	char *user_host;
+	uint32_t flag = 0;
+	int i;
+
+	if (!profile->reg_hash) {
+		char *sql = reg_store_row_sql(key_type, col, expires);
+		sofia_glue_actually_execute_sql_trans(profile, sql, NULL);
+		switch_safe_free(sql);
+		return;
+	}
+
+	user_host = switch_mprintf("%s@%s", col[SOFIA_REG_COL_SIP_USER], col[SOFIA_REG_COL_SIP_HOST]);
+
+	if (key_type == SOFIA_REG_KEY_CALL_ID) {
+		/* the call-id is the key, a row under any other user@host is replaced too */
+		for (c = (sofia_reg_contact_t *) switch_core_hash_find(profile->reg_cid_hash, col[SOFIA_REG_COL_CALL_ID]); c; c = next) {
+			next = c->cid_next;
+
+			if (strcmp(c->col[SOFIA_REG_COL_CALL_ID], col[SOFIA_REG_COL_CALL_ID])) {
+				continue;
+			}
+
+			if (!match && !strcasecmp(c->user_host, user_host)) {
+				match = c;
+			} else {
+				reg_store_unlink(profile, c);
+				flag |= SOFIA_REG_DIRTY_ROW;
+			}
+		}
+	} else {
+		for (c = (sofia_reg_contact_t *) switch_core_hash_find(profile->reg_hash, user_host); c; c = next) {
+			next = c->next;
+
+			if (key_type == SOFIA_REG_KEY_USER_HOST) {
+				/* a single registration per user@host, it replaces all of them */
+				if (!match) {
+					match = c;
+				} else {
+					reg_store_unlink(profile, c);
+					flag |= SOFIA_REG_DIRTY_ROW;
+				}
+			} else if (!match && !strcmp(c->col[SOFIA_REG_COL_CONTACT], col[SOFIA_REG_COL_CONTACT])) {
+				match = c;
+			}
+		}
+	}
+
+	switch_safe_free(user_host);
+
+	if (!match) {
+		c = reg_store_add(profile, col, expires, key_type);
+		reg_store_mark(profile, c, SOFIA_REG_DIRTY_ROW);
+		/* readers query the table for new contacts (lookups, max registrations), so it goes out now */
+		sofia_reg_store_flush(profile);
+		return;
+	}
+
+	if (flag) {
+		reg_store_mark(profile, match, flag);
+	}
+
+	/* a refresh that only moves the expiry becomes a cheap update when flushed */
+	for (i = 0; i < SOFIA_REG_COL_MAX; i++) {
+		const char *val = col[i] ? col[i] : "";
+
+		if (strcmp(match->col[i], val)) {
+			if (i == SOFIA_REG_COL_CALL_ID) {
+				reg_store_cid_unlink(profile, match);
+			}
+			free(match->col[i]);
+			match->col[i] = reg_store_dup(val);
+			if (i == SOFIA_REG_COL_CALL_ID) {
+				reg_store_cid_link(profile, match);
+			}
+			flag |= SOFIA_REG_DIRTY_ROW;
+		}
+	}
+
+	if (match->key_type != key_type) {
+		match->key_type = key_type;
+		flag |= SOFIA_REG_DIRTY_ROW;
+	}
+
+	if (match->expires != expires) {
+		reg_store_wheel_del(profile, match);
+		match->expires = expires;
+		reg_store_wheel_add(profile, match);
+		flag |= SOFIA_REG_DIRTY_EXPIRES;
+	}
+
+	if (flag) {
+		reg_store_mark(profile, match, flag);
+	}
+
+	if ((flag & SOFIA_REG_DIRTY_ROW)) {
+		sofia_reg_store_flush(profile);
+	}
+}
+
+static void reg_store_unregister(sofia_profile_t *profile, sofia_reg_key_t key_type, const char *user, const char *host,
+								 const char *call_id, const char *contact)
+{
+	sofia_reg_contact_t *c, *next;
+	char *user_host;
+	int hits = 0;
+
+	if (!profile->reg_hash) {
+		char *sql;
+
+		if (key_type == SOFIA_REG_KEY_CALL_ID) {
+			sql = switch_mprintf("delete from sip_registrations where call_id='%q'", call_id);
+		} else if (key_type == SOFIA_REG_KEY_CONTACT) {
+			sql = switch_mprintf("delete from sip_registrations where sip_user='%q' and sip_host='%q' and contact='%q'", user, host, contact);
+		} else {
+			sql = switch_mprintf("delete from sip_registrations where sip_user='%q' and sip_host='%q'", user, host);
+		}
+
+		sofia_glue_actually_execute_sql(profile, sql, NULL);
+		switch_safe_free(sql);
+		return;
+	}
+
+	if (key_type == SOFIA_REG_KEY_CALL_ID) {
+		for (c = (sofia_reg_contact_t *) switch_core_hash_find(profile->reg_cid_hash, call_id); c; c = next) {
+			next = c->cid_next;
+
+			if (!strcmp(c->col[SOFIA_REG_COL_CALL_ID], call_id)) {
+				reg_store_unlink(profile, c);
+				hits++;
+			}
+		}
+	} else {
+		user_host = switch_mprintf("%s@%s", user, host);
+
+		for (c = (sofia_reg_contact_t *) switch_core_hash_find(profile->reg_hash, user_host); c; c = next) {
+			next = c->next;
+
+			if (key_type == SOFIA_REG_KEY_USER_HOST || !strcmp(c->col[SOFIA_REG_COL_CONTACT], contact)) {
+				reg_store_unlink(profile, c);
+				hits++;
+			}
+		}
+
+		switch_safe_free(user_host);
+	}
+
+	if (hits) {
+		sofia_reg_store_flush(profile);
+	}
+}
+
+void sofia_reg_store_expire_user(sofia_profile_t *profile, const char *user, const char *host, time_t expires)
+{
+	sofia_reg_contact_t *c;
+	char *user_host = switch_mprintf("%s@%s", user, host);
+
+	switch_mutex_lock(profile->ireg_mutex);
+
+	if (profile->reg_hash) {
+		for (c = (sofia_reg_contact_t *) switch_core_hash_find(profile->reg_hash, user_host); c; c = c->next) {
+			reg_store_wheel_del(profile, c);
+			c->expires = (long) expires;
+			reg_store_wheel_add(profile, c);
+			reg_store_mark(profile, c, SOFIA_REG_DIRTY_EXPIRES);
+		}
+	} else {
+		char *sql = switch_mprintf("update sip_registrations set expires=%ld where sip_user='%q' and sip_host='%q'", (long) expires, user, host);
+		sofia_glue_actually_execute_sql(profile, sql, NULL);
+		switch_safe_free(sql);
+	}
+
+	switch_mutex_unlock(profile->ireg_mutex);
+	switch_safe_free(user_host);
+}
+
+void sofia_reg_store_tick(sofia_profile_t *profile, time_t now)
+{
+	sofia_reg_contact_t *c, *next, *reap = NULL;
+	time_t t;
+	int n = 0;
+
+	switch_mutex_lock(profile->ireg_mutex);
+
+	if (!profile->reg_hash) {
+		goto end;
+	}
+
+	if (!profile->reg_wheel_tick) {
+		profile->reg_wheel_tick = now - 1;
+	}
+
+	/* visit each second since the last tick, a whole turn covers every slot after a clock jump */
+	for (t = profile->reg_wheel_tick + 1; t <= now && n < SOFIA_REG_WHEEL_SLOTS; t++, n++) {
+		for (c = profile->reg_wheel[t % SOFIA_REG_WHEEL_SLOTS]; c; c = c->wheel_next) {
+			if (c->expires <= now) {
+				c->reap_next = reap;
+				reap = c;
+			}
+		}
+	}
+
+	profile->reg_wheel_tick = now;
+
+	for (c = reap; c; c = next) {
+		next = c->reap_next;
+		reg_store_expire_contact(profile, c, 0);
+	}
+
+  end:
+	switch_mutex_unlock(profile->ireg_mutex);
+}
+
+
+void sofia_reg_store_flush(sofia_profile_t *profile)
+{
+	sofia_reg_contact_t *list, *c, *next;
+	switch_stream_handle_t stream = { 0 };
+	char *where, *sql;
+	uint32_t rows = 0;
+
+	switch_mutex_lock(profile->ireg_mutex);
+
+	if (!(list = profile->reg_dirty)) {
+		switch_mutex_unlock(profile->ireg_mutex);
+		return;
+	}
+
+	profile->reg_dirty = NULL;
+	profile->reg_dirty_count = 0;
+
+	SWITCH_STANDARD_STREAM(stream);
+
+	/* removals first so a replacement for the same user@host in this batch survives them */
+	for (c = list; c; c = c->dirty_next) {
+		if ((c->dirty & SOFIA_REG_DIRTY_DEAD) && c->persisted) {
+			where = reg_store_where(c);
+			stream.write_function(&stream, "delete from sip_registrations where %s;\n", where);
+			switch_safe_free(where);
+			rows++;
+		}
+	}
+
+	for (c = list; c; c = c->dirty_next) {
+		if ((c->dirty & SOFIA_REG_DIRTY_DEAD)) {
+			continue;
+		}
+
+		if ((c->dirty & SOFIA_REG_DIRTY_ROW) || !c->persisted) {
+			sql = reg_store_row_sql(c->key_type, (const char **) c->col, c->expires);
+		} else {
+			where = reg_store_where(c);
+			sql = switch_mprintf("update sip_registrations set expires=%ld where %s;\n", c->expires, where);
+			switch_safe_free(where);
+		}
+
+		stream.write_function(&stream, "%s", sql);
+		switch_safe_free(sql);
+		c->persisted = 1;
+		rows++;
+	}
+
+	for (c = list; c; c = next) {
+		next = c->dirty_next;
+
+		if ((c->dirty & SOFIA_REG_DIRTY_DEAD)) {
+			reg_store_free_contact(c);
+		} else {
+			c->dirty = 0;
+			c->dirty_next = NULL;
+		}
+	}
+
+	if (rows) {
+		sofia_glue_actually_execute_sql_trans(profile, (char *) stream.data, NULL);
+	}
+
+	switch_mutex_unlock(profile->ireg_mutex);
+
+	switch_safe_free(stream.data);
+}
+
+static int reg_store_load_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	sofia_profile_t *profile = (sofia_profile_t *) pArg;
+	sofia_reg_key_t key_type = SOFIA_REG_KEY_USER_HOST;
+	sofia_reg_contact_t *c;
+
+	if (argc < SOFIA_REG_COL_MAX + 1) {
+		return 0;
+	}
+
+	if (sofia_test_pflag(profile, PFLAG_MULTIREG)) {
+		key_type = sofia_test_pflag(profile, PFLAG_MULTIREG_CONTACT) ? SOFIA_REG_KEY_CONTACT : SOFIA_REG_KEY_CALL_ID;
+	}
+
+	c = reg_store_add(profile, (const char **) argv, atol(switch_str_nil(argv[SOFIA_REG_COL_MAX])), key_type);
+	c->persisted = 1;
+
+	return 0;
+}
+
+void sofia_reg_store_load(sofia_profile_t *profile)
+{
+	char *sql;
+
+	switch_mutex_lock(profile->ireg_mutex);
+
+	switch_core_hash_init(&profile->reg_hash, profile->pool);
+	switch_core_hash_init(&profile->reg_cid_hash, profile->pool);
+	profile->reg_wheel_tick = switch_epoch_time_now(NULL);
+
+	/* columns in sofia_reg_col_t order, expires last */
+	sql = switch_mprintf("select call_id,sip_user,sip_host,presence_hosts,contact,status,rpid,user_agent,server_user,server_host,"
+						 "profile_name,hostname,network_ip,network_port,sip_username,sip_realm,mwi_user,mwi_host,orig_server_host,"
+						 "orig_hostname,expires from sip_registrations where profile_name='%q' and hostname='%q'",
+						 profile->name, mod_sofia_globals.hostname);
+
+	sofia_glue_execute_sql_callback(profile, NULL, sql, reg_store_load_callback, profile);
+	switch_safe_free(sql);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Loaded %u registration(s) for %s\n", profile->reg_contact_count, profile->name);
+
+	switch_mutex_unlock(profile->ireg_mutex);
+}
+
+void sofia_reg_store_destroy(sofia_profile_t *profile)
+{
+	sofia_reg_contact_t *c, *next, *reap = NULL;
+
+	sofia_reg_store_flush(profile);
+
+	switch_mutex_lock(profile->ireg_mutex);
+
+	if (profile->reg_hash) {
+		reap = reg_store_collect(profile, NULL, NULL, NULL);
+
+		for (c = reap; c; c = next) {
+			next = c->reap_next;
+			reg_store_free_contact(c);
+		}
+
+		switch_core_hash_destroy(&profile->reg_hash);
+		switch_core_hash_destroy(&profile->reg_cid_hash);
+	}
+
+	memset(profile->reg_wheel, 0, sizeof(profile->reg_wheel));
+	profile->reg_contact_count = 0;
+
+	switch_mutex_unlock(profile->ireg_mutex);
+}
+
 void sofia_reg_expire_call_id(sofia_profile_t *profile, const char *call_id, int reboot)
 {
 	char *sql = NULL;
-	char *sqlextra = NULL;
 	char *dup = strdup(call_id);
 	char *host = NULL, *user = NULL;
+	sofia_reg_contact_t *c, *next;
 
 	switch_assert(dup);
 
@@ -549,21 +1165,14 @@ void sofia_reg_expire_call_id(sofia_profile_t *profile, const char *call_id, int
 		host = "none";
 	}
 
-	if (zstr(user)) {
-		sqlextra = switch_mprintf(" or (sip_host='%q')", host);
-	} else {
-		sqlextra = switch_mprintf(" or (sip_user='%q' and sip_host='%q')", user, host);
-	}
-
-	sql = switch_mprintf("select call_id,sip_user,sip_host,contact,status,rpid,expires"
-						 ",user_agent,server_user,server_host,profile_name,network_ip"
-						 ",%d from sip_registrations where call_id='%q' %s", reboot, call_id, sqlextra);
-	switch_safe_free(sqlextra);
-
 	switch_mutex_lock(profile->ireg_mutex);
-	sofia_glue_execute_sql_callback(profile, NULL, sql, sofia_reg_del_callback, profile);
+	if (profile->reg_hash) {
+		for (c = reg_store_collect(profile, call_id, user, host); c; c = next) {
+			next = c->reap_next;
+			reg_store_expire_contact(profile, c, reboot);
+		}
+	}
 	switch_mutex_unlock(profile->ireg_mutex);
-	switch_safe_free(sql);
 
 	sql = switch_mprintf("delete from sip_registrations where call_id='%q' or (sip_user='%q' and sip_host='%q')", call_id, user, host);
 	sofia_glue_execute_sql(profile, &sql, SWITCH_FALSE);
@@ -576,40 +1185,28 @@ void sofia_reg_expire_call_id(sofia_profile_t *profile, const char *call_id, int
 void sofia_reg_check_expire(sofia_profile_t *profile, time_t now, int reboot)
 {
 	char sql[1024];
+	sofia_reg_contact_t *c, *next;
 
 	switch_mutex_lock(profile->ireg_mutex);
 
-	if (now) {
-		switch_snprintf(sql, sizeof(sql), "select call_id,sip_user,sip_host,contact,status,rpid,expires"
-						",user_agent,server_user,server_host,profile_name,network_ip"
-						",%d from sip_registrations where expires > 0 and expires <= %ld", reboot, (long) now);
-	} else {
-		switch_snprintf(sql, sizeof(sql), "select call_id,sip_user,sip_host,contact,status,rpid,expires"
-						",user_agent,server_user,server_host,profile_name,network_ip" ",%d from sip_registrations where expires > 0", reboot);
-	}
+	/* registrations expire off the timer wheel in sofia_reg_store_tick, only a flush walks all of them */
+	if (!now) {
+		if (profile->reg_hash) {
+			for (c = reg_store_collect(profile, NULL, NULL, NULL); c; c = next) {
+				next = c->reap_next;
+				reg_store_expire_contact(profile, c, reboot);
+			}
+		}
 
-	sofia_glue_execute_sql_callback(profile, NULL, sql, sofia_reg_del_callback, profile);
-	if (now) {
-		switch_snprintf(sql, sizeof(sql), "delete from sip_registrations where expires > 0 and expires <= %ld and hostname='%s'",
-						(long) now, mod_sofia_globals.hostname);
-	} else {
 		switch_snprintf(sql, sizeof(sql), "delete from sip_registrations where expires > 0 and hostname='%s'", mod_sofia_globals.hostname);
+		sofia_glue_actually_execute_sql(profile, sql, NULL);
 	}
 
-	sofia_glue_actually_execute_sql(profile, sql, NULL);
-
-
-
 	if (now) {
 		switch_snprintf(sql, sizeof(sql), "select call_id from sip_shared_appearance_dialogs where hostname='%s' "
 						"and profile_name='%s' and expires <= %ld", mod_sofia_globals.hostname, profile->name, (long) now);
 
 		sofia_glue_execute_sql_callback(profile, NULL, sql, sofia_sla_dialog_del_callback, profile);
-		switch_snprintf(sql, sizeof(sql), "delete from sip_registrations where expires > 0 and hostname='%s' and expires <= %ld",
-						mod_sofia_globals.hostname, (long) now);
-
-
-		sofia_glue_actually_execute_sql(profile, sql, NULL);
 	}
 
 
@@ -663,13 +1260,19 @@ void sofia_reg_check_expire(sofia_profile_t *profile, time_t now, int reboot)
 	sofia_glue_actually_execute_sql(profile, sql, NULL);
 
 
-	if (now && sofia_test_pflag(profile, PFLAG_NAT_OPTIONS_PING)) {
-		switch_snprintf(sql, sizeof(sql), "select call_id,sip_user,sip_host,contact,status,rpid,"
-						"expires,user_agent,server_user,server_host,profile_name"
-						" from sip_registrations where (status like '%%AUTO-NAT%%' "
-						"or status like '%%UDP-NAT%%') and hostname='%s'", mod_sofia_globals.hostname);
+	if (now && profile->reg_hash && sofia_test_pflag(profile, PFLAG_NAT_OPTIONS_PING)) {
+		for (c = reg_store_collect(profile, NULL, NULL, NULL); c; c = c->reap_next) {
+			const char *status = c->col[SOFIA_REG_COL_STATUS];
+			char *argv[4];
 
-		sofia_glue_execute_sql_callback(profile, NULL, sql, sofia_reg_nat_callback, profile);
+			if (strstr(status, "AUTO-NAT") || strstr(status, "UDP-NAT")) {
+				argv[0] = c->col[SOFIA_REG_COL_CALL_ID];
+				argv[1] = c->col[SOFIA_REG_COL_SIP_USER];
+				argv[2] = c->col[SOFIA_REG_COL_SIP_HOST];
+				argv[3] = c->col[SOFIA_REG_COL_CONTACT];
+				sofia_reg_nat_callback(profile, 4, argv, NULL);
+			}
+		}
 	}
 
 	switch_mutex_unlock(profile->ireg_mutex);
@@ -759,6 +1362,8 @@ uint8_t sofia_reg_handle_register(nua_t *nua, sofia_profile_t *profile, nua_hand
 	char contact_str[1024] = "";
 	int nat_hack = 0;
 	uint8_t multi_reg = 0, multi_reg_contact = 0, avoid_multi_reg = 0;
+	sofia_reg_key_t reg_key = SOFIA_REG_KEY_USER_HOST;
+	const char *reg_col[SOFIA_REG_COL_MAX];
 	uint8_t stale = 0, forbidden = 0;
 	auth_res_t auth_res;
 	long exptime = 300;
@@ -1097,6 +1702,10 @@ uint8_t sofia_reg_handle_register(nua_t *nua, sofia_profile_t *profile, nua_hand
 		multi_reg = 0;
 	}
 
+	if (multi_reg) {
+		reg_key = multi_reg_contact ? SOFIA_REG_KEY_CONTACT : SOFIA_REG_KEY_CALL_ID;
+	}
+
 	if (exptime) {
 		const char *agent = "dunno";
 		char guess_ip4[256];
@@ -1112,34 +1721,32 @@ uint8_t sofia_reg_handle_register(nua_t *nua, sofia_profile_t *profile, nua_hand
 			agent = sip->sip_user_agent->g_string;
 		}
 
-		if (multi_reg) {
-			if (multi_reg_contact) {
-				sql =
-					switch_mprintf("delete from sip_registrations where sip_user='%q' and sip_host='%q' and contact='%q'", to_user, reg_host, contact_str);
-			} else {
-				sql = switch_mprintf("delete from sip_registrations where call_id='%q'", call_id);
-			}
-		} else {
-			sql = switch_mprintf("delete from sip_registrations where sip_user='%q' and sip_host='%q'", to_user, reg_host);
-		}
-		switch_mutex_lock(profile->ireg_mutex);
-		sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
-
 		switch_find_local_ip(guess_ip4, sizeof(guess_ip4), NULL, AF_INET);
-		sql = switch_mprintf("insert into sip_registrations "
-							 "(call_id,sip_user,sip_host,presence_hosts,contact,status,rpid,expires,"
-							 "user_agent,server_user,server_host,profile_name,hostname,network_ip,network_port,sip_username,sip_realm,"
-							 "mwi_user,mwi_host, orig_server_host, orig_hostname) "
-							 "values ('%q','%q', '%q','%q','%q','%q', '%q', %ld, '%q', '%q', '%q', '%q', '%q', '%q', '%q','%q','%q','%q','%q','%q','%q')", 
-							 call_id, to_user, reg_host, profile->presence_hosts ? profile->presence_hosts : reg_host, 
-							 contact_str, reg_desc, rpid, (long) switch_epoch_time_now(NULL) + (long) exptime * 2, 
-							 agent, from_user, guess_ip4, profile->name, mod_sofia_globals.hostname, network_ip, network_port_c, username, realm, 
-							 mwi_user, mwi_host, guess_ip4, mod_sofia_globals.hostname);
-							 
-		if (sql) {
-			sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
-		}
 
+		reg_col[SOFIA_REG_COL_CALL_ID] = call_id;
+		reg_col[SOFIA_REG_COL_SIP_USER] = to_user;
+		reg_col[SOFIA_REG_COL_SIP_HOST] = reg_host;
+		reg_col[SOFIA_REG_COL_PRESENCE_HOSTS] = profile->presence_hosts ? profile->presence_hosts : reg_host;
+		reg_col[SOFIA_REG_COL_CONTACT] = contact_str;
+		reg_col[SOFIA_REG_COL_STATUS] = reg_desc;
+		reg_col[SOFIA_REG_COL_RPID] = rpid;
+		reg_col[SOFIA_REG_COL_USER_AGENT] = agent;
+		reg_col[SOFIA_REG_COL_SERVER_USER] = from_user;
+		reg_col[SOFIA_REG_COL_SERVER_HOST] = guess_ip4;
+		reg_col[SOFIA_REG_COL_PROFILE_NAME] = profile->name;
+		reg_col[SOFIA_REG_COL_HOSTNAME] = mod_sofia_globals.hostname;
+		reg_col[SOFIA_REG_COL_NETWORK_IP] = network_ip;
+		reg_col[SOFIA_REG_COL_NETWORK_PORT] = network_port_c;
+		reg_col[SOFIA_REG_COL_SIP_USERNAME] = username;
+		reg_col[SOFIA_REG_COL_SIP_REALM] = realm;
+		reg_col[SOFIA_REG_COL_MWI_USER] = mwi_user;
+		reg_col[SOFIA_REG_COL_MWI_HOST] = mwi_host;
+		reg_col[SOFIA_REG_COL_ORIG_SERVER_HOST] = guess_ip4;
+		reg_col[SOFIA_REG_COL_ORIG_HOSTNAME] = mod_sofia_globals.hostname;
+
+		/* sip_registrations is written behind the store by the profile worker */
+		switch_mutex_lock(profile->ireg_mutex);
+		reg_store_register(profile, reg_key, reg_col, (long) switch_epoch_time_now(NULL) + (long) exptime * 2);
 		switch_mutex_unlock(profile->ireg_mutex);
 
 		if (switch_event_create_subclass(&s_event, SWITCH_EVENT_CUSTOM, MY_EVENT_REGISTER) == SWITCH_STATUS_SUCCESS) {
@@ -1246,25 +1853,16 @@ uint8_t sofia_reg_handle_register(nua_t *nua, sofia_profile_t *profile, nua_hand
 
 			sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
 
-			if (multi_reg_contact) {
-				sql =
-					switch_mprintf("delete from sip_registrations where sip_user='%q' and sip_host='%q' and contact='%q'", to_user, reg_host, contact_str);
-			} else {
-				sql = switch_mprintf("delete from sip_registrations where call_id='%q'", call_id);
-			}
-
-			sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
-
 			switch_safe_free(icontact);
 		} else {
 			if ((sql = switch_mprintf("delete from sip_subscriptions where sip_user='%q' and sip_host='%q'", to_user, reg_host))) {
 				sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
 			}
-
-			if ((sql = switch_mprintf("delete from sip_registrations where sip_user='%q' and sip_host='%q'", to_user, reg_host))) {
-				sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
-			}
 		}
+
+		switch_mutex_lock(profile->ireg_mutex);
+		reg_store_unregister(profile, reg_key, to_user, reg_host, call_id, contact_str);
+		switch_mutex_unlock(profile->ireg_mutex);
 	}
 
 
@@ -64,6 +64,26 @@ typedef enum {
 	EVENT_FORMAT_XML
 } event_format_t;
 
+#define EVENT_FORMAT_COUNT 2
+
+/* An event rendered once per format and shared by every listener queue it was pushed to.
+   The bodies are immutable once the buffer is queued, the last reader frees it. */
+typedef struct {
+	volatile uint32_t refs;
+	char *body[EVENT_FORMAT_COUNT];
+	switch_size_t len[EVENT_FORMAT_COUNT];
+} event_buf_t;
+
+/* One step of a listener's compiled filter program, built from listener->filters whenever they change.
+   name and value point into the filter headers and are only valid under filter_mutex. */
+typedef struct {
+	const char *name;
+	const char *value;
+	switch_regex_t *re;
+	uint8_t pos;
+	uint8_t is_regex;
+} filter_op_t;
+
 struct listener {
 	switch_socket_t *sock;
 	switch_queue_t *event_queue;
@@ -74,7 +94,6 @@ struct listener {
 	switch_mutex_t *filter_mutex;
 	uint32_t flags;
 	switch_log_level_t level;
-	char *ebuf;
 	uint8_t event_list[SWITCH_EVENT_ALL + 1];
 	uint8_t allowed_event_list[SWITCH_EVENT_ALL + 1];
 	switch_hash_t *event_hash;
@@ -92,6 +111,9 @@ struct listener {
 	char remote_ip[50];
 	switch_port_t remote_port;
 	switch_event_t *filters;
+	filter_op_t *filter_ops;
+	uint32_t filter_op_count;
+	uint8_t matched;
 	struct listener *next;
 };
 
@@ -175,6 +197,178 @@ static switch_status_t socket_logger(const switch_log_node_t *node, switch_log_l
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static event_buf_t *event_buf_create(void)
+{
+	event_buf_t *eb;
+
+	switch_zmalloc(eb, sizeof(*eb));
+	eb->refs = 1;
+
+	return eb;
+}
+
+static void event_buf_render(event_buf_t *eb, switch_event_t *event, event_format_t format)
+{
+	char *body = NULL;
+
+	if (eb->body[format]) {
+		return;
+	}
+
+	if (format == EVENT_FORMAT_PLAIN) {
+		switch_event_serialize(event, &body, SWITCH_TRUE);
+	} else {
+		switch_xml_t xml;
+
+		if ((xml = switch_event_xmlize(event, "%s", ""))) {
+			body = switch_xml_toxml(xml, SWITCH_FALSE);
+			switch_xml_free(xml);
+		}
+	}
+
+	if (body) {
+		eb->body[format] = body;
+		eb->len[format] = strlen(body);
+	}
+}
+
+/* Pick the body to send for a listener, falling back to another format when the
+   listener changed formats after the event was queued. */
+static event_format_t event_buf_format(event_buf_t *eb, event_format_t format)
+{
+	int i;
+
+	if (eb->body[format]) {
+		return format;
+	}
+
+	for (i = 0; i < EVENT_FORMAT_COUNT; i++) {
+		if (eb->body[i]) {
+			return (event_format_t) i;
+		}
+	}
+
+	return format;
+}
+
+static void event_buf_release(event_buf_t **ebp)
+{
+	event_buf_t *eb = *ebp;
+	int i;
+
+	*ebp = NULL;
+
+	if (!eb || switch_atomic_dec(&eb->refs)) {
+		return;
+	}
+
+	for (i = 0; i < EVENT_FORMAT_COUNT; i++) {
+		switch_safe_free(eb->body[i]);
+	}
+
+	free(eb);
+}
+
+/* Must be called with filter_mutex held whenever listener->filters changes. */
+static void free_filter_ops(listener_t *listener)
+{
+	uint32_t i;
+
+	for (i = 0; i < listener->filter_op_count; i++) {
+		switch_regex_safe_free(listener->filter_ops[i].re);
+	}
+
+	switch_safe_free(listener->filter_ops);
+	listener->filter_op_count = 0;
+}
+
+static void compile_filters(listener_t *listener)
+{
+	switch_event_header_t *hp;
+	uint32_t count = 0;
+
+	free_filter_ops(listener);
+
+	if (!listener->filters) {
+		return;
+	}
+
+	for (hp = listener->filters->headers; hp; hp = hp->next) {
+		count++;
+	}
+
+	if (!count) {
+		return;
+	}
+
+	switch_zmalloc(listener->filter_ops, count * sizeof(filter_op_t));
+
+	for (hp = listener->filters->headers; hp; hp = hp->next) {
+		filter_op_t *op = &listener->filter_ops[listener->filter_op_count++];
+		const char *comp_to = hp->value;
+
+		op->pos = 1;
+
+		while (comp_to && *comp_to) {
+			if (*comp_to == '+') {
+				op->pos = 1;
+			} else if (*comp_to == '-') {
+				op->pos = 0;
+			} else if (*comp_to != ' ') {
+				break;
+			}
+			comp_to++;
+		}
+
+		op->name = hp->name;
+		op->value = switch_str_nil(comp_to);
+
+		if (hp->value && *hp->value == '/') {
+			op->is_regex = 1;
+			op->re = switch_regex_compile_expression(op->value);
+		}
+	}
+}
+
+/* Evaluate the compiled filters, must be called with filter_mutex held. */
+static int run_filters(listener_t *listener, switch_event_t *event)
+{
+	uint32_t i;
+	int send = 0;
+
+	for (i = 0; i < listener->filter_op_count; i++) {
+		filter_op_t *op = &listener->filter_ops[i];
+		const char *hval;
+		int cmp;
+
+		if (send && op->pos) {
+			continue;
+		}
+
+		if (!(hval = switch_event_get_header(event, op->name))) {
+			continue;
+		}
+
+		if (op->is_regex) {
+			int ovector[30];
+			cmp = op->re && switch_regex_exec(op->re, hval, ovector, sizeof(ovector) / sizeof(ovector[0])) > 0;
+		} else {
+			cmp = !strcasecmp(hval, op->value);
+		}
+
+		if (cmp) {
+			if (op->pos) {
+				send = 1;
+			} else {
+				send = 0;
+				break;
+			}
+		}
+	}
+
+	return send;
+}
+
 static void flush_listener(listener_t *listener, switch_bool_t flush_log, switch_bool_t flush_events)
 {
 	void *pop;
@@ -190,10 +384,10 @@ static void flush_listener(listener_t *listener, switch_bool_t flush_log, switch
 
 	if (listener->event_queue) {
 		while (switch_queue_trypop(listener->event_queue, &pop) == SWITCH_STATUS_SUCCESS) {
-			switch_event_t *pevent = (switch_event_t *) pop;
+			event_buf_t *eb = (event_buf_t *) pop;
 			if (!pop)
 				continue;
-			switch_event_destroy(&pevent);
+			event_buf_release(&eb);
 		}
 	}
 }
@@ -232,6 +426,7 @@ static switch_status_t expire_listener(listener_t ** listener)
 	if (l->filters) {
 		switch_event_destroy(&l->filters);
 	}
+	free_filter_ops(l);
 
 	switch_mutex_unlock(l->filter_mutex);
 	switch_thread_rwlock_unlock(l->rwlock);
@@ -244,8 +439,11 @@ static switch_status_t expire_listener(listener_t ** listener)
 static void event_handler(switch_event_t *event)
 {
 	switch_event_t *clone = NULL;
+	event_buf_t *eb = NULL;
 	listener_t *l, *lp, *last = NULL;
 	time_t now = switch_epoch_time_now(NULL);
+	uint8_t formats[EVENT_FORMAT_COUNT] = { 0 };
+	int matches = 0, i;
 
 	switch_assert(event != NULL);
 
@@ -273,6 +471,8 @@ static void event_handler(switch_event_t *event)
 			}
 		}
 
+		l->matched = 0;
+
 		if (l->expire_time || !switch_test_flag(l, LFLAG_EVENTS)) {
 			last = l;
 			continue;
@@ -286,54 +486,10 @@ static void event_handler(switch_event_t *event)
 			}
 		}
 
-		if (send && l->filters && l->filters->headers) {
-			switch_event_header_t *hp;
-			const char *hval;
-
-			send = 0;
+		if (send && l->filter_op_count) {
 			switch_mutex_lock(l->filter_mutex);
-			for (hp = l->filters->headers; hp; hp = hp->next) {
-				if ((hval = switch_event_get_header(event, hp->name))) {
-					const char *comp_to = hp->value;
-					int pos = 1, cmp = 0;
-
-					while (comp_to && *comp_to) {
-						if (*comp_to == '+') {
-							pos = 1;
-						} else if (*comp_to == '-') {
-							pos = 0;
-						} else if (*comp_to != ' ') {
-							break;
-						}
-						comp_to++;
-					}
-
-					if (send && pos) {
-						continue;
-					}
-
-					if (!comp_to) {
-						continue;
-					}
-
-					if (*hp->value == '/') {
-						switch_regex_t *re = NULL;
-						int ovector[30];
-						cmp = !!switch_regex_perform(hval, comp_to, &re, ovector, sizeof(ovector) / sizeof(ovector[0]));
-						switch_regex_safe_free(re);
-					} else {
-						cmp = !strcasecmp(hval, comp_to);
-					}
-
-					if (cmp) {
-						if (pos) {
-							send = 1;
-						} else {
-							send = 0;
-							break;
-						}
-					}
-				}
+			if (l->filter_op_count) {
+				send = run_filters(l, event);
 			}
 			switch_mutex_unlock(l->filter_mutex);
 		}
@@ -346,28 +502,62 @@ static void event_handler(switch_event_t *event)
 		}
 
 		if (send) {
-			if (switch_event_dup(&clone, event) == SWITCH_STATUS_SUCCESS) {
-				if (switch_queue_trypush(l->event_queue, clone) == SWITCH_STATUS_SUCCESS) {
-					if (l->lost_events) {
-						int le = l->lost_events;
-						l->lost_events = 0;
-						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(l->session), SWITCH_LOG_CRIT, "Lost %d events!\n", le);
-						clone = NULL;
-						if (switch_event_create(&clone, SWITCH_EVENT_TRAP) == SWITCH_STATUS_SUCCESS) {
-							switch_event_add_header(clone, SWITCH_STACK_BOTTOM, "info", "lost %d events", le);
-							switch_event_fire(&clone);
-						}
-					}
-				} else {
-					l->lost_events++;
-					switch_event_destroy(&clone);
+			l->matched = 1;
+			formats[l->format] = 1;
+			matches++;
+		}
+
+		last = l;
+	}
+
+	if (!matches) {
+		goto end;
+	}
+
+	/* Render each format some listener asked for exactly once, then share the result. */
+	eb = event_buf_create();
+
+	for (i = 0; i < EVENT_FORMAT_COUNT; i++) {
+		if (formats[i]) {
+			event_buf_render(eb, event, (event_format_t) i);
+		}
+	}
+
+	for (l = listen_list.listeners; l; l = l->next) {
+		if (!l->matched) {
+			continue;
+		}
+
+		l->matched = 0;
+
+		if (!eb->body[l->format]) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(l->session), SWITCH_LOG_ERROR, "%s Render Error!\n",
+							  l->format == EVENT_FORMAT_XML ? "XML" : "Event");
+			continue;
+		}
+
+		switch_atomic_inc(&eb->refs);
+
+		if (switch_queue_trypush(l->event_queue, eb) == SWITCH_STATUS_SUCCESS) {
+			if (l->lost_events) {
+				int le = l->lost_events;
+				l->lost_events = 0;
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(l->session), SWITCH_LOG_CRIT, "Lost %d events!\n", le);
+				clone = NULL;
+				if (switch_event_create(&clone, SWITCH_EVENT_TRAP) == SWITCH_STATUS_SUCCESS) {
+					switch_event_add_header(clone, SWITCH_STACK_BOTTOM, "info", "lost %d events", le);
+					switch_event_fire(&clone);
 				}
-			} else {
-				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(l->session), SWITCH_LOG_ERROR, "Memory Error!\n");
 			}
+		} else {
+			l->lost_events++;
+			switch_atomic_dec(&eb->refs);
 		}
-		last = l;
 	}
+
+	event_buf_release(&eb);
+
+  end:
 	switch_mutex_unlock(globals.listener_mutex);
 }
 
@@ -694,6 +884,7 @@ SWITCH_STANDARD_API(event_sink_function)
 
 	  filter_end:
 
+		compile_filters(listener);
 		switch_mutex_unlock(listener->filter_mutex);
 
 	} else if (!strcasecmp(wcmd, "stop-logging")) {
@@ -882,7 +1073,6 @@ SWITCH_STANDARD_API(event_sink_function)
 		char *id = switch_event_get_header(stream->param_event, "listen-id");
 		uint32_t idl = 0;
 		void *pop;
-		switch_event_t *pevent = NULL;
 
 		if (id) {
 			idl = (uint32_t) atol(id);
@@ -924,38 +1114,26 @@ SWITCH_STANDARD_API(event_sink_function)
 		stream->write_function(stream, "<events>\n");
 
 		while (switch_queue_trypop(listener->event_queue, &pop) == SWITCH_STATUS_SUCCESS) {
-			char *etype;
-			pevent = (switch_event_t *) pop;
+			event_buf_t *eb = (event_buf_t *) pop;
+			event_format_t fmt = event_buf_format(eb, listener->format);
 
-			if (listener->format == EVENT_FORMAT_PLAIN) {
-				etype = "plain";
-				switch_event_serialize(pevent, &listener->ebuf, SWITCH_TRUE);
-				stream->write_function(stream, "<event type=\"plain\">\n%s</event>", listener->ebuf);
-			} else {
-				switch_xml_t xml;
-				etype = "xml";
-
-				if ((xml = switch_event_xmlize(pevent, "%s", ""))) {
-					listener->ebuf = switch_xml_toxml(xml, SWITCH_FALSE);
-					switch_xml_free(xml);
-				} else {
-					stream->write_function(stream, "<data><reply type=\"error\">XML Render Error</reply></data>\n");
-					break;
-				}
+			if (!eb->body[fmt]) {
+				stream->write_function(stream, "<data><reply type=\"error\">XML Render Error</reply></data>\n");
+				event_buf_release(&eb);
+				break;
+			}
 
-				stream->write_function(stream, "%s\n", listener->ebuf);
+			if (fmt == EVENT_FORMAT_PLAIN) {
+				stream->write_function(stream, "<event type=\"plain\">\n%s</event>", eb->body[fmt]);
+			} else {
+				stream->write_function(stream, "%s\n", eb->body[fmt]);
 			}
 
-			switch_safe_free(listener->ebuf);
-			switch_event_destroy(&pevent);
+			event_buf_release(&eb);
 		}
 
 		stream->write_function(stream, " </events>\n</data>\n");
 
-		if (pevent) {
-			switch_event_destroy(&pevent);
-		}
-
 		switch_thread_rwlock_unlock(listener->rwlock);
 	} else if (!strcasecmp(wcmd, "exec-fsapi")) {
 		char *api_command = switch_event_get_header(stream->param_event, "fsapi-command");
@@ -1201,10 +1379,17 @@ static switch_status_t read_packet(listener_t *listener, switch_event_t **event,
 				if (switch_channel_get_state(chan) < CS_HANGUP && switch_channel_test_flag(chan, CF_DIVERT_EVENTS)) {
 					switch_event_t *e = NULL;
 					while (switch_core_session_dequeue_event(listener->session, &e, SWITCH_TRUE) == SWITCH_STATUS_SUCCESS) {
-						if (switch_queue_trypush(listener->event_queue, e) != SWITCH_STATUS_SUCCESS) {
+						event_buf_t *eb = event_buf_create();
+
+						event_buf_render(eb, e, listener->format);
+
+						if (switch_queue_trypush(listener->event_queue, eb) != SWITCH_STATUS_SUCCESS) {
+							event_buf_release(&eb);
 							switch_core_session_queue_event(listener->session, &e);
 							break;
 						}
+
+						switch_event_destroy(&e);
 					}
 				}
 			}
@@ -1212,43 +1397,28 @@ static switch_status_t read_packet(listener_t *listener, switch_event_t **event,
 			if (switch_test_flag(listener, LFLAG_EVENTS)) {
 				while (switch_queue_trypop(listener->event_queue, &pop) == SWITCH_STATUS_SUCCESS) {
 					char hbuf[512];
-					switch_event_t *pevent = (switch_event_t *) pop;
-					char *etype;
+					event_buf_t *eb = (event_buf_t *) pop;
+					event_format_t fmt = event_buf_format(eb, listener->format);
 
 					do_sleep = 0;
-					if (listener->format == EVENT_FORMAT_PLAIN) {
-						etype = "plain";
-						switch_event_serialize(pevent, &listener->ebuf, SWITCH_TRUE);
-					} else {
-						switch_xml_t xml;
-						etype = "xml";
-
-						if ((xml = switch_event_xmlize(pevent, "%s", ""))) {
-							listener->ebuf = switch_xml_toxml(xml, SWITCH_FALSE);
-							switch_xml_free(xml);
-						} else {
-							switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(listener->session), SWITCH_LOG_ERROR, "XML ERROR!\n");
-							goto endloop;
-						}
-					}
-
-					switch_assert(listener->ebuf);
 
-					len = strlen(listener->ebuf);
+					if (!eb->body[fmt]) {
+						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(listener->session), SWITCH_LOG_ERROR, "XML ERROR!\n");
+						goto endloop;
+					}
 
-					switch_snprintf(hbuf, sizeof(hbuf), "Content-Length: %" SWITCH_SSIZE_T_FMT "\n" "Content-Type: text/event-%s\n" "\n", len, etype);
+					switch_snprintf(hbuf, sizeof(hbuf), "Content-Length: %" SWITCH_SSIZE_T_FMT "\n" "Content-Type: text/event-%s\n" "\n",
+									eb->len[fmt], fmt == EVENT_FORMAT_XML ? "xml" : "plain");
 
 					len = strlen(hbuf);
 					switch_socket_send(listener->sock, hbuf, &len);
 
-					len = strlen(listener->ebuf);
-					switch_socket_send(listener->sock, listener->ebuf, &len);
-
-					switch_safe_free(listener->ebuf);
+					len = eb->len[fmt];
+					switch_socket_send(listener->sock, eb->body[fmt], &len);
 
 				  endloop:
 
-					switch_event_destroy(&pevent);
+					event_buf_release(&eb);
 				}
 			}
 		}
@@ -1735,6 +1905,7 @@ static switch_status_t parse_command(listener_t *listener, switch_event_t **even
 		} else {
 			switch_snprintf(reply, reply_len, "-ERR invalid syntax");
 		}
+		compile_filters(listener);
 		switch_mutex_unlock(listener->filter_mutex);
 
 		goto done;
@@ -2472,6 +2643,7 @@ static void *SWITCH_THREAD_FUNC listener_run(switch_thread_t *thread, void *obj)
 	if (listener->filters) {
 		switch_event_destroy(&listener->filters);
 	}
+	free_filter_ops(listener);
 	switch_mutex_unlock(listener->filter_mutex);
 
 	if (listener->session) {
@@ -41,9 +41,46 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lua_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_lua_shutdown);
 
 SWITCH_MODULE_DEFINITION_EX(mod_lua, mod_lua_load, mod_lua_shutdown, NULL, SMODF_GLOBAL_SYMBOLS);
+typedef struct {
+	switch_bool_t state_pool;
+	switch_bool_t bytecode_cache;
+} lua_script_opts_t;
+
+/* sub-second part of the mtime, so a script saved twice within one second is still seen as changed */
+#if defined(__APPLE__)
+#define LUA_STAT_MTIME_NSEC(_st) ((long) (_st)->st_mtimespec.tv_nsec)
+#elif defined(WIN32)
+#define LUA_STAT_MTIME_NSEC(_st) 0L
+#else
+#define LUA_STAT_MTIME_NSEC(_st) ((long) (_st)->st_mtim.tv_nsec)
+#endif
+
+typedef struct lua_chunk {
+	char *data;
+	size_t len;
+	time_t mtime;
+	long mtime_nsec;
+	off_t size;
+	int refs;
+	int stale;
+} lua_chunk_t;
+
 static struct {
 	switch_memory_pool_t *pool;
 	char *xml_handler;
+	switch_mutex_t *mutex;
+	/* idle pre-initialized states, reset before they go back in */
+	lua_State **idle;
+	uint32_t idle_count;
+	uint32_t state_pool_size;
+	lua_script_opts_t defaults;
+	switch_hash_t *script_opts;
+	switch_hash_t *chunks;
+	uint32_t chunk_count;
+	uint64_t state_hits;
+	uint64_t state_misses;
+	uint64_t chunk_hits;
+	uint64_t chunk_misses;
 } globals;
 
 int luaopen_freeswitch(lua_State * L);
@@ -116,8 +153,260 @@ static lua_State *lua_init(void)
 	return L;
 }
 
+/* copy the table at idx into the registry under name so lua_reset can put it back the way it was */
+static void lua_snapshot(lua_State * L, int idx, const char *name)
+{
+	lua_newtable(L);
+	lua_pushnil(L);
+	while (lua_next(L, idx) != 0) {
+		lua_pushvalue(L, -2);
+		lua_insert(L, -2);
+		lua_rawset(L, -4);
+	}
+	lua_setfield(L, LUA_REGISTRYINDEX, name);
+}
+
+static void lua_restore(lua_State * L, int idx, const char *name)
+{
+	int snap;
+
+	lua_getfield(L, LUA_REGISTRYINDEX, name);
+	if (!lua_istable(L, -1)) {
+		lua_pop(L, 1);
+		return;
+	}
+	snap = lua_gettop(L);
+
+	/* drop what the script added, assigning nil to an existing field is allowed while traversing */
+	lua_pushnil(L);
+	while (lua_next(L, idx) != 0) {
+		lua_pop(L, 1);
+		lua_pushvalue(L, -1);
+		lua_rawget(L, snap);
+		if (lua_isnil(L, -1)) {
+			lua_pushvalue(L, -2);
+			lua_pushnil(L);
+			lua_rawset(L, idx);
+		}
+		lua_pop(L, 1);
+	}
+
+	/* and put back anything it replaced */
+	lua_pushnil(L);
+	while (lua_next(L, snap) != 0) {
+		lua_pushvalue(L, -2);
+		lua_insert(L, -2);
+		lua_rawset(L, idx);
+	}
+
+	lua_pop(L, 1);
+}
+
+static lua_State *lua_init_pooled(void)
+{
+	lua_State *L = lua_init();
+
+	if (L) {
+		lua_snapshot(L, LUA_GLOBALSINDEX, "mod_lua_globals");
+		lua_getfield(L, LUA_GLOBALSINDEX, "package");
+		lua_getfield(L, -1, "loaded");
+		lua_snapshot(L, lua_gettop(L), "mod_lua_loaded");
+		lua_settop(L, 0);
+	}
+
+	return L;
+}
+
+/*
+ * Bring a used state back to what lua_init_pooled left behind.  The full collection at the end is what runs the
+ * finalizers of the session, stream and event objects the script was handed, just like lua_close used to.
+ */
+static void lua_reset(lua_State * L)
+{
+	lua_settop(L, 0);
+
+	lua_pushnil(L);
+	lua_setmetatable(L, LUA_GLOBALSINDEX);
+	lua_restore(L, LUA_GLOBALSINDEX, "mod_lua_globals");
+
+	lua_getfield(L, LUA_GLOBALSINDEX, "package");
+	if (lua_istable(L, -1)) {
+		lua_getfield(L, -1, "loaded");
+		if (lua_istable(L, -1)) {
+			lua_restore(L, lua_gettop(L), "mod_lua_loaded");
+		}
+	}
+
+	lua_settop(L, 0);
+	lua_gc(L, LUA_GCCOLLECT, 0);
+}
+
+static void lua_script_opts(const char *input_code, lua_script_opts_t *opts)
+{
+	char name[512];
+	char *p;
+	lua_script_opts_t *found = NULL;
+
+	*opts = globals.defaults;
+
+	if (zstr(input_code) || *input_code == '~') {
+		opts->bytecode_cache = SWITCH_FALSE;
+		return;
+	}
+
+	if (globals.script_opts) {
+		switch_copy_string(name, input_code, sizeof(name));
+		if ((p = strchr(name, ' '))) {
+			*p = '\0';
+		}
+		if ((found = (lua_script_opts_t *) switch_core_hash_find(globals.script_opts, name))) {
+			*opts = *found;
+		}
+	}
+}
+
+static lua_State *lua_acquire(const lua_script_opts_t *opts)
+{
+	lua_State *L = NULL;
+
+	if (!opts->state_pool || !globals.state_pool_size) {
+		return lua_init();
+	}
+
+	switch_mutex_lock(globals.mutex);
+	if (globals.idle_count) {
+		L = globals.idle[--globals.idle_count];
+		globals.state_hits++;
+	} else {
+		globals.state_misses++;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	return L ? L : lua_init_pooled();
+}
+
+static void lua_release(lua_State * L, const lua_script_opts_t *opts)
+{
+	if (opts->state_pool && globals.state_pool_size) {
+		lua_reset(L);
+
+		switch_mutex_lock(globals.mutex);
+		if (globals.idle_count < globals.state_pool_size) {
+			globals.idle[globals.idle_count++] = L;
+			L = NULL;
+		}
+		switch_mutex_unlock(globals.mutex);
+	}
+
+	if (L) {
+		lua_uninit(L);
+	}
+}
+
+static int lua_chunk_writer(lua_State * L, const void *p, size_t sz, void *ud)
+{
+	switch_stream_handle_t *stream = (switch_stream_handle_t *) ud;
+
+	return stream->raw_write_function(stream, (uint8_t *) p, sz) == SWITCH_STATUS_SUCCESS ? 0 : 1;
+}
+
+static void lua_chunk_unref(lua_chunk_t *chunk)
+{
+	if (!--chunk->refs && chunk->stale) {
+		free(chunk->data);
+		free(chunk);
+	}
+}
+
+/* luaL_loadfile with the compiled chunk kept around until the file changes */
+static int lua_load_file_cached(lua_State * L, const char *file)
+{
+	struct stat st;
+	lua_chunk_t *chunk, *old;
+	switch_stream_handle_t stream = { 0 };
+	int error;
+
+	if (stat(file, &st)) {
+		return luaL_loadfile(L, file);
+	}
+
+	switch_mutex_lock(globals.mutex);
+	if ((chunk = (lua_chunk_t *) switch_core_hash_find(globals.chunks, file)) && chunk->mtime == st.st_mtime &&
+		chunk->mtime_nsec == LUA_STAT_MTIME_NSEC(&st) && chunk->size == st.st_size) {
+		chunk->refs++;
+		globals.chunk_hits++;
+	} else {
+		chunk = NULL;
+		globals.chunk_misses++;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	if (chunk) {
+		/* the source name travels inside the dump so errors still point at the file */
+		error = luaL_loadbuffer(L, chunk->data, chunk->len, file);
+		switch_mutex_lock(globals.mutex);
+		lua_chunk_unref(chunk);
+		switch_mutex_unlock(globals.mutex);
+		return error;
+	}
+
+	if ((error = luaL_loadfile(L, file))) {
+		return error;
+	}
+
+	SWITCH_STANDARD_STREAM(stream);
+
+	if (lua_dump(L, lua_chunk_writer, &stream) || !stream.data_len) {
+		switch_safe_free(stream.data);
+		return 0;
+	}
+
+	chunk = (lua_chunk_t *) malloc(sizeof(*chunk));
+	switch_assert(chunk);
+	chunk->data = (char *) stream.data;
+	chunk->len = stream.data_len;
+	chunk->mtime = st.st_mtime;
+	chunk->mtime_nsec = LUA_STAT_MTIME_NSEC(&st);
+	chunk->size = st.st_size;
+	chunk->refs = 1;
+	chunk->stale = 0;
+
+	switch_mutex_lock(globals.mutex);
+	if ((old = (lua_chunk_t *) switch_core_hash_find(globals.chunks, file))) {
+		/* drop the hash's reference, the chunk goes once the last loader is done with it */
+		old->stale = 1;
+		lua_chunk_unref(old);
+	} else {
+		globals.chunk_count++;
+	}
+	switch_core_hash_insert(globals.chunks, file, chunk);
+	switch_mutex_unlock(globals.mutex);
+
+	return 0;
+}
+
+static void lua_chunks_flush(void)
+{
+	switch_hash_index_t *hi;
+	void *val;
+
+	switch_mutex_lock(globals.mutex);
+	while ((hi = switch_hash_first(NULL, globals.chunks))) {
+		const void *key;
+		lua_chunk_t *chunk;
+
+		switch_hash_this(hi, &key, NULL, &val);
+		chunk = (lua_chunk_t *) val;
+		switch_core_hash_delete(globals.chunks, (const char *) key);
+		globals.chunk_count--;
+		chunk->stale = 1;
+		lua_chunk_unref(chunk);
+	}
+	switch_mutex_unlock(globals.mutex);
+}
+
 
-static int lua_parse_and_execute(lua_State * L, char *input_code)
+static int lua_parse_and_execute(lua_State * L, char *input_code, const lua_script_opts_t *opts)
 {
 	int error = 0;
 
@@ -171,7 +460,11 @@ static int lua_parse_and_execute(lua_State * L, char *input_code)
 				switch_assert(fdup);
 				file = fdup;
 			}
-			error = luaL_loadfile(L, file) || docall(L, 0, 1);
+			if (opts && opts->bytecode_cache) {
+				error = lua_load_file_cached(L, file) || docall(L, 0, 1);
+			} else {
+				error = luaL_loadfile(L, file) || docall(L, 0, 1);
+			}
 			switch_safe_free(fdup);
 		}
 	}
@@ -198,7 +491,7 @@ static void *SWITCH_THREAD_FUNC lua_thread_run(switch_thread_t *thread, void *ob
 	switch_memory_pool_t *pool = lth->pool;
 	lua_State *L = lua_init();	/* opens Lua */
 
-	lua_parse_and_execute(L, lth->input_code);
+	lua_parse_and_execute(L, lth->input_code, NULL);
 
 	lth = NULL;
 
@@ -217,13 +510,17 @@ static switch_xml_t lua_fetch(const char *section,
 	switch_xml_t xml = NULL;
 
 	if (!zstr(globals.xml_handler)) {
-		lua_State *L = lua_init();
+		lua_script_opts_t opts;
+		lua_State *L;
 		char *mycmd = strdup(globals.xml_handler);
 		const char *str;
 		int error;
 
 		switch_assert(mycmd);
 
+		lua_script_opts(mycmd, &opts);
+		L = lua_acquire(&opts);
+
 		lua_newtable(L);
 
 		lua_pushstring(L, "section");
@@ -244,8 +541,10 @@ static switch_xml_t lua_fetch(const char *section,
 			mod_lua_conjure_event(L, params, "params", 1);
 		}
 
-		if( error = lua_parse_and_execute(L, mycmd) ){
+		if( error = lua_parse_and_execute(L, mycmd, &opts) ){
 		    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "LUA script parse/execute error!\n");
+		    lua_release(L, &opts);
+		    free(mycmd);
 		    return NULL;
 		}
 
@@ -263,7 +562,7 @@ static switch_xml_t lua_fetch(const char *section,
 			}
 		}
 
-		lua_uninit(L);
+		lua_release(L, &opts);
 		free(mycmd);
 	}
 
@@ -274,7 +573,7 @@ static switch_xml_t lua_fetch(const char *section,
 static switch_status_t do_config(void)
 {
 	const char *cf = "lua.conf";
-	switch_xml_t cfg, xml, settings, param;
+	switch_xml_t cfg, xml, settings, param, scripts, script;
 	switch_stream_handle_t path_stream = {0};
 	switch_stream_handle_t cpath_stream = {0};
 	
@@ -297,6 +596,13 @@ static switch_status_t do_config(void)
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "binding '%s' to '%s'\n", globals.xml_handler, val);
 					switch_xml_bind_search_function(lua_fetch, switch_xml_parse_section_string(val), NULL);
 				}
+			} else if (!strcmp(var, "state-pool-size") && !zstr(val)) {
+				int tmp = atoi(val);
+				globals.state_pool_size = tmp > 0 ? (uint32_t) tmp : 0;
+			} else if (!strcmp(var, "state-pool")) {
+				globals.defaults.state_pool = switch_true(val) ? SWITCH_TRUE : SWITCH_FALSE;
+			} else if (!strcmp(var, "bytecode-cache")) {
+				globals.defaults.bytecode_cache = switch_true(val) ? SWITCH_TRUE : SWITCH_FALSE;
 			} else if (!strcmp(var, "module-directory") && !zstr(val)) {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "lua: appending module directory: '%s'\n", val);
 				if (cpath_stream.data_len) {
@@ -313,6 +619,39 @@ static switch_status_t do_config(void)
 		}
 	}
 
+	if (globals.state_pool_size) {
+		globals.idle = (lua_State **) switch_core_alloc(globals.pool, sizeof(lua_State *) * globals.state_pool_size);
+	}
+
+	if ((scripts = switch_xml_child(cfg, "scripts"))) {
+		for (script = switch_xml_child(scripts, "script"); script; script = script->next) {
+			const char *name = switch_xml_attr_soft(script, "name");
+			const char *val;
+			lua_script_opts_t *opts;
+
+			if (zstr(name)) {
+				continue;
+			}
+
+			if (!globals.script_opts) {
+				switch_core_hash_init(&globals.script_opts, globals.pool);
+			}
+
+			opts = (lua_script_opts_t *) switch_core_alloc(globals.pool, sizeof(*opts));
+			*opts = globals.defaults;
+
+			if ((val = switch_xml_attr(script, "state-pool"))) {
+				opts->state_pool = switch_true(val) ? SWITCH_TRUE : SWITCH_FALSE;
+			}
+
+			if ((val = switch_xml_attr(script, "bytecode-cache"))) {
+				opts->bytecode_cache = switch_true(val) ? SWITCH_TRUE : SWITCH_FALSE;
+			}
+
+			switch_core_hash_insert(globals.script_opts, name, opts);
+		}
+	}
+
 	if (cpath_stream.data_len) {
 		char *lua_cpath = NULL;
 		if (lua_cpath = getenv("LUA_CPATH")) {
@@ -389,7 +728,8 @@ int lua_thread(const char *text)
 
 SWITCH_STANDARD_APP(lua_function)
 {
-	lua_State *L = lua_init();
+	lua_script_opts_t opts;
+	lua_State *L;
 	char *mycmd;
 
 	if (zstr(data)) {
@@ -397,13 +737,16 @@ SWITCH_STANDARD_APP(lua_function)
 		return;
 	}
 
+	lua_script_opts(data, &opts);
+	L = lua_acquire(&opts);
+
 	mod_lua_conjure_session(L, session, "session", 1);
 
 	mycmd = strdup((char *) data);
 	switch_assert(mycmd);
 
-	lua_parse_and_execute(L, mycmd);
-	lua_uninit(L);
+	lua_parse_and_execute(L, mycmd, &opts);
+	lua_release(L, &opts);
 	free(mycmd);
 
 }
@@ -425,7 +768,8 @@ SWITCH_STANDARD_API(luarun_api_function)
 SWITCH_STANDARD_API(lua_api_function)
 {
 
-	lua_State *L = lua_init();
+	lua_script_opts_t opts;
+	lua_State *L;
 	char *mycmd;
 	int error;
 
@@ -436,6 +780,9 @@ SWITCH_STANDARD_API(lua_api_function)
 		mycmd = strdup(cmd);
 		switch_assert(mycmd);
 
+		lua_script_opts(cmd, &opts);
+		L = lua_acquire(&opts);
+
 		if (session) {
 			mod_lua_conjure_session(L, session, "session", 1);
 		}
@@ -446,22 +793,57 @@ SWITCH_STANDARD_API(lua_api_function)
 			mod_lua_conjure_event(L, stream->param_event, "env", 1);
 		}
 
-		if ((error = lua_parse_and_execute(L, mycmd))) {
+		if ((error = lua_parse_and_execute(L, mycmd, &opts))) {
 			if (switch_event_get_header(stream->param_event, "http-host")) {
 				stream->write_function(stream, "Content-Type: text/html\n\n<H2>Error Executing Script</H2>");
 			} else {
 				stream->write_function(stream, "-ERR encounterd\n");
 			}
 		}
-		lua_uninit(L);
+		lua_release(L, &opts);
 		free(mycmd);
 	}
 	return SWITCH_STATUS_SUCCESS;
 }
 
+#define LUACACHE_SYNTAX "stats|flush"
+SWITCH_STANDARD_API(luacache_api_function)
+{
+	if (zstr(cmd) || !strcasecmp(cmd, "stats")) {
+		switch_mutex_lock(globals.mutex);
+		stream->write_function(stream, "states: %u/%u idle, %" SWITCH_UINT64_T_FMT " reused, %" SWITCH_UINT64_T_FMT " created\n",
+							   globals.idle_count, globals.state_pool_size, globals.state_hits, globals.state_misses);
+		stream->write_function(stream, "bytecode: %u script(s), %" SWITCH_UINT64_T_FMT " hit(s), %" SWITCH_UINT64_T_FMT " miss(es)\n",
+							   globals.chunk_count, globals.chunk_hits, globals.chunk_misses);
+		switch_mutex_unlock(globals.mutex);
+	} else if (!strcasecmp(cmd, "flush")) {
+		lua_State *L;
+
+		lua_chunks_flush();
+
+		for (;;) {
+			switch_mutex_lock(globals.mutex);
+			L = globals.idle_count ? globals.idle[--globals.idle_count] : NULL;
+			switch_mutex_unlock(globals.mutex);
+
+			if (!L) {
+				break;
+			}
+			lua_uninit(L);
+		}
+
+		stream->write_function(stream, "+OK\n");
+	} else {
+		stream->write_function(stream, "-USAGE: %s\n", LUACACHE_SYNTAX);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_STANDARD_DIALPLAN(lua_dialplan_hunt)
 {
-	lua_State *L = lua_init();
+	lua_script_opts_t opts;
+	lua_State *L = NULL;
 	switch_caller_extension_t *extension = NULL;
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	char *cmd = NULL;
@@ -488,8 +870,11 @@ SWITCH_STANDARD_DIALPLAN(lua_dialplan_hunt)
 	cmd = strdup(caller_profile->context);
 	switch_assert(cmd);
 
+	lua_script_opts(cmd, &opts);
+	L = lua_acquire(&opts);
+
 	mod_lua_conjure_session(L, session, "session", 1);
-	lua_parse_and_execute(L, cmd);
+	lua_parse_and_execute(L, cmd, &opts);
 
 	/* expecting ACTIONS = { {"app1", "app_data1"}, { "app2" }, "app3" } -- each of three is valid */
 	lua_getfield(L, LUA_GLOBALSINDEX, "ACTIONS");
@@ -573,7 +958,9 @@ SWITCH_STANDARD_DIALPLAN(lua_dialplan_hunt)
 
  done:
 	switch_safe_free(cmd);
-	lua_uninit(L);
+	if (L) {
+		lua_release(L, &opts);
+	}
 	return extension;
 }
 
@@ -589,11 +976,16 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lua_load)
 	SWITCH_ADD_API(api_interface, "luarun", "run a script", luarun_api_function, "<script>");
 	SWITCH_ADD_API(api_interface, "lua", "run a script as an api function", lua_api_function, "<script>");
 	SWITCH_ADD_APP(app_interface, "lua", "Launch LUA ivr", "Run a lua ivr on a channel", lua_function, "<script>", SAF_SUPPORT_NOMEDIA);
+	SWITCH_ADD_API(api_interface, "luacache", "lua state pool and bytecode cache", luacache_api_function, LUACACHE_SYNTAX);
 	SWITCH_ADD_DIALPLAN(dp_interface, "LUA", lua_dialplan_hunt);
+	switch_console_set_complete("add luacache stats");
+	switch_console_set_complete("add luacache flush");
 
 
 
 	globals.pool = pool;
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	switch_core_hash_init(&globals.chunks, globals.pool);
 	do_config();
 
 	/* indicate that the module should continue to be loaded */
@@ -602,6 +994,18 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lua_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_lua_shutdown)
 {
+	lua_chunks_flush();
+
+	while (globals.idle_count) {
+		lua_uninit(globals.idle[--globals.idle_count]);
+	}
+
+	switch_core_hash_destroy(&globals.chunks);
+
+	if (globals.script_opts) {
+		switch_core_hash_destroy(&globals.script_opts);
+	}
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
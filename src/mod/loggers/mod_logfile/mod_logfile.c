@@ -39,6 +39,7 @@ SWITCH_MODULE_DEFINITION(mod_logfile, mod_logfile_load, mod_logfile_shutdown, NU
 #define DEFAULT_LIMIT	 0xA00000	/* About 10 MB */
 #define WARM_FUZZY_OFFSET 256
 #define MAX_ROT 4096			/* why not */
+#define WRITE_BUFFER_SIZE 65536	/* lines are collected here until the log queue runs dry */
 
 static switch_memory_pool_t *module_pool = NULL;
 static switch_hash_t *profile_hash = NULL;
@@ -58,6 +59,8 @@ struct logfile_profile {
 	switch_hash_t *log_hash;
 	uint32_t all_level;
 	switch_bool_t log_uuid;
+	char *buf;
+	switch_size_t buf_len;
 };
 
 typedef struct logfile_profile logfile_profile_t;
@@ -82,6 +85,7 @@ static void add_mapping(logfile_profile_t *profile, char *var, char *val)
 }
 
 static switch_status_t mod_logfile_rotate(logfile_profile_t *profile);
+static switch_status_t mod_logfile_flush_profile(logfile_profile_t *profile);
 
 static switch_status_t mod_logfile_openlogfile(logfile_profile_t *profile, switch_bool_t check)
 {
@@ -125,6 +129,8 @@ static switch_status_t mod_logfile_rotate(logfile_profile_t *profile)
 
 	switch_mutex_lock(globals.mutex);
 
+	mod_logfile_flush_profile(profile);
+
 	switch_time_exp_lt(&tm, switch_micro_time_now());
 	switch_strftime_nocheck(date, &retsize, sizeof(date), "%Y-%m-%d-%H-%M-%S", &tm);
 
@@ -168,7 +174,45 @@ static switch_status_t mod_logfile_rotate(logfile_profile_t *profile)
 	return status;
 }
 
-/* write to the actual logfile */
+/* write to the actual logfile, globals.mutex must be held */
+static switch_status_t mod_logfile_write(logfile_profile_t *profile, const char *data, switch_size_t len)
+{
+	switch_size_t wlen = len;
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+	if (switch_file_write(profile->log_afd, data, &wlen) != SWITCH_STATUS_SUCCESS) {
+		switch_file_close(profile->log_afd);
+		if ((status = mod_logfile_openlogfile(profile, SWITCH_TRUE)) == SWITCH_STATUS_SUCCESS) {
+			wlen = len;
+			switch_file_write(profile->log_afd, data, &wlen);
+		}
+	}
+
+	if (status == SWITCH_STATUS_SUCCESS) {
+		profile->log_size += wlen;
+
+		if (profile->roll_size && profile->log_size >= profile->roll_size) {
+			mod_logfile_rotate(profile);
+		}
+	}
+
+	return status;
+}
+
+static switch_status_t mod_logfile_flush_profile(logfile_profile_t *profile)
+{
+	switch_size_t len = profile->buf_len;
+
+	if (!len || !profile->log_afd) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	/* emptied first, writing can end up rotating which flushes again */
+	profile->buf_len = 0;
+
+	return mod_logfile_write(profile, profile->buf, len);
+}
+
 static switch_status_t mod_logfile_raw_write(logfile_profile_t *profile, char *log_data)
 {
 	switch_size_t len;
@@ -181,25 +225,34 @@ static switch_status_t mod_logfile_raw_write(logfile_profile_t *profile, char *l
 
 	switch_mutex_lock(globals.mutex);
 
-	if (switch_file_write(profile->log_afd, log_data, &len) != SWITCH_STATUS_SUCCESS) {
-		switch_file_close(profile->log_afd);
-		if ((status = mod_logfile_openlogfile(profile, SWITCH_TRUE)) == SWITCH_STATUS_SUCCESS) {
-			len = strlen(log_data);
-			switch_file_write(profile->log_afd, log_data, &len);
+	if (profile->buf && len < WRITE_BUFFER_SIZE) {
+		if (profile->buf_len + len > WRITE_BUFFER_SIZE) {
+			mod_logfile_flush_profile(profile);
 		}
+		memcpy(profile->buf + profile->buf_len, log_data, len);
+		profile->buf_len += len;
+	} else {
+		mod_logfile_flush_profile(profile);
+		status = mod_logfile_write(profile, log_data, len);
 	}
 
 	switch_mutex_unlock(globals.mutex);
 
-	if (status == SWITCH_STATUS_SUCCESS) {
-		profile->log_size += len;
+	return status;
+}
 
-		if (profile->roll_size && profile->log_size >= profile->roll_size) {
-			mod_logfile_rotate(profile);
-		}
-	}
+static void mod_logfile_flush(void)
+{
+	switch_hash_index_t *hi;
+	void *val;
+	const void *var;
 
-	return status;
+	switch_mutex_lock(globals.mutex);
+	for (hi = switch_hash_first(NULL, profile_hash); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, &var, NULL, &val);
+		mod_logfile_flush_profile((logfile_profile_t *) val);
+	}
+	switch_mutex_unlock(globals.mutex);
 }
 
 static switch_status_t process_node(const switch_log_node_t *node, switch_log_level_t level)
@@ -292,6 +345,8 @@ static switch_status_t load_profile(switch_xml_t xml)
 		new_profile->logfile = strdup(logfile);
 	}
 
+	new_profile->buf = switch_core_alloc(module_pool, WRITE_BUFFER_SIZE);
+
 	if (mod_logfile_openlogfile(new_profile, SWITCH_TRUE) != SWITCH_STATUS_SUCCESS) {
 		return SWITCH_STATUS_GENERR;
 	}
@@ -321,6 +376,7 @@ static void event_handler(switch_event_t *event)
 			for (hi = switch_hash_first(NULL, profile_hash); hi; hi = switch_hash_next(hi)) {
 				switch_hash_this(hi, &var, NULL, &val);
 				profile = val;
+				mod_logfile_flush_profile(profile);
 				switch_file_close(profile->log_afd);
 				if (mod_logfile_openlogfile(profile, SWITCH_TRUE) != SWITCH_STATUS_SUCCESS) {
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Error Re-opening Log!\n");
@@ -379,6 +435,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_logfile_load)
 	}
 
 	switch_log_bind_logger(mod_logfile_logger, SWITCH_LOG_DEBUG, SWITCH_FALSE);
+	switch_log_bind_flush(mod_logfile_logger, mod_logfile_flush);
 
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -396,6 +453,9 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_logfile_shutdown)
 		logfile_profile_t *profile;
 		switch_hash_this(hi, &var, NULL, &val);
 		if ((profile = (logfile_profile_t *) val)) {
+			switch_mutex_lock(globals.mutex);
+			mod_logfile_flush_profile(profile);
+			switch_mutex_unlock(globals.mutex);
 			switch_file_close(profile->log_afd);
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Closing %s\n", profile->logfile);
 		}
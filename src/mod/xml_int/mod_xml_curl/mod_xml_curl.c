@@ -38,6 +38,8 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_xml_curl_shutdown);
 SWITCH_MODULE_DEFINITION(mod_xml_curl, mod_xml_curl_load, mod_xml_curl_shutdown, NULL);
 
 
+typedef struct xml_curl_cache xml_curl_cache_t;
+
 struct xml_binding {
 	char *method;
 	char *url;
@@ -57,6 +59,7 @@ struct xml_binding {
 	int use_dynamic_url;
 	int auth_scheme;
 	int timeout;
+	xml_curl_cache_t *cache;
 };
 
 static int keep_files_around = 0;
@@ -78,15 +81,359 @@ typedef struct hash_node {
 	struct hash_node *next;
 } hash_node_t;
 
+#define XML_CURL_CACHE_MAX_KEY_VARS 32
+#define XML_CURL_CACHE_WAIT_SLICE 1000000
+
+typedef struct xml_curl_cache_entry {
+	char *key;
+	char *text;
+	time_t expires;
+	int negative;
+	int fetching;
+	int discard;
+	struct xml_curl_cache_entry *prev;
+	struct xml_curl_cache_entry *next;
+} xml_curl_cache_entry_t;
+
+/*
+ * Response cache for one binding.  Entries hold the serialized xml of a fetch and are kept in lru order; the
+ * first request for a missing key marks the entry as fetching and everybody else asking for the same key waits
+ * on the condition until that fetch is stored instead of hitting the web server again.
+ */
+struct xml_curl_cache {
+	char *name;
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	switch_hash_t *hash;
+	xml_curl_cache_entry_t *head;
+	xml_curl_cache_entry_t *tail;
+	uint32_t count;
+	uint32_t max_entries;
+	uint32_t ttl;
+	uint32_t negative_ttl;
+	int wait_timeout;
+	char *key_vars[XML_CURL_CACHE_MAX_KEY_VARS];
+	int key_var_count;
+	uint64_t hits;
+	uint64_t negative_hits;
+	uint64_t misses;
+	uint64_t coalesced;
+	uint64_t stores;
+	uint64_t evictions;
+	struct xml_curl_cache *next;
+};
+
 static struct {
 	switch_memory_pool_t *pool;
 	hash_node_t *hash_root;
 	hash_node_t *hash_tail;
+	xml_curl_cache_t *caches;
 } globals;
 
-#define XML_CURL_SYNTAX "[debug_on|debug_off]"
+static void cache_unlink(xml_curl_cache_t *cache, xml_curl_cache_entry_t *entry)
+{
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	} else {
+		cache->head = entry->next;
+	}
+
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	} else {
+		cache->tail = entry->prev;
+	}
+
+	entry->prev = entry->next = NULL;
+}
+
+static void cache_link_head(xml_curl_cache_t *cache, xml_curl_cache_entry_t *entry)
+{
+	entry->prev = NULL;
+	entry->next = cache->head;
+
+	if (cache->head) {
+		cache->head->prev = entry;
+	} else {
+		cache->tail = entry;
+	}
+
+	cache->head = entry;
+}
+
+static void cache_free_entry(xml_curl_cache_t *cache, xml_curl_cache_entry_t *entry)
+{
+	switch_core_hash_delete(cache->hash, entry->key);
+	cache_unlink(cache, entry);
+	cache->count--;
+	switch_safe_free(entry->text);
+	switch_safe_free(entry->key);
+	free(entry);
+}
+
+static void cache_evict(xml_curl_cache_t *cache)
+{
+	xml_curl_cache_entry_t *entry = cache->tail, *prev;
+	time_t now = switch_epoch_time_now(NULL);
+
+	/* expired entries go first, then the least recently used ones */
+	for (entry = cache->tail; entry; entry = prev) {
+		prev = entry->prev;
+		if (!entry->fetching && entry->expires <= now) {
+			cache_free_entry(cache, entry);
+			cache->evictions++;
+		}
+	}
+
+	for (entry = cache->tail; entry && cache->count > cache->max_entries; entry = prev) {
+		prev = entry->prev;
+		if (!entry->fetching) {
+			cache_free_entry(cache, entry);
+			cache->evictions++;
+		}
+	}
+}
+
+static char *cache_build_key(xml_curl_cache_t *cache, const char *section, const char *tag_name, const char *key_name,
+							 const char *key_value, switch_event_t *params, const char *data)
+{
+	char *key, *tmp;
+	int i;
+
+	if (!cache->key_var_count) {
+		return strdup(data);
+	}
+
+	key = switch_mprintf("%s|%s|%s|%s", switch_str_nil(section), switch_str_nil(tag_name), switch_str_nil(key_name), switch_str_nil(key_value));
+
+	for (i = 0; key && i < cache->key_var_count; i++) {
+		tmp = switch_mprintf("%s|%s", key, params ? switch_str_nil(switch_event_get_header(params, cache->key_vars[i])) : "");
+		free(key);
+		key = tmp;
+	}
+
+	return key;
+}
+
+static int xml_is_not_found(switch_xml_t xml)
+{
+	switch_xml_t conf, p;
+	const char *aname;
+
+	if ((conf = switch_xml_find_child(xml, "section", "name", "result")) && (p = switch_xml_child(conf, "result"))) {
+		aname = switch_xml_attr(p, "status");
+		return aname && !strcasecmp(aname, "not found");
+	}
+
+	return 0;
+}
+
+/*
+ * Returns a copy of the cached document for key.  On a miss *claimed is set and the caller must hand the result
+ * of its own fetch to cache_put, even when that fetch failed, so requests waiting on the key are released.
+ */
+static switch_xml_t cache_get(xml_curl_cache_t *cache, const char *key, int *claimed)
+{
+	xml_curl_cache_entry_t *entry;
+	char *text = NULL;
+	int negative = 0, waited = 0;
+	switch_time_t deadline = switch_micro_time_now() + (switch_time_t) cache->wait_timeout * 1000000;
+
+	*claimed = 0;
+
+	switch_mutex_lock(cache->mutex);
+
+	for (;;) {
+		entry = switch_core_hash_find(cache->hash, key);
+
+		if (entry && entry->fetching) {
+			if (switch_micro_time_now() >= deadline) {
+				/* the fetch in progress is taking too long, go on our own without touching the entry */
+				break;
+			}
+			if (!waited++) {
+				cache->coalesced++;
+			}
+			switch_thread_cond_timedwait(cache->cond, cache->mutex, XML_CURL_CACHE_WAIT_SLICE);
+			continue;
+		}
+
+		if (entry && entry->text && entry->expires > switch_epoch_time_now(NULL)) {
+			text = strdup(entry->text);
+			negative = entry->negative;
+			if (negative) {
+				cache->negative_hits++;
+			} else {
+				cache->hits++;
+			}
+			if (cache->head != entry) {
+				cache_unlink(cache, entry);
+				cache_link_head(cache, entry);
+			}
+			break;
+		}
+
+		if (!entry) {
+			switch_zmalloc(entry, sizeof(*entry));
+			entry->key = strdup(key);
+			switch_core_hash_insert(cache->hash, entry->key, entry);
+			cache_link_head(cache, entry);
+			cache->count++;
+		}
+
+		entry->fetching = 1;
+		entry->discard = 0;
+		cache->misses++;
+		*claimed = 1;
+		break;
+	}
+
+	switch_mutex_unlock(cache->mutex);
+
+	if (text) {
+		switch_xml_t xml;
+
+		if (!(xml = switch_xml_parse_str_dynamic(text, SWITCH_FALSE))) {
+			free(text);
+		}
+		return xml;
+	}
+
+	return NULL;
+}
+
+static void cache_put(xml_curl_cache_t *cache, const char *key, switch_xml_t xml)
+{
+	xml_curl_cache_entry_t *entry;
+	char *text = NULL;
+	int negative = 0;
+	uint32_t ttl = 0;
+
+	/* a body that failed to parse still hands back a root, cache it as if the fetch had returned nothing */
+	if (xml && zstr(switch_xml_error(xml))) {
+		negative = xml_is_not_found(xml);
+		ttl = negative ? cache->negative_ttl : cache->ttl;
+		if (ttl) {
+			text = switch_xml_toxml(xml, SWITCH_FALSE);
+		}
+	}
+
+	switch_mutex_lock(cache->mutex);
+
+	if ((entry = switch_core_hash_find(cache->hash, key))) {
+		entry->fetching = 0;
+
+		if (text && !entry->discard) {
+			switch_safe_free(entry->text);
+			entry->text = text;
+			entry->negative = negative;
+			entry->expires = switch_epoch_time_now(NULL) + ttl;
+			cache->stores++;
+			text = NULL;
+		} else if (!entry->text || entry->discard) {
+			cache_free_entry(cache, entry);
+		}
+	}
+
+	if (cache->count > cache->max_entries) {
+		cache_evict(cache);
+	}
+
+	switch_thread_cond_broadcast(cache->cond);
+	switch_mutex_unlock(cache->mutex);
+
+	switch_safe_free(text);
+}
+
+/* drops every entry whose key starts with prefix, or all of them when prefix is NULL */
+static uint32_t cache_flush(xml_curl_cache_t *cache, const char *prefix)
+{
+	xml_curl_cache_entry_t *entry, *next;
+	size_t len = prefix ? strlen(prefix) : 0;
+	uint32_t flushed = 0;
+
+	switch_mutex_lock(cache->mutex);
+
+	for (entry = cache->head; entry; entry = next) {
+		next = entry->next;
+
+		if (prefix && strncmp(entry->key, prefix, len)) {
+			continue;
+		}
+
+		if (entry->fetching) {
+			entry->discard = 1;
+		} else {
+			cache_free_entry(cache, entry);
+		}
+		flushed++;
+	}
+
+	switch_mutex_unlock(cache->mutex);
+
+	return flushed;
+}
+
+static xml_curl_cache_t *cache_create(const char *name, uint32_t ttl, uint32_t negative_ttl, uint32_t max_entries, int wait_timeout,
+									  char **key_vars, int key_var_count)
+{
+	switch_memory_pool_t *pool = NULL;
+	xml_curl_cache_t *cache;
+	int i;
+
+	if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
+		return NULL;
+	}
+
+	cache = switch_core_alloc(pool, sizeof(*cache));
+	cache->pool = pool;
+	cache->name = switch_core_strdup(pool, name);
+	cache->ttl = ttl;
+	cache->negative_ttl = negative_ttl;
+	cache->max_entries = max_entries;
+	cache->wait_timeout = wait_timeout;
+
+	for (i = 0; i < key_var_count; i++) {
+		cache->key_vars[i] = switch_core_strdup(pool, key_vars[i]);
+	}
+	cache->key_var_count = key_var_count;
+
+	switch_mutex_init(&cache->mutex, SWITCH_MUTEX_DEFAULT, pool);
+	switch_thread_cond_create(&cache->cond, pool);
+	switch_core_hash_init(&cache->hash, pool);
+
+	cache->next = globals.caches;
+	globals.caches = cache;
+
+	return cache;
+}
+
+static void cache_destroy(xml_curl_cache_t *cache)
+{
+	switch_memory_pool_t *pool = cache->pool;
+
+	cache_flush(cache, NULL);
+	switch_core_hash_destroy(&cache->hash);
+	switch_core_destroy_memory_pool(&pool);
+}
+
+static void reload_xml_event_handler(switch_event_t *event)
+{
+	xml_curl_cache_t *cache;
+
+	for (cache = globals.caches; cache; cache = cache->next) {
+		cache_flush(cache, NULL);
+	}
+}
+
+#define XML_CURL_SYNTAX "[debug_on|debug_off|cache stats|cache flush [<key prefix>]]"
 SWITCH_STANDARD_API(xml_curl_function)
 {
+	char *mydata = NULL, *argv[3] = { 0 };
+	int argc = 0;
+	xml_curl_cache_t *cache;
+
 	if (session) {
 		return SWITCH_STATUS_FALSE;
 	}
@@ -95,19 +442,44 @@ SWITCH_STANDARD_API(xml_curl_function)
 		goto usage;
 	}
 
-	if (!strcasecmp(cmd, "debug_on")) {
+	mydata = strdup(cmd);
+	switch_assert(mydata);
+	argc = switch_separate_string(mydata, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
+
+	if (!strcasecmp(argv[0], "debug_on")) {
 		keep_files_around = 1;
-	} else if (!strcasecmp(cmd, "debug_off")) {
+	} else if (!strcasecmp(argv[0], "debug_off")) {
 		keep_files_around = 0;
+	} else if (argc >= 2 && !strcasecmp(argv[0], "cache") && !strcasecmp(argv[1], "stats")) {
+		for (cache = globals.caches; cache; cache = cache->next) {
+			switch_mutex_lock(cache->mutex);
+			stream->write_function(stream, "%s: entries=%u/%u ttl=%u negative_ttl=%u hits=%" SWITCH_UINT64_T_FMT " negative_hits=%" SWITCH_UINT64_T_FMT
+								   " misses=%" SWITCH_UINT64_T_FMT " coalesced=%" SWITCH_UINT64_T_FMT " stores=%" SWITCH_UINT64_T_FMT
+								   " evictions=%" SWITCH_UINT64_T_FMT "\n", cache->name, cache->count, cache->max_entries, cache->ttl, cache->negative_ttl,
+								   cache->hits, cache->negative_hits, cache->misses, cache->coalesced, cache->stores, cache->evictions);
+			switch_mutex_unlock(cache->mutex);
+		}
+		goto done;
+	} else if (argc >= 2 && !strcasecmp(argv[0], "cache") && !strcasecmp(argv[1], "flush")) {
+		uint32_t flushed = 0;
+
+		for (cache = globals.caches; cache; cache = cache->next) {
+			flushed += cache_flush(cache, argv[2]);
+		}
+		stream->write_function(stream, "+OK flushed %u\n", flushed);
+		goto done;
 	} else {
 		goto usage;
 	}
 
 	stream->write_function(stream, "OK\n");
-	return SWITCH_STATUS_SUCCESS;
+	goto done;
 
   usage:
 	stream->write_function(stream, "USAGE: %s\n", XML_CURL_SYNTAX);
+
+  done:
+	switch_safe_free(mydata);
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -154,6 +526,8 @@ static switch_xml_t xml_url_fetch(const char *section, const char *tag_name, con
 	char basic_data[512];
 	char *uri = NULL;
 	char *dynamic_url = NULL;
+	char *cache_key = NULL;
+	int claimed = 0;
 
 	gethostname(hostname, sizeof(hostname));
 
@@ -177,6 +551,14 @@ static switch_xml_t xml_url_fetch(const char *section, const char *tag_name, con
 	data = switch_event_build_param_string(params, basic_data, binding->vars_map);
 	switch_assert(data);
 
+	if (binding->cache && (cache_key = cache_build_key(binding->cache, section, tag_name, key_name, key_value, params, data))) {
+		if ((xml = cache_get(binding->cache, cache_key, &claimed))) {
+			switch_safe_free(cache_key);
+			switch_safe_free(data);
+			return xml;
+		}
+	}
+
 	if (binding->use_dynamic_url) {
 		if (!params) {
 			switch_event_create(&params, SWITCH_EVENT_REQUEST_PARAMS);
@@ -316,6 +698,11 @@ static switch_xml_t xml_url_fetch(const char *section, const char *tag_name, con
 		}
 	}
 
+	if (claimed) {
+		cache_put(binding->cache, cache_key, xml);
+	}
+	switch_safe_free(cache_key);
+
 	switch_safe_free(data);
 	if (binding->use_get_style == 1)
 		switch_safe_free(uri);
@@ -362,6 +749,9 @@ static switch_status_t do_config(void)
 		char *cookie_file = NULL;
 		hash_node_t *hash_node;
 		int auth_scheme = CURLAUTH_BASIC;
+		uint32_t cache_ttl = 0, cache_negative_ttl = 0, cache_max_entries = 4096;
+		char *cache_key_vars[XML_CURL_CACHE_MAX_KEY_VARS];
+		int cache_key_var_count = 0;
 		need_vars_map = 0;
 		vars_map = NULL;
 
@@ -423,6 +813,28 @@ static switch_status_t do_config(void)
 				cookie_file = val;
 			} else if (!strcasecmp(var, "use-dynamic-url") && switch_true(val)) {
 				use_dynamic_url = 1;
+			} else if (!strcasecmp(var, "cache-ttl")) {
+				int tmp = atoi(val);
+				cache_ttl = tmp > 0 ? tmp : 0;
+			} else if (!strcasecmp(var, "cache-negative-ttl")) {
+				int tmp = atoi(val);
+				cache_negative_ttl = tmp > 0 ? tmp : 0;
+			} else if (!strcasecmp(var, "cache-max-entries")) {
+				int tmp = atoi(val);
+				if (tmp > 0) {
+					cache_max_entries = tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid cache-max-entries [%s]\n", val);
+				}
+			} else if (!strcasecmp(var, "cache-key-var")) {
+				if (zstr(val)) {
+					continue;
+				}
+				if (cache_key_var_count < XML_CURL_CACHE_MAX_KEY_VARS) {
+					cache_key_vars[cache_key_var_count++] = val;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Too many cache-key-var params, ignoring %s\n", val);
+				}
 			} else if (!strcasecmp(var, "enable-post-var")) {
 				if (!vars_map && need_vars_map == 0) {
 					if (switch_core_hash_init(&vars_map, globals.pool) != SWITCH_STATUS_SUCCESS) {
@@ -505,6 +917,13 @@ static switch_status_t do_config(void)
 
 		binding->vars_map = vars_map;
 
+		if (cache_ttl || cache_negative_ttl) {
+			if (!(binding->cache = cache_create(zstr(bname) ? binding->url : bname, cache_ttl, cache_negative_ttl, cache_max_entries,
+												timeout ? timeout : 30, cache_key_vars, cache_key_var_count))) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Can't create response cache, binding will not cache\n");
+			}
+		}
+
 		if (vars_map) {
 			switch_zmalloc(hash_node, sizeof(hash_node_t));
 			hash_node->hash = vars_map;
@@ -556,6 +975,12 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_curl_load)
 	SWITCH_ADD_API(xml_curl_api_interface, "xml_curl", "XML Curl", xml_curl_function, XML_CURL_SYNTAX);
 	switch_console_set_complete("add xml_curl debug_on");
 	switch_console_set_complete("add xml_curl debug_off");
+	switch_console_set_complete("add xml_curl cache stats");
+	switch_console_set_complete("add xml_curl cache flush");
+
+	if (globals.caches && switch_event_bind(modname, SWITCH_EVENT_RELOADXML, NULL, reload_xml_event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Couldn't bind reloadxml event, caches will only expire by ttl\n");
+	}
 
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_SUCCESS;
@@ -573,6 +998,14 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_xml_curl_shutdown)
 	}
 
 	switch_xml_unbind_search_function_ptr(xml_url_fetch);
+	switch_event_unbind_callback(reload_xml_event_handler);
+
+	while (globals.caches) {
+		xml_curl_cache_t *cache = globals.caches;
+		globals.caches = cache->next;
+		cache_destroy(cache);
+	}
+
 	curl_global_cleanup();
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -65,6 +65,7 @@
 #include <apr_queue.h>
 #include <apr_uuid.h>
 #include <apr_md5.h>
+#include <apr_atomic.h>
 
 /* apr stubs */
 
@@ -399,6 +400,48 @@ SWITCH_DECLARE(switch_status_t) switch_thread_cond_destroy(switch_thread_cond_t
 	return apr_thread_cond_destroy(cond);
 }
 
+/* Atomic operations */
+
+SWITCH_DECLARE(uint32_t) switch_atomic_read(volatile uint32_t *mem)
+{
+	return apr_atomic_read32((volatile apr_uint32_t *) mem);
+}
+
+SWITCH_DECLARE(void) switch_atomic_set(volatile uint32_t *mem, uint32_t val)
+{
+	apr_atomic_xchg32((volatile apr_uint32_t *) mem, val);
+}
+
+SWITCH_DECLARE(uint32_t) switch_atomic_add(volatile uint32_t *mem, uint32_t val)
+{
+	return apr_atomic_add32((volatile apr_uint32_t *) mem, val);
+}
+
+SWITCH_DECLARE(uint32_t) switch_atomic_inc(volatile uint32_t *mem)
+{
+	return apr_atomic_inc32((volatile apr_uint32_t *) mem);
+}
+
+SWITCH_DECLARE(int) switch_atomic_dec(volatile uint32_t *mem)
+{
+	return apr_atomic_dec32((volatile apr_uint32_t *) mem);
+}
+
+SWITCH_DECLARE(uint32_t) switch_atomic_cas(volatile uint32_t *mem, uint32_t with, uint32_t cmp)
+{
+	return apr_atomic_cas32((volatile apr_uint32_t *) mem, with, cmp);
+}
+
+SWITCH_DECLARE(uint32_t) switch_atomic_xchg(volatile uint32_t *mem, uint32_t val)
+{
+	return apr_atomic_xchg32((volatile apr_uint32_t *) mem, val);
+}
+
+SWITCH_DECLARE(void *) switch_atomic_casptr(volatile void **mem, void *with, const void *cmp)
+{
+	return apr_atomic_casptr(mem, with, cmp);
+}
+
 /* file i/o stubs */
 
 SWITCH_DECLARE(switch_status_t) switch_file_open(switch_file_t ** newf, const char *fname, int32_t flag, switch_fileperms_t perm,
@@ -816,6 +859,57 @@ SWITCH_DECLARE(switch_status_t) switch_socket_recvfrom(switch_sockaddr_t *from,
 	return r;
 }
 
+SWITCH_DECLARE(int) switch_socket_fd_get(switch_socket_t *sock)
+{
+	apr_os_sock_t fd = -1;
+
+	if (!sock || apr_os_sock_get(&fd, sock) != APR_SUCCESS) {
+		return -1;
+	}
+
+	return (int) fd;
+}
+
+SWITCH_DECLARE(const void *) switch_sockaddr_raw_get(switch_sockaddr_t *sa, uint32_t *len)
+{
+	if (len) {
+		*len = sa->salen;
+	}
+	return &sa->sa;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_sockaddr_raw_set(switch_sockaddr_t *sa, const void *raw, uint32_t len)
+{
+	const struct sockaddr *in = (const struct sockaddr *) raw;
+
+	if (!sa || !raw || len > sizeof(sa->sa)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (in->sa_family == APR_INET) {
+		sa->ipaddr_ptr = &(sa->sa.sin.sin_addr);
+		sa->ipaddr_len = sizeof(struct in_addr);
+		sa->addr_str_len = 16;
+	}
+#if APR_HAVE_IPV6
+	else if (in->sa_family == APR_INET6) {
+		sa->ipaddr_ptr = &(sa->sa.sin6.sin6_addr);
+		sa->ipaddr_len = sizeof(struct in6_addr);
+		sa->addr_str_len = 46;
+	}
+#endif
+	else {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	memcpy(&sa->sa, raw, len);
+	sa->salen = len;
+	sa->family = in->sa_family;
+	sa->port = ntohs(sa->sa.sin.sin_port);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 /* poll stubs */
 
 SWITCH_DECLARE(switch_status_t) switch_pollset_create(switch_pollset_t ** pollset, uint32_t size, switch_memory_pool_t *p, uint32_t flags)
@@ -564,29 +564,16 @@ static int uuid_callback(void *pArg, int argc, char **argv, char **columnNames)
 
 SWITCH_DECLARE(switch_status_t) switch_console_list_uuid(const char *line, const char *cursor, switch_console_callback_match_t **matches)
 {
-	char *sql;
 	struct match_helper h = { 0 };
-	switch_cache_db_handle_t *db = NULL;
 	switch_status_t status = SWITCH_STATUS_FALSE;
-	char *errmsg;
-
-
-	if (switch_core_db_handle(&db) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Database Error\n");
-		return SWITCH_STATUS_GENERR;
-	}
+	char *match = NULL;
 
 	if (!zstr(cursor)) {
-		sql = switch_mprintf("select distinct uuid from channels where uuid like '%q%%' and hostname='%q' order by uuid",
-							 cursor, switch_core_get_variable("hostname"));
-	} else {
-		sql = switch_mprintf("select distinct uuid from channels where hostname='%q' order by uuid", switch_core_get_variable("hostname"));
+		match = switch_mprintf("%s%%", cursor);
 	}
 
-	switch_cache_db_execute_sql_callback(db, sql, uuid_callback, &h, &errmsg);
-	free(sql);
-
-	switch_cache_db_release_db_handle(&db);
+	switch_core_registry_execute_callback(SWITCH_REGISTRY_CHANNELS, "uuid", match, SWITCH_REGISTRY_SORT_UUID, uuid_callback, &h);
+	switch_safe_free(match);
 
 	if (h.my_matches) {
 		*matches = h.my_matches;
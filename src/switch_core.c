@@ -929,44 +929,35 @@ SWITCH_DECLARE(void) switch_load_network_lists(switch_bool_t reload)
 	char guess_mask[16] = "";
 	char *tmp_name;
 	struct in_addr in;
+	switch_ip_list_t new_list = { 0 }, old_list;
 
 	switch_find_local_ip(guess_ip, sizeof(guess_ip), &mask, AF_INET);
 	in.s_addr = mask;
 	switch_set_string(guess_mask, inet_ntoa(in));
 
-	switch_mutex_lock(runtime.global_mutex);
-
-	if (IP_LIST.hash) {
-		switch_core_hash_destroy(&IP_LIST.hash);
-	}
-
-	if (IP_LIST.pool) {
-		switch_core_destroy_memory_pool(&IP_LIST.pool);
-	}
-
-	memset(&IP_LIST, 0, sizeof(IP_LIST));
-	switch_core_new_memory_pool(&IP_LIST.pool);
-	switch_core_hash_init(&IP_LIST.hash, IP_LIST.pool);
+	/* the new lists are built on the side and swapped in at the end so lookups never wait for a reload */
+	switch_core_new_memory_pool(&new_list.pool);
+	switch_core_hash_init(&new_list.hash, new_list.pool);
 
 
 	tmp_name = "rfc1918.auto";
-	switch_network_list_create(&rfc_list, tmp_name, SWITCH_FALSE, IP_LIST.pool);
+	switch_network_list_create(&rfc_list, tmp_name, SWITCH_FALSE, new_list.pool);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Created ip list %s default (deny)\n", tmp_name);
 	switch_network_list_add_cidr(rfc_list, "10.0.0.0/8", SWITCH_TRUE);
 	switch_network_list_add_cidr(rfc_list, "172.16.0.0/12", SWITCH_TRUE);
 	switch_network_list_add_cidr(rfc_list, "192.168.0.0/16", SWITCH_TRUE);
-	switch_core_hash_insert(IP_LIST.hash, tmp_name, rfc_list);
+	switch_core_hash_insert(new_list.hash, tmp_name, rfc_list);
 
 	tmp_name = "wan.auto";
-	switch_network_list_create(&rfc_list, tmp_name, SWITCH_TRUE, IP_LIST.pool);
+	switch_network_list_create(&rfc_list, tmp_name, SWITCH_TRUE, new_list.pool);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Created ip list %s default (allow)\n", tmp_name);
 	switch_network_list_add_cidr(rfc_list, "10.0.0.0/8", SWITCH_FALSE);
 	switch_network_list_add_cidr(rfc_list, "172.16.0.0/12", SWITCH_FALSE);
 	switch_network_list_add_cidr(rfc_list, "192.168.0.0/16", SWITCH_FALSE);
-	switch_core_hash_insert(IP_LIST.hash, tmp_name, rfc_list);
+	switch_core_hash_insert(new_list.hash, tmp_name, rfc_list);
 
 	tmp_name = "nat.auto";
-	switch_network_list_create(&rfc_list, tmp_name, SWITCH_FALSE, IP_LIST.pool);
+	switch_network_list_create(&rfc_list, tmp_name, SWITCH_FALSE, new_list.pool);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Created ip list %s default (deny)\n", tmp_name);
 	if (switch_network_list_add_host_mask(rfc_list, guess_ip, guess_mask, SWITCH_FALSE) == SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Adding %s/%s (deny) to list %s\n", guess_ip, guess_mask, tmp_name);
@@ -974,22 +965,22 @@ SWITCH_DECLARE(void) switch_load_network_lists(switch_bool_t reload)
 	switch_network_list_add_cidr(rfc_list, "10.0.0.0/8", SWITCH_TRUE);
 	switch_network_list_add_cidr(rfc_list, "172.16.0.0/12", SWITCH_TRUE);
 	switch_network_list_add_cidr(rfc_list, "192.168.0.0/16", SWITCH_TRUE);
-	switch_core_hash_insert(IP_LIST.hash, tmp_name, rfc_list);
+	switch_core_hash_insert(new_list.hash, tmp_name, rfc_list);
 
 	tmp_name = "loopback.auto";
-	switch_network_list_create(&rfc_list, tmp_name, SWITCH_FALSE, IP_LIST.pool);
+	switch_network_list_create(&rfc_list, tmp_name, SWITCH_FALSE, new_list.pool);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Created ip list %s default (deny)\n", tmp_name);
 	switch_network_list_add_cidr(rfc_list, "127.0.0.0/8", SWITCH_TRUE);
-	switch_core_hash_insert(IP_LIST.hash, tmp_name, rfc_list);
+	switch_core_hash_insert(new_list.hash, tmp_name, rfc_list);
 
 	tmp_name = "localnet.auto";
-	switch_network_list_create(&list, tmp_name, SWITCH_FALSE, IP_LIST.pool);
+	switch_network_list_create(&list, tmp_name, SWITCH_FALSE, new_list.pool);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Created ip list %s default (deny)\n", tmp_name);
 
 	if (switch_network_list_add_host_mask(list, guess_ip, guess_mask, SWITCH_TRUE) == SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Adding %s/%s (allow) to list %s\n", guess_ip, guess_mask, tmp_name);
 	}
-	switch_core_hash_insert(IP_LIST.hash, tmp_name, list);
+	switch_core_hash_insert(new_list.hash, tmp_name, list);
 
 
 	if ((xml = switch_xml_open_cfg("acl.conf", &cfg, NULL))) {
@@ -1007,7 +998,7 @@ SWITCH_DECLARE(void) switch_load_network_lists(switch_bool_t reload)
 					default_type = switch_true(dft);
 				}
 
-				if (switch_network_list_create(&list, name, default_type, IP_LIST.pool) != SWITCH_STATUS_SUCCESS) {
+				if (switch_network_list_create(&list, name, default_type, new_list.pool) != SWITCH_STATUS_SUCCESS) {
 					abort();
 				}
 
@@ -1095,7 +1086,7 @@ SWITCH_DECLARE(void) switch_load_network_lists(switch_bool_t reload)
 						}
 					}
 
-					switch_core_hash_insert(IP_LIST.hash, name, list);
+					switch_core_hash_insert(new_list.hash, name, list);
 				}
 			}
 		}
@@ -1103,7 +1094,18 @@ SWITCH_DECLARE(void) switch_load_network_lists(switch_bool_t reload)
 		switch_xml_free(xml);
 	}
 
+	switch_mutex_lock(runtime.global_mutex);
+	old_list = IP_LIST;
+	IP_LIST = new_list;
 	switch_mutex_unlock(runtime.global_mutex);
+
+	if (old_list.hash) {
+		switch_core_hash_destroy(&old_list.hash);
+	}
+
+	if (old_list.pool) {
+		switch_core_destroy_memory_pool(&old_list.pool);
+	}
 }
 
 SWITCH_DECLARE(uint32_t) switch_core_max_dtmf_duration(uint32_t duration)
@@ -1216,6 +1218,19 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 	runtime.default_dtmf_duration = SWITCH_DEFAULT_DTMF_DURATION;
 	runtime.min_dtmf_duration = SWITCH_MIN_DTMF_DURATION;
 
+#ifdef WIN32
+	{
+		SYSTEM_INFO sysinfo;
+		GetSystemInfo(&sysinfo);
+		runtime.cpu_count = sysinfo.dwNumberOfProcessors;
+	}
+#elif defined(_SC_NPROCESSORS_ONLN)
+	runtime.cpu_count = (uint32_t) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (!runtime.cpu_count) {
+		runtime.cpu_count = 1;
+	}
+
 	/* INIT APR and Create the pool context */
 	if (apr_initialize() != SWITCH_STATUS_SUCCESS) {
 		*err = "FATAL ERROR! Could not initialize APR\n";
@@ -1249,11 +1264,16 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 	switch_mutex_init(&runtime.global_var_mutex, SWITCH_MUTEX_NESTED, runtime.memory_pool);
 	switch_core_set_globals();
 	switch_core_session_init(runtime.memory_pool);
+	switch_core_registry_init(runtime.memory_pool);
+	switch_resample_pool_init(runtime.memory_pool);
 	switch_core_hash_init(&runtime.global_vars, runtime.memory_pool);
 	switch_core_hash_init(&runtime.mime_types, runtime.memory_pool);
 	load_mime_types();
 	runtime.flags = flags;
 	runtime.sps_total = 30;
+	runtime.resample_quality = SWITCH_RESAMPLE_DEFAULT_QUALITY;
+	runtime.resample_pool_size = 64;
+	runtime.port_quarantine_ms = 2000;
 
 	*err = NULL;
 
@@ -1446,6 +1466,17 @@ static void switch_load_core_config(const char *file)
 					switch_time_set_cond_yield(switch_true(var));
 				} else if (!strcasecmp(var, "enable-timer-matrix")) {
 					switch_time_set_matrix(switch_true(var));
+				} else if (!strcasecmp(var, "event-bus") && !strcasecmp(val, "sharded")) {
+					switch_event_bus_start(0);
+				} else if (!strcasecmp(var, "event-bus-shards") && !zstr(val)) {
+					switch_event_bus_start((uint32_t) atoi(val));
+				} else if (!strcasecmp(var, "session-thread-pool")) {
+					session_manager.thread_pool = switch_true(val);
+				} else if (!strcasecmp(var, "session-thread-pool-idle") && !zstr(val)) {
+					int tmp = atoi(val);
+					if (tmp > -1) {
+						session_manager.thread_pool_idle_min = (uint32_t) tmp;
+					}
 				} else if (!strcasecmp(var, "max-sessions") && !zstr(val)) {
 					switch_core_session_limit(atoi(val));
 				} else if (!strcasecmp(var, "min-idle-cpu") && !zstr(val)) {
@@ -1458,10 +1489,37 @@ static void switch_load_core_config(const char *file)
 					} else {
 						runtime.timer_affinity = atoi(val);
 					}
+				} else if (!strcasecmp(var, "resample-quality") && !zstr(val)) {
+					if (!strcasecmp(val, "fast")) {
+						runtime.resample_quality = SWITCH_RESAMPLE_QUALITY_FAST;
+					} else if (!strcasecmp(val, "low")) {
+						runtime.resample_quality = 0;
+					} else if (!strcasecmp(val, "default")) {
+						runtime.resample_quality = SWITCH_RESAMPLE_DEFAULT_QUALITY;
+					} else if (!strcasecmp(val, "high")) {
+						runtime.resample_quality = 6;
+					} else if (!strcasecmp(val, "best")) {
+						runtime.resample_quality = 10;
+					} else {
+						int tmp = atoi(val);
+						if (tmp > -1 && tmp < 11) {
+							runtime.resample_quality = tmp;
+						}
+					}
+				} else if (!strcasecmp(var, "resample-pool-size") && !zstr(val)) {
+					int tmp = atoi(val);
+					if (tmp > -1) {
+						runtime.resample_pool_size = (uint32_t) tmp;
+					}
 				} else if (!strcasecmp(var, "rtp-start-port") && !zstr(val)) {
 					switch_rtp_set_start_port((switch_port_t) atoi(val));
 				} else if (!strcasecmp(var, "rtp-end-port") && !zstr(val)) {
 					switch_rtp_set_end_port((switch_port_t) atoi(val));
+				} else if (!strcasecmp(var, "rtp-port-quarantine") && !zstr(val)) {
+					int tmp = atoi(val);
+					if (tmp > -1) {
+						runtime.port_quarantine_ms = (uint32_t) tmp;
+					}
 				} else if (!strcasecmp(var, "core-db-dsn") && !zstr(val)) {
 					if (switch_odbc_available()) {
 						runtime.odbc_dsn = switch_core_strdup(runtime.memory_pool, val);
@@ -1474,6 +1532,12 @@ static void switch_load_core_config(const char *file)
 					} else {
 						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "ODBC IS NOT AVAILABLE!\n");
 					}
+				} else if (!strcasecmp(var, "core-db-channels")) {
+					if (switch_true(val)) {
+						switch_clear_flag((&runtime), SCF_NO_CHANNEL_SQL);
+					} else {
+						switch_set_flag((&runtime), SCF_NO_CHANNEL_SQL);
+					}
 #ifdef ENABLE_ZRTP
 				} else if (!strcasecmp(var, "rtp-enable-zrtp")) {
 					switch_core_set_variable("zrtp_enabled", val);
@@ -1831,6 +1895,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_destroy(void)
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Clean up modules.\n");
 
 	switch_loadable_module_shutdown();
+	switch_core_session_thread_pool_stop();
 
 	if (switch_test_flag((&runtime), SCF_USE_SQL)) {
 		switch_core_sqldb_stop();
@@ -1847,6 +1912,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_destroy(void)
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Closing Event Engine.\n");
 	switch_event_shutdown();
+	switch_core_registry_shutdown();
+	switch_resample_pool_shutdown();
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Finalizing Shutdown.\n");
 	switch_log_shutdown();
@@ -35,18 +35,110 @@
 #include <switch.h>
 #include "private/switch_core_pvt.h"
 
+/*
+ * Ports are tracked in two bitmaps, one bit per slot (a slot is a port, or an even/odd pair when only one parity is
+ * handed out so the RTCP port next to it stays reserved too).  A set bit in free_map is a port ready to be handed
+ * out, a set bit in quarantine_map is a port that was released recently and should rest for a while before it is
+ * reused, so late packets of the old call don't land on the new one.  A set bit in used_map is a port that is handed
+ * out, releasing a port has to clear it first so only one of two racing frees gives the port back.  The maps are only
+ * changed with atomic compare and swap so requests and releases never wait on each other.
+ */
 struct switch_core_port_allocator {
 	switch_port_t start;
 	switch_port_t end;
-	switch_port_t next;
-	int8_t *track;
 	uint32_t track_len;
-	uint32_t track_used;
+	uint32_t words;
+	volatile uint32_t *free_map;
+	volatile uint32_t *quarantine_map;
+	volatile uint32_t *used_map;
+	volatile uint32_t *released;
+	volatile uint32_t track_used;
+	volatile uint32_t track_quarantined;
+	uint32_t quarantine_ms;
+	switch_time_t epoch;
 	switch_port_flag_t flags;
-	switch_mutex_t *mutex;
 	switch_memory_pool_t *pool;
 };
 
+static uint32_t port_allocator_now(switch_core_port_allocator_t *alloc)
+{
+	return (uint32_t) ((switch_micro_time_now() - alloc->epoch) / 1000);
+}
+
+static uint32_t port_allocator_step(switch_core_port_allocator_t *alloc)
+{
+	return switch_test_flag(alloc, SPF_EVEN) && switch_test_flag(alloc, SPF_ODD) ? 1 : 2;
+}
+
+/* atomically clear bit from map, returns non zero if this caller was the one that cleared it */
+static int port_allocator_take(volatile uint32_t *map, uint32_t word, uint32_t bit)
+{
+	uint32_t old;
+
+	while ((old = map[word]) & bit) {
+		if (switch_atomic_cas(&map[word], old & ~bit, old) == old) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void port_allocator_give(volatile uint32_t *map, uint32_t word, uint32_t bit)
+{
+	uint32_t old;
+
+	do {
+		old = map[word];
+	} while (switch_atomic_cas(&map[word], old | bit, old) != old);
+}
+
+/*
+ * Claim a slot from map starting at a random word, returns the slot index or -1.  With quarantined set only slots
+ * that rested for the full quarantine are taken unless force is set.
+ */
+static int32_t port_allocator_scan(switch_core_port_allocator_t *alloc, volatile uint32_t *map, int quarantined, int force)
+{
+	uint32_t start = (uint32_t) rand() % alloc->words, rot = (uint32_t) rand() % 32, now = 0;
+	uint32_t w, i, word, bits, bit, b;
+
+	if (quarantined && !force) {
+		now = port_allocator_now(alloc);
+	}
+
+	for (w = 0; w < alloc->words; w++) {
+		word = (start + w) % alloc->words;
+
+		while ((bits = map[word])) {
+			/* start at a random bit so the ports handed out are not predictable */
+			for (i = 0; i < 32; i++) {
+				b = (i + rot) % 32;
+				bit = 1U << b;
+
+				if (!(bits & bit)) {
+					continue;
+				}
+
+				if (quarantined && !force && now - alloc->released[word * 32 + b] < alloc->quarantine_ms) {
+					continue;
+				}
+
+				if (port_allocator_take(map, word, bit)) {
+					return (int32_t) (word * 32 + b);
+				}
+
+				break;
+			}
+
+			if (i == 32) {
+				break;
+			}
+		}
+	}
+
+	return -1;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_new(switch_port_t start,
 															   switch_port_t end, switch_port_flag_t flags, switch_core_port_allocator_t **new_allocator)
 {
@@ -54,6 +146,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_new(switch_port_t sta
 	switch_memory_pool_t *pool;
 	switch_core_port_allocator_t *alloc;
 	int even, odd;
+	uint32_t i;
 
 	if ((status = switch_core_new_memory_pool(&pool)) != SWITCH_STATUS_SUCCESS) {
 		return status;
@@ -90,20 +183,27 @@ SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_new(switch_port_t sta
 		}
 	}
 
-	alloc->track_len = (end - start) + 2;
-
-	if (!(even && odd)) {
-		alloc->track_len /= 2;
+	if (end < start) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid port range %d-%d\n", start, end);
+		switch_core_destroy_memory_pool(&pool);
+		return SWITCH_STATUS_FALSE;
 	}
 
-	alloc->track = switch_core_alloc(pool, (alloc->track_len + 2) * sizeof(switch_byte_t));
-
 	alloc->start = start;
-	alloc->next = start;
 	alloc->end = end;
+	alloc->track_len = (end - start) / port_allocator_step(alloc) + 1;
+	alloc->words = (alloc->track_len + 31) / 32;
+	alloc->free_map = switch_core_alloc(pool, alloc->words * sizeof(uint32_t));
+	alloc->quarantine_map = switch_core_alloc(pool, alloc->words * sizeof(uint32_t));
+	alloc->used_map = switch_core_alloc(pool, alloc->words * sizeof(uint32_t));
+	alloc->released = switch_core_alloc(pool, alloc->words * 32 * sizeof(uint32_t));
+	alloc->quarantine_ms = runtime.port_quarantine_ms;
+	alloc->epoch = switch_micro_time_now();
+
+	for (i = 0; i < alloc->track_len; i++) {
+		alloc->free_map[i / 32] |= 1U << (i % 32);
+	}
 
-
-	switch_mutex_init(&alloc->mutex, SWITCH_MUTEX_NESTED, pool);
 	alloc->pool = pool;
 	*new_allocator = alloc;
 
@@ -112,83 +212,73 @@ SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_new(switch_port_t sta
 
 SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_request_port(switch_core_port_allocator_t *alloc, switch_port_t *port_ptr)
 {
-	switch_port_t port = 0;
-	switch_status_t status = SWITCH_STATUS_FALSE;
-	int even = switch_test_flag(alloc, SPF_EVEN);
-	int odd = switch_test_flag(alloc, SPF_ODD);
-
-	switch_mutex_lock(alloc->mutex);
-	srand((unsigned) ((unsigned) (intptr_t) port_ptr + (unsigned) (intptr_t) switch_thread_self() + switch_micro_time_now()));
-
-	while (alloc->track_used < alloc->track_len) {
-		uint32_t index;
-		uint32_t tries = 0;
-
-		/* randomly pick a port */
-		index = rand() % alloc->track_len;
-
-		/* if it is used walk up the list to find a free one */
-		while (alloc->track[index] && tries < alloc->track_len) {
-			tries++;
-			if (alloc->track[index] < 0) {
-				alloc->track[index]++;
-			}
-			if (++index >= alloc->track_len) {
-				index = 0;
-			}
-		}
+	int32_t index;
 
-		if (tries < alloc->track_len) {
-			alloc->track[index] = 1;
-			alloc->track_used++;
-			status = SWITCH_STATUS_SUCCESS;
-
-			if ((even && odd)) {
-				port = (switch_port_t) (index + alloc->start);
-			} else {
-				port = (switch_port_t) (index + (alloc->start / 2));
-				port *= 2;
-			}
-			goto end;
+	/* fresh ports first, then ports that sat out their quarantine, and only when the range is exhausted the ones still resting */
+	if ((index = port_allocator_scan(alloc, alloc->free_map, 0, 0)) < 0) {
+		if ((index = port_allocator_scan(alloc, alloc->quarantine_map, 1, 0)) < 0) {
+			index = port_allocator_scan(alloc, alloc->quarantine_map, 1, 1);
+		}
+		if (index >= 0) {
+			switch_atomic_dec(&alloc->track_quarantined);
 		}
 	}
 
+	if (index < 0) {
+		*port_ptr = 0;
+		return SWITCH_STATUS_FALSE;
+	}
 
-  end:
+	port_allocator_give(alloc->used_map, (uint32_t) index / 32, 1U << (index % 32));
+	switch_atomic_inc(&alloc->track_used);
+	*port_ptr = (switch_port_t) (alloc->start + (uint32_t) index * port_allocator_step(alloc));
 
-	switch_mutex_unlock(alloc->mutex);
+	return SWITCH_STATUS_SUCCESS;
+}
 
-	if (status == SWITCH_STATUS_SUCCESS) {
-		*port_ptr = port;
-	} else {
-		*port_ptr = 0;
+SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_free_port(switch_core_port_allocator_t *alloc, switch_port_t port)
+{
+	uint32_t index, word, bit;
+
+	if (port < alloc->start || port > alloc->end) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	index = (port - alloc->start) / port_allocator_step(alloc);
+	word = index / 32;
+	bit = 1U << (index % 32);
+
+	/* not handed out, or another release of the same port got here first */
+	if (!port_allocator_take(alloc->used_map, word, bit)) {
+		return SWITCH_STATUS_FALSE;
 	}
 
+	switch_atomic_dec(&alloc->track_used);
 
-	return status;
+	if (alloc->quarantine_ms) {
+		switch_atomic_set(&alloc->released[index], port_allocator_now(alloc));
+		switch_atomic_inc(&alloc->track_quarantined);
+		port_allocator_give(alloc->quarantine_map, word, bit);
+	} else {
+		port_allocator_give(alloc->free_map, word, bit);
+	}
 
+	return SWITCH_STATUS_SUCCESS;
 }
 
-SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_free_port(switch_core_port_allocator_t *alloc, switch_port_t port)
+SWITCH_DECLARE(void) switch_core_port_allocator_get_stats(switch_core_port_allocator_t *alloc, uint32_t *total, uint32_t *used, uint32_t *quarantined)
 {
-	switch_status_t status = SWITCH_STATUS_FALSE;
-	int even = switch_test_flag(alloc, SPF_EVEN);
-	int odd = switch_test_flag(alloc, SPF_ODD);
-	int index = port - alloc->start;
-
-	if (!(even && odd)) {
-		index /= 2;
+	if (total) {
+		*total = alloc->track_len;
 	}
 
-	switch_mutex_lock(alloc->mutex);
-	if (alloc->track[index] > 0) {
-		alloc->track[index] = -4;
-		alloc->track_used--;
-		status = SWITCH_STATUS_SUCCESS;
+	if (used) {
+		*used = switch_atomic_read(&alloc->track_used);
 	}
-	switch_mutex_unlock(alloc->mutex);
 
-	return status;
+	if (quarantined) {
+		*quarantined = switch_atomic_read(&alloc->track_quarantined);
+	}
 }
 
 SWITCH_DECLARE(void) switch_core_port_allocator_destroy(switch_core_port_allocator_t **alloc)
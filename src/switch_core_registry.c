@@ -0,0 +1,785 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2010, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * Anthony Minessale II <anthm@freeswitch.org>
+ *
+ *
+ * switch_core_registry.c -- Live channel and call registry
+ *
+ */
+
+#include <switch.h>
+#include "private/switch_core_pvt.h"
+
+/* The registry holds the same rows the channels and calls tables of the core db hold, updated in the thread
+   that fires the channel event instead of behind the sql thread.  Rows are spread over lock stripes by uuid and
+   a bridge lives in the stripe of its caller so a channel and the call it originated can be read under one lock. */
+
+#define REGISTRY_STRIPES 32
+
+typedef enum {
+	CH_UUID,
+	CH_DIRECTION,
+	CH_CREATED,
+	CH_CREATED_EPOCH,
+	CH_NAME,
+	CH_STATE,
+	CH_CID_NAME,
+	CH_CID_NUM,
+	CH_IP_ADDR,
+	CH_DEST,
+	CH_APPLICATION,
+	CH_APPLICATION_DATA,
+	CH_DIALPLAN,
+	CH_CONTEXT,
+	CH_READ_CODEC,
+	CH_READ_RATE,
+	CH_WRITE_CODEC,
+	CH_WRITE_RATE,
+	CH_SECURE,
+	CH_HOSTNAME,
+	CH_PRESENCE_ID,
+	CH_PRESENCE_DATA,
+	CH_MAX
+} channel_col_t;
+
+typedef enum {
+	CL_CALL_CREATED,
+	CL_CALL_CREATED_EPOCH,
+	CL_FUNCTION,
+	CL_CALLER_CID_NAME,
+	CL_CALLER_CID_NUM,
+	CL_CALLER_DEST_NUM,
+	CL_CALLER_CHAN_NAME,
+	CL_CALLER_UUID,
+	CL_CALLEE_CID_NAME,
+	CL_CALLEE_CID_NUM,
+	CL_CALLEE_DEST_NUM,
+	CL_CALLEE_CHAN_NAME,
+	CL_CALLEE_UUID,
+	CL_HOSTNAME,
+	CL_MAX
+} call_col_t;
+
+static char *CHANNEL_COLUMNS[CH_MAX] = {
+	"uuid", "direction", "created", "created_epoch", "name", "state", "cid_name", "cid_num", "ip_addr", "dest",
+	"application", "application_data", "dialplan", "context", "read_codec", "read_rate", "write_codec", "write_rate",
+	"secure", "hostname", "presence_id", "presence_data"
+};
+
+static char *CALL_COLUMNS[CL_MAX] = {
+	"call_created", "call_created_epoch", "function", "caller_cid_name", "caller_cid_num", "caller_dest_num",
+	"caller_chan_name", "caller_uuid", "callee_cid_name", "callee_cid_num", "callee_dest_num", "callee_chan_name",
+	"callee_uuid", "hostname"
+};
+
+static char *JOINED_COLUMNS[CH_MAX + CL_MAX];
+
+typedef struct {
+	char *fields[CH_MAX + CL_MAX];
+	time_t epoch;
+	uint32_t seq;
+} registry_row_t;
+
+typedef struct {
+	switch_mutex_t *mutex;
+	switch_hash_t *channels;
+	switch_hash_t *calls;
+} registry_stripe_t;
+
+struct switch_registry_snapshot {
+	switch_memory_pool_t *pool;
+	int argc;
+	char **columns;
+	char ***rows;
+	uint32_t count;
+	uint32_t pos;
+};
+
+static struct {
+	registry_stripe_t stripes[REGISTRY_STRIPES];
+	volatile uint32_t seq;
+	volatile uint32_t channels;
+	volatile uint32_t calls;
+	switch_mutex_t *sort_mutex;
+	int running;
+} REGISTRY;
+
+static registry_stripe_t *registry_stripe(const char *uuid)
+{
+	uint32_t h = 5381;
+
+	for (; *uuid; uuid++) {
+		h = ((h << 5) + h) + (uint8_t) *uuid;
+	}
+
+	return &REGISTRY.stripes[h % REGISTRY_STRIPES];
+}
+
+static void registry_set(registry_row_t *row, int col, const char *val)
+{
+	switch_safe_free(row->fields[col]);
+	row->fields[col] = val ? strdup(val) : NULL;
+}
+
+static registry_row_t *registry_row_new(void)
+{
+	registry_row_t *row = calloc(1, sizeof(*row));
+
+	switch_assert(row);
+	row->epoch = switch_epoch_time_now(NULL);
+
+	return row;
+}
+
+static void registry_row_free(registry_row_t *row)
+{
+	int i;
+
+	if (!row) {
+		return;
+	}
+
+	for (i = 0; i < CH_MAX + CL_MAX; i++) {
+		switch_safe_free(row->fields[i]);
+	}
+
+	free(row);
+}
+
+static void registry_set_epoch(registry_row_t *row, int col)
+{
+	char epoch[32];
+
+	switch_snprintf(epoch, sizeof(epoch), "%ld", (long) row->epoch);
+	registry_set(row, col, epoch);
+}
+
+static void registry_rekey(switch_hash_t *(*which) (registry_stripe_t *), const char *old_uuid, const char *uuid, int col, volatile uint32_t *counter)
+{
+	registry_stripe_t *from = registry_stripe(old_uuid), *to = registry_stripe(uuid);
+	registry_row_t *row;
+
+	switch_mutex_lock(from->mutex);
+	if ((row = switch_core_hash_find(which(from), old_uuid))) {
+		switch_core_hash_delete(which(from), old_uuid);
+	}
+	switch_mutex_unlock(from->mutex);
+
+	if (!row) {
+		return;
+	}
+
+	registry_set(row, col, uuid);
+
+	switch_mutex_lock(to->mutex);
+	if (switch_core_hash_find(which(to), uuid)) {
+		/* a row already claims the new uuid, keep that one */
+		registry_row_free(row);
+		switch_atomic_dec(counter);
+	} else {
+		switch_core_hash_insert(which(to), uuid, row);
+	}
+	switch_mutex_unlock(to->mutex);
+}
+
+static switch_hash_t *stripe_channels(registry_stripe_t *stripe)
+{
+	return stripe->channels;
+}
+
+static switch_hash_t *stripe_calls(registry_stripe_t *stripe)
+{
+	return stripe->calls;
+}
+
+static void registry_rename_callee(const char *old_uuid, const char *uuid)
+{
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+	int i;
+
+	for (i = 0; i < REGISTRY_STRIPES; i++) {
+		registry_stripe_t *stripe = &REGISTRY.stripes[i];
+
+		switch_mutex_lock(stripe->mutex);
+		for (hi = switch_hash_first(NULL, stripe->calls); hi; hi = switch_hash_next(hi)) {
+			registry_row_t *row;
+
+			switch_hash_this(hi, &var, NULL, &val);
+			row = (registry_row_t *) val;
+
+			if (row->fields[CL_CALLEE_UUID] && !strcmp(row->fields[CL_CALLEE_UUID], old_uuid)) {
+				registry_set(row, CL_CALLEE_UUID, uuid);
+			}
+		}
+		switch_mutex_unlock(stripe->mutex);
+	}
+}
+
+/* must run in the thread that fires the event, before it is handed to the event system */
+void switch_core_registry_event(switch_event_t *event)
+{
+	const char *uuid;
+	registry_stripe_t *stripe;
+	registry_row_t *row;
+
+	if (!REGISTRY.running) {
+		return;
+	}
+
+	switch (event->event_id) {
+	case SWITCH_EVENT_CHANNEL_CREATE:
+	case SWITCH_EVENT_CHANNEL_DESTROY:
+	case SWITCH_EVENT_CHANNEL_STATE:
+	case SWITCH_EVENT_CHANNEL_EXECUTE:
+	case SWITCH_EVENT_CODEC:
+		uuid = switch_event_get_header(event, "unique-id");
+		break;
+	case SWITCH_EVENT_CHANNEL_BRIDGE:
+	case SWITCH_EVENT_CHANNEL_UNBRIDGE:
+	case SWITCH_EVENT_CALL_SECURE:
+		uuid = switch_event_get_header(event, "caller-unique-id");
+		break;
+	case SWITCH_EVENT_CHANNEL_UUID:
+		{
+			const char *old_uuid = switch_event_get_header(event, "old-unique-id");
+
+			if ((uuid = switch_event_get_header(event, "unique-id")) && old_uuid) {
+				registry_rekey(stripe_channels, old_uuid, uuid, CH_UUID, &REGISTRY.channels);
+				registry_rekey(stripe_calls, old_uuid, uuid, CL_CALLER_UUID, &REGISTRY.calls);
+				registry_rename_callee(old_uuid, uuid);
+			}
+		}
+		return;
+	default:
+		return;
+	}
+
+	if (zstr(uuid)) {
+		return;
+	}
+
+	stripe = registry_stripe(uuid);
+
+	switch_mutex_lock(stripe->mutex);
+
+	switch (event->event_id) {
+	case SWITCH_EVENT_CHANNEL_CREATE:
+		if (!(row = switch_core_hash_find(stripe->channels, uuid))) {
+			row = registry_row_new();
+			row->seq = switch_atomic_inc(&REGISTRY.seq);
+			switch_core_hash_insert(stripe->channels, uuid, row);
+			switch_atomic_inc(&REGISTRY.channels);
+		}
+		registry_set(row, CH_UUID, uuid);
+		registry_set(row, CH_DIRECTION, switch_event_get_header_nil(event, "call-direction"));
+		registry_set(row, CH_CREATED, switch_event_get_header_nil(event, "event-date-local"));
+		registry_set_epoch(row, CH_CREATED_EPOCH);
+		registry_set(row, CH_NAME, switch_event_get_header_nil(event, "channel-name"));
+		registry_set(row, CH_STATE, switch_event_get_header_nil(event, "channel-state"));
+		registry_set(row, CH_DIALPLAN, switch_event_get_header_nil(event, "caller-dialplan"));
+		registry_set(row, CH_CONTEXT, switch_event_get_header_nil(event, "caller-context"));
+		registry_set(row, CH_HOSTNAME, switch_core_get_variable("hostname"));
+		break;
+	case SWITCH_EVENT_CHANNEL_DESTROY:
+		if ((row = switch_core_hash_find(stripe->channels, uuid))) {
+			switch_core_hash_delete(stripe->channels, uuid);
+			registry_row_free(row);
+			switch_atomic_dec(&REGISTRY.channels);
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_STATE:
+		if ((row = switch_core_hash_find(stripe->channels, uuid))) {
+			const char *state = switch_event_get_header_nil(event, "channel-state-number");
+			switch_channel_state_t state_i = CS_DESTROY;
+
+			if (!zstr(state)) {
+				state_i = atoi(state);
+			}
+
+			switch (state_i) {
+			case CS_HANGUP:
+			case CS_DESTROY:
+				break;
+			case CS_ROUTING:
+				registry_set(row, CH_CID_NAME, switch_event_get_header_nil(event, "caller-caller-id-name"));
+				registry_set(row, CH_CID_NUM, switch_event_get_header_nil(event, "caller-caller-id-number"));
+				registry_set(row, CH_IP_ADDR, switch_event_get_header_nil(event, "caller-network-addr"));
+				registry_set(row, CH_DEST, switch_event_get_header_nil(event, "caller-destination-number"));
+				registry_set(row, CH_DIALPLAN, switch_event_get_header_nil(event, "caller-dialplan"));
+				registry_set(row, CH_CONTEXT, switch_event_get_header_nil(event, "caller-context"));
+				registry_set(row, CH_PRESENCE_ID, switch_event_get_header_nil(event, "channel-presence-id"));
+				registry_set(row, CH_PRESENCE_DATA, switch_event_get_header_nil(event, "channel-presence-data"));
+				/* fall through */
+			default:
+				registry_set(row, CH_STATE, switch_event_get_header_nil(event, "channel-state"));
+				break;
+			}
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_EXECUTE:
+		if ((row = switch_core_hash_find(stripe->channels, uuid))) {
+			registry_set(row, CH_APPLICATION, switch_event_get_header_nil(event, "application"));
+			registry_set(row, CH_APPLICATION_DATA, switch_event_get_header_nil(event, "application-data"));
+			registry_set(row, CH_PRESENCE_ID, switch_event_get_header_nil(event, "channel-presence-id"));
+			registry_set(row, CH_PRESENCE_DATA, switch_event_get_header_nil(event, "channel-presence-data"));
+		}
+		break;
+	case SWITCH_EVENT_CODEC:
+		if ((row = switch_core_hash_find(stripe->channels, uuid))) {
+			registry_set(row, CH_READ_CODEC, switch_event_get_header_nil(event, "channel-read-codec-name"));
+			registry_set(row, CH_READ_RATE, switch_event_get_header_nil(event, "channel-read-codec-rate"));
+			registry_set(row, CH_WRITE_CODEC, switch_event_get_header_nil(event, "channel-write-codec-name"));
+			registry_set(row, CH_WRITE_RATE, switch_event_get_header_nil(event, "channel-write-codec-rate"));
+		}
+		break;
+	case SWITCH_EVENT_CALL_SECURE:
+		{
+			const char *type = switch_event_get_header(event, "secure_type");
+
+			if (!zstr(type) && (row = switch_core_hash_find(stripe->channels, uuid))) {
+				registry_set(row, CH_SECURE, type);
+			}
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_BRIDGE:
+		if (!(row = switch_core_hash_find(stripe->calls, uuid))) {
+			row = registry_row_new();
+			switch_core_hash_insert(stripe->calls, uuid, row);
+			switch_atomic_inc(&REGISTRY.calls);
+		}
+		row->seq = switch_atomic_inc(&REGISTRY.seq);
+		registry_set(row, CL_CALL_CREATED, switch_event_get_header_nil(event, "event-date-local"));
+		registry_set_epoch(row, CL_CALL_CREATED_EPOCH);
+		registry_set(row, CL_FUNCTION, switch_event_get_header_nil(event, "event-calling-function"));
+		registry_set(row, CL_CALLER_CID_NAME, switch_event_get_header_nil(event, "caller-caller-id-name"));
+		registry_set(row, CL_CALLER_CID_NUM, switch_event_get_header_nil(event, "caller-caller-id-number"));
+		registry_set(row, CL_CALLER_DEST_NUM, switch_event_get_header_nil(event, "caller-destination-number"));
+		registry_set(row, CL_CALLER_CHAN_NAME, switch_event_get_header_nil(event, "caller-channel-name"));
+		registry_set(row, CL_CALLER_UUID, uuid);
+		registry_set(row, CL_CALLEE_CID_NAME, switch_event_get_header_nil(event, "Other-Leg-caller-id-name"));
+		registry_set(row, CL_CALLEE_CID_NUM, switch_event_get_header_nil(event, "Other-Leg-caller-id-number"));
+		registry_set(row, CL_CALLEE_DEST_NUM, switch_event_get_header_nil(event, "Other-Leg-destination-number"));
+		registry_set(row, CL_CALLEE_CHAN_NAME, switch_event_get_header_nil(event, "Other-Leg-channel-name"));
+		registry_set(row, CL_CALLEE_UUID, switch_event_get_header_nil(event, "Other-Leg-unique-id"));
+		registry_set(row, CL_HOSTNAME, switch_core_get_variable("hostname"));
+		break;
+	case SWITCH_EVENT_CHANNEL_UNBRIDGE:
+		if ((row = switch_core_hash_find(stripe->calls, uuid))) {
+			switch_core_hash_delete(stripe->calls, uuid);
+			registry_row_free(row);
+			switch_atomic_dec(&REGISTRY.calls);
+		}
+		break;
+	default:
+		break;
+	}
+
+	switch_mutex_unlock(stripe->mutex);
+}
+
+/* same semantics as an sql like: % matches any run, _ any one char, ascii case is ignored */
+static switch_bool_t registry_like(const char *pattern, const char *str)
+{
+	if (!str) {
+		return SWITCH_FALSE;
+	}
+
+	for (; *pattern; pattern++, str++) {
+		if (*pattern == '%') {
+			while (*pattern == '%') {
+				pattern++;
+			}
+
+			if (!*pattern) {
+				return SWITCH_TRUE;
+			}
+
+			for (; *str; str++) {
+				if (registry_like(pattern, str)) {
+					return SWITCH_TRUE;
+				}
+			}
+
+			return SWITCH_FALSE;
+		}
+
+		if (!*str) {
+			return SWITCH_FALSE;
+		}
+
+		if (*pattern != '_' && switch_tolower(*pattern) != switch_tolower(*str)) {
+			return SWITCH_FALSE;
+		}
+	}
+
+	return *str ? SWITCH_FALSE : SWITCH_TRUE;
+}
+
+static int registry_column(char **columns, int argc, const char *name)
+{
+	int i;
+
+	for (i = 0; i < argc; i++) {
+		if (!strcasecmp(columns[i], name)) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static const char *registry_field(switch_registry_table_t table, registry_row_t *row, registry_row_t *call, int col)
+{
+	if (table == SWITCH_REGISTRY_DISTINCT_CHANNELS && col >= CH_MAX) {
+		return call ? call->fields[col - CH_MAX] : NULL;
+	}
+
+	return row->fields[col];
+}
+
+static switch_bool_t registry_match(switch_registry_table_t table, registry_row_t *row, registry_row_t *call, int col, const char *match)
+{
+	if (!match) {
+		return SWITCH_TRUE;
+	}
+
+	if (col > -1) {
+		return registry_like(match, registry_field(table, row, call, col));
+	}
+
+	if (table == SWITCH_REGISTRY_CALLS) {
+		return registry_like(match, row->fields[CL_CALLER_UUID]) || registry_like(match, row->fields[CL_CALLEE_UUID]) ||
+			registry_like(match, row->fields[CL_CALLER_CHAN_NAME]) || registry_like(match, row->fields[CL_CALLEE_CHAN_NAME]) ||
+			registry_like(match, row->fields[CL_CALLER_CID_NAME]) || registry_like(match, row->fields[CL_CALLER_CID_NUM]);
+	}
+
+	return registry_like(match, row->fields[CH_UUID]) || registry_like(match, row->fields[CH_NAME]) ||
+		registry_like(match, row->fields[CH_CID_NAME]) || registry_like(match, row->fields[CH_CID_NUM]);
+}
+
+typedef struct {
+	char **row;
+	time_t epoch;
+	uint32_t seq;
+} registry_entry_t;
+
+static int registry_sort_col;
+
+static int registry_compare(const void *a, const void *b)
+{
+	const registry_entry_t *ea = (const registry_entry_t *) a, *eb = (const registry_entry_t *) b;
+
+	if (registry_sort_col > -1) {
+		int r = strcmp(switch_str_nil(ea->row[registry_sort_col]), switch_str_nil(eb->row[registry_sort_col]));
+		if (r) {
+			return r;
+		}
+	} else if (ea->epoch != eb->epoch) {
+		return ea->epoch < eb->epoch ? -1 : 1;
+	}
+
+	return ea->seq < eb->seq ? -1 : ea->seq > eb->seq ? 1 : 0;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_registry_snapshot(switch_registry_snapshot_t **snapshot, switch_registry_table_t table,
+															   const char *column, const char *match, switch_registry_sort_t sort)
+{
+	switch_memory_pool_t *pool;
+	switch_registry_snapshot_t *snap;
+	registry_entry_t *entries = NULL;
+	uint32_t count = 0, size = 0, i;
+	switch_hash_t *callees = NULL;
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+	int col = -1, ncols;
+	char **columns;
+
+	*snapshot = NULL;
+
+	if (!REGISTRY.running) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch (table) {
+	case SWITCH_REGISTRY_CALLS:
+		columns = CALL_COLUMNS;
+		ncols = CL_MAX;
+		break;
+	case SWITCH_REGISTRY_DISTINCT_CHANNELS:
+		columns = JOINED_COLUMNS;
+		ncols = CH_MAX + CL_MAX;
+		break;
+	default:
+		columns = CHANNEL_COLUMNS;
+		ncols = CH_MAX;
+		break;
+	}
+
+	if (column && (col = registry_column(columns, ncols, column)) < 0) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (table == SWITCH_REGISTRY_DISTINCT_CHANNELS) {
+		/* the b legs of live bridges, their a legs already represent the call */
+		switch_core_hash_init(&callees, NULL);
+
+		for (i = 0; i < REGISTRY_STRIPES; i++) {
+			registry_stripe_t *stripe = &REGISTRY.stripes[i];
+
+			switch_mutex_lock(stripe->mutex);
+			for (hi = switch_hash_first(NULL, stripe->calls); hi; hi = switch_hash_next(hi)) {
+				registry_row_t *row;
+
+				switch_hash_this(hi, &var, NULL, &val);
+				row = (registry_row_t *) val;
+
+				if (!zstr(row->fields[CL_CALLEE_UUID])) {
+					switch_core_hash_insert(callees, row->fields[CL_CALLEE_UUID], callees);
+				}
+			}
+			switch_mutex_unlock(stripe->mutex);
+		}
+	}
+
+	switch_core_new_memory_pool(&pool);
+	snap = switch_core_alloc(pool, sizeof(*snap));
+	snap->pool = pool;
+	snap->argc = ncols;
+	snap->columns = columns;
+
+	for (i = 0; i < REGISTRY_STRIPES; i++) {
+		registry_stripe_t *stripe = &REGISTRY.stripes[i];
+		switch_hash_t *hash = table == SWITCH_REGISTRY_CALLS ? stripe->calls : stripe->channels;
+
+		switch_mutex_lock(stripe->mutex);
+		for (hi = switch_hash_first(NULL, hash); hi; hi = switch_hash_next(hi)) {
+			registry_row_t *row, *call = NULL;
+			int f;
+
+			switch_hash_this(hi, &var, NULL, &val);
+			row = (registry_row_t *) val;
+
+			if (table == SWITCH_REGISTRY_DISTINCT_CHANNELS) {
+				if (switch_core_hash_find(callees, (const char *) var)) {
+					continue;
+				}
+				call = switch_core_hash_find(stripe->calls, (const char *) var);
+			}
+
+			if (!registry_match(table, row, call, col, match)) {
+				continue;
+			}
+
+			if (count == size) {
+				registry_entry_t *tmp;
+
+				size = size ? size * 2 : 64;
+				tmp = realloc(entries, size * sizeof(*entries));
+				switch_assert(tmp);
+				entries = tmp;
+			}
+
+			entries[count].row = switch_core_alloc(pool, sizeof(char *) * ncols);
+			entries[count].epoch = row->epoch;
+			entries[count].seq = row->seq;
+
+			for (f = 0; f < ncols; f++) {
+				const char *v = registry_field(table, row, call, f);
+				entries[count].row[f] = v ? switch_core_strdup(pool, v) : NULL;
+			}
+
+			count++;
+		}
+		switch_mutex_unlock(stripe->mutex);
+	}
+
+	if (callees) {
+		switch_core_hash_destroy(&callees);
+	}
+
+	if (count > 1) {
+		switch (sort) {
+		case SWITCH_REGISTRY_SORT_UUID:
+			col = table == SWITCH_REGISTRY_CALLS ? CL_CALLER_UUID : CH_UUID;
+			break;
+		case SWITCH_REGISTRY_SORT_NAME:
+			col = table == SWITCH_REGISTRY_CALLS ? CL_CALLER_CHAN_NAME : CH_NAME;
+			break;
+		default:
+			col = -1;
+			break;
+		}
+
+		switch_mutex_lock(REGISTRY.sort_mutex);
+		registry_sort_col = col;
+		qsort(entries, count, sizeof(*entries), registry_compare);
+		switch_mutex_unlock(REGISTRY.sort_mutex);
+	}
+
+	snap->count = count;
+	snap->rows = switch_core_alloc(pool, sizeof(char **) * (count ? count : 1));
+
+	for (i = 0; i < count; i++) {
+		snap->rows[i] = entries[i].row;
+	}
+
+	switch_safe_free(entries);
+
+	*snapshot = snap;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(uint32_t) switch_core_registry_snapshot_size(switch_registry_snapshot_t *snapshot)
+{
+	return snapshot ? snapshot->count : 0;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_registry_snapshot_next(switch_registry_snapshot_t *snapshot, int *argc, char ***argv, char ***columns)
+{
+	if (!snapshot || snapshot->pos >= snapshot->count) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	*argc = snapshot->argc;
+	*argv = snapshot->rows[snapshot->pos++];
+
+	if (columns) {
+		*columns = snapshot->columns;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(void) switch_core_registry_snapshot_destroy(switch_registry_snapshot_t **snapshot)
+{
+	if (snapshot && *snapshot) {
+		switch_memory_pool_t *pool = (*snapshot)->pool;
+		*snapshot = NULL;
+		switch_core_destroy_memory_pool(&pool);
+	}
+}
+
+SWITCH_DECLARE(int) switch_core_registry_execute_callback(switch_registry_table_t table, const char *column, const char *match,
+														  switch_registry_sort_t sort, switch_core_db_callback_func_t callback, void *pArg)
+{
+	switch_registry_snapshot_t *snapshot;
+	int argc, count = 0;
+	char **argv, **columns;
+
+	if (switch_core_registry_snapshot(&snapshot, table, column, match, sort) != SWITCH_STATUS_SUCCESS) {
+		return -1;
+	}
+
+	while (switch_core_registry_snapshot_next(snapshot, &argc, &argv, &columns) == SWITCH_STATUS_SUCCESS) {
+		count++;
+		if (callback(pArg, argc, argv, columns)) {
+			break;
+		}
+	}
+
+	switch_core_registry_snapshot_destroy(&snapshot);
+
+	return count;
+}
+
+SWITCH_DECLARE(uint32_t) switch_core_registry_count(switch_registry_table_t table)
+{
+	return table == SWITCH_REGISTRY_CALLS ? switch_atomic_read(&REGISTRY.calls) : switch_atomic_read(&REGISTRY.channels);
+}
+
+void switch_core_registry_init(switch_memory_pool_t *pool)
+{
+	int i;
+
+	memset(&REGISTRY, 0, sizeof(REGISTRY));
+	switch_mutex_init(&REGISTRY.sort_mutex, SWITCH_MUTEX_NESTED, pool);
+
+	for (i = 0; i < CH_MAX; i++) {
+		JOINED_COLUMNS[i] = CHANNEL_COLUMNS[i];
+	}
+
+	for (i = 0; i < CL_MAX; i++) {
+		JOINED_COLUMNS[CH_MAX + i] = CALL_COLUMNS[i];
+	}
+
+	for (i = 0; i < REGISTRY_STRIPES; i++) {
+		switch_mutex_init(&REGISTRY.stripes[i].mutex, SWITCH_MUTEX_NESTED, pool);
+		switch_core_hash_init(&REGISTRY.stripes[i].channels, NULL);
+		switch_core_hash_init(&REGISTRY.stripes[i].calls, NULL);
+	}
+
+	REGISTRY.running = 1;
+}
+
+void switch_core_registry_shutdown(void)
+{
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+	int i;
+
+	if (!REGISTRY.running) {
+		return;
+	}
+
+	REGISTRY.running = 0;
+
+	for (i = 0; i < REGISTRY_STRIPES; i++) {
+		registry_stripe_t *stripe = &REGISTRY.stripes[i];
+
+		switch_mutex_lock(stripe->mutex);
+
+		for (hi = switch_hash_first(NULL, stripe->channels); hi; hi = switch_hash_next(hi)) {
+			switch_hash_this(hi, &var, NULL, &val);
+			registry_row_free((registry_row_t *) val);
+		}
+
+		for (hi = switch_hash_first(NULL, stripe->calls); hi; hi = switch_hash_next(hi)) {
+			switch_hash_this(hi, &var, NULL, &val);
+			registry_row_free((registry_row_t *) val);
+		}
+
+		switch_core_hash_destroy(&stripe->channels);
+		switch_core_hash_destroy(&stripe->calls);
+
+		switch_mutex_unlock(stripe->mutex);
+	}
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
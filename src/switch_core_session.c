@@ -38,6 +38,26 @@
 
 struct switch_session_manager session_manager;
 
+static switch_session_partition_t *session_partition(const char *uuid_str)
+{
+	switch_ssize_t len = (switch_ssize_t) strlen(uuid_str);
+	unsigned int hash = switch_ci_hashfunc_default(uuid_str, &len);
+
+	return &session_manager.session_table[(hash ^ (hash >> 16)) & (SWITCH_SESSION_TABLE_PARTITIONS - 1)];
+}
+
+static switch_bool_t session_uuid_exists(const char *uuid_str)
+{
+	switch_session_partition_t *part = session_partition(uuid_str);
+	switch_bool_t r;
+
+	switch_thread_rwlock_rdlock(part->rwlock);
+	r = switch_core_hash_find(part->table, uuid_str) ? SWITCH_TRUE : SWITCH_FALSE;
+	switch_thread_rwlock_unlock(part->rwlock);
+
+	return r;
+}
+
 #ifdef SWITCH_DEBUG_RWLOCKS
 SWITCH_DECLARE(switch_core_session_t *) switch_core_session_perform_locate(const char *uuid_str, const char *file, const char *func, int line)
 #else
@@ -47,8 +67,10 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_locate(const char *u
 	switch_core_session_t *session = NULL;
 
 	if (uuid_str) {
-		switch_mutex_lock(runtime.session_hash_mutex);
-		if ((session = switch_core_hash_find(session_manager.session_table, uuid_str))) {
+		switch_session_partition_t *part = session_partition(uuid_str);
+
+		switch_thread_rwlock_rdlock(part->rwlock);
+		if ((session = switch_core_hash_find(part->table, uuid_str))) {
 			/* Acquire a read lock on the session */
 #ifdef SWITCH_DEBUG_RWLOCKS
 			if (switch_core_session_perform_read_lock(session, file, func, line) != SWITCH_STATUS_SUCCESS) {
@@ -62,7 +84,7 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_locate(const char *u
 				session = NULL;
 			}
 		}
-		switch_mutex_unlock(runtime.session_hash_mutex);
+		switch_thread_rwlock_unlock(part->rwlock);
 	}
 
 	/* if its not NULL, now it's up to you to rwunlock this */
@@ -82,8 +104,10 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_force_locate(const c
 	switch_status_t status;
 
 	if (uuid_str) {
-		switch_mutex_lock(runtime.session_hash_mutex);
-		if ((session = switch_core_hash_find(session_manager.session_table, uuid_str))) {
+		switch_session_partition_t *part = session_partition(uuid_str);
+
+		switch_thread_rwlock_rdlock(part->rwlock);
+		if ((session = switch_core_hash_find(part->table, uuid_str))) {
 			/* Acquire a read lock on the session */
 
 			if (switch_test_flag(session, SSF_DESTROYED)) {
@@ -105,7 +129,7 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_force_locate(const c
 				session = NULL;
 			}
 		}
-		switch_mutex_unlock(runtime.session_hash_mutex);
+		switch_thread_rwlock_unlock(part->rwlock);
 	}
 
 	/* if its not NULL, now it's up to you to rwunlock this */
@@ -133,40 +157,43 @@ struct str_node {
 	struct str_node *next;
 };
 
-SWITCH_DECLARE(void) switch_core_session_hupall_matching_var(const char *var_name, const char *var_val, switch_call_cause_t cause)
+typedef switch_bool_t (*session_match_func_t) (switch_core_session_t *session, const void *user_data);
+
+/* collect the matching uuids one partition at a time, then hang them up without holding any table lock */
+static void session_hupall_matching(session_match_func_t match, const void *user_data, switch_call_cause_t cause)
 {
 	switch_hash_index_t *hi;
 	void *val;
 	switch_core_session_t *session;
 	switch_memory_pool_t *pool;
 	struct str_node *head = NULL, *np;
+	int i;
 
 	switch_core_new_memory_pool(&pool);
 
-	if (!var_val)
-		return;
-
-	switch_mutex_lock(runtime.session_hash_mutex);
-	for (hi = switch_hash_first(NULL, session_manager.session_table); hi; hi = switch_hash_next(hi)) {
-		switch_hash_this(hi, NULL, NULL, &val);
-		if (val) {
-			const char *this_val;
-			session = (switch_core_session_t *) val;
-			if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-				if (switch_channel_up(session->channel) &&
-					(this_val = switch_channel_get_variable(session->channel, var_name)) && (!strcmp(this_val, var_val))) {
-					np = switch_core_alloc(pool, sizeof(*np));
-					np->str = switch_core_strdup(pool, session->uuid_str);
-					np->next = head;
-					head = np;
+	for (i = 0; i < SWITCH_SESSION_TABLE_PARTITIONS; i++) {
+		switch_session_partition_t *part = &session_manager.session_table[i];
+
+		switch_thread_rwlock_rdlock(part->rwlock);
+		for (hi = switch_hash_first(NULL, part->table); hi; hi = switch_hash_next(hi)) {
+			switch_hash_this(hi, NULL, NULL, &val);
+			if (val) {
+				session = (switch_core_session_t *) val;
+				if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
+					if (!match || match(session, user_data)) {
+						np = switch_core_alloc(pool, sizeof(*np));
+						np->str = switch_core_strdup(pool, session->uuid_str);
+						np->next = head;
+						head = np;
+					}
+					switch_core_session_rwunlock(session);
 				}
-				switch_core_session_rwunlock(session);
 			}
 		}
+		switch_thread_rwlock_unlock(part->rwlock);
 	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
 
-	for(np = head; np; np = np->next) {
+	for (np = head; np; np = np->next) {
 		if ((session = switch_core_session_locate(np->str))) {
 			switch_channel_hangup(session->channel, cause);
 			switch_core_session_rwunlock(session);
@@ -174,84 +201,47 @@ SWITCH_DECLARE(void) switch_core_session_hupall_matching_var(const char *var_nam
 	}
 
 	switch_core_destroy_memory_pool(&pool);
-
 }
 
-SWITCH_DECLARE(void) switch_core_session_hupall_endpoint(const switch_endpoint_interface_t *endpoint_interface, switch_call_cause_t cause)
-{
-	switch_hash_index_t *hi;
-	void *val;
-	switch_core_session_t *session;
-	switch_memory_pool_t *pool;
-    struct str_node *head = NULL, *np;
-	
-	switch_core_new_memory_pool(&pool);
-	
-	switch_mutex_lock(runtime.session_hash_mutex);
-	for (hi = switch_hash_first(NULL, session_manager.session_table); hi; hi = switch_hash_next(hi)) {
-		switch_hash_this(hi, NULL, NULL, &val);
-		if (val) {
-			session = (switch_core_session_t *) val;
-			if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-				if (session->endpoint_interface == endpoint_interface) {
-					np = switch_core_alloc(pool, sizeof(*np));
-                    np->str = switch_core_strdup(pool, session->uuid_str);
-                    np->next = head;
-					head = np;
-				}
-				switch_core_session_rwunlock(session);
-			}
-		}
-	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
-
-	for(np = head; np; np = np->next) {
-		if ((session = switch_core_session_locate(np->str))) {
-			switch_channel_hangup(session->channel, cause);
-			switch_core_session_rwunlock(session);
-		}
-	}
+struct var_match {
+	const char *var_name;
+	const char *var_val;
+};
 
-	switch_core_destroy_memory_pool(&pool);
+static switch_bool_t session_var_match(switch_core_session_t *session, const void *user_data)
+{
+	const struct var_match *vm = (const struct var_match *) user_data;
+	const char *this_val;
 
+	return (switch_channel_up(session->channel) &&
+			(this_val = switch_channel_get_variable(session->channel, vm->var_name)) && !strcmp(this_val, vm->var_val)) ? SWITCH_TRUE : SWITCH_FALSE;
 }
 
-SWITCH_DECLARE(void) switch_core_session_hupall(switch_call_cause_t cause)
+SWITCH_DECLARE(void) switch_core_session_hupall_matching_var(const char *var_name, const char *var_val, switch_call_cause_t cause)
 {
-	switch_hash_index_t *hi;
-	void *val;
-	switch_core_session_t *session;
-	switch_memory_pool_t *pool;
-	struct str_node *head = NULL, *np;
-
-	switch_core_new_memory_pool(&pool);
+	struct var_match vm;
 
+	if (!var_val)
+		return;
 
-	switch_mutex_lock(runtime.session_hash_mutex);
-	for (hi = switch_hash_first(NULL, session_manager.session_table); hi; hi = switch_hash_next(hi)) {
-		switch_hash_this(hi, NULL, NULL, &val);
-		if (val) {
-			session = (switch_core_session_t *) val;
-			if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-				np = switch_core_alloc(pool, sizeof(*np));
-				np->str = switch_core_strdup(pool, session->uuid_str);
-				np->next = head;
-				head = np;
-				switch_core_session_rwunlock(session);
-			}
-		}
-	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
+	vm.var_name = var_name;
+	vm.var_val = var_val;
+	session_hupall_matching(session_var_match, &vm, cause);
+}
 
-	for(np = head; np; np = np->next) { 
-		if ((session = switch_core_session_locate(np->str))) {
-			switch_channel_hangup(session->channel, cause);
-			switch_core_session_rwunlock(session);
-		}
-	}
+static switch_bool_t session_endpoint_match(switch_core_session_t *session, const void *user_data)
+{
+	return session->endpoint_interface == (const switch_endpoint_interface_t *) user_data ? SWITCH_TRUE : SWITCH_FALSE;
+}
 
-	switch_core_destroy_memory_pool(&pool);
+SWITCH_DECLARE(void) switch_core_session_hupall_endpoint(const switch_endpoint_interface_t *endpoint_interface, switch_call_cause_t cause)
+{
+	session_hupall_matching(session_endpoint_match, endpoint_interface, cause);
+}
 
+SWITCH_DECLARE(void) switch_core_session_hupall(switch_call_cause_t cause)
+{
+	session_hupall_matching(NULL, NULL, cause);
 }
 
 
@@ -260,17 +250,13 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_message_send(const char *uui
 	switch_core_session_t *session = NULL;
 	switch_status_t status = SWITCH_STATUS_FALSE;
 
-	switch_mutex_lock(runtime.session_hash_mutex);
-	if ((session = switch_core_hash_find(session_manager.session_table, uuid_str)) != 0) {
-		/* Acquire a read lock on the session or forget it the channel is dead */
-		if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-			if (switch_channel_up(session->channel)) {
-				status = switch_core_session_receive_message(session, message);
-			}
-			switch_core_session_rwunlock(session);
+	/* the read lock keeps the session around, the table lock is not held while the message is delivered */
+	if ((session = switch_core_session_locate(uuid_str))) {
+		if (switch_channel_up(session->channel)) {
+			status = switch_core_session_receive_message(session, message);
 		}
+		switch_core_session_rwunlock(session);
 	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
 
 	return status;
 }
@@ -280,17 +266,12 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_event_send(const char *uuid_
 	switch_core_session_t *session = NULL;
 	switch_status_t status = SWITCH_STATUS_FALSE;
 
-	switch_mutex_lock(runtime.session_hash_mutex);
-	if ((session = switch_core_hash_find(session_manager.session_table, uuid_str)) != 0) {
-		/* Acquire a read lock on the session or forget it the channel is dead */
-		if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-			if (switch_channel_up(session->channel)) {
-				status = switch_core_session_queue_event(session, event);
-			}
-			switch_core_session_rwunlock(session);
+	if ((session = switch_core_session_locate(uuid_str))) {
+		if (switch_channel_up(session->channel)) {
+			status = switch_core_session_queue_event(session, event);
 		}
+		switch_core_session_rwunlock(session);
 	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
 
 	return status;
 }
@@ -992,6 +973,12 @@ SWITCH_DECLARE(switch_channel_t *) switch_core_session_get_channel(switch_core_s
 
 SWITCH_DECLARE(void) switch_core_session_wake_session_thread(switch_core_session_t *session)
 {
+	/* A dormant session has no thread to signal, whoever clears the flag first hands it back to a worker */
+	if (switch_atomic_cas(&session->dormant, 0, 1) == 1) {
+		switch_core_session_resume(session);
+		return;
+	}
+
 	/* If trylock fails the signal is already awake so we needn't bother */
 
 	if (switch_mutex_trylock(session->mutex) == SWITCH_STATUS_SUCCESS) {
@@ -1031,6 +1018,7 @@ SWITCH_DECLARE(void) switch_core_session_perform_destroy(switch_core_session_t *
 	switch_memory_pool_t *pool;
 	switch_event_t *event;
 	switch_endpoint_interface_t *endpoint_interface = (*session)->endpoint_interface;
+	switch_session_partition_t *part;
 
 
 	switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, switch_core_session_get_uuid(*session), SWITCH_LOG_NOTICE, "Close Channel %s [%s]\n",
@@ -1044,8 +1032,12 @@ SWITCH_DECLARE(void) switch_core_session_perform_destroy(switch_core_session_t *
 
 	switch_scheduler_del_task_group((*session)->uuid_str);
 
+	part = session_partition((*session)->uuid_str);
+	switch_thread_rwlock_wrlock(part->rwlock);
+	switch_core_hash_delete(part->table, (*session)->uuid_str);
+	switch_thread_rwlock_unlock(part->rwlock);
+
 	switch_mutex_lock(runtime.session_hash_mutex);
-	switch_core_hash_delete(session_manager.session_table, (*session)->uuid_str);
 	if (session_manager.session_count) {
 		session_manager.session_count--;
 	}
@@ -1159,7 +1151,15 @@ static void *SWITCH_THREAD_FUNC switch_core_session_thread(switch_thread_t *thre
 	session->thread = thread;
 	session->thread_id = switch_thread_self();
 
-	switch_core_session_run(session);
+	if (session_manager.thread_pool) {
+		if (switch_core_session_run_yield(session)) {
+			/* dormant, the session belongs to whoever wakes it now */
+			return NULL;
+		}
+	} else {
+		switch_core_session_run(session);
+	}
+
 	switch_core_media_bug_remove_all(session);
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Session %" SWITCH_SIZE_T_FMT " (%s) Locked, Waiting on external entities\n",
 					  session->id, switch_channel_get_name(session->channel));
@@ -1185,6 +1185,161 @@ static void *SWITCH_THREAD_FUNC switch_core_session_thread(switch_thread_t *thre
 	return NULL;
 }
 
+/*
+ * With session-thread-pool enabled the session threads and the helper threads started with
+ * switch_core_session_launch_thread are run on pooled workers instead of a fresh detached thread each.
+ * A session whose state machine goes idle in PARK, HIBERNATE or CONSUME_MEDIA (signal or proxy bridged,
+ * bypass media park, outbound legs waiting for instructions) goes dormant and hands its worker back,
+ * it is queued to a worker again when something wakes it.  Only a session running a blocking application
+ * or state handler holds a worker.  Idle workers over session-thread-pool-idle are reaped after
+ * SESSION_POOL_IDLE_SEC, each worker lives in its own memory pool which it destroys on exit.
+ */
+#define SESSION_POOL_IDLE_SEC 10
+
+struct switch_session_job {
+	switch_thread_start_t func;
+	void *obj;
+	struct switch_session_job *next;
+};
+
+static void *SWITCH_THREAD_FUNC session_pool_worker(switch_thread_t *thread, void *obj)
+{
+	switch_memory_pool_t *pool = (switch_memory_pool_t *) obj;
+	struct switch_session_job *job;
+
+	switch_mutex_lock(session_manager.thread_pool_mutex);
+
+	for (;;) {
+		if ((job = session_manager.thread_pool_jobs)) {
+			if (!(session_manager.thread_pool_jobs = job->next)) {
+				session_manager.thread_pool_jobs_tail = NULL;
+			}
+			session_manager.thread_pool_pending--;
+			session_manager.thread_pool_idle--;
+			switch_mutex_unlock(session_manager.thread_pool_mutex);
+
+			job->func(thread, job->obj);
+			free(job);
+
+			switch_mutex_lock(session_manager.thread_pool_mutex);
+			session_manager.thread_pool_idle++;
+			continue;
+		}
+
+		if (session_manager.thread_pool_stopping) {
+			break;
+		}
+
+		if (switch_thread_cond_timedwait(session_manager.thread_pool_cond, session_manager.thread_pool_mutex,
+										 SESSION_POOL_IDLE_SEC * 1000000) == SWITCH_STATUS_TIMEOUT &&
+			!session_manager.thread_pool_jobs && session_manager.thread_pool_idle > session_manager.thread_pool_idle_min) {
+			break;
+		}
+	}
+
+	session_manager.thread_pool_idle--;
+	session_manager.thread_pool_running--;
+	switch_mutex_unlock(session_manager.thread_pool_mutex);
+
+	switch_core_destroy_memory_pool(&pool);
+
+	return NULL;
+}
+
+static switch_status_t session_pool_launch(switch_thread_start_t func, void *obj)
+{
+	struct switch_session_job *job;
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+	switch_zmalloc(job, sizeof(*job));
+	job->func = func;
+	job->obj = obj;
+
+	switch_mutex_lock(session_manager.thread_pool_mutex);
+
+	if (session_manager.thread_pool_stopping) {
+		status = SWITCH_STATUS_FALSE;
+	} else if (session_manager.thread_pool_idle <= session_manager.thread_pool_pending) {
+		/* every queued job needs a worker of its own since it may run for the whole call */
+		switch_thread_t *thread;
+		switch_threadattr_t *thd_attr;
+		switch_memory_pool_t *pool;
+
+		if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
+			status = SWITCH_STATUS_FALSE;
+		} else {
+			switch_threadattr_create(&thd_attr, pool);
+			switch_threadattr_detach_set(thd_attr, 1);
+			switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+			if (switch_thread_create(&thread, thd_attr, session_pool_worker, pool, pool) == SWITCH_STATUS_SUCCESS) {
+				session_manager.thread_pool_running++;
+				session_manager.thread_pool_idle++;
+			} else {
+				switch_core_destroy_memory_pool(&pool);
+				status = SWITCH_STATUS_FALSE;
+			}
+		}
+	}
+
+	if (status == SWITCH_STATUS_SUCCESS) {
+		if (session_manager.thread_pool_jobs_tail) {
+			session_manager.thread_pool_jobs_tail->next = job;
+		} else {
+			session_manager.thread_pool_jobs = job;
+		}
+		session_manager.thread_pool_jobs_tail = job;
+		session_manager.thread_pool_pending++;
+		switch_thread_cond_signal(session_manager.thread_pool_cond);
+	}
+
+	switch_mutex_unlock(session_manager.thread_pool_mutex);
+
+	if (status != SWITCH_STATUS_SUCCESS) {
+		free(job);
+	}
+
+	return status;
+}
+
+void switch_core_session_thread_pool_stop(void)
+{
+	int sanity = 100;
+
+	if (!session_manager.thread_pool_mutex) {
+		return;
+	}
+
+	switch_mutex_lock(session_manager.thread_pool_mutex);
+	session_manager.thread_pool_stopping = SWITCH_TRUE;
+	switch_thread_cond_broadcast(session_manager.thread_pool_cond);
+	switch_mutex_unlock(session_manager.thread_pool_mutex);
+
+	while (session_manager.thread_pool_running && --sanity > 0) {
+		switch_yield(100000);
+	}
+}
+
+void switch_core_session_resume(switch_core_session_t *session)
+{
+	switch_thread_t *thread;
+	switch_threadattr_t *thd_attr;
+
+	if (session_pool_launch(switch_core_session_thread, session) == SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	switch_threadattr_create(&thd_attr, session->pool);
+	switch_threadattr_detach_set(thd_attr, 1);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	if (switch_thread_create(&thread, thd_attr, switch_core_session_thread, session, session->pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_CRIT, "Cannot resume thread!\n");
+		/* leave it dormant so the next wake tries again */
+		switch_atomic_set(&session->dormant, 1);
+	}
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_session_thread_launch(switch_core_session_t *session)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
@@ -1199,7 +1354,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_thread_launch(switch_core_se
 	if (!session->thread_running) {
 		session->thread_running = 1;
 		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
-		if (switch_thread_create(&thread, thd_attr, switch_core_session_thread, session, session->pool) == SWITCH_STATUS_SUCCESS) {
+		if (session_manager.thread_pool && session_pool_launch(switch_core_session_thread, session) == SWITCH_STATUS_SUCCESS) {
+			status = SWITCH_STATUS_SUCCESS;
+		} else if (switch_thread_create(&thread, thd_attr, switch_core_session_thread, session, session->pool) == SWITCH_STATUS_SUCCESS) {
 			status = SWITCH_STATUS_SUCCESS;
 		} else {
 			session->thread_running = 0;
@@ -1218,6 +1375,11 @@ SWITCH_DECLARE(void) switch_core_session_launch_thread(switch_core_session_t *se
 {
 	switch_thread_t *thread;
 	switch_threadattr_t *thd_attr = NULL;
+
+	if (session_manager.thread_pool && session_pool_launch(func, obj) == SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
 	switch_threadattr_create(&thd_attr, session->pool);
 	switch_threadattr_detach_set(thd_attr, 1);
 
@@ -1228,15 +1390,15 @@ SWITCH_DECLARE(void) switch_core_session_launch_thread(switch_core_session_t *se
 
 SWITCH_DECLARE(switch_status_t) switch_core_session_set_uuid(switch_core_session_t *session, const char *use_uuid)
 {
-	switch_event_t *event;
+	switch_event_t *event = NULL;
 	switch_core_session_message_t msg = { 0 };
+	switch_session_partition_t *old_part, *new_part;
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
 
 	switch_assert(use_uuid);
 
-	switch_mutex_lock(runtime.session_hash_mutex);
-	if (switch_core_hash_find(session_manager.session_table, use_uuid)) {
+	if (session_uuid_exists(use_uuid)) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Duplicate UUID!\n");
-		switch_mutex_unlock(runtime.session_hash_mutex);
 		return SWITCH_STATUS_FALSE;
 	}
 
@@ -1246,12 +1408,40 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_set_uuid(switch_core_session
 	msg.string_array_arg[1] = use_uuid;
 	switch_core_session_receive_message(session, &msg);
 
-	switch_event_create(&event, SWITCH_EVENT_CHANNEL_UUID);
-	switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Old-Unique-ID", session->uuid_str);
-	switch_core_hash_delete(session_manager.session_table, session->uuid_str);
-	switch_set_string(session->uuid_str, use_uuid);
-	switch_core_hash_insert(session_manager.session_table, session->uuid_str, session);
-	switch_mutex_unlock(runtime.session_hash_mutex);
+	old_part = session_partition(session->uuid_str);
+	new_part = session_partition(use_uuid);
+
+	/* take both partitions in table order so two renames can never deadlock */
+	if (old_part < new_part) {
+		switch_thread_rwlock_wrlock(old_part->rwlock);
+		switch_thread_rwlock_wrlock(new_part->rwlock);
+	} else {
+		switch_thread_rwlock_wrlock(new_part->rwlock);
+		if (old_part != new_part) {
+			switch_thread_rwlock_wrlock(old_part->rwlock);
+		}
+	}
+
+	if (switch_core_hash_find(new_part->table, use_uuid)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Duplicate UUID!\n");
+		status = SWITCH_STATUS_FALSE;
+	} else {
+		switch_event_create(&event, SWITCH_EVENT_CHANNEL_UUID);
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Old-Unique-ID", session->uuid_str);
+		switch_core_hash_delete(old_part->table, session->uuid_str);
+		switch_set_string(session->uuid_str, use_uuid);
+		switch_core_hash_insert(new_part->table, session->uuid_str, session);
+	}
+
+	switch_thread_rwlock_unlock(new_part->rwlock);
+	if (old_part != new_part) {
+		switch_thread_rwlock_unlock(old_part->rwlock);
+	}
+
+	if (status != SWITCH_STATUS_SUCCESS) {
+		return status;
+	}
+
 	switch_channel_event_set_data(session->channel, event);
 	switch_event_fire(&event);
 
@@ -1473,12 +1663,13 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_request_uuid(switch_
 {
 	switch_memory_pool_t *usepool;
 	switch_core_session_t *session;
+	switch_session_partition_t *part;
 	switch_uuid_t uuid;
 	uint32_t count = 0;
 	int32_t sps = 0;
 
 
-	if (use_uuid && switch_core_hash_find(session_manager.session_table, use_uuid)) {
+	if (use_uuid && session_uuid_exists(use_uuid)) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Duplicate UUID!\n");
 		return NULL;
 	}
@@ -1570,8 +1761,12 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_request_uuid(switch_
 	switch_queue_create(&session->private_event_queue, SWITCH_EVENT_QUEUE_LEN, session->pool);
 	switch_queue_create(&session->private_event_queue_pri, SWITCH_EVENT_QUEUE_LEN, session->pool);
 
+	part = session_partition(session->uuid_str);
+	switch_thread_rwlock_wrlock(part->rwlock);
+	switch_core_hash_insert(part->table, session->uuid_str, session);
+	switch_thread_rwlock_unlock(part->rwlock);
+
 	switch_mutex_lock(runtime.session_hash_mutex);
-	switch_core_hash_insert(session_manager.session_table, session->uuid_str, session);
 	session->id = session_manager.session_id++;
 	session_manager.session_count++;
 	switch_mutex_unlock(runtime.session_hash_mutex);
@@ -1663,6 +1858,11 @@ SWITCH_DECLARE(double) switch_core_idle_cpu(void)
 	return runtime.profile_time;
 }
 
+SWITCH_DECLARE(uint32_t) switch_core_cpu_count(void)
+{
+	return runtime.cpu_count;
+}
+
 SWITCH_DECLARE(uint32_t) switch_core_sessions_per_second(uint32_t new_limit)
 {
 	if (new_limit) {
@@ -1674,16 +1874,30 @@ SWITCH_DECLARE(uint32_t) switch_core_sessions_per_second(uint32_t new_limit)
 
 void switch_core_session_init(switch_memory_pool_t *pool)
 {
+	int i;
+
 	memset(&session_manager, 0, sizeof(session_manager));
 	session_manager.session_limit = 1000;
 	session_manager.session_id = 1;
 	session_manager.memory_pool = pool;
-	switch_core_hash_init(&session_manager.session_table, session_manager.memory_pool);
+
+	for (i = 0; i < SWITCH_SESSION_TABLE_PARTITIONS; i++) {
+		switch_thread_rwlock_create(&session_manager.session_table[i].rwlock, session_manager.memory_pool);
+		switch_core_hash_init(&session_manager.session_table[i].table, session_manager.memory_pool);
+	}
+
+	session_manager.thread_pool_idle_min = 8;
+	switch_mutex_init(&session_manager.thread_pool_mutex, SWITCH_MUTEX_DEFAULT, session_manager.memory_pool);
+	switch_thread_cond_create(&session_manager.thread_pool_cond, session_manager.memory_pool);
 }
 
 void switch_core_session_uninit(void)
 {
-	switch_core_hash_destroy(&session_manager.session_table);
+	int i;
+
+	for (i = 0; i < SWITCH_SESSION_TABLE_PARTITIONS; i++) {
+		switch_core_hash_destroy(&session_manager.session_table[i].table);
+	}
 }
 
 SWITCH_DECLARE(switch_app_log_t *) switch_core_session_get_app_log(switch_core_session_t *session)
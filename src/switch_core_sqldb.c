@@ -795,22 +795,441 @@ SWITCH_DECLARE(switch_bool_t) switch_cache_db_test_reactive(switch_cache_db_hand
 
 
 
-#define SQLLEN 1024 * 1024
+/* Core db writer
+   core_event_handler turns events into typed row mutations instead of sql text.  The sql thread collects them into
+   batches, drops channel updates that a later update of the same kind on the same channel overrides, and applies
+   the batch in one transaction through statements that are prepared once per connection.  Connections that cannot
+   keep prepared statements (odbc) get the batch rendered back into sql text.
+*/
+
+typedef enum {
+	CSQL_TASK_ADD,
+	CSQL_TASK_DEL,
+	CSQL_TASK_UPDATE,
+	CSQL_CHANNEL_ADD,
+	CSQL_CHANNEL_DEL,
+	CSQL_CHANNEL_RENAME,
+	CSQL_CHANNEL_CODEC,
+	CSQL_CHANNEL_EXECUTE,
+	CSQL_CHANNEL_ROUTING,
+	CSQL_CHANNEL_STATE,
+	CSQL_CHANNEL_SECURE,
+	CSQL_CHANNEL_PURGE,
+	CSQL_CALL_ADD,
+	CSQL_CALL_DEL,
+	CSQL_CALL_RENAME_CALLER,
+	CSQL_CALL_RENAME_CALLEE,
+	CSQL_CALL_PURGE,
+	CSQL_INTERFACE_ADD,
+	CSQL_INTERFACE_DEL,
+	CSQL_INTERFACE_PURGE,
+	CSQL_NAT_ADD,
+	CSQL_NAT_DEL,
+	CSQL_MAX
+} core_sql_stmt_id_t;
+
+/* types has one letter per placeholder: s text, i integer, h this host's name (not carried in the row)
+   key is the argument holding the channel uuid for updates that may be coalesced, -1 for everything else */
+typedef struct {
+	core_sql_stmt_id_t id;
+	const char *sql;
+	const char *types;
+	int key;
+} core_sql_stmt_def_t;
+
+static const core_sql_stmt_def_t CORE_SQL_STMTS[CSQL_MAX] = {
+	{CSQL_TASK_ADD, "insert into tasks values(?,?,?,?,?)", "issih", -1},
+	{CSQL_TASK_DEL, "delete from tasks where task_id=? and hostname=?", "ih", -1},
+	{CSQL_TASK_UPDATE, "update tasks set task_desc=?,task_group=?, task_sql_manager=? where task_id=? and hostname=?", "ssiih", -1},
+	{CSQL_CHANNEL_ADD, "insert into channels (uuid,direction,created,created_epoch, name,state,dialplan,context,hostname) "
+	 "values(?,?,?,?,?,?,?,?,?)", "sssissssh", -1},
+	{CSQL_CHANNEL_DEL, "delete from channels where uuid=? and hostname=?", "sh", -1},
+	{CSQL_CHANNEL_RENAME, "update channels set uuid=? where uuid=? and hostname=?", "ssh", -1},
+	{CSQL_CHANNEL_CODEC, "update channels set read_codec=?,read_rate=?,write_codec=?,write_rate=? where uuid=? and hostname=?", "sssssh", 4},
+	{CSQL_CHANNEL_EXECUTE, "update channels set application=?,application_data=?,presence_id=?,presence_data=? where uuid=? and hostname=?",
+	 "sssssh", 4},
+	{CSQL_CHANNEL_ROUTING, "update channels set state=?,cid_name=?,cid_num=?,ip_addr=?,dest=?,dialplan=?,context=?,presence_id=?,presence_data=? "
+	 "where uuid=? and hostname=?", "ssssssssssh", 9},
+	{CSQL_CHANNEL_STATE, "update channels set state=? where uuid=? and hostname=?", "ssh", 1},
+	{CSQL_CHANNEL_SECURE, "update channels set secure=? where uuid=? and hostname=?", "ssh", 1},
+	{CSQL_CHANNEL_PURGE, "delete from channels where hostname=?", "h", -1},
+	{CSQL_CALL_ADD, "insert into calls values (?,?,?,?,?,?,?,?,?,?,?,?,?,?)", "sisssssssssssh", -1},
+	{CSQL_CALL_DEL, "delete from calls where caller_uuid=? and hostname=?", "sh", -1},
+	{CSQL_CALL_RENAME_CALLER, "update calls set caller_uuid=? where caller_uuid=? and hostname=?", "ssh", -1},
+	{CSQL_CALL_RENAME_CALLEE, "update calls set callee_uuid=? where callee_uuid=? and hostname=?", "ssh", -1},
+	{CSQL_CALL_PURGE, "delete from calls where hostname=?", "h", -1},
+	{CSQL_INTERFACE_ADD, "insert into interfaces (type,name,description,syntax,ikey,filename,hostname) values(?,?,?,?,?,?,?)", "ssssssh", -1},
+	{CSQL_INTERFACE_DEL, "delete from interfaces where type=? and name=? and hostname=?", "ssh", -1},
+	{CSQL_INTERFACE_PURGE, "delete from interfaces where hostname=?", "h", -1},
+	{CSQL_NAT_ADD, "insert into nat (port, proto, sticky, hostname) values (?,?,?,?)", "iiih", -1},
+	{CSQL_NAT_DEL, "delete from nat where port=? and proto=? and hostname=?", "iih", -1}
+};
+
+#define CORE_SQL_MAX_ARGS 16
+#define CORE_SQL_BATCH 100000
+#define CORE_SQL_COALESCE_SLOTS 131072
+
+typedef struct {
+	core_sql_stmt_id_t id;
+	uint32_t hash;
+	int argc;
+	const char *argv[CORE_SQL_MAX_ARGS];
+	char data[1];
+} core_sql_row_t;
+
+typedef struct {
+	uint32_t gen;
+	uint32_t idx;
+} core_sql_slot_t;
+
+static struct {
+	core_sql_row_t **batch;
+	uint32_t batch_len;
+	core_sql_slot_t *slots;
+	uint32_t slots_used;
+	uint32_t gen;
+	switch_core_db_stmt_t *stmts[CSQL_MAX];
+	switch_core_db_t *stmt_db;
+	uint64_t rows;
+	uint64_t coalesced;
+	uint64_t batches;
+	uint64_t lost;
+} CORE_SQL;
+
+static uint32_t core_sql_hash(core_sql_stmt_id_t id, const char *key)
+{
+	uint32_t h = 2166136261u ^ (uint32_t) id;
+
+	for (; *key; key++) {
+		h ^= (uint8_t) *key;
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+/* everything that updates a live channel row shares queue 1 so a rename stays behind the updates queued before it */
+static int core_sql_queue_index(core_sql_stmt_id_t id)
+{
+	switch (id) {
+	case CSQL_CHANNEL_RENAME:
+	case CSQL_CALL_RENAME_CALLER:
+	case CSQL_CALL_RENAME_CALLEE:
+		return 1;
+	default:
+		return CORE_SQL_STMTS[id].key > -1 ? 1 : 0;
+	}
+}
+
+static void core_sql_queue_row(core_sql_stmt_id_t id, ...)
+{
+	const core_sql_stmt_def_t *def = &CORE_SQL_STMTS[id];
+	const char *args[CORE_SQL_MAX_ARGS];
+	size_t lens[CORE_SQL_MAX_ARGS];
+	size_t total = 0;
+	core_sql_row_t *row;
+	const char *t;
+	char *p;
+	int argc = 0, i;
+	va_list ap;
+
+	if (id >= CSQL_CHANNEL_ADD && id <= CSQL_CALL_PURGE && switch_test_flag((&runtime), SCF_NO_CHANNEL_SQL)) {
+		/* the registry answers for the channels and calls tables */
+		return;
+	}
+
+	va_start(ap, id);
+	for (t = def->types; *t; t++) {
+		if (*t != 'h') {
+			args[argc] = switch_str_nil(va_arg(ap, const char *));
+			lens[argc] = strlen(args[argc]) + 1;
+			total += lens[argc];
+			argc++;
+		}
+	}
+	va_end(ap);
+
+	switch_assert(argc <= CORE_SQL_MAX_ARGS);
+
+	row = malloc(sizeof(*row) + total);
+	switch_assert(row);
+
+	row->id = id;
+	row->argc = argc;
+	p = row->data;
+
+	for (i = 0; i < argc; i++) {
+		memcpy(p, args[i], lens[i]);
+		row->argv[i] = p;
+		p += lens[i];
+	}
+
+	row->hash = def->key > -1 ? core_sql_hash(id, row->argv[def->key]) : 0;
+
+	switch_queue_push(sql_manager.sql_queue[core_sql_queue_index(id)], row);
+}
+
+/* add a row to the pending batch, retiring an earlier update of the same kind to the same channel */
+static void core_sql_batch_add(core_sql_row_t *row)
+{
+	const core_sql_stmt_def_t *def = &CORE_SQL_STMTS[row->id];
+
+	if (row->id == CSQL_CHANNEL_RENAME) {
+		/* rows already batched under the old uuid must not absorb anything queued after the rename */
+		CORE_SQL.gen++;
+		CORE_SQL.slots_used = 0;
+	} else if (def->key > -1 && CORE_SQL.slots_used < CORE_SQL_COALESCE_SLOTS / 2) {
+		uint32_t slot = row->hash & (CORE_SQL_COALESCE_SLOTS - 1);
+
+		for (;;) {
+			core_sql_slot_t *s = &CORE_SQL.slots[slot];
+
+			if (s->gen != CORE_SQL.gen) {
+				s->gen = CORE_SQL.gen;
+				s->idx = CORE_SQL.batch_len;
+				CORE_SQL.slots_used++;
+				break;
+			} else {
+				core_sql_row_t *old = CORE_SQL.batch[s->idx];
+
+				if (old && old->id == row->id && old->hash == row->hash && !strcmp(old->argv[def->key], row->argv[def->key])) {
+					free(old);
+					CORE_SQL.batch[s->idx] = NULL;
+					s->idx = CORE_SQL.batch_len;
+					CORE_SQL.coalesced++;
+					break;
+				}
+			}
+
+			slot = (slot + 1) & (CORE_SQL_COALESCE_SLOTS - 1);
+		}
+	}
+
+	CORE_SQL.batch[CORE_SQL.batch_len++] = row;
+	CORE_SQL.rows++;
+}
+
+static void core_sql_batch_reset(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < CORE_SQL.batch_len; i++) {
+		switch_safe_free(CORE_SQL.batch[i]);
+	}
+
+	CORE_SQL.batch_len = 0;
+	CORE_SQL.slots_used = 0;
+	CORE_SQL.gen++;
+}
+
+static int64_t core_sql_int(const char *val)
+{
+	const char *p = val;
+
+	if (*p == '-') {
+		p++;
+	}
+
+	if (!*p || !switch_is_number(p)) {
+		return 0;
+	}
+
+	return (int64_t) strtoll(val, NULL, 10);
+}
+
+static void core_sql_finalize_stmts(void)
+{
+	int i;
+
+	for (i = 0; i < CSQL_MAX; i++) {
+		if (CORE_SQL.stmts[i]) {
+			switch_core_db_finalize(CORE_SQL.stmts[i]);
+			CORE_SQL.stmts[i] = NULL;
+		}
+	}
+
+	CORE_SQL.stmt_db = NULL;
+}
+
+static switch_core_db_stmt_t *core_sql_get_stmt(switch_core_db_t *db, core_sql_stmt_id_t id)
+{
+	if (CORE_SQL.stmt_db != db) {
+		core_sql_finalize_stmts();
+		CORE_SQL.stmt_db = db;
+	}
+
+	if (!CORE_SQL.stmts[id]) {
+		if (switch_core_db_prepare(db, CORE_SQL_STMTS[id].sql, -1, &CORE_SQL.stmts[id], NULL) != SWITCH_CORE_DB_OK) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "SQL ERR [%s]\n%s\n", switch_core_db_errmsg(db), CORE_SQL_STMTS[id].sql);
+			CORE_SQL.stmts[id] = NULL;
+		}
+	}
+
+	return CORE_SQL.stmts[id];
+}
+
+static switch_status_t core_sql_apply_row(switch_core_db_t *db, core_sql_row_t *row, const char *hostname)
+{
+	switch_core_db_stmt_t *stmt;
+	const char *t;
+	int i = 0, col = 1, r, sanity = 100;
+
+	if (!(stmt = core_sql_get_stmt(db, row->id))) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	for (t = CORE_SQL_STMTS[row->id].types; *t; t++, col++) {
+		switch (*t) {
+		case 'h':
+			switch_core_db_bind_text(stmt, col, hostname, -1, SWITCH_CORE_DB_STATIC);
+			break;
+		case 'i':
+			switch_core_db_bind_int64(stmt, col, core_sql_int(row->argv[i++]));
+			break;
+		default:
+			switch_core_db_bind_text(stmt, col, row->argv[i++], -1, SWITCH_CORE_DB_STATIC);
+			break;
+		}
+	}
+
+	while ((r = switch_core_db_step(stmt)) == SWITCH_CORE_DB_BUSY && --sanity > 0) {
+		switch_yield(1000);
+	}
+
+	switch_core_db_reset(stmt);
+
+	if (r != SWITCH_CORE_DB_DONE && r != SWITCH_CORE_DB_ROW) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "SQL ERR [%s]\n%s\n", switch_core_db_errmsg(db), CORE_SQL_STMTS[row->id].sql);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* render a row back into sql text for connections without prepared statement support */
+static char *core_sql_render_row(core_sql_row_t *row, const char *hostname)
+{
+	switch_stream_handle_t stream = { 0 };
+	const char *s, *t = CORE_SQL_STMTS[row->id].types;
+	int i = 0;
+
+	SWITCH_STANDARD_STREAM(stream);
+
+	for (s = CORE_SQL_STMTS[row->id].sql; *s; s++) {
+		if (*s != '?') {
+			stream.write_function(&stream, "%c", *s);
+			continue;
+		}
+
+		switch (*t++) {
+		case 'h':
+			{
+				char *q = switch_mprintf("'%q'", hostname);
+				stream.write_function(&stream, "%s", q);
+				switch_core_db_free(q);
+			}
+			break;
+		case 'i':
+			stream.write_function(&stream, "%" SWITCH_INT64_T_FMT, core_sql_int(row->argv[i++]));
+			break;
+		default:
+			{
+				char *q = switch_mprintf("'%q'", row->argv[i++]);
+				stream.write_function(&stream, "%s", q);
+				switch_core_db_free(q);
+			}
+			break;
+		}
+	}
+
+	return (char *) stream.data;
+}
+
+static void core_sql_flush(switch_cache_db_handle_t *dbh)
+{
+	const char *hostname = switch_str_nil(switch_core_get_variable("hostname"));
+	uint32_t i;
+
+	if (!CORE_SQL.batch_len) {
+		return;
+	}
+
+	CORE_SQL.batches++;
+
+	if (dbh->type == SCDB_TYPE_CORE_DB) {
+		switch_core_db_t *db = dbh->native_handle.core_db_dbh;
+		char *errmsg = NULL;
+		int begin_retries = 100;
+
+		if (dbh->io_mutex) {
+			switch_mutex_lock(dbh->io_mutex);
+		}
+
+		while (begin_retries-- > 0) {
+			switch_core_db_exec(db, "BEGIN", NULL, NULL, &errmsg);
+
+			if (!errmsg) {
+				break;
+			}
+
+			if (strstr(errmsg, "cannot start a transaction within a transaction")) {
+				switch_core_db_exec(db, "COMMIT", NULL, NULL, NULL);
+			} else {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "SQL Retry [%s]\n", errmsg);
+				switch_yield(100000);
+			}
+
+			switch_core_db_free(errmsg);
+			errmsg = NULL;
+		}
+
+		for (i = 0; i < CORE_SQL.batch_len; i++) {
+			if (CORE_SQL.batch[i] && core_sql_apply_row(db, CORE_SQL.batch[i], hostname) != SWITCH_STATUS_SUCCESS) {
+				CORE_SQL.lost++;
+			}
+		}
+
+		switch_core_db_exec(db, "COMMIT", NULL, NULL, NULL);
+
+		if (dbh->io_mutex) {
+			switch_mutex_unlock(dbh->io_mutex);
+		}
+	} else {
+		switch_stream_handle_t stream = { 0 };
+
+		SWITCH_STANDARD_STREAM(stream);
+
+		for (i = 0; i < CORE_SQL.batch_len; i++) {
+			if (CORE_SQL.batch[i]) {
+				char *sql = core_sql_render_row(CORE_SQL.batch[i], hostname);
+				stream.write_function(&stream, "%s;\n", sql);
+				free(sql);
+			}
+		}
+
+		if (switch_cache_db_persistant_execute_trans(dbh, (char *) stream.data, 1) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "SQL thread unable to commit transaction, records lost!\n");
+			CORE_SQL.lost += CORE_SQL.batch_len;
+		}
+
+		free(stream.data);
+	}
+
+	core_sql_batch_reset();
+}
+
 static void *SWITCH_THREAD_FUNC switch_core_sql_thread(switch_thread_t *thread, void *obj)
 {
 	void *pop;
-	uint32_t itterations = 0;
-	uint8_t trans = 0, nothing_in_queue = 0;
-	uint32_t target = 100000;
-	switch_size_t len = 0, sql_len = SQLLEN;
-	char *tmp, *sqlbuf = (char *) malloc(sql_len);
-	char *sql;
-	switch_size_t newlen;
+	uint8_t nothing_in_queue = 0;
 	int lc = 0;
 	uint32_t loops = 0, sec = 0;
 	uint32_t l1 = 1000;
 
-	switch_assert(sqlbuf);
+	CORE_SQL.batch = calloc(CORE_SQL_BATCH, sizeof(*CORE_SQL.batch));
+	CORE_SQL.slots = calloc(CORE_SQL_COALESCE_SLOTS, sizeof(*CORE_SQL.slots));
+	CORE_SQL.gen = 1;
+	switch_assert(CORE_SQL.batch && CORE_SQL.slots);
 
 	if (!sql_manager.manage) {
 		l1 = 10;
@@ -838,32 +1257,8 @@ static void *SWITCH_THREAD_FUNC switch_core_sql_thread(switch_thread_t *thread,
 
 		if (switch_queue_trypop(sql_manager.sql_queue[0], &pop) == SWITCH_STATUS_SUCCESS ||
 			switch_queue_trypop(sql_manager.sql_queue[1], &pop) == SWITCH_STATUS_SUCCESS) {
-			sql = (char *) pop;
-
-			if (sql) {
-				newlen = strlen(sql) + 2;
-
-				if (itterations == 0) {
-					trans = 1;
-				}
-
-				/* ignore abnormally large strings sql strings as potential buffer overflow */
-				if (newlen < SQLLEN) {
-					itterations++;
-					if (len + newlen > sql_len) {
-						sql_len = len + SQLLEN;
-						if (!(tmp = realloc(sqlbuf, sql_len))) {
-							switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "SQL thread ending on mem err\n");
-							abort();
-							break;
-						}
-						sqlbuf = tmp;
-					}
-					sprintf(sqlbuf + len, "%s;\n", sql);
-					len += newlen;
-
-				}
-				switch_core_db_free(sql);
+			if (pop) {
+				core_sql_batch_add((core_sql_row_t *) pop);
 			} else {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "SQL thread ending\n");
 				break;
@@ -873,15 +1268,15 @@ static void *SWITCH_THREAD_FUNC switch_core_sql_thread(switch_thread_t *thread,
 		}
 
 
-		if (trans && ((itterations == target) || (nothing_in_queue && ++lc >= 500))) {
-			if (switch_cache_db_persistant_execute_trans(sql_manager.event_db, sqlbuf, 1) != SWITCH_STATUS_SUCCESS) {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "SQL thread unable to commit transaction, records lost!\n");
+		if (CORE_SQL.batch_len && ((CORE_SQL.batch_len == CORE_SQL_BATCH) || (nothing_in_queue && ++lc >= 500))) {
+			if (sql_manager.event_db) {
+				core_sql_flush(sql_manager.event_db);
+			} else {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "SQL thread has no db handle, records lost!\n");
+				CORE_SQL.lost += CORE_SQL.batch_len;
+				core_sql_batch_reset();
 			}
-			itterations = 0;
-			trans = 0;
 			nothing_in_queue = 0;
-			len = 0;
-			*sqlbuf = '\0';
 			lc = 0;
 		}
 
@@ -898,7 +1293,10 @@ static void *SWITCH_THREAD_FUNC switch_core_sql_thread(switch_thread_t *thread,
 		free(pop);
 	}
 
-	free(sqlbuf);
+	core_sql_batch_reset();
+	core_sql_finalize_stmts();
+	switch_safe_free(CORE_SQL.batch);
+	switch_safe_free(CORE_SQL.slots);
 
 	sql_manager.thread_running = 0;
 
@@ -909,8 +1307,6 @@ static void *SWITCH_THREAD_FUNC switch_core_sql_thread(switch_thread_t *thread,
 
 static void core_event_handler(switch_event_t *event)
 {
-	char *sql = NULL;
-
 	switch_assert(event);
 
 	switch (event->event_id) {
@@ -920,18 +1316,15 @@ static void core_event_handler(switch_event_t *event)
 			const char *manager = switch_event_get_header(event, "task-sql_manager");
 
 			if (id) {
-				sql = switch_mprintf("insert into tasks values(%q,'%q','%q',%q, '%q')",
-									 id,
-									 switch_event_get_header_nil(event, "task-desc"),
-									 switch_event_get_header_nil(event, "task-group"), manager ? manager : "0", switch_core_get_variable("hostname")
-					);
+				core_sql_queue_row(CSQL_TASK_ADD, id,
+								   switch_event_get_header_nil(event, "task-desc"),
+								   switch_event_get_header_nil(event, "task-group"), manager ? manager : "0");
 			}
 		}
 		break;
 	case SWITCH_EVENT_DEL_SCHEDULE:
 	case SWITCH_EVENT_EXE_SCHEDULE:
-		sql = switch_mprintf("delete from tasks where task_id=%q and hostname='%q'",
-							 switch_event_get_header_nil(event, "task-id"), switch_core_get_variable("hostname"));
+		core_sql_queue_row(CSQL_TASK_DEL, switch_event_get_header_nil(event, "task-id"));
 		break;
 	case SWITCH_EVENT_RE_SCHEDULE:
 		{
@@ -939,66 +1332,53 @@ static void core_event_handler(switch_event_t *event)
 			const char *manager = switch_event_get_header(event, "task-sql_manager");
 
 			if (id) {
-				sql = switch_mprintf("update tasks set task_desc='%q',task_group='%q', task_sql_manager=%q where task_id=%q and hostname='%q'",
-									 switch_event_get_header_nil(event, "task-desc"),
-									 switch_event_get_header_nil(event, "task-group"), manager ? manager : "0", id, switch_core_get_variable("hostname"));
+				core_sql_queue_row(CSQL_TASK_UPDATE,
+								   switch_event_get_header_nil(event, "task-desc"),
+								   switch_event_get_header_nil(event, "task-group"), manager ? manager : "0", id);
 			}
 		}
 		break;
 	case SWITCH_EVENT_CHANNEL_DESTROY:
-		sql = switch_mprintf("delete from channels where uuid='%q' and hostname='%q'",
-							 switch_event_get_header_nil(event, "unique-id"), switch_core_get_variable("hostname"));
+		core_sql_queue_row(CSQL_CHANNEL_DEL, switch_event_get_header_nil(event, "unique-id"));
 		break;
 	case SWITCH_EVENT_CHANNEL_UUID:
 		{
-			sql = switch_mprintf("update channels set uuid='%q' where uuid='%q' and hostname='%q';"
-								 "update calls set caller_uuid='%q' where caller_uuid='%q' and hostname='%q';"
-								 "update calls set callee_uuid='%q' where callee_uuid='%q' and hostname='%q'",
-								 switch_event_get_header_nil(event, "unique-id"),
-								 switch_event_get_header_nil(event, "old-unique-id"),
-								 switch_core_get_variable("hostname"),
-								 switch_event_get_header_nil(event, "unique-id"),
-								 switch_event_get_header_nil(event, "old-unique-id"),
-								 switch_core_get_variable("hostname"),
-								 switch_event_get_header_nil(event, "unique-id"),
-								 switch_event_get_header_nil(event, "old-unique-id"), switch_core_get_variable("hostname")
-				);
+			const char *uuid = switch_event_get_header_nil(event, "unique-id");
+			const char *old_uuid = switch_event_get_header_nil(event, "old-unique-id");
+
+			core_sql_queue_row(CSQL_CHANNEL_RENAME, uuid, old_uuid);
+			core_sql_queue_row(CSQL_CALL_RENAME_CALLER, uuid, old_uuid);
+			core_sql_queue_row(CSQL_CALL_RENAME_CALLEE, uuid, old_uuid);
 			break;
 		}
 	case SWITCH_EVENT_CHANNEL_CREATE:
-		sql = switch_mprintf("insert into channels (uuid,direction,created,created_epoch, name,state,dialplan,context,hostname) "
-							 "values('%q','%q','%q','%ld','%q','%q','%q','%q','%q')",
-							 switch_event_get_header_nil(event, "unique-id"),
-							 switch_event_get_header_nil(event, "call-direction"),
-							 switch_event_get_header_nil(event, "event-date-local"),
-							 (long) switch_epoch_time_now(NULL),
-							 switch_event_get_header_nil(event, "channel-name"),
-							 switch_event_get_header_nil(event, "channel-state"),
-							 switch_event_get_header_nil(event, "caller-dialplan"),
-							 switch_event_get_header_nil(event, "caller-context"), switch_core_get_variable("hostname")
-			);
+		{
+			char epoch[32];
+
+			switch_snprintf(epoch, sizeof(epoch), "%ld", (long) switch_epoch_time_now(NULL));
+			core_sql_queue_row(CSQL_CHANNEL_ADD,
+							   switch_event_get_header_nil(event, "unique-id"),
+							   switch_event_get_header_nil(event, "call-direction"),
+							   switch_event_get_header_nil(event, "event-date-local"),
+							   epoch,
+							   switch_event_get_header_nil(event, "channel-name"),
+							   switch_event_get_header_nil(event, "channel-state"),
+							   switch_event_get_header_nil(event, "caller-dialplan"), switch_event_get_header_nil(event, "caller-context"));
+		}
 		break;
 	case SWITCH_EVENT_CODEC:
-		sql =
-			switch_mprintf
-			("update channels set read_codec='%q',read_rate='%q',write_codec='%q',write_rate='%q' where uuid='%q' and hostname='%q'",
-			 switch_event_get_header_nil(event, "channel-read-codec-name"),
-			 switch_event_get_header_nil(event, "channel-read-codec-rate"),
-			 switch_event_get_header_nil(event, "channel-write-codec-name"),
-			 switch_event_get_header_nil(event, "channel-write-codec-rate"),
-			 switch_event_get_header_nil(event, "unique-id"), switch_core_get_variable("hostname"));
+		core_sql_queue_row(CSQL_CHANNEL_CODEC,
+						   switch_event_get_header_nil(event, "channel-read-codec-name"),
+						   switch_event_get_header_nil(event, "channel-read-codec-rate"),
+						   switch_event_get_header_nil(event, "channel-write-codec-name"),
+						   switch_event_get_header_nil(event, "channel-write-codec-rate"), switch_event_get_header_nil(event, "unique-id"));
 		break;
 	case SWITCH_EVENT_CHANNEL_EXECUTE:
-		sql = switch_mprintf("update channels set application='%q',application_data='%q',"
-							 "presence_id='%q',presence_data='%q' where uuid='%q' and hostname='%q'",
-							 switch_event_get_header_nil(event, "application"),
-							 switch_event_get_header_nil(event, "application-data"),
-							 switch_event_get_header_nil(event, "channel-presence-id"),
-							 switch_event_get_header_nil(event, "channel-presence-data"),
-							 switch_event_get_header_nil(event, "unique-id"), switch_core_get_variable("hostname")
-
-			);
-
+		core_sql_queue_row(CSQL_CHANNEL_EXECUTE,
+						   switch_event_get_header_nil(event, "application"),
+						   switch_event_get_header_nil(event, "application-data"),
+						   switch_event_get_header_nil(event, "channel-presence-id"),
+						   switch_event_get_header_nil(event, "channel-presence-data"), switch_event_get_header_nil(event, "unique-id"));
 		break;
 	case SWITCH_EVENT_CHANNEL_STATE:
 		{
@@ -1014,55 +1394,51 @@ static void core_event_handler(switch_event_t *event)
 			case CS_DESTROY:
 				break;
 			case CS_ROUTING:
-				sql = switch_mprintf("update channels set state='%s',cid_name='%q',cid_num='%q',"
-									 "ip_addr='%s',dest='%q',dialplan='%q',context='%q',presence_id='%q',presence_data='%q' "
-									 "where uuid='%s' and hostname='%q'",
-									 switch_event_get_header_nil(event, "channel-state"),
-									 switch_event_get_header_nil(event, "caller-caller-id-name"),
-									 switch_event_get_header_nil(event, "caller-caller-id-number"),
-									 switch_event_get_header_nil(event, "caller-network-addr"),
-									 switch_event_get_header_nil(event, "caller-destination-number"),
-									 switch_event_get_header_nil(event, "caller-dialplan"),
-									 switch_event_get_header_nil(event, "caller-context"),
-									 switch_event_get_header_nil(event, "channel-presence-id"),
-									 switch_event_get_header_nil(event, "channel-presence-data"),
-									 switch_event_get_header_nil(event, "unique-id"), switch_core_get_variable("hostname"));
+				core_sql_queue_row(CSQL_CHANNEL_ROUTING,
+								   switch_event_get_header_nil(event, "channel-state"),
+								   switch_event_get_header_nil(event, "caller-caller-id-name"),
+								   switch_event_get_header_nil(event, "caller-caller-id-number"),
+								   switch_event_get_header_nil(event, "caller-network-addr"),
+								   switch_event_get_header_nil(event, "caller-destination-number"),
+								   switch_event_get_header_nil(event, "caller-dialplan"),
+								   switch_event_get_header_nil(event, "caller-context"),
+								   switch_event_get_header_nil(event, "channel-presence-id"),
+								   switch_event_get_header_nil(event, "channel-presence-data"), switch_event_get_header_nil(event, "unique-id"));
 				break;
 			default:
-				sql = switch_mprintf("update channels set state='%s' where uuid='%s' and hostname='%q'",
-									 switch_event_get_header_nil(event, "channel-state"),
-									 switch_event_get_header_nil(event, "unique-id"), switch_core_get_variable("hostname"));
+				core_sql_queue_row(CSQL_CHANNEL_STATE,
+								   switch_event_get_header_nil(event, "channel-state"), switch_event_get_header_nil(event, "unique-id"));
 				break;
 			}
 			break;
 		}
 	case SWITCH_EVENT_CHANNEL_BRIDGE:
-		sql = switch_mprintf("insert into calls values ('%s', '%ld', '%s','%q','%q','%q','%q','%s','%q','%q','%q','%q','%s','%q')",
-							 switch_event_get_header_nil(event, "event-date-local"),
-							 (long) switch_epoch_time_now(NULL),
-							 switch_event_get_header_nil(event, "event-calling-function"),
-							 switch_event_get_header_nil(event, "caller-caller-id-name"),
-							 switch_event_get_header_nil(event, "caller-caller-id-number"),
-							 switch_event_get_header_nil(event, "caller-destination-number"),
-							 switch_event_get_header_nil(event, "caller-channel-name"),
-							 switch_event_get_header_nil(event, "caller-unique-id"),
-							 switch_event_get_header_nil(event, "Other-Leg-caller-id-name"),
-							 switch_event_get_header_nil(event, "Other-Leg-caller-id-number"),
-							 switch_event_get_header_nil(event, "Other-Leg-destination-number"),
-							 switch_event_get_header_nil(event, "Other-Leg-channel-name"),
-							 switch_event_get_header_nil(event, "Other-Leg-unique-id"), switch_core_get_variable("hostname")
-			);
+		{
+			char epoch[32];
+
+			switch_snprintf(epoch, sizeof(epoch), "%ld", (long) switch_epoch_time_now(NULL));
+			core_sql_queue_row(CSQL_CALL_ADD,
+							   switch_event_get_header_nil(event, "event-date-local"),
+							   epoch,
+							   switch_event_get_header_nil(event, "event-calling-function"),
+							   switch_event_get_header_nil(event, "caller-caller-id-name"),
+							   switch_event_get_header_nil(event, "caller-caller-id-number"),
+							   switch_event_get_header_nil(event, "caller-destination-number"),
+							   switch_event_get_header_nil(event, "caller-channel-name"),
+							   switch_event_get_header_nil(event, "caller-unique-id"),
+							   switch_event_get_header_nil(event, "Other-Leg-caller-id-name"),
+							   switch_event_get_header_nil(event, "Other-Leg-caller-id-number"),
+							   switch_event_get_header_nil(event, "Other-Leg-destination-number"),
+							   switch_event_get_header_nil(event, "Other-Leg-channel-name"), switch_event_get_header_nil(event, "Other-Leg-unique-id"));
+		}
 		break;
 	case SWITCH_EVENT_CHANNEL_UNBRIDGE:
-		sql = switch_mprintf("delete from calls where caller_uuid='%s' and hostname='%q'",
-							 switch_event_get_header_nil(event, "caller-unique-id"), switch_core_get_variable("hostname"));
+		core_sql_queue_row(CSQL_CALL_DEL, switch_event_get_header_nil(event, "caller-unique-id"));
 		break;
 	case SWITCH_EVENT_SHUTDOWN:
-		sql = switch_mprintf("delete from channels where hostname='%q';"
-							 "delete from interfaces where hostname='%q';"
-							 "delete from calls where hostname='%q'",
-							 switch_core_get_variable("hostname"), switch_core_get_variable("hostname"), switch_core_get_variable("hostname")
-			);
+		core_sql_queue_row(CSQL_CHANNEL_PURGE);
+		core_sql_queue_row(CSQL_INTERFACE_PURGE);
+		core_sql_queue_row(CSQL_CALL_PURGE);
 		break;
 	case SWITCH_EVENT_LOG:
 		return;
@@ -1075,12 +1451,7 @@ static void core_event_handler(switch_event_t *event)
 			const char *key = switch_event_get_header_nil(event, "key");
 			const char *filename = switch_event_get_header_nil(event, "filename");
 			if (!zstr(type) && !zstr(name)) {
-				sql =
-					switch_mprintf
-					("insert into interfaces (type,name,description,syntax,ikey,filename,hostname) values('%q','%q','%q','%q','%q','%q','%q')", type, name,
-					 switch_str_nil(description), switch_str_nil(syntax), switch_str_nil(key), switch_str_nil(filename),
-					 switch_core_get_variable("hostname")
-					);
+				core_sql_queue_row(CSQL_INTERFACE_ADD, type, name, description, syntax, key, filename);
 			}
 			break;
 		}
@@ -1089,8 +1460,7 @@ static void core_event_handler(switch_event_t *event)
 			const char *type = switch_event_get_header_nil(event, "type");
 			const char *name = switch_event_get_header_nil(event, "name");
 			if (!zstr(type) && !zstr(name)) {
-				sql = switch_mprintf("delete from interfaces where type='%q' and name='%q' and hostname='%q'", type, name,
-									 switch_core_get_variable("hostname"));
+				core_sql_queue_row(CSQL_INTERFACE_DEL, type, name);
 			}
 			break;
 		}
@@ -1101,9 +1471,7 @@ static void core_event_handler(switch_event_t *event)
 			if (zstr(type)) {
 				break;
 			}
-			sql = switch_mprintf("update channels set secure='%s' where uuid='%s' and hostname='%q'",
-								 type, switch_event_get_header_nil(event, "caller-unique-id"), switch_core_get_variable("hostname")
-				);
+			core_sql_queue_row(CSQL_CHANNEL_SECURE, type, switch_event_get_header_nil(event, "caller-unique-id"));
 			break;
 		}
 	case SWITCH_EVENT_NAT:
@@ -1111,14 +1479,10 @@ static void core_event_handler(switch_event_t *event)
 			const char *op = switch_event_get_header_nil(event, "op");
 			switch_bool_t sticky = switch_true(switch_event_get_header_nil(event, "sticky"));
 			if (!strcmp("add", op)) {
-				sql = switch_mprintf("insert into nat (port, proto, sticky, hostname) values (%s, %s, %d,'%q')",
-									 switch_event_get_header_nil(event, "port"),
-									 switch_event_get_header_nil(event, "proto"), sticky, switch_core_get_variable("hostname")
-					);
+				core_sql_queue_row(CSQL_NAT_ADD,
+								   switch_event_get_header_nil(event, "port"), switch_event_get_header_nil(event, "proto"), sticky ? "1" : "0");
 			} else if (!strcmp("del", op)) {
-				sql = switch_mprintf("delete from nat where port=%s and proto=%s and hostname='%q'",
-									 switch_event_get_header_nil(event, "port"),
-									 switch_event_get_header_nil(event, "proto"), switch_core_get_variable("hostname"));
+				core_sql_queue_row(CSQL_NAT_DEL, switch_event_get_header_nil(event, "port"), switch_event_get_header_nil(event, "proto"));
 			} else if (!strcmp("status", op)) {
 				/* call show nat api */
 			} else if (!strcmp("status_response", op)) {
@@ -1131,15 +1495,6 @@ static void core_event_handler(switch_event_t *event)
 	default:
 		break;
 	}
-
-	if (sql) {
-		if (switch_stristr("update channels", sql)) {
-			switch_queue_push(sql_manager.sql_queue[1], sql);
-		} else {
-			switch_queue_push(sql_manager.sql_queue[0], sql);
-		}
-		sql = NULL;
-	}
 }
 
 
@@ -1459,6 +1814,12 @@ SWITCH_DECLARE(void) switch_cache_db_status(switch_stream_handle_t *stream)
 		}
 	}
 	switch_mutex_unlock(sql_manager.dbh_mutex);
+
+	if (sql_manager.manage) {
+		stream->write_function(stream, "core db writer\n\tRows: %" SWITCH_UINT64_T_FMT "\n\tCoalesced: %" SWITCH_UINT64_T_FMT
+							   "\n\tBatches: %" SWITCH_UINT64_T_FMT "\n\tLost: %" SWITCH_UINT64_T_FMT "\n\tPending: %u\n",
+							   CORE_SQL.rows, CORE_SQL.coalesced, CORE_SQL.batches, CORE_SQL.lost, CORE_SQL.batch_len);
+	}
 }
 
 /* For Emacs:
@@ -265,7 +265,36 @@ void switch_core_state_machine_init(switch_memory_pool_t *pool)
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "(%s) State %s going to sleep\n", switch_channel_get_name(session->channel), __STATE_STR); \
 	} while (silly)
 
-SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
+/*
+  Park an idle pooled session instead of sleeping on its condition.  Called with session->mutex held at the point the
+  thread would wait; on SWITCH_TRUE the mutex has been released and the session may already be running elsewhere.
+*/
+static switch_bool_t core_session_go_dormant(switch_core_session_t *session)
+{
+	switch_thread_id_t self = session->thread_id;
+
+	memset(&session->thread_id, 0, sizeof(session->thread_id));
+	/* the cas is a full barrier, the state below is read after the flag is visible to wakers */
+	switch_atomic_cas(&session->dormant, 1, 0);
+
+	/* a wake that came before the flag was set found the mutex held and gave up, so look again */
+	if (switch_channel_get_state(session->channel) == switch_channel_get_running_state(session->channel) &&
+		!switch_queue_size(session->message_queue)) {
+		switch_mutex_unlock(session->mutex);
+		return SWITCH_TRUE;
+	}
+
+	if (switch_atomic_cas(&session->dormant, 0, 1) != 1) {
+		/* a waker already took it and queued it to resume */
+		switch_mutex_unlock(session->mutex);
+		return SWITCH_TRUE;
+	}
+
+	session->thread_id = self;
+	return SWITCH_FALSE;
+}
+
+static switch_bool_t core_session_run(switch_core_session_t *session, switch_bool_t can_yield)
 {
 	switch_channel_state_t state = CS_NEW, midstate = CS_DESTROY, endstate;
 	const switch_endpoint_interface_t *endpoint_interface;
@@ -299,6 +328,7 @@ SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
 	switch_assert(driver_state_handler != NULL);
 
 	switch_mutex_lock(session->mutex);
+	switch_channel_clear_flag(session->channel, CF_THREAD_SLEEPING);
 
 	while ((state = switch_channel_get_state(session->channel)) != CS_DESTROY) {
 
@@ -393,7 +423,11 @@ SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
 
 				if (switch_channel_get_state(session->channel) == switch_channel_get_running_state(session->channel)) {
 					switch_channel_set_flag(session->channel, CF_THREAD_SLEEPING);
-					if (switch_channel_get_state(session->channel) == switch_channel_get_running_state(session->channel)) {
+					if (can_yield && (endstate == CS_PARK || endstate == CS_HIBERNATE || endstate == CS_CONSUME_MEDIA)) {
+						if (core_session_go_dormant(session)) {
+							return SWITCH_TRUE;
+						}
+					} else if (switch_channel_get_state(session->channel) == switch_channel_get_running_state(session->channel)) {
 						switch_thread_cond_wait(session->cond, session->mutex);
 					}
 					switch_channel_clear_flag(session->channel, CF_THREAD_SLEEPING);
@@ -410,6 +444,18 @@ SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
 	switch_mutex_unlock(session->mutex);
 
 	session->thread_running = 0;
+
+	return SWITCH_FALSE;
+}
+
+SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
+{
+	core_session_run(session, SWITCH_FALSE);
+}
+
+switch_bool_t switch_core_session_run_yield(switch_core_session_t *session)
+{
+	return core_session_run(session, SWITCH_TRUE);
 }
 
 SWITCH_DECLARE(void) switch_core_session_destroy_state(switch_core_session_t *session)
@@ -34,6 +34,7 @@
 
 #include <switch.h>
 #include <switch_event.h>
+#include "private/switch_core_pvt.h"
 
 #define DISPATCH_QUEUE_LEN 5000
 //#define DEBUG_DISPATCH_QUEUES
@@ -90,6 +91,64 @@ static switch_queue_t *EVENT_RECYCLE_QUEUE = NULL;
 static switch_queue_t *EVENT_HEADER_RECYCLE_QUEUE = NULL;
 #endif
 static void launch_dispatch_threads(uint32_t max, int len, switch_memory_pool_t *pool);
+static void event_intern_init(void);
+
+/*! \brief A precompiled subscriber entry */
+typedef struct {
+	switch_event_node_t *node;
+	/*! the binding depends on event headers (file: and func: subclasses) and must be matched at delivery */
+	uint8_t dynamic;
+} event_sub_t;
+
+/*! \brief A precompiled list of subscribers in delivery order */
+typedef struct {
+	event_sub_t *subs;
+	uint32_t count;
+} event_sub_list_t;
+
+/*! \brief The subscriber table, rebuilt on every bind/unbind while RWLOCK is held for write */
+static struct {
+	/* subscribers for events without a subclass, indexed by event id */
+	event_sub_list_t plain[SWITCH_EVENT_ALL + 1];
+	/* every node that may match a CUSTOM event with a subclass */
+	event_sub_list_t custom;
+	uint32_t generation;
+} SUB_TABLE;
+
+#define EVENT_BUS_RING_LEN 8192
+#define EVENT_BUS_CACHE_MAX 1024
+
+typedef struct {
+	volatile uint32_t seq;
+	switch_event_t *event;
+} event_bus_cell_t;
+
+/*! \brief One shard of the event bus: a bounded lock-free MPMC ring drained by its own dispatch thread */
+typedef struct {
+	event_bus_cell_t *cells;
+	uint32_t mask;
+	volatile uint32_t head;
+	char pad1[64];
+	volatile uint32_t tail;
+	char pad2[64];
+	volatile uint32_t sleeping;
+	volatile uint32_t running;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	switch_thread_t *thread;
+	/* subclass name -> resolved event_sub_list_t, private to the dispatch thread */
+	switch_hash_t *subclass_cache;
+	uint32_t cache_generation;
+	uint32_t cache_count;
+	uint32_t id;
+} event_bus_shard_t;
+
+static struct {
+	event_bus_shard_t *shards;
+	uint32_t shard_count;
+	volatile uint32_t rr;
+	volatile uint32_t running;
+} EVENT_BUS;
 
 static char *my_dup(const char *s)
 {
@@ -337,31 +396,419 @@ static void *SWITCH_THREAD_FUNC switch_event_thread(switch_thread_t *thread, voi
 }
 
 
-SWITCH_DECLARE(void) switch_event_deliver(switch_event_t **event)
+static void sub_list_add(event_sub_list_t *list, switch_event_node_t *node, uint8_t dynamic)
+{
+	list->subs[list->count].node = node;
+	list->subs[list->count].dynamic = dynamic;
+	list->count++;
+}
+
+static uint8_t sub_node_dynamic(switch_event_node_t *node)
+{
+	return (node->subclass && (!strncasecmp(node->subclass->name, "file:", 5) || !strncasecmp(node->subclass->name, "func:", 5))) ? 1 : 0;
+}
+
+/* must be called with RWLOCK held for write */
+static void event_sub_table_rebuild(void)
 {
-	switch_event_types_t e;
 	switch_event_node_t *node;
+	uint32_t all_count = 0, count, x;
+	switch_event_types_t e;
+
+	for (node = EVENT_NODES[SWITCH_EVENT_ALL]; node; node = node->next) {
+		all_count++;
+	}
+
+	FREE(SUB_TABLE.custom.subs);
+	SUB_TABLE.custom.count = 0;
+
+	for (e = 0; e <= SWITCH_EVENT_ALL; e++) {
+		event_sub_list_t *list = &SUB_TABLE.plain[e];
+
+		FREE(list->subs);
+		list->count = 0;
+
+		count = all_count;
+		if (e != SWITCH_EVENT_ALL) {
+			for (node = EVENT_NODES[e]; node; node = node->next) {
+				count++;
+			}
+		}
+
+		if (!count) {
+			continue;
+		}
+
+		list->subs = ALLOC(sizeof(event_sub_t) * count);
+		switch_assert(list->subs);
+
+		/* same order as the node walk: nodes bound to the event itself, then nodes bound to ALL */
+		for (x = 0; x < 2; x++) {
+			if (x == 0 && e == SWITCH_EVENT_ALL) {
+				continue;
+			}
+			for (node = EVENT_NODES[x ? SWITCH_EVENT_ALL : e]; node; node = node->next) {
+				if (!node->subclass) {
+					sub_list_add(list, node, 0);
+				}
+			}
+		}
+
+		if (e == SWITCH_EVENT_CUSTOM) {
+			SUB_TABLE.custom.subs = ALLOC(sizeof(event_sub_t) * count);
+			switch_assert(SUB_TABLE.custom.subs);
+
+			for (x = 0; x < 2; x++) {
+				for (node = EVENT_NODES[x ? SWITCH_EVENT_ALL : e]; node; node = node->next) {
+					sub_list_add(&SUB_TABLE.custom, node, sub_node_dynamic(node));
+				}
+			}
+		}
+	}
+
+	SUB_TABLE.generation++;
+}
+
+/* resolve the subscribers of a CUSTOM event with the given subclass, leaving only header dependent bindings to be matched later */
+static event_sub_list_t *event_sub_list_resolve(const char *subclass_name)
+{
+	event_sub_list_t *list;
+	uint32_t x;
+
+	switch_zmalloc(list, sizeof(*list));
+
+	if (!SUB_TABLE.custom.count) {
+		return list;
+	}
+
+	list->subs = ALLOC(sizeof(event_sub_t) * SUB_TABLE.custom.count);
+	switch_assert(list->subs);
+
+	for (x = 0; x < SUB_TABLE.custom.count; x++) {
+		event_sub_t *sub = &SUB_TABLE.custom.subs[x];
+
+		if (!sub->node->subclass || sub->dynamic) {
+			sub_list_add(list, sub->node, sub->dynamic);
+		} else if (strstr(subclass_name, sub->node->subclass->name)) {
+			sub_list_add(list, sub->node, 0);
+		}
+	}
+
+	return list;
+}
+
+static void event_sub_list_free(event_sub_list_t *list)
+{
+	if (list) {
+		FREE(list->subs);
+		FREE(list);
+	}
+}
+
+static void event_bus_flush_cache(event_bus_shard_t *shard)
+{
+	switch_hash_index_t *hi;
+	void *val;
+
+	if (!shard->subclass_cache) {
+		return;
+	}
+
+	for (hi = switch_hash_first(NULL, shard->subclass_cache); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		event_sub_list_free((event_sub_list_t *) val);
+	}
+
+	switch_core_hash_destroy(&shard->subclass_cache);
+	switch_core_hash_init(&shard->subclass_cache, NULL);
+	shard->cache_count = 0;
+}
+
+static void event_deliver_list(switch_event_t *event, event_sub_list_t *list)
+{
+	uint32_t x;
+
+	for (x = 0; x < list->count; x++) {
+		event_sub_t *sub = &list->subs[x];
+
+		if (sub->dynamic && !switch_events_match(event, sub->node)) {
+			continue;
+		}
+
+		event->bind_user_data = sub->node->user_data;
+		sub->node->callback(event);
+	}
+}
+
+static void event_deliver(event_bus_shard_t *shard, switch_event_t **event)
+{
+	switch_event_t *ep = *event;
 
 	if (SYSTEM_RUNNING) {
 		switch_thread_rwlock_rdlock(RWLOCK);
-		for (e = (*event)->event_id;; e = SWITCH_EVENT_ALL) {
-			for (node = EVENT_NODES[e]; node; node = node->next) {
-				if (switch_events_match(*event, node)) {
-					(*event)->bind_user_data = node->user_data;
-					node->callback(*event);
+
+		if (!ep->subclass_name) {
+			event_deliver_list(ep, &SUB_TABLE.plain[ep->event_id]);
+		} else if (ep->event_id == SWITCH_EVENT_CUSTOM) {
+			event_sub_list_t *list;
+
+			if (shard) {
+				if (shard->cache_generation != SUB_TABLE.generation || shard->cache_count > EVENT_BUS_CACHE_MAX) {
+					event_bus_flush_cache(shard);
+					shard->cache_generation = SUB_TABLE.generation;
+				}
+
+				if (!(list = switch_core_hash_find(shard->subclass_cache, ep->subclass_name))) {
+					list = event_sub_list_resolve(ep->subclass_name);
+					switch_core_hash_insert(shard->subclass_cache, ep->subclass_name, list);
+					shard->cache_count++;
+				}
+
+				event_deliver_list(ep, list);
+			} else {
+				uint32_t x;
+
+				for (x = 0; x < SUB_TABLE.custom.count; x++) {
+					switch_event_node_t *node = SUB_TABLE.custom.subs[x].node;
+
+					if (switch_events_match(ep, node)) {
+						ep->bind_user_data = node->user_data;
+						node->callback(ep);
+					}
 				}
 			}
+		} else {
+			switch_event_types_t e;
+			switch_event_node_t *node;
+
+			for (e = ep->event_id;; e = SWITCH_EVENT_ALL) {
+				for (node = EVENT_NODES[e]; node; node = node->next) {
+					if (switch_events_match(ep, node)) {
+						ep->bind_user_data = node->user_data;
+						node->callback(ep);
+					}
+				}
 
-			if (e == SWITCH_EVENT_ALL) {
-				break;
+				if (e == SWITCH_EVENT_ALL) {
+					break;
+				}
 			}
 		}
+
 		switch_thread_rwlock_unlock(RWLOCK);
 	}
 
 	switch_event_destroy(event);
 }
 
+SWITCH_DECLARE(void) switch_event_deliver(switch_event_t **event)
+{
+	event_deliver(NULL, event);
+}
+
+static switch_status_t event_bus_push(event_bus_shard_t *shard, switch_event_t *event)
+{
+	event_bus_cell_t *cell;
+	uint32_t pos, seq;
+	int32_t dif;
+
+	pos = switch_atomic_read(&shard->head);
+
+	for (;;) {
+		cell = &shard->cells[pos & shard->mask];
+		seq = switch_atomic_read(&cell->seq);
+		dif = (int32_t) (seq - pos);
+
+		if (dif == 0) {
+			if (switch_atomic_cas(&shard->head, pos + 1, pos) == pos) {
+				break;
+			}
+			pos = switch_atomic_read(&shard->head);
+		} else if (dif < 0) {
+			return SWITCH_STATUS_FALSE;
+		} else {
+			pos = switch_atomic_read(&shard->head);
+		}
+	}
+
+	cell->event = event;
+	switch_atomic_set(&cell->seq, pos + 1);
+
+	if (switch_atomic_read(&shard->sleeping)) {
+		switch_mutex_lock(shard->mutex);
+		switch_thread_cond_signal(shard->cond);
+		switch_mutex_unlock(shard->mutex);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_event_t *event_bus_pop(event_bus_shard_t *shard)
+{
+	event_bus_cell_t *cell;
+	switch_event_t *event;
+	uint32_t pos, seq;
+	int32_t dif;
+
+	pos = switch_atomic_read(&shard->tail);
+
+	for (;;) {
+		cell = &shard->cells[pos & shard->mask];
+		seq = switch_atomic_read(&cell->seq);
+		dif = (int32_t) (seq - (pos + 1));
+
+		if (dif == 0) {
+			if (switch_atomic_cas(&shard->tail, pos + 1, pos) == pos) {
+				break;
+			}
+			pos = switch_atomic_read(&shard->tail);
+		} else if (dif < 0) {
+			return NULL;
+		} else {
+			pos = switch_atomic_read(&shard->tail);
+		}
+	}
+
+	event = cell->event;
+	cell->event = NULL;
+	switch_atomic_set(&cell->seq, pos + shard->mask + 1);
+
+	return event;
+}
+
+static void *SWITCH_THREAD_FUNC switch_event_bus_thread(switch_thread_t *thread, void *obj)
+{
+	event_bus_shard_t *shard = (event_bus_shard_t *) obj;
+	switch_event_t *event;
+
+	switch_mutex_lock(EVENT_QUEUE_MUTEX);
+	THREAD_COUNT++;
+	switch_mutex_unlock(EVENT_QUEUE_MUTEX);
+
+	while (switch_atomic_read(&shard->running)) {
+		if (!(event = event_bus_pop(shard))) {
+			switch_mutex_lock(shard->mutex);
+			switch_atomic_set(&shard->sleeping, 1);
+			/* a producer may have pushed before it could see us sleeping */
+			if (!(event = event_bus_pop(shard)) && switch_atomic_read(&shard->running)) {
+				switch_thread_cond_timedwait(shard->cond, shard->mutex, 100000);
+			}
+			switch_atomic_set(&shard->sleeping, 0);
+			switch_mutex_unlock(shard->mutex);
+
+			if (!event) {
+				continue;
+			}
+		}
+
+		event_deliver(shard, &event);
+	}
+
+	while ((event = event_bus_pop(shard))) {
+		switch_event_destroy(&event);
+	}
+
+	event_bus_flush_cache(shard);
+
+	switch_mutex_lock(EVENT_QUEUE_MUTEX);
+	THREAD_COUNT--;
+	switch_mutex_unlock(EVENT_QUEUE_MUTEX);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Event Bus Shard %d Ended.\n", shard->id);
+	return NULL;
+}
+
+static event_bus_shard_t *event_bus_shard(switch_event_t *event)
+{
+	const char *uuid;
+	uint32_t index;
+
+	if ((uuid = switch_event_get_header(event, "Unique-ID"))) {
+		switch_ssize_t hlen = -1;
+		/* keep every event of a call on the same shard so they are delivered in order */
+		index = (uint32_t) (switch_ci_hashfunc_default(uuid, &hlen) % EVENT_BUS.shard_count);
+	} else {
+		index = switch_atomic_inc(&EVENT_BUS.rr) % EVENT_BUS.shard_count;
+	}
+
+	return &EVENT_BUS.shards[index];
+}
+
+SWITCH_DECLARE(switch_status_t) switch_event_bus_start(uint32_t shards)
+{
+	switch_threadattr_t *thd_attr;
+	uint32_t x, y;
+
+	switch_assert(RUNTIME_POOL != NULL);
+
+	if (EVENT_BUS.running) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Event bus is already running with %u shard(s)\n", EVENT_BUS.shard_count);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!shards) {
+		shards = switch_core_cpu_count();
+	}
+
+	if (shards > MAX_DISPATCH) {
+		shards = MAX_DISPATCH;
+	}
+
+	EVENT_BUS.shards = switch_core_alloc(RUNTIME_POOL, sizeof(event_bus_shard_t) * shards);
+	EVENT_BUS.shard_count = shards;
+
+	for (x = 0; x < shards; x++) {
+		event_bus_shard_t *shard = &EVENT_BUS.shards[x];
+
+		shard->id = x;
+		shard->mask = EVENT_BUS_RING_LEN - 1;
+		shard->cells = switch_core_alloc(RUNTIME_POOL, sizeof(event_bus_cell_t) * EVENT_BUS_RING_LEN);
+		for (y = 0; y < EVENT_BUS_RING_LEN; y++) {
+			shard->cells[y].seq = y;
+		}
+		shard->running = 1;
+		shard->cache_generation = SUB_TABLE.generation;
+		switch_mutex_init(&shard->mutex, SWITCH_MUTEX_NESTED, RUNTIME_POOL);
+		switch_thread_cond_create(&shard->cond, RUNTIME_POOL);
+		switch_core_hash_init(&shard->subclass_cache, NULL);
+
+		switch_threadattr_create(&thd_attr, RUNTIME_POOL);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_threadattr_priority_increase(thd_attr);
+		switch_thread_create(&shard->thread, thd_attr, switch_event_bus_thread, shard, RUNTIME_POOL);
+	}
+
+	switch_atomic_set(&EVENT_BUS.running, 1);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Event bus started with %u shard(s)\n", shards);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void event_bus_stop(void)
+{
+	uint32_t x;
+	switch_status_t st;
+
+	if (!EVENT_BUS.running) {
+		return;
+	}
+
+	switch_atomic_set(&EVENT_BUS.running, 0);
+
+	for (x = 0; x < EVENT_BUS.shard_count; x++) {
+		event_bus_shard_t *shard = &EVENT_BUS.shards[x];
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Stopping event bus shard %d\n", x);
+		switch_atomic_set(&shard->running, 0);
+		switch_mutex_lock(shard->mutex);
+		switch_thread_cond_signal(shard->cond);
+		switch_mutex_unlock(shard->mutex);
+		switch_thread_join(&st, shard->thread);
+		switch_core_hash_destroy(&shard->subclass_cache);
+	}
+}
+
 SWITCH_DECLARE(switch_status_t) switch_event_running(void)
 {
 	return SYSTEM_RUNNING ? SWITCH_STATUS_SUCCESS : SWITCH_STATUS_FALSE;
@@ -481,6 +928,8 @@ SWITCH_DECLARE(switch_status_t) switch_event_shutdown(void)
 	SYSTEM_RUNNING = 0;
 	switch_mutex_unlock(EVENT_QUEUE_MUTEX);
 
+	event_bus_stop();
+
 	for (x = 0; x < 3; x++) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Stopping event queue %d\n", x);
 		switch_queue_trypush(EVENT_QUEUE[x], NULL);
@@ -542,6 +991,11 @@ SWITCH_DECLARE(switch_status_t) switch_event_shutdown(void)
 	switch_core_hash_destroy(&CUSTOM_HASH);
 	switch_core_memory_reclaim_events();
 
+	for (x = 0; x <= SWITCH_EVENT_ALL; x++) {
+		FREE(SUB_TABLE.plain[x].subs);
+	}
+	FREE(SUB_TABLE.custom.subs);
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -585,6 +1039,7 @@ SWITCH_DECLARE(switch_status_t) switch_event_init(switch_memory_pool_t *pool)
 	switch_mutex_init(&POOL_LOCK, SWITCH_MUTEX_NESTED, RUNTIME_POOL);
 	switch_mutex_init(&EVENT_QUEUE_MUTEX, SWITCH_MUTEX_NESTED, RUNTIME_POOL);
 	switch_core_hash_init(&CUSTOM_HASH, RUNTIME_POOL);
+	event_intern_init();
 
 	switch_mutex_lock(EVENT_QUEUE_MUTEX);
 	SYSTEM_RUNNING = -1;
@@ -673,6 +1128,326 @@ SWITCH_DECLARE(switch_status_t) switch_event_set_priority(switch_event_t *event,
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* Header arena
+   Fired events are built once and destroyed once, so their headers are carved out of a per event bump
+   allocator and released with a handful of free() calls.  Once a header is deleted the event is being
+   used as a mutable variable store; from then on new headers go back to the heap so the arena cannot
+   grow without bound.  Common header names are interned and never copied at all.
+*/
+
+#define EVENT_ARENA_BLOCK_SIZE 4096
+#define EVENT_ARENA_ALIGN(_l) (((_l) + 7) & ~((switch_size_t) 7))
+
+struct switch_event_arena_block {
+	struct switch_event_arena_block *next;
+	switch_size_t size;
+	switch_size_t used;
+};
+
+#define EVENT_ARENA_DATA(_b) ((char *) (_b) + EVENT_ARENA_ALIGN(sizeof(struct switch_event_arena_block)))
+
+static void *event_arena_alloc(switch_event_t *event, switch_size_t len)
+{
+	struct switch_event_arena_block *block = event->arena;
+	void *ptr;
+
+	len = EVENT_ARENA_ALIGN(len);
+
+	if (!block || block->size - block->used < len) {
+		switch_size_t size = len > EVENT_ARENA_BLOCK_SIZE ? len : EVENT_ARENA_BLOCK_SIZE;
+
+		block = ALLOC(EVENT_ARENA_ALIGN(sizeof(*block)) + size);
+		switch_assert(block);
+		block->size = size;
+		block->used = 0;
+		block->next = event->arena;
+		event->arena = block;
+	}
+
+	ptr = EVENT_ARENA_DATA(block) + block->used;
+	block->used += len;
+
+	return ptr;
+}
+
+static char *event_arena_strdup(switch_event_t *event, const char *str)
+{
+	switch_size_t len = strlen(str) + 1;
+	return (char *) memcpy(event_arena_alloc(event, len), str, len);
+}
+
+static char *event_arena_vsprintf(switch_event_t *event, const char *fmt, va_list ap)
+{
+	struct switch_event_arena_block *block = event->arena;
+	switch_size_t avail = block ? block->size - block->used : 0;
+	char *buf = block ? EVENT_ARENA_DATA(block) + block->used : NULL;
+	va_list cp;
+	int ret;
+
+	/* format straight into the free tail of the current block and only allocate if it did not fit */
+	va_copy(cp, ap);
+	ret = vsnprintf(buf, avail, fmt, cp);
+	va_end(cp);
+
+	if (ret < 0) {
+		return NULL;
+	}
+
+	if ((switch_size_t) ret < avail) {
+		block->used += EVENT_ARENA_ALIGN((switch_size_t) ret + 1);
+		if (block->used > block->size) {
+			block->used = block->size;
+		}
+		return buf;
+	}
+
+	buf = event_arena_alloc(event, (switch_size_t) ret + 1);
+	vsnprintf(buf, (switch_size_t) ret + 1, fmt, ap);
+
+	return buf;
+}
+
+static void event_arena_destroy(switch_event_t *event)
+{
+	struct switch_event_arena_block *block, *next;
+
+	for (block = event->arena; block; block = next) {
+		next = block->next;
+		FREE(block);
+	}
+
+	event->arena = NULL;
+}
+
+#define EVENT_INTERN_SIZE 512
+
+static const char *EVENT_INTERN[EVENT_INTERN_SIZE] = { 0 };
+static unsigned long EVENT_INTERN_HASH[EVENT_INTERN_SIZE] = { 0 };
+
+static const char *EVENT_INTERN_NAMES[] = {
+	"Event-Name",
+	"Core-UUID",
+	"FreeSWITCH-Hostname",
+	"FreeSWITCH-IPv4",
+	"FreeSWITCH-IPv6",
+	"Event-Date-Local",
+	"Event-Date-GMT",
+	"Event-Date-Timestamp",
+	"Event-Calling-File",
+	"Event-Calling-Function",
+	"Event-Calling-Line-Number",
+	"Event-Subclass",
+	"Channel-State",
+	"Channel-State-Number",
+	"Channel-Name",
+	"Unique-ID",
+	"Call-Direction",
+	"Presence-Call-Direction",
+	"Channel-Presence-ID",
+	"Channel-Presence-Data",
+	"Answer-State",
+	"Channel-Read-Codec-Name",
+	"Channel-Read-Codec-Rate",
+	"Channel-Write-Codec-Name",
+	"Channel-Write-Codec-Rate",
+	"Application",
+	"Application-Data",
+	"Application-Response",
+	"Hangup-Cause",
+	"Other-Type",
+	"priority",
+	NULL
+};
+
+/* caller profile headers are built as <prefix>-<suffix> by switch_caller_profile_event_set_data */
+static const char *EVENT_INTERN_PREFIXES[] = { "Caller", "Other-Leg", "Originator", "Originatee", NULL };
+
+static const char *EVENT_INTERN_SUFFIXES[] = {
+	"Username",
+	"Dialplan",
+	"Caller-ID-Name",
+	"Caller-ID-Number",
+	"Network-Addr",
+	"ANI",
+	"ANI-II",
+	"Destination-Number",
+	"Unique-ID",
+	"Source",
+	"Context",
+	"RDNIS",
+	"Channel-Name",
+	"Profile-Index",
+	"Profile-Created-Time",
+	"Channel-Created-Time",
+	"Channel-Answered-Time",
+	"Channel-Progress-Time",
+	"Channel-Progress-Media-Time",
+	"Channel-Hangup-Time",
+	"Channel-Transfer-Time",
+	"Screen-Bit",
+	"Privacy-Hide-Name",
+	"Privacy-Hide-Number",
+	NULL
+};
+
+static void event_intern_add(const char *name)
+{
+	switch_ssize_t hlen = -1;
+	unsigned long hash = switch_ci_hashfunc_default(name, &hlen);
+	uint32_t pos = (uint32_t) hash & (EVENT_INTERN_SIZE - 1);
+	uint32_t x;
+
+	for (x = 0; x < EVENT_INTERN_SIZE / 2; x++) {
+		if (!EVENT_INTERN[pos]) {
+			EVENT_INTERN[pos] = switch_core_strdup(RUNTIME_POOL, name);
+			EVENT_INTERN_HASH[pos] = hash;
+			return;
+		}
+		if (!strcmp(EVENT_INTERN[pos], name)) {
+			return;
+		}
+		pos = (pos + 1) & (EVENT_INTERN_SIZE - 1);
+	}
+}
+
+static void event_intern_init(void)
+{
+	char name[128];
+	int x, y;
+
+	for (x = 0; EVENT_INTERN_NAMES[x]; x++) {
+		event_intern_add(EVENT_INTERN_NAMES[x]);
+	}
+
+	for (x = 0; EVENT_INTERN_PREFIXES[x]; x++) {
+		for (y = 0; EVENT_INTERN_SUFFIXES[y]; y++) {
+			switch_snprintf(name, sizeof(name), "%s-%s", EVENT_INTERN_PREFIXES[x], EVENT_INTERN_SUFFIXES[y]);
+			event_intern_add(name);
+		}
+	}
+}
+
+static const char *event_intern_find(const char *name, unsigned long hash)
+{
+	uint32_t pos = (uint32_t) hash & (EVENT_INTERN_SIZE - 1);
+	const char *str;
+
+	while ((str = EVENT_INTERN[pos])) {
+		if (EVENT_INTERN_HASH[pos] == hash && !strcmp(str, name)) {
+			return str;
+		}
+		pos = (pos + 1) & (EVENT_INTERN_SIZE - 1);
+	}
+
+	return NULL;
+}
+
+/* Header index
+   Events with many headers (channel variables mostly) get an open addressing table with linear probing
+   that maps each header name to the first header of that name on the list.  The list itself stays the
+   authoritative storage so serialization keeps insertion order.
+   Below a couple of dozen headers walking the list is as fast as hashing into the index, hence the threshold.
+*/
+
+#define EVENT_INDEX_MIN_HEADERS 24
+#define EVENT_INDEX_MIN_SIZE 64
+
+static int32_t event_index_slot(switch_event_t *event, unsigned long hash, const char *header_name)
+{
+	uint32_t mask = event->index_size - 1;
+	uint32_t pos = (uint32_t) hash & mask;
+	switch_event_header_t *hp;
+
+	while ((hp = event->index[pos])) {
+		if (hp->hash == hash && !strcasecmp(hp->name, header_name)) {
+			return (int32_t) pos;
+		}
+		pos = (pos + 1) & mask;
+	}
+
+	return -1;
+}
+
+static void event_index_put(switch_event_t *event, switch_event_header_t *header, switch_bool_t replace)
+{
+	uint32_t mask = event->index_size - 1;
+	uint32_t pos = (uint32_t) header->hash & mask;
+	switch_event_header_t *hp;
+
+	while ((hp = event->index[pos])) {
+		if (hp->hash == header->hash && !strcasecmp(hp->name, header->name)) {
+			if (replace) {
+				event->index[pos] = header;
+			}
+			return;
+		}
+		pos = (pos + 1) & mask;
+	}
+
+	event->index[pos] = header;
+	event->index_count++;
+}
+
+/* backward shift deletion so lookups never need tombstones */
+static void event_index_remove_slot(switch_event_t *event, uint32_t pos)
+{
+	uint32_t mask = event->index_size - 1;
+	uint32_t next = pos, home;
+
+	event->index[pos] = NULL;
+	event->index_count--;
+
+	for (;;) {
+		next = (next + 1) & mask;
+
+		if (!event->index[next]) {
+			break;
+		}
+
+		home = (uint32_t) event->index[next]->hash & mask;
+
+		/* move the entry back if its home slot is not between the hole and its current slot */
+		if (((next - home) & mask) >= ((next - pos) & mask)) {
+			event->index[pos] = event->index[next];
+			event->index[next] = NULL;
+			pos = next;
+		}
+	}
+}
+
+static void event_index_build(switch_event_t *event, uint32_t size)
+{
+	switch_event_header_t *hp;
+
+	FREE(event->index);
+
+	event->index_size = size;
+	event->index_count = 0;
+	event->index = calloc(size, sizeof(switch_event_header_t *));
+	switch_assert(event->index);
+
+	for (hp = event->headers; hp; hp = hp->next) {
+		event_index_put(event, hp, SWITCH_FALSE);
+	}
+}
+
+static void event_index_add(switch_event_t *event, switch_event_header_t *header, switch_stack_t stack)
+{
+	if (!event->index) {
+		if (event->header_count >= EVENT_INDEX_MIN_HEADERS) {
+			event_index_build(event, EVENT_INDEX_MIN_SIZE);
+		}
+		return;
+	}
+
+	if ((event->index_count + 1) * 2 > event->index_size) {
+		event_index_build(event, event->index_size * 2);
+		return;
+	}
+
+	event_index_put(event, header, stack == SWITCH_STACK_TOP ? SWITCH_TRUE : SWITCH_FALSE);
+}
+
 SWITCH_DECLARE(char *) switch_event_get_header(switch_event_t *event, const char *header_name)
 {
 	switch_event_header_t *hp;
@@ -686,6 +1461,11 @@ SWITCH_DECLARE(char *) switch_event_get_header(switch_event_t *event, const char
 
 	hash = switch_ci_hashfunc_default(header_name, &hlen);
 
+	if (event->index) {
+		int32_t pos = event_index_slot(event, hash, header_name);
+		return pos < 0 ? NULL : event->index[pos]->value;
+	}
+
 	for (hp = event->headers; hp; hp = hp->next) {
 		if ((!hp->hash || hash == hp->hash) && !strcasecmp(hp->name, header_name)) {
 			return hp->value;
@@ -699,6 +1479,29 @@ SWITCH_DECLARE(char *) switch_event_get_body(switch_event_t *event)
 	return (event ? event->body : NULL);
 }
 
+static void event_header_free(switch_event_t *event, switch_event_header_t *hp)
+{
+	if (switch_test_flag(hp, EHF_ARENA)) {
+		/* reclaimed along with the arena */
+		return;
+	}
+
+	if (!switch_test_flag(hp, EHF_INTERNED)) {
+		FREE(hp->name);
+	}
+	FREE(hp->value);
+	event->heap_headers--;
+
+	memset(hp, 0, sizeof(*hp));
+#ifdef SWITCH_EVENT_RECYCLE
+	if (switch_queue_trypush(EVENT_HEADER_RECYCLE_QUEUE, hp) != SWITCH_STATUS_SUCCESS) {
+		FREE(hp);
+	}
+#else
+	FREE(hp);
+#endif
+}
+
 SWITCH_DECLARE(switch_status_t) switch_event_del_header_val(switch_event_t *event, const char *header_name, const char *val)
 {
 	switch_event_header_t *hp, *lp = NULL, *tp;
@@ -707,6 +1510,12 @@ SWITCH_DECLARE(switch_status_t) switch_event_del_header_val(switch_event_t *even
 	switch_ssize_t hlen = -1;
 	unsigned long hash = 0;
 
+	hash = switch_ci_hashfunc_default(header_name, &hlen);
+
+	if (event->index && event_index_slot(event, hash, header_name) < 0) {
+		return status;
+	}
+
 	tp = event->headers;
 	while (tp) {
 		hp = tp;
@@ -714,7 +1523,6 @@ SWITCH_DECLARE(switch_status_t) switch_event_del_header_val(switch_event_t *even
 
 		x++;
 		switch_assert(x < 1000);
-		hash = switch_ci_hashfunc_default(header_name, &hlen);
 
 		if ((!hp->hash || hash == hp->hash) && !strcasecmp(header_name, hp->name) && (zstr(val) || !strcmp(hp->value, val))) {
 			if (lp) {
@@ -725,52 +1533,81 @@ SWITCH_DECLARE(switch_status_t) switch_event_del_header_val(switch_event_t *even
 			if (hp == event->last_header || !hp->next) {
 				event->last_header = lp;
 			}
-			FREE(hp->name);
-			FREE(hp->value);
-			memset(hp, 0, sizeof(*hp));
-#ifdef SWITCH_EVENT_RECYCLE
-			if (switch_queue_trypush(EVENT_HEADER_RECYCLE_QUEUE, hp) != SWITCH_STATUS_SUCCESS) {
-				FREE(hp);
+			if (event->index) {
+				int32_t pos = event_index_slot(event, hash, header_name);
+				if (pos > -1 && event->index[pos] == hp) {
+					event_index_remove_slot(event, (uint32_t) pos);
+				}
 			}
-#else
-			FREE(hp);
-#endif
+			event->header_count--;
+			switch_set_flag(event, EF_HEAP_HEADERS);
+			event_header_free(event, hp);
 			status = SWITCH_STATUS_SUCCESS;
 		} else {
 			lp = hp;
 		}
 	}
 
+	if (event->index && status == SWITCH_STATUS_SUCCESS) {
+		/* a header of the same name may remain further down the list if only some values were removed */
+		for (hp = event->headers; hp; hp = hp->next) {
+			if (hp->hash == hash && !strcasecmp(header_name, hp->name)) {
+				event_index_put(event, hp, SWITCH_FALSE);
+				break;
+			}
+		}
+	}
+
 	return status;
 }
 
-switch_status_t switch_event_base_add_header(switch_event_t *event, switch_stack_t stack, const char *header_name, char *data)
+static switch_event_header_t *event_new_header(switch_event_t *event, const char *header_name)
 {
 	switch_event_header_t *header;
 	switch_ssize_t hlen = -1;
+	unsigned long hash;
+	const char *interned;
 
-#ifdef SWITCH_EVENT_RECYCLE
-	void *pop;
-	if (switch_queue_trypop(EVENT_HEADER_RECYCLE_QUEUE, &pop) == SWITCH_STATUS_SUCCESS) {
-		header = (switch_event_header_t *) pop;
+	if (switch_test_flag(event, EF_UNIQ_HEADERS)) {
+		switch_event_del_header(event, header_name);
+	}
+
+	hash = switch_ci_hashfunc_default(header_name, &hlen);
+	interned = event_intern_find(header_name, hash);
+
+	if (!switch_test_flag(event, EF_HEAP_HEADERS)) {
+		header = event_arena_alloc(event, sizeof(*header));
+		memset(header, 0, sizeof(*header));
+		header->flags = EHF_ARENA;
+		header->name = interned ? (char *) interned : event_arena_strdup(event, header_name);
 	} else {
+#ifdef SWITCH_EVENT_RECYCLE
+		void *pop;
+		if (switch_queue_trypop(EVENT_HEADER_RECYCLE_QUEUE, &pop) == SWITCH_STATUS_SUCCESS) {
+			header = (switch_event_header_t *) pop;
+		} else {
 #endif
-		header = ALLOC(sizeof(*header));
-		switch_assert(header);
+			header = ALLOC(sizeof(*header));
+			switch_assert(header);
 #ifdef SWITCH_EVENT_RECYCLE
-	}
+		}
 #endif
+		memset(header, 0, sizeof(*header));
+		header->name = interned ? (char *) interned : DUP(header_name);
+		event->heap_headers++;
+	}
 
-	if (switch_test_flag(event, EF_UNIQ_HEADERS)) {
-		switch_event_del_header(event, header_name);
+	if (interned) {
+		header->flags |= EHF_INTERNED;
 	}
 
-	memset(header, 0, sizeof(*header));
+	header->hash = hash;
 
-	header->name = DUP(header_name);
-	header->value = data;
-	header->hash = switch_ci_hashfunc_default(header->name, &hlen);
+	return header;
+}
 
+static switch_status_t event_link_header(switch_event_t *event, switch_stack_t stack, switch_event_header_t *header)
+{
 	if (stack == SWITCH_STACK_TOP) {
 		header->next = event->headers;
 		event->headers = header;
@@ -787,15 +1624,55 @@ switch_status_t switch_event_base_add_header(switch_event_t *event, switch_stack
 		event->last_header = header;
 	}
 
+	event->header_count++;
+	event_index_add(event, header, stack);
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* takes ownership of data, which must be allocated with malloc */
+switch_status_t switch_event_base_add_header(switch_event_t *event, switch_stack_t stack, const char *header_name, char *data)
+{
+	switch_event_header_t *header = event_new_header(event, header_name);
+
+	if (switch_test_flag(header, EHF_ARENA)) {
+		header->value = event_arena_strdup(event, data);
+		FREE(data);
+	} else {
+		header->value = data;
+	}
+
+	return event_link_header(event, stack, header);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_event_add_header(switch_event_t *event, switch_stack_t stack, const char *header_name, const char *fmt, ...)
 {
 	int ret = 0;
 	char *data;
 	va_list ap;
 
+	if (!switch_test_flag(event, EF_HEAP_HEADERS)) {
+		switch_event_header_t *header = event_new_header(event, header_name);
+
+		/* replacing a unique header can move the event to heap headers, so the value follows the header */
+		va_start(ap, fmt);
+		if (switch_test_flag(header, EHF_ARENA)) {
+			data = event_arena_vsprintf(event, fmt, ap);
+		} else {
+			data = switch_vmprintf(fmt, ap);
+		}
+		va_end(ap);
+
+		if (!data) {
+			/* an arena header struct stays in the arena unlinked */
+			event_header_free(event, header);
+			return SWITCH_STATUS_MEMERR;
+		}
+
+		header->value = data;
+		return event_link_header(event, stack, header);
+	}
+
 	va_start(ap, fmt);
 	ret = switch_vasprintf(&data, fmt, ap);
 	va_end(ap);
@@ -822,7 +1699,11 @@ SWITCH_DECLARE(switch_status_t) switch_event_set_subclass_name(switch_event_t *e
 SWITCH_DECLARE(switch_status_t) switch_event_add_header_string(switch_event_t *event, switch_stack_t stack, const char *header_name, const char *data)
 {
 	if (data) {
-		return switch_event_base_add_header(event, stack, header_name, DUP(data));
+		switch_event_header_t *header = event_new_header(event, header_name);
+
+		header->value = switch_test_flag(header, EHF_ARENA) ? event_arena_strdup(event, data) : DUP(data);
+
+		return event_link_header(event, stack, header);
 	}
 	return SWITCH_STATUS_GENERR;
 }
@@ -856,23 +1737,15 @@ SWITCH_DECLARE(void) switch_event_destroy(switch_event_t **event)
 	switch_event_header_t *hp, *this;
 
 	if (ep) {
-		for (hp = ep->headers; hp;) {
+		for (hp = ep->headers; hp && ep->heap_headers;) {
 			this = hp;
 			hp = hp->next;
-			FREE(this->name);
-			FREE(this->value);
-#ifdef SWITCH_EVENT_RECYCLE
-			if (switch_queue_trypush(EVENT_HEADER_RECYCLE_QUEUE, this) != SWITCH_STATUS_SUCCESS) {
-				FREE(this);
-			}
-#else
-			FREE(this);
-#endif
-
-
+			event_header_free(ep, this);
 		}
+		event_arena_destroy(ep);
 		FREE(ep->body);
 		FREE(ep->subclass_name);
+		FREE(ep->index);
 #ifdef SWITCH_EVENT_RECYCLE
 		if (switch_queue_trypush(EVENT_RECYCLE_QUEUE, ep) != SWITCH_STATUS_SUCCESS) {
 			FREE(ep);
@@ -1163,6 +2036,22 @@ SWITCH_DECLARE(switch_status_t) switch_event_fire_detailed(const char *file, con
 		(*event)->event_user_data = user_data;
 	}
 
+	switch_core_registry_event(*event);
+
+	if (EVENT_BUS.running) {
+		event_bus_shard_t *shard = event_bus_shard(*event);
+		int x = 0;
+
+		while (event_bus_push(shard, *event) != SWITCH_STATUS_SUCCESS) {
+			if (!x++) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Event bus shard %d is full!\n", shard->id);
+			}
+			switch_cond_next();
+		}
+
+		goto end;
+	}
+
 	for (;;) {
 		for (index = (*event)->priority; index < 3; index++) {
 			int was = (*event)->priority;
@@ -1226,6 +2115,7 @@ SWITCH_DECLARE(switch_status_t) switch_event_bind_removable(const char *id, swit
 		}
 
 		EVENT_NODES[event] = event_node;
+		event_sub_table_rebuild();
 		switch_thread_rwlock_unlock(RWLOCK);
 		switch_mutex_unlock(BLOCK);
 		/* </LOCKED> ----------------------------------------------- */
@@ -1279,6 +2169,7 @@ SWITCH_DECLARE(switch_status_t) switch_event_unbind_callback(switch_event_callba
 			}
 		}
 	}
+	event_sub_table_rebuild();
 	switch_mutex_unlock(BLOCK);
 	switch_thread_rwlock_unlock(RWLOCK);
 	/* </LOCKED> ----------------------------------------------- */
@@ -1319,6 +2210,7 @@ SWITCH_DECLARE(switch_status_t) switch_event_unbind(switch_event_node_t **node)
 		}
 		lnp = np;
 	}
+	event_sub_table_rebuild();
 	switch_mutex_unlock(BLOCK);
 	switch_thread_rwlock_unlock(RWLOCK);
 	/* </LOCKED> ----------------------------------------------- */
@@ -47,6 +47,7 @@ static const char *LEVELS[] = {
 
 struct switch_log_binding {
 	switch_log_function_t function;
+	switch_log_flush_function_t flush;
 	switch_log_level_t level;
 	int is_console;
 	struct switch_log_binding *next;
@@ -67,6 +68,23 @@ static int mods_loaded = 0;
 static int console_mods_loaded = 0;
 static switch_bool_t COLORIZE = SWITCH_FALSE;
 
+/* most lines to hand to the bindings per lock of BINDLOCK */
+#define LOG_BATCH_LEN 64
+#define LOG_DATE_SLOTS 4
+
+/*
+ * The "YYYY-MM-DD HH:MM:SS" part of the log date only changes once a second, so it is rendered by whoever logs first
+ * in a new second and published in a small ring; everyone else copies it and appends the microseconds.
+ * sec[] guards str[] like a sequence count: the writer zeroes it, fills str and sets it with full barriers, readers
+ * check it before and after copying str.
+ */
+static struct {
+	volatile uint32_t claimed;
+	volatile uint32_t slot;
+	volatile uint32_t sec[LOG_DATE_SLOTS];
+	char str[LOG_DATE_SLOTS][24];
+} LOG_DATE;
+
 #ifdef WIN32
 static HANDLE hStdout;
 static WORD wOldColorAttrs;
@@ -112,6 +130,10 @@ SWITCH_DECLARE(switch_log_node_t *) switch_log_node_dup(const switch_log_node_t
 	if (!zstr(node->data)) {
 		newnode->data = strdup(node->data);
 		switch_assert(node->data);
+
+		if (node->content >= node->data && node->content <= node->data + strlen(node->data)) {
+			newnode->content = newnode->data + (node->content - node->data);
+		}
 	}
 
 	if (!zstr(node->userdata)) {
@@ -242,6 +264,24 @@ SWITCH_DECLARE(switch_status_t) switch_log_unbind_logger(switch_log_function_t f
 	return status;
 }
 
+SWITCH_DECLARE(switch_status_t) switch_log_bind_flush(switch_log_function_t function, switch_log_flush_function_t flush)
+{
+	switch_log_binding_t *ptr = NULL;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	switch_mutex_lock(BINDLOCK);
+	for (ptr = BINDINGS; ptr; ptr = ptr->next) {
+		if (ptr->function == function) {
+			ptr->flush = flush;
+			status = SWITCH_STATUS_SUCCESS;
+			break;
+		}
+	}
+	switch_mutex_unlock(BINDLOCK);
+
+	return status;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_log_bind_logger(switch_log_function_t function, switch_log_level_t level, switch_bool_t is_console)
 {
 	switch_log_binding_t *binding = NULL, *ptr = NULL;
@@ -288,28 +328,62 @@ static void *SWITCH_THREAD_FUNC log_thread(switch_thread_t *t, void *obj)
 
 	while (THREAD_RUNNING == 1) {
 		void *pop = NULL;
-		switch_log_node_t *node = NULL;
+		switch_log_node_t *nodes[LOG_BATCH_LEN];
 		switch_log_binding_t *binding;
+		int count = 0, i, drained = 0, stop = 0;
 
 		if (switch_queue_pop(LOG_QUEUE, &pop) != SWITCH_STATUS_SUCCESS) {
 			break;
 		}
 
-		if (!pop) {
-			break;
+		/* take whatever else piled up meanwhile so a burst costs one pass over the bindings */
+		for (;;) {
+			if (!pop) {
+				stop = 1;
+				break;
+			}
+
+			nodes[count++] = (switch_log_node_t *) pop;
+
+			if (count == LOG_BATCH_LEN) {
+				/* a full batch can also be the last one, don't leave the flush to a message that may never come */
+				drained = !switch_queue_size(LOG_QUEUE);
+				break;
+			}
+
+			pop = NULL;
+			if (switch_queue_trypop(LOG_QUEUE, &pop) != SWITCH_STATUS_SUCCESS) {
+				drained = 1;
+				break;
+			}
 		}
 
-		node = (switch_log_node_t *) pop;
 		switch_mutex_lock(BINDLOCK);
-		for (binding = BINDINGS; binding; binding = binding->next) {
-			if (binding->level >= node->level) {
-				binding->function(node, node->level);
+		for (i = 0; i < count; i++) {
+			for (binding = BINDINGS; binding; binding = binding->next) {
+				if (binding->level >= nodes[i]->level) {
+					binding->function(nodes[i], nodes[i]->level);
+				}
+			}
+		}
+
+		if (drained || stop) {
+			/* nothing else is waiting, let buffering loggers write out what they collected */
+			for (binding = BINDINGS; binding; binding = binding->next) {
+				if (binding->flush) {
+					binding->flush();
+				}
 			}
 		}
 		switch_mutex_unlock(BINDLOCK);
 
-		switch_log_node_free(&node);
+		for (i = 0; i < count; i++) {
+			switch_log_node_free(&nodes[i]);
+		}
 
+		if (stop) {
+			break;
+		}
 	}
 
 	THREAD_RUNNING = 0;
@@ -327,24 +401,64 @@ SWITCH_DECLARE(void) switch_log_printf(switch_text_channel_t channel, const char
 	va_end(ap);
 }
 
+/* switch_atomic_read is a plain load, a cas that leaves the value alone also orders the str copy around it */
+static int log_date_current(uint32_t slot, uint32_t sec)
+{
+	return switch_atomic_cas(&LOG_DATE.sec[slot], sec, sec) == sec;
+}
+
+static void log_date(char *buf, switch_size_t len, switch_time_t now)
+{
+	uint32_t sec = (uint32_t) (now / 1000000), slot;
+	int usec = (int) (now % 1000000);
+	switch_time_exp_t tm;
+
+	slot = switch_atomic_read(&LOG_DATE.slot);
+
+	if (log_date_current(slot, sec)) {
+		char date[24];
+
+		memcpy(date, LOG_DATE.str[slot], sizeof(date));
+		/* the slot is only rewritten LOG_DATE_SLOTS seconds later, a changed second means we were too slow */
+		if (log_date_current(slot, sec)) {
+			switch_snprintf(buf, len, "%s.%0.6d", date, usec);
+			return;
+		}
+	}
+
+	switch_time_exp_lt(&tm, now);
+	switch_snprintf(buf, len, "%0.4d-%0.2d-%0.2d %0.2d:%0.2d:%0.2d.%0.6d",
+					tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, tm.tm_usec);
+
+	/* one thread per second gets to publish, the others just used what they computed */
+	if (sec > switch_atomic_read(&LOG_DATE.sec[slot])) {
+		uint32_t claimed = switch_atomic_read(&LOG_DATE.claimed);
+
+		if (claimed < sec && switch_atomic_cas(&LOG_DATE.claimed, sec, claimed) == claimed) {
+			slot = (slot + 1) % LOG_DATE_SLOTS;
+			switch_atomic_set(&LOG_DATE.sec[slot], 0);
+			switch_copy_string(LOG_DATE.str[slot], buf, 20);
+			switch_atomic_set(&LOG_DATE.sec[slot], sec);
+			switch_atomic_set(&LOG_DATE.slot, slot);
+		}
+	}
+}
+
 #define do_mods (LOG_QUEUE && THREAD_RUNNING)
 SWITCH_DECLARE(void) switch_log_vprintf(switch_text_channel_t channel, const char *file, const char *func, int line,
 										const char *userdata, switch_log_level_t level, const char *fmt, va_list ap)
 {
 	char *data = NULL;
-	char *new_fmt = NULL;
 	int ret = 0;
 	FILE *handle;
 	const char *filep = (file ? switch_cut_path(file) : "");
 	const char *funcp = (func ? func : "");
 	char *content = NULL;
 	switch_time_t now = switch_micro_time_now();
-	uint32_t len;
-#ifdef SWITCH_FUNC_IN_LOG
-	const char *extra_fmt = "%s [%s] %s:%d %s()%c%s";
-#else
-	const char *extra_fmt = "%s [%s] %s:%d%c%s";
-#endif
+	char header[512] = "";
+	char body[2048];
+	size_t hlen = 0;
+	va_list ap2;
 	switch_log_level_t limit_level = runtime.hard_log_level;
 
 	if (channel == SWITCH_CHANNEL_ID_SESSION && userdata) {
@@ -371,45 +485,52 @@ SWITCH_DECLARE(void) switch_log_vprintf(switch_text_channel_t channel, const cha
 	handle = switch_core_data_channel(channel);
 
 	if (channel != SWITCH_CHANNEL_ID_LOG_CLEAN) {
-		char date[80] = "";
-		//switch_size_t retsize;
-		switch_time_exp_t tm;
+		char date[32];
 
-		switch_time_exp_lt(&tm, now);
-		switch_snprintf(date, sizeof(date), "%0.4d-%0.2d-%0.2d %0.2d:%0.2d:%0.2d.%0.6d",
-						tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, tm.tm_usec);
-
-		//switch_strftime_nocheck(date, &retsize, sizeof(date), "%Y-%m-%d %T", &tm);
+		log_date(date, sizeof(date), now);
 
+		/* the header ends in the space content points at, the message goes right after it */
 #ifdef SWITCH_FUNC_IN_LOG
-		len = (uint32_t) (strlen(extra_fmt) + strlen(date) + strlen(filep) + 32 + strlen(funcp) + strlen(fmt));
+		switch_snprintf(header, sizeof(header), "%s [%s] %s:%d %s() ", date, switch_log_level2str(level), filep, line, funcp);
 #else
-		len = (uint32_t) (strlen(extra_fmt) + strlen(date) + strlen(filep) + 32 + strlen(fmt));
+		switch_snprintf(header, sizeof(header), "%s [%s] %s:%d ", date, switch_log_level2str(level), filep, line);
 #endif
-		new_fmt = malloc(len + 1);
-		switch_assert(new_fmt);
-#ifdef SWITCH_FUNC_IN_LOG
-		switch_snprintf(new_fmt, len, extra_fmt, date, switch_log_level2str(level), filep, line, funcp, 128, fmt);
+		hlen = strlen(header);
+	}
+
+	/* format the message once, on the stack when it fits, and build the whole line in a single allocation */
+#ifdef _MSC_VER
+	ap2 = ap;
 #else
-		switch_snprintf(new_fmt, len, extra_fmt, date, switch_log_level2str(level), filep, line, 128, fmt);
+	va_copy(ap2, ap);
 #endif
+	ret = vsnprintf(body, sizeof(body), fmt, ap2);
+	va_end(ap2);
+
+	if (ret >= 0 && (size_t) ret < sizeof(body)) {
+		data = malloc(hlen + ret + 1);
+		switch_assert(data);
+		memcpy(data, header, hlen);
+		memcpy(data + hlen, body, ret + 1);
+	} else {
+		char *big = NULL;
 
-		fmt = new_fmt;
-	}
-
-	ret = switch_vasprintf(&data, fmt, ap);
+		if ((ret = switch_vasprintf(&big, fmt, ap)) == -1) {
+			fprintf(stderr, "Memory Error\n");
+			goto end;
+		}
 
-	if (ret == -1) {
-		fprintf(stderr, "Memory Error\n");
-		goto end;
+		data = malloc(hlen + ret + 1);
+		switch_assert(data);
+		memcpy(data, header, hlen);
+		memcpy(data + hlen, big, ret + 1);
+		free(big);
 	}
 
 	if (channel == SWITCH_CHANNEL_ID_LOG_CLEAN) {
 		content = data;
 	} else {
-		if ((content = strchr(data, 128))) {
-			*content = ' ';
-		}
+		content = data + hlen - 1;
 	}
 
 	if (channel == SWITCH_CHANNEL_ID_EVENT) {
@@ -494,7 +615,6 @@ SWITCH_DECLARE(void) switch_log_vprintf(switch_text_channel_t channel, const cha
   end:
 
 	switch_safe_free(data);
-	switch_safe_free(new_fmt);
 
 }
 
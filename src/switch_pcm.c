@@ -41,6 +41,42 @@ SWITCH_MODULE_LOAD_FUNCTION(core_pcm_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(core_pcm_shutdown);
 SWITCH_MODULE_DEFINITION(CORE_PCM_MODULE, core_pcm_load, core_pcm_shutdown, NULL);
 
+/*
+ * G.711 lookup tables, filled from the g711.h reference routines at load time so the output is identical.
+ * u-law only depends on the top 14 bits of the magnitude and A-law on the top 13, so the encoders index by the
+ * shifted magnitude with the negative half stored after the positive one.
+ */
+#define G711_ULAW_SHIFT 2
+#define G711_ALAW_SHIFT 3
+#define G711_ULAW_NEG (0x8000 >> G711_ULAW_SHIFT)
+#define G711_ALAW_NEG (0x8000 >> G711_ALAW_SHIFT)
+
+static uint8_t ulaw_encode_table[G711_ULAW_NEG * 2 + 1];
+static uint8_t alaw_encode_table[G711_ALAW_NEG * 2 + 1];
+static int16_t ulaw_decode_table[256];
+static int16_t alaw_decode_table[256];
+
+static __inline__ uint32_t g711_index(int16_t sample, int shift, uint32_t neg)
+{
+	return sample < 0 ? neg + ((uint32_t) -sample >> shift) : (uint32_t) sample >> shift;
+}
+
+static void g711_tables_init(void)
+{
+	int32_t s;
+	int i;
+
+	for (s = -32768; s <= 32767; s++) {
+		ulaw_encode_table[g711_index((int16_t) s, G711_ULAW_SHIFT, G711_ULAW_NEG)] = linear_to_ulaw(s);
+		alaw_encode_table[g711_index((int16_t) s, G711_ALAW_SHIFT, G711_ALAW_NEG)] = linear_to_alaw(s);
+	}
+
+	for (i = 0; i < 256; i++) {
+		ulaw_decode_table[i] = ulaw_to_linear((uint8_t) i);
+		alaw_decode_table[i] = alaw_to_linear((uint8_t) i);
+	}
+}
+
 static switch_status_t switch_raw_init(switch_codec_t *codec, switch_codec_flag_t flags, const switch_codec_settings_t *codec_settings)
 {
 	int encoding, decoding;
@@ -155,7 +191,7 @@ static switch_status_t switch_g711u_encode(switch_codec_t *codec,
 	ebuf = encoded_data;
 
 	for (i = 0; i < decoded_data_len / sizeof(short); i++) {
-		ebuf[i] = linear_to_ulaw(dbuf[i]);
+		ebuf[i] = ulaw_encode_table[g711_index(dbuf[i], G711_ULAW_SHIFT, G711_ULAW_NEG)];
 	}
 
 	*encoded_data_len = i;
@@ -182,7 +218,7 @@ static switch_status_t switch_g711u_decode(switch_codec_t *codec,
 		*decoded_data_len = codec->implementation->decoded_bytes_per_packet;
 	} else {
 		for (i = 0; i < encoded_data_len; i++) {
-			dbuf[i] = ulaw_to_linear(ebuf[i]);
+			dbuf[i] = ulaw_decode_table[ebuf[i]];
 		}
 
 		*decoded_data_len = i * 2;
@@ -226,7 +262,7 @@ static switch_status_t switch_g711a_encode(switch_codec_t *codec,
 	ebuf = encoded_data;
 
 	for (i = 0; i < decoded_data_len / sizeof(short); i++) {
-		ebuf[i] = linear_to_alaw(dbuf[i]);
+		ebuf[i] = alaw_encode_table[g711_index(dbuf[i], G711_ALAW_SHIFT, G711_ALAW_NEG)];
 	}
 
 	*encoded_data_len = i;
@@ -253,7 +289,7 @@ static switch_status_t switch_g711a_decode(switch_codec_t *codec,
 		*decoded_data_len = codec->implementation->decoded_bytes_per_packet;
 	} else {
 		for (i = 0; i < encoded_data_len; i++) {
-			dbuf[i] = alaw_to_linear(ebuf[i]);
+			dbuf[i] = alaw_decode_table[ebuf[i]];
 		}
 
 		*decoded_data_len = i * 2;
@@ -273,6 +309,8 @@ static void mod_g711_load(switch_loadable_module_interface_t ** module_interface
 	switch_codec_interface_t *codec_interface;
 	int mpf = 10000, spf = 80, bpf = 160, ebpf = 80, count;
 
+	g711_tables_init();
+
 	SWITCH_ADD_CODEC(codec_interface, "G.711 ulaw");
 	for (count = 12; count > 0; count--) {
 		switch_core_codec_add_implementation(pool, codec_interface, SWITCH_CODEC_TYPE_AUDIO,	/* enumeration defining the type of the codec */
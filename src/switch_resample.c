@@ -32,6 +32,7 @@
 
 #include <switch.h>
 #include <switch_resample.h>
+#include "private/switch_core_pvt.h"
 #ifndef WIN32
 #include <switch_private.h>
 #endif
@@ -40,7 +41,6 @@
 #define NORMFACT (float)0x8000
 #define MAXSAMPLE (float)0x7FFF
 #define MAXSAMPLEC (char)0x7F
-#define QUALITY 0
 
 #ifndef MIN
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
@@ -52,6 +52,364 @@
 
 #define resample_buffer(a, b, c) a > b ? ((a / 1000) / 2) * c : ((b / 1000) / 2) * c
 
+/*
+ * Bulk PCM helpers.  The SSE2/AVX2 kernels are compiled with per-function target attributes and picked at
+ * runtime from the cpu we are running on, NEON is used when the build targets it.  Every kernel produces
+ * exactly the same samples as the scalar loop it replaces.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define PCM_SIMD_X86
+#include <immintrin.h>
+#define PCM_TARGET(_t) __attribute__((target(_t)))
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PCM_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+typedef enum {
+	PCM_SIMD_NONE,
+	PCM_SIMD_SSE2,
+	PCM_SIMD_AVX2
+} pcm_simd_t;
+
+static int pcm_simd_level = -1;
+
+static pcm_simd_t pcm_simd(void)
+{
+	if (pcm_simd_level < 0) {
+		int level = PCM_SIMD_NONE;
+#ifdef PCM_SIMD_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			level = PCM_SIMD_AVX2;
+		} else if (__builtin_cpu_supports("sse2")) {
+			level = PCM_SIMD_SSE2;
+		}
+#endif
+		pcm_simd_level = level;
+	}
+
+	return (pcm_simd_t) pcm_simd_level;
+}
+
+#ifdef PCM_SIMD_X86
+PCM_TARGET("sse2") static uint32_t pcm_merge_sse2(int16_t *data, const int16_t *other, uint32_t samples)
+{
+	uint32_t i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (data + i));
+		__m128i b = _mm_loadu_si128((const __m128i *) (other + i));
+		_mm_storeu_si128((__m128i *) (data + i), _mm_adds_epi16(a, b));
+	}
+
+	return i;
+}
+
+PCM_TARGET("avx2") static uint32_t pcm_merge_avx2(int16_t *data, const int16_t *other, uint32_t samples)
+{
+	uint32_t i;
+
+	for (i = 0; i + 16 <= samples; i += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i *) (data + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *) (other + i));
+		_mm256_storeu_si256((__m256i *) (data + i), _mm256_adds_epi16(a, b));
+	}
+
+	return i;
+}
+
+/* stereo down to mono in place, each output is left + right saturated once, the reads always stay ahead of the writes */
+PCM_TARGET("sse2") static switch_size_t pcm_mux_stereo_sse2(int16_t *data, switch_size_t samples)
+{
+	switch_size_t i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (data + i * 2));
+		__m128i b = _mm_loadu_si128((const __m128i *) (data + i * 2 + 8));
+		__m128i sa = _mm_add_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(a, 16));
+		__m128i sb = _mm_add_epi32(_mm_srai_epi32(_mm_slli_epi32(b, 16), 16), _mm_srai_epi32(b, 16));
+		_mm_storeu_si128((__m128i *) (data + i), _mm_packs_epi32(sa, sb));
+	}
+
+	return i;
+}
+
+/* the divisor is a power of two so scaling by its inverse is exact */
+PCM_TARGET("sse2") static int pcm_short_to_float_sse2(const short *s, float *f, int len)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / NORMFACT);
+	int i;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (s + i));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		_mm_storeu_ps(f + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(f + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+
+	return i;
+}
+
+PCM_TARGET("avx2") static int pcm_short_to_float_avx2(const short *s, float *f, int len)
+{
+	const __m256 scale = _mm256_set1_ps(1.0f / NORMFACT);
+	int i;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		__m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (s + i)));
+		_mm256_storeu_ps(f + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+	}
+
+	return i;
+}
+
+/* volume is applied in double precision and truncated just like the scalar cast, packs does the clamping */
+PCM_TARGET("sse2") static uint32_t pcm_volume_sse2(int16_t *data, uint32_t samples, double newrate, int div)
+{
+	const __m128d rate = _mm_set1_pd(newrate);
+	uint32_t i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (data + i));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		__m128d d0 = _mm_cvtepi32_pd(lo), d1 = _mm_cvtepi32_pd(_mm_srli_si128(lo, 8));
+		__m128d d2 = _mm_cvtepi32_pd(hi), d3 = _mm_cvtepi32_pd(_mm_srli_si128(hi, 8));
+
+		if (div) {
+			d0 = _mm_div_pd(d0, rate);
+			d1 = _mm_div_pd(d1, rate);
+			d2 = _mm_div_pd(d2, rate);
+			d3 = _mm_div_pd(d3, rate);
+		} else {
+			d0 = _mm_mul_pd(d0, rate);
+			d1 = _mm_mul_pd(d1, rate);
+			d2 = _mm_mul_pd(d2, rate);
+			d3 = _mm_mul_pd(d3, rate);
+		}
+
+		lo = _mm_unpacklo_epi64(_mm_cvttpd_epi32(d0), _mm_cvttpd_epi32(d1));
+		hi = _mm_unpacklo_epi64(_mm_cvttpd_epi32(d2), _mm_cvttpd_epi32(d3));
+		_mm_storeu_si128((__m128i *) (data + i), _mm_packs_epi32(lo, hi));
+	}
+
+	return i;
+}
+
+PCM_TARGET("avx2") static uint32_t pcm_volume_avx2(int16_t *data, uint32_t samples, double newrate, int div)
+{
+	const __m256d rate = _mm256_set1_pd(newrate);
+	uint32_t i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (data + i));
+		__m256d d0 = _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(v));
+		__m256d d1 = _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_srli_si128(v, 8)));
+
+		if (div) {
+			d0 = _mm256_div_pd(d0, rate);
+			d1 = _mm256_div_pd(d1, rate);
+		} else {
+			d0 = _mm256_mul_pd(d0, rate);
+			d1 = _mm256_mul_pd(d1, rate);
+		}
+
+		_mm_storeu_si128((__m128i *) (data + i), _mm_packs_epi32(_mm256_cvttpd_epi32(d0), _mm256_cvttpd_epi32(d1)));
+	}
+
+	return i;
+}
+
+/*
+ * Comfort noise, eight samples per pass.  Lane n runs the same 16 bit LCG as the scalar loop but starts 6 * n
+ * steps ahead and jumps 42 more steps after each pass so the lanes never overlap.  Returns the samples written
+ * and leaves the generator where the scalar loop picks up the tail.
+ */
+PCM_TARGET("sse2") static uint32_t pcm_silence_sse2(int16_t *data, uint32_t samples, int divisor, int16_t *rnd)
+{
+	uint16_t seed[8], r = (uint16_t) *rnd, jmul = 1, jadd = 0;
+	__m128i state, mul = _mm_set1_epi16((short) 31821), add = _mm_set1_epi16(13849), jm, ja;
+	__m128d div = _mm_set1_pd((double) divisor);
+	uint32_t i;
+	int x;
+
+	if (samples < 8) {
+		return 0;
+	}
+
+	for (i = 0; i < 8; i++) {
+		seed[i] = r;
+		for (x = 0; x < 6; x++) {
+			r = (uint16_t) (r * 31821U + 13849U);
+		}
+	}
+
+	for (x = 0; x < 42; x++) {
+		jadd = (uint16_t) (jadd * 31821U + 13849U);
+		jmul = (uint16_t) (jmul * 31821U);
+	}
+
+	state = _mm_loadu_si128((const __m128i *) seed);
+	jm = _mm_set1_epi16((short) jmul);
+	ja = _mm_set1_epi16((short) jadd);
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		__m128i sum = _mm_setzero_si128(), lo, hi;
+
+		for (x = 0; x < 6; x++) {
+			state = _mm_add_epi16(_mm_mullo_epi16(state, mul), add);
+			sum = _mm_add_epi16(sum, state);
+		}
+		state = _mm_add_epi16(_mm_mullo_epi16(state, jm), ja);
+
+		lo = _mm_srai_epi32(_mm_unpacklo_epi16(sum, sum), 16);
+		hi = _mm_srai_epi32(_mm_unpackhi_epi16(sum, sum), 16);
+		lo = _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(lo), div)),
+								_mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(_mm_srli_si128(lo, 8)), div)));
+		hi = _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(hi), div)),
+								_mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(_mm_srli_si128(hi, 8)), div)));
+		_mm_storeu_si128((__m128i *) (data + i), _mm_packs_epi32(lo, hi));
+	}
+
+	*rnd = (int16_t) _mm_cvtsi128_si32(state);
+
+	return i;
+}
+#endif
+
+#ifdef PCM_SIMD_NEON
+static uint32_t pcm_merge_neon(int16_t *data, const int16_t *other, uint32_t samples)
+{
+	uint32_t i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		vst1q_s16(data + i, vqaddq_s16(vld1q_s16(data + i), vld1q_s16(other + i)));
+	}
+
+	return i;
+}
+
+static switch_size_t pcm_mux_stereo_neon(int16_t *data, switch_size_t samples)
+{
+	switch_size_t i;
+
+	for (i = 0; i + 8 <= samples; i += 8) {
+		int16x8x2_t v = vld2q_s16(data + i * 2);
+		int32x4_t lo = vaddl_s16(vget_low_s16(v.val[0]), vget_low_s16(v.val[1]));
+		int32x4_t hi = vaddl_s16(vget_high_s16(v.val[0]), vget_high_s16(v.val[1]));
+		vst1q_s16(data + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+	}
+
+	return i;
+}
+
+static int pcm_short_to_float_neon(const short *s, float *f, int len)
+{
+	int i;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		int16x8_t v = vld1q_s16(s + i);
+		vst1q_f32(f + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), 1.0f / NORMFACT));
+		vst1q_f32(f + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), 1.0f / NORMFACT));
+	}
+
+	return i;
+}
+#endif
+
+/*
+ * Idle handles are parked here on destroy and handed back out to the next create with the same rates, channels and
+ * quality so calls that keep opening the same conversion do not rebuild the speex filter tables every time.
+ */
+static struct {
+	switch_mutex_t *mutex;
+	switch_audio_resampler_t *idle;
+	uint32_t idle_count;
+} RESAMPLE_POOL;
+
+void switch_resample_pool_init(switch_memory_pool_t *pool)
+{
+	memset(&RESAMPLE_POOL, 0, sizeof(RESAMPLE_POOL));
+	switch_mutex_init(&RESAMPLE_POOL.mutex, SWITCH_MUTEX_NESTED, pool);
+}
+
+static void resample_free(switch_audio_resampler_t *resampler)
+{
+	if (resampler->resampler) {
+		speex_resampler_destroy(resampler->resampler);
+	}
+	switch_safe_free(resampler->to);
+	free(resampler);
+}
+
+void switch_resample_pool_shutdown(void)
+{
+	switch_audio_resampler_t *np;
+
+	if (!RESAMPLE_POOL.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(RESAMPLE_POOL.mutex);
+	while ((np = RESAMPLE_POOL.idle)) {
+		RESAMPLE_POOL.idle = np->pool_next;
+		resample_free(np);
+	}
+	RESAMPLE_POOL.idle_count = 0;
+	switch_mutex_unlock(RESAMPLE_POOL.mutex);
+
+	RESAMPLE_POOL.mutex = NULL;
+}
+
+static switch_audio_resampler_t *resample_pool_get(uint32_t from_rate, uint32_t to_rate, int quality, uint32_t channels)
+{
+	switch_audio_resampler_t *np = NULL, *last = NULL;
+
+	if (!RESAMPLE_POOL.mutex) {
+		return NULL;
+	}
+
+	switch_mutex_lock(RESAMPLE_POOL.mutex);
+	for (np = RESAMPLE_POOL.idle; np; np = np->pool_next) {
+		if (np->from_rate == (int) from_rate && np->to_rate == (int) to_rate && np->quality == quality && np->channels == channels) {
+			if (last) {
+				last->pool_next = np->pool_next;
+			} else {
+				RESAMPLE_POOL.idle = np->pool_next;
+			}
+			RESAMPLE_POOL.idle_count--;
+			np->pool_next = NULL;
+			break;
+		}
+		last = np;
+	}
+	switch_mutex_unlock(RESAMPLE_POOL.mutex);
+
+	return np;
+}
+
+static switch_bool_t resample_pool_put(switch_audio_resampler_t *resampler)
+{
+	switch_bool_t r = SWITCH_FALSE;
+
+	if (!RESAMPLE_POOL.mutex) {
+		return r;
+	}
+
+	switch_mutex_lock(RESAMPLE_POOL.mutex);
+	if (RESAMPLE_POOL.idle_count < runtime.resample_pool_size) {
+		resampler->pool_next = RESAMPLE_POOL.idle;
+		RESAMPLE_POOL.idle = resampler;
+		RESAMPLE_POOL.idle_count++;
+		r = SWITCH_TRUE;
+	}
+	switch_mutex_unlock(RESAMPLE_POOL.mutex);
+
+	return r;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_resample_perform_create(switch_audio_resampler_t **new_resampler,
 															   uint32_t from_rate, uint32_t to_rate,
 															   uint32_t to_size,
@@ -59,33 +417,118 @@ SWITCH_DECLARE(switch_status_t) switch_resample_perform_create(switch_audio_resa
 {
 	int err = 0;
 	switch_audio_resampler_t *resampler;
-	double lto_rate, lfrom_rate;
+	uint32_t buf_size = resample_buffer(to_rate, from_rate, (uint32_t) to_size);
+
+	if (quality == SWITCH_RESAMPLE_QUALITY) {
+		quality = runtime.resample_quality;
+	}
 
-	switch_zmalloc(resampler, sizeof(*resampler));
+	if (quality != SWITCH_RESAMPLE_QUALITY_FAST) {
+		if (quality < 0) {
+			quality = 0;
+		} else if (quality > 10) {
+			quality = 10;
+		}
+	}
+
+	if (!channels) {
+		channels = 1;
+	}
+
+	if ((resampler = resample_pool_get(from_rate, to_rate, quality, channels))) {
+		if (resampler->resampler) {
+			speex_resampler_reset_mem(resampler->resampler);
+		}
+
+		if (resampler->to_size < buf_size) {
+			int16_t *to;
 
-	resampler->resampler = speex_resampler_init(channels ? channels : 1, from_rate, to_rate, quality, &err);
+			if (!(to = realloc(resampler->to, buf_size * sizeof(int16_t)))) {
+				resample_free(resampler);
+				return SWITCH_STATUS_MEMERR;
+			}
+			resampler->to = to;
+			resampler->to_size = buf_size;
+		}
+	} else {
+		switch_zmalloc(resampler, sizeof(*resampler));
+
+		if (quality == SWITCH_RESAMPLE_QUALITY_FAST && channels == 1 && from_rate * 2 == to_rate) {
+			resampler->fast = 1;
+		} else if (quality == SWITCH_RESAMPLE_QUALITY_FAST && channels == 1 && to_rate * 2 == from_rate) {
+			resampler->fast = -1;
+		} else {
+			resampler->resampler = speex_resampler_init(channels, from_rate, to_rate,
+														quality == SWITCH_RESAMPLE_QUALITY_FAST ? 0 : quality, &err);
+
+			if (!resampler->resampler) {
+				free(resampler);
+				return SWITCH_STATUS_GENERR;
+			}
+		}
 
-	if (!resampler->resampler) {
-		free(resampler);
-		return SWITCH_STATUS_GENERR;
+		resampler->from_rate = from_rate;
+		resampler->to_rate = to_rate;
+		resampler->factor = ((double) to_rate / (double) from_rate);
+		resampler->rfactor = ((double) from_rate / (double) to_rate);
+		resampler->quality = quality;
+		resampler->channels = channels;
+		resampler->to_size = buf_size;
+		resampler->to = malloc(resampler->to_size * sizeof(int16_t));
+
+		if (!resampler->to) {
+			resample_free(resampler);
+			return SWITCH_STATUS_MEMERR;
+		}
 	}
 
+	resampler->to_len = 0;
+	resampler->fast_hist[0] = resampler->fast_hist[1] = 0;
+	resampler->fast_pending = 0;
+
 	*new_resampler = resampler;
-	lto_rate = (double) resampler->to_rate;
-	lfrom_rate = (double) resampler->from_rate;
-	resampler->from_rate = from_rate;
-	resampler->to_rate = to_rate;
-	resampler->factor = (lto_rate / lfrom_rate);
-	resampler->rfactor = (lfrom_rate / lto_rate);
-	resampler->to_size = resample_buffer(to_rate, from_rate, (uint32_t) to_size);
-	resampler->to = malloc(resampler->to_size * sizeof(int16_t));
 
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/*
+ * Integer octave conversion for mono audio.  Halving runs a 1-2-1 lowpass over each output sample and keeps an odd
+ * sample over between calls, doubling interpolates half way between neighbours.
+ */
+static uint32_t resample_fast_process(switch_audio_resampler_t *resampler, int16_t *src, uint32_t srclen)
+{
+	uint32_t i, len = 0;
+	int16_t *to = resampler->to;
+
+	if (resampler->fast > 0) {
+		for (i = 0; i < srclen && len + 2 <= resampler->to_size; i++) {
+			to[len++] = (int16_t) (((int32_t) resampler->fast_hist[0] + src[i] + 1) >> 1);
+			to[len++] = src[i];
+			resampler->fast_hist[0] = src[i];
+		}
+	} else {
+		for (i = 0; i < srclen && len < resampler->to_size; i++) {
+			if (!resampler->fast_pending) {
+				resampler->fast_hist[1] = src[i];
+				resampler->fast_pending = 1;
+			} else {
+				to[len++] = (int16_t) (((int32_t) resampler->fast_hist[0] + 2 * resampler->fast_hist[1] + src[i] + 2) >> 2);
+				resampler->fast_hist[0] = src[i];
+				resampler->fast_pending = 0;
+			}
+		}
+	}
+
+	return len;
+}
 
 SWITCH_DECLARE(uint32_t) switch_resample_process(switch_audio_resampler_t *resampler, int16_t *src, uint32_t srclen)
 {
+	if (resampler->fast) {
+		resampler->to_len = resample_fast_process(resampler, src, srclen);
+		return resampler->to_len;
+	}
+
 	resampler->to_len = resampler->to_size;
 	speex_resampler_process_interleaved_int(resampler->resampler, src, &srclen, resampler->to, &resampler->to_len);
 	return resampler->to_len;
@@ -95,11 +538,9 @@ SWITCH_DECLARE(void) switch_resample_destroy(switch_audio_resampler_t **resample
 {
 
 	if (resampler && *resampler) {
-		if ((*resampler)->resampler) {
-			speex_resampler_destroy((*resampler)->resampler);
+		if (!resample_pool_put(*resampler)) {
+			resample_free(*resampler);
 		}
-		free((*resampler)->to);
-		free(*resampler);
 		*resampler = NULL;
 	}
 }
@@ -162,9 +603,24 @@ SWITCH_DECLARE(int) switch_float_to_char(float *f, char *c, int len)
 
 SWITCH_DECLARE(int) switch_short_to_float(short *s, float *f, int len)
 {
-	int i;
+	int i = 0;
+
+#ifdef PCM_SIMD_X86
+	switch (pcm_simd()) {
+	case PCM_SIMD_AVX2:
+		i = pcm_short_to_float_avx2(s, f, len);
+		break;
+	case PCM_SIMD_SSE2:
+		i = pcm_short_to_float_sse2(s, f, len);
+		break;
+	default:
+		break;
+	}
+#elif defined(PCM_SIMD_NEON)
+	i = pcm_short_to_float_neon(s, f, len);
+#endif
 
-	for (i = 0; i < len; i++) {
+	for (; i < len; i++) {
 		f[i] = (float) (s[i]) / NORMFACT;
 		/* f[i] = (float) s[i]; */
 	}
@@ -184,13 +640,20 @@ SWITCH_DECLARE(void) switch_swap_linear(int16_t *buf, int len)
 SWITCH_DECLARE(void) switch_generate_sln_silence(int16_t *data, uint32_t samples, uint32_t divisor)
 {
 	int16_t x;
-	uint32_t i;
+	uint32_t i = 0;
 	int sum_rnd = 0;
 	int16_t rnd2 = (int16_t) switch_micro_time_now() + (int16_t) (intptr_t) data;
 
 	assert(divisor);
 
-	for (i = 0; i < samples; i++, sum_rnd = 0) {
+#ifdef PCM_SIMD_X86
+	if ((int) divisor > 0 && pcm_simd() != PCM_SIMD_NONE) {
+		i = pcm_silence_sse2(data, samples, (int) divisor, &rnd2);
+		data += i;
+	}
+#endif
+
+	for (; i < samples; i++, sum_rnd = 0) {
 		for (x = 0; x < 6; x++) {
 			rnd2 = rnd2 * 31821U + 13849U;
 			sum_rnd += rnd2;
@@ -229,8 +692,8 @@ SWITCH_DECLARE(void) switch_generate_sln_silence(int16_t *data, uint32_t samples
 
 SWITCH_DECLARE(uint32_t) switch_merge_sln(int16_t *data, uint32_t samples, int16_t *other_data, uint32_t other_samples)
 {
-	int i;
-	int32_t x, z;
+	uint32_t i = 0, x;
+	int32_t z;
 
 	if (samples > other_samples) {
 		x = other_samples;
@@ -238,7 +701,22 @@ SWITCH_DECLARE(uint32_t) switch_merge_sln(int16_t *data, uint32_t samples, int16
 		x = samples;
 	}
 
-	for (i = 0; i < x; i++) {
+#ifdef PCM_SIMD_X86
+	switch (pcm_simd()) {
+	case PCM_SIMD_AVX2:
+		i = pcm_merge_avx2(data, other_data, x);
+		break;
+	case PCM_SIMD_SSE2:
+		i = pcm_merge_sse2(data, other_data, x);
+		break;
+	default:
+		break;
+	}
+#elif defined(PCM_SIMD_NEON)
+	i = pcm_merge_neon(data, other_data, x);
+#endif
+
+	for (; i < x; i++) {
 		z = data[i] + other_data[i];
 		switch_normalize_to_16bit(z);
 		data[i] = (int16_t) z;
@@ -249,24 +727,31 @@ SWITCH_DECLARE(uint32_t) switch_merge_sln(int16_t *data, uint32_t samples, int16
 
 SWITCH_DECLARE(void) switch_mux_channels(int16_t *data, switch_size_t samples, uint32_t channels)
 {
-	int16_t *buf;
-	switch_size_t len = samples * sizeof(int16_t);
-	switch_size_t i = 0;
-	uint32_t j = 0, k = 0;
+	switch_size_t i = 0, k;
+	uint32_t j;
+
+	if (channels == 2) {
+#ifdef PCM_SIMD_X86
+		if (pcm_simd() != PCM_SIMD_NONE) {
+			i = pcm_mux_stereo_sse2(data, samples);
+		}
+#elif defined(PCM_SIMD_NEON)
+		i = pcm_mux_stereo_neon(data, samples);
+#endif
+	}
 
-	switch_zmalloc(buf, len);
+	/* frame i only reads samples at or past i * channels so it is safe to write the result back in place */
+	for (k = i * channels; i < samples; i++) {
+		int16_t out = 0;
 
-	for (i = 0; i < samples; i++) {
 		for (j = 0; j < channels; j++) {
-			int32_t z = buf[i] + data[k++];
+			int32_t z = out + data[k++];
 			switch_normalize_to_16bit(z);
-			buf[i] = (int16_t) z;
+			out = (int16_t) z;
 		}
-	}
-
-	memcpy(data, buf, len);
-	free(buf);
 
+		data[i] = out;
+	}
 }
 
 SWITCH_DECLARE(void) switch_change_sln_volume(int16_t *data, uint32_t samples, int32_t vol)
@@ -291,10 +776,23 @@ SWITCH_DECLARE(void) switch_change_sln_volume(int16_t *data, uint32_t samples, i
 
 	if (newrate) {
 		int32_t tmp;
-		uint32_t x;
+		uint32_t x = 0;
 		int16_t *fp = data;
 
-		for (x = 0; x < samples; x++) {
+#ifdef PCM_SIMD_X86
+		switch (pcm_simd()) {
+		case PCM_SIMD_AVX2:
+			x = pcm_volume_avx2(fp, samples, newrate, div);
+			break;
+		case PCM_SIMD_SSE2:
+			x = pcm_volume_sse2(fp, samples, newrate, div);
+			break;
+		default:
+			break;
+		}
+#endif
+
+		for (; x < samples; x++) {
 			tmp = (int32_t) (div ? fp[x] / newrate : fp[x] * newrate);
 			switch_normalize_to_16bit(tmp);
 			fp[x] = (int16_t) tmp;
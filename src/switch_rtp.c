@@ -34,6 +34,9 @@
 //#define RTP_DEBUG_WRITE_DELTA
 #include <switch.h>
 #include <switch_stun.h>
+#ifndef WIN32
+#include <switch_private.h>
+#endif
 #undef PACKAGE_NAME
 #undef PACKAGE_STRING
 #undef PACKAGE_TARNAME
@@ -52,6 +55,12 @@
 
 #include "stfu.h"
 
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG) && defined(HAVE_EPOLL_CREATE)
+#define RTP_BATCH_IO
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#endif
+
 #define rtp_header_len 12
 #define RTP_START_PORT 16384
 #define RTP_END_PORT 32768
@@ -89,6 +98,50 @@ typedef struct {
 	char body[SWITCH_RTP_MAX_BUF_LEN];
 } rtp_msg_t;
 
+#ifdef RTP_BATCH_IO
+/* batched socket io
+   Sessions flagged SWITCH_RTP_FLAG_BATCH_IO hand their socket to one of a few engine threads.  Each engine sleeps in
+   epoll across all of its sockets, drains whatever is readable with recvmmsg into a small per session ring and, once
+   per tick, pushes everything the sessions queued for sending out with one sendmmsg per socket.
+*/
+
+#define RTP_BATCH_MAX_ENGINES 16
+#define RTP_BATCH_MAX_EVENTS 128
+#define RTP_BATCH_VLEN 32
+#define RTP_BATCH_RING 16
+#define RTP_BATCH_TXQ 4
+#define RTP_BATCH_PKT_LEN 2048
+#define RTP_BATCH_TICK_MS 10
+
+typedef struct {
+	char data[RTP_BATCH_PKT_LEN];
+	uint32_t len;
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+} rtp_batch_pkt_t;
+
+typedef struct rtp_batch_engine rtp_batch_engine_t;
+typedef struct rtp_batch_io rtp_batch_io_t;
+
+struct rtp_batch_io {
+	rtp_batch_engine_t *engine;
+	int fd;
+	/* single producer (the engine) single consumer (the session reader) */
+	rtp_batch_pkt_t rx[RTP_BATCH_RING];
+	volatile uint32_t rx_head;
+	volatile uint32_t rx_tail;
+	uint32_t rx_drops;
+	/* writers fill tx[tx_cur] under the engine tx_mutex while the engine sends the other half under send_mutex */
+	rtp_batch_pkt_t tx[2][RTP_BATCH_TXQ];
+	uint32_t tx_len[2];
+	uint8_t tx_cur;
+	uint8_t tx_send;
+	uint8_t tx_queued;
+	rtp_batch_io_t *tx_next;
+	rtp_batch_io_t *send_next;
+};
+#endif
+
 struct switch_rtp_vad_data {
 	switch_core_session_t *session;
 	switch_codec_t vad_codec;
@@ -216,6 +269,9 @@ struct switch_rtp {
 	switch_rtp_stats_t stats;
 	uint32_t hot_hits;
 	uint32_t sync_packets;
+#ifdef RTP_BATCH_IO
+	rtp_batch_io_t *batch;
+#endif
 
 #ifdef ENABLE_ZRTP
 	zrtp_session_t *zrtp_session;
@@ -235,6 +291,506 @@ static int global_init = 0;
 static int rtp_common_write(switch_rtp_t *rtp_session,
 							rtp_msg_t *send_msg, void *data, uint32_t datalen, switch_payload_t payload, uint32_t timestamp, switch_frame_flag_t *flags);
 
+#ifdef RTP_BATCH_IO
+
+struct rtp_batch_engine {
+	uint32_t id;
+	int epfd;
+	switch_thread_t *thread;
+	switch_mutex_t *mutex;
+	switch_mutex_t *tx_mutex;
+	switch_mutex_t *send_mutex;
+	rtp_batch_io_t *tx_list;
+	volatile uint32_t loops;
+	uint32_t sessions;
+	uint64_t wakeups;
+	uint64_t rx_calls;
+	uint64_t rx_packets;
+	uint64_t rx_drops;
+	uint64_t tx_calls;
+	uint64_t tx_packets;
+	uint64_t tx_drops;
+	char scratch[RTP_BATCH_PKT_LEN];
+};
+
+static struct {
+	rtp_batch_engine_t *engines[RTP_BATCH_MAX_ENGINES];
+	uint32_t engine_count;
+	uint32_t next_engine;
+	int32_t running;
+	switch_mutex_t *mutex;
+	switch_memory_pool_t *pool;
+} BATCH;
+
+static void rtp_batch_drain(rtp_batch_engine_t *engine, rtp_batch_io_t *io, struct mmsghdr *msgs, struct iovec *iov)
+{
+	uint32_t head = io->rx_head;
+	uint32_t room = RTP_BATCH_RING - (head - switch_atomic_read(&io->rx_tail));
+	uint32_t x;
+	int r;
+
+	memset(msgs, 0, sizeof(*msgs) * RTP_BATCH_VLEN);
+
+	if (!room) {
+		/* the reader is not keeping up, take the packets off the wire anyway so the socket does not back up */
+		for (x = 0; x < RTP_BATCH_VLEN; x++) {
+			iov[x].iov_base = engine->scratch;
+			iov[x].iov_len = sizeof(engine->scratch);
+			msgs[x].msg_hdr.msg_iov = &iov[x];
+			msgs[x].msg_hdr.msg_iovlen = 1;
+		}
+
+		if ((r = recvmmsg(io->fd, msgs, RTP_BATCH_VLEN, MSG_DONTWAIT, NULL)) > 0) {
+			engine->rx_calls++;
+			engine->rx_drops += r;
+			io->rx_drops += r;
+		}
+		return;
+	}
+
+	if (room > RTP_BATCH_VLEN) {
+		room = RTP_BATCH_VLEN;
+	}
+
+	for (x = 0; x < room; x++) {
+		rtp_batch_pkt_t *pkt = &io->rx[(head + x) % RTP_BATCH_RING];
+
+		iov[x].iov_base = pkt->data;
+		iov[x].iov_len = sizeof(pkt->data);
+		msgs[x].msg_hdr.msg_iov = &iov[x];
+		msgs[x].msg_hdr.msg_iovlen = 1;
+		msgs[x].msg_hdr.msg_name = &pkt->addr;
+		msgs[x].msg_hdr.msg_namelen = sizeof(pkt->addr);
+	}
+
+	if ((r = recvmmsg(io->fd, msgs, room, MSG_DONTWAIT, NULL)) <= 0) {
+		return;
+	}
+
+	engine->rx_calls++;
+	engine->rx_packets += r;
+
+	for (x = 0; x < (uint32_t) r; x++) {
+		rtp_batch_pkt_t *pkt = &io->rx[(head + x) % RTP_BATCH_RING];
+
+		/* a truncated datagram is useless to us, the reader skips empty slots */
+		pkt->len = (msgs[x].msg_hdr.msg_flags & MSG_TRUNC) ? 0 : msgs[x].msg_len;
+		pkt->addrlen = msgs[x].msg_hdr.msg_namelen;
+	}
+
+	switch_atomic_set(&io->rx_head, head + r);
+}
+
+static void rtp_batch_send_slot(rtp_batch_engine_t *engine, rtp_batch_io_t *io, uint8_t slot, struct mmsghdr *msgs, struct iovec *iov)
+{
+	uint32_t x, len = io->tx_len[slot];
+	int r;
+
+	if (!len) {
+		return;
+	}
+
+	memset(msgs, 0, sizeof(*msgs) * len);
+
+	for (x = 0; x < len; x++) {
+		rtp_batch_pkt_t *pkt = &io->tx[slot][x];
+
+		iov[x].iov_base = pkt->data;
+		iov[x].iov_len = pkt->len;
+		msgs[x].msg_hdr.msg_iov = &iov[x];
+		msgs[x].msg_hdr.msg_iovlen = 1;
+		msgs[x].msg_hdr.msg_name = &pkt->addr;
+		msgs[x].msg_hdr.msg_namelen = pkt->addrlen;
+	}
+
+	if ((r = sendmmsg(io->fd, msgs, len, MSG_DONTWAIT)) < 0) {
+		r = 0;
+	}
+
+	engine->tx_calls++;
+	engine->tx_packets += r;
+	engine->tx_drops += len - r;
+	io->tx_len[slot] = 0;
+}
+
+static void rtp_batch_flush(rtp_batch_engine_t *engine, struct mmsghdr *msgs, struct iovec *iov)
+{
+	rtp_batch_io_t *io, *list;
+
+	switch_mutex_lock(engine->send_mutex);
+
+	switch_mutex_lock(engine->tx_mutex);
+	list = engine->tx_list;
+	engine->tx_list = NULL;
+	for (io = list; io; io = io->tx_next) {
+		io->send_next = io->tx_next;
+		io->tx_send = io->tx_cur;
+		io->tx_cur = !io->tx_cur;
+		io->tx_queued = 0;
+	}
+	switch_mutex_unlock(engine->tx_mutex);
+
+	for (io = list; io; io = io->send_next) {
+		rtp_batch_send_slot(engine, io, io->tx_send, msgs, iov);
+	}
+
+	switch_mutex_unlock(engine->send_mutex);
+}
+
+static void *SWITCH_THREAD_FUNC rtp_batch_thread(switch_thread_t *thread, void *obj)
+{
+	rtp_batch_engine_t *engine = (rtp_batch_engine_t *) obj;
+	struct epoll_event events[RTP_BATCH_MAX_EVENTS];
+	struct mmsghdr msgs[RTP_BATCH_VLEN];
+	struct iovec iov[RTP_BATCH_VLEN];
+	switch_time_t now, next_tick = switch_micro_time_now();
+	int x, r, timeout;
+
+	while (BATCH.running) {
+		now = switch_micro_time_now();
+		timeout = next_tick > now ? (int) ((next_tick - now + 999) / 1000) : 0;
+
+		if ((r = epoll_wait(engine->epfd, events, RTP_BATCH_MAX_EVENTS, timeout)) < 0) {
+			if (errno != EINTR) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "RTP batch engine %u epoll error: %s\n", engine->id, strerror(errno));
+				switch_yield(RTP_BATCH_TICK_MS * 1000);
+			}
+			r = 0;
+		}
+
+		switch_mutex_lock(engine->mutex);
+
+		engine->wakeups++;
+
+		for (x = 0; x < r; x++) {
+			rtp_batch_drain(engine, (rtp_batch_io_t *) events[x].data.ptr, msgs, iov);
+		}
+
+		if ((now = switch_micro_time_now()) >= next_tick) {
+			rtp_batch_flush(engine, msgs, iov);
+			next_tick = now + RTP_BATCH_TICK_MS * 1000;
+		}
+
+		switch_atomic_inc(&engine->loops);
+		switch_mutex_unlock(engine->mutex);
+	}
+
+	return NULL;
+}
+
+static switch_bool_t rtp_batch_start(void)
+{
+	switch_threadattr_t *thd_attr;
+	uint32_t x, count;
+
+	switch_mutex_lock(BATCH.mutex);
+
+	if (BATCH.running || !BATCH.pool) {
+		goto end;
+	}
+
+	count = switch_core_cpu_count();
+
+	if (count > RTP_BATCH_MAX_ENGINES) {
+		count = RTP_BATCH_MAX_ENGINES;
+	}
+
+	BATCH.running = 1;
+
+	for (x = 0; x < count; x++) {
+		rtp_batch_engine_t *engine = switch_core_alloc(BATCH.pool, sizeof(*engine));
+
+		engine->id = x;
+
+		if ((engine->epfd = epoll_create(RTP_BATCH_MAX_EVENTS)) < 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot create epoll for RTP batch engine %u: %s\n", x, strerror(errno));
+			break;
+		}
+
+		switch_mutex_init(&engine->mutex, SWITCH_MUTEX_NESTED, BATCH.pool);
+		switch_mutex_init(&engine->tx_mutex, SWITCH_MUTEX_NESTED, BATCH.pool);
+		switch_mutex_init(&engine->send_mutex, SWITCH_MUTEX_NESTED, BATCH.pool);
+		BATCH.engines[BATCH.engine_count++] = engine;
+
+		switch_threadattr_create(&thd_attr, BATCH.pool);
+		switch_threadattr_detach_set(thd_attr, 0);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_threadattr_priority_increase(thd_attr);
+		switch_thread_create(&engine->thread, thd_attr, rtp_batch_thread, engine, BATCH.pool);
+	}
+
+	if (!BATCH.engine_count) {
+		BATCH.running = 0;
+	} else {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Started %u RTP batch io engine(s)\n", BATCH.engine_count);
+	}
+
+  end:
+
+	switch_mutex_unlock(BATCH.mutex);
+
+	return BATCH.running ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+static void rtp_batch_stop(void)
+{
+	uint32_t x;
+	switch_status_t st;
+
+	if (!BATCH.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(BATCH.mutex);
+	if (!BATCH.running) {
+		switch_mutex_unlock(BATCH.mutex);
+		return;
+	}
+	BATCH.running = 0;
+	switch_mutex_unlock(BATCH.mutex);
+
+	for (x = 0; x < BATCH.engine_count; x++) {
+		rtp_batch_engine_t *engine = BATCH.engines[x];
+
+		switch_thread_join(&st, engine->thread);
+		close(engine->epfd);
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG,
+						  "RTP batch engine %u: %" SWITCH_UINT64_T_FMT " wakeups, %" SWITCH_UINT64_T_FMT " recvmmsg for %" SWITCH_UINT64_T_FMT
+						  " packets (%" SWITCH_UINT64_T_FMT " dropped), %" SWITCH_UINT64_T_FMT " sendmmsg for %" SWITCH_UINT64_T_FMT
+						  " packets (%" SWITCH_UINT64_T_FMT " dropped)\n",
+						  engine->id, engine->wakeups, engine->rx_calls, engine->rx_packets, engine->rx_drops,
+						  engine->tx_calls, engine->tx_packets, engine->tx_drops);
+	}
+
+	BATCH.engine_count = 0;
+}
+
+/* the same counters live, syscalls per packet is (wakeups + recvmmsg + sendmmsg) / packets */
+static void rtp_batch_usage(switch_stream_handle_t *stream)
+{
+	uint32_t x;
+
+	if (!BATCH.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(BATCH.mutex);
+
+	for (x = 0; BATCH.running && x < BATCH.engine_count; x++) {
+		rtp_batch_engine_t *engine = BATCH.engines[x];
+		uint64_t calls, packets;
+
+		switch_mutex_lock(engine->mutex);
+		switch_mutex_lock(engine->send_mutex);
+
+		calls = engine->wakeups + engine->rx_calls + engine->tx_calls;
+		packets = engine->rx_packets + engine->tx_packets;
+
+		stream->write_function(stream, "rtp batch engine %u: %u session(s), %" SWITCH_UINT64_T_FMT " wakeup(s), %" SWITCH_UINT64_T_FMT
+							   " recvmmsg for %" SWITCH_UINT64_T_FMT " packet(s), %" SWITCH_UINT64_T_FMT " sendmmsg for %" SWITCH_UINT64_T_FMT
+							   " packet(s), %0.3f syscall(s)/packet\n",
+							   engine->id, engine->sessions, engine->wakeups, engine->rx_calls, engine->rx_packets, engine->tx_calls,
+							   engine->tx_packets, packets ? (double) calls / (double) packets : 0.0);
+
+		switch_mutex_unlock(engine->send_mutex);
+		switch_mutex_unlock(engine->mutex);
+	}
+
+	switch_mutex_unlock(BATCH.mutex);
+}
+
+static void rtp_batch_attach(switch_rtp_t *rtp_session)
+{
+	rtp_batch_io_t *io;
+	rtp_batch_engine_t *engine;
+	struct epoll_event e = { 0 };
+	int fd;
+
+	if ((fd = switch_socket_fd_get(rtp_session->sock_input)) < 0 || !rtp_batch_start()) {
+		return;
+	}
+
+	if (!(io = rtp_session->batch)) {
+		io = rtp_session->batch = switch_core_alloc(rtp_session->pool, sizeof(*io));
+	}
+
+	switch_mutex_lock(BATCH.mutex);
+	engine = BATCH.engines[BATCH.next_engine++ % BATCH.engine_count];
+	switch_mutex_unlock(BATCH.mutex);
+
+	switch_mutex_lock(engine->mutex);
+	switch_mutex_lock(engine->tx_mutex);
+
+	io->fd = fd;
+	io->rx_head = io->rx_tail = 0;
+	io->tx_len[0] = io->tx_len[1] = 0;
+	io->tx_queued = 0;
+
+	e.events = EPOLLIN;
+	e.data.ptr = io;
+
+	if (epoll_ctl(engine->epfd, EPOLL_CTL_ADD, fd, &e) < 0) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot add RTP socket to batch engine %u: %s\n", engine->id, strerror(errno));
+	} else {
+		io->engine = engine;
+		engine->sessions++;
+	}
+
+	switch_mutex_unlock(engine->tx_mutex);
+	switch_mutex_unlock(engine->mutex);
+}
+
+static void rtp_batch_detach(switch_rtp_t *rtp_session)
+{
+	rtp_batch_io_t *io = rtp_session->batch, **p;
+	rtp_batch_engine_t *engine;
+	uint32_t loops;
+
+	if (!io || !(engine = io->engine)) {
+		return;
+	}
+
+	switch_mutex_lock(engine->mutex);
+	switch_mutex_lock(engine->tx_mutex);
+
+	epoll_ctl(engine->epfd, EPOLL_CTL_DEL, io->fd, NULL);
+
+	for (p = &engine->tx_list; *p; p = &(*p)->tx_next) {
+		if (*p == io) {
+			*p = io->tx_next;
+			break;
+		}
+	}
+
+	io->tx_queued = 0;
+	io->engine = NULL;
+	engine->sessions--;
+	loops = switch_atomic_read(&engine->loops);
+
+	switch_mutex_unlock(engine->tx_mutex);
+	switch_mutex_unlock(engine->mutex);
+
+	/* the engine may already hold an event for this socket from before the delete, let it finish that pass */
+	while (BATCH.running && switch_atomic_read(&engine->loops) == loops) {
+		switch_cond_next();
+	}
+}
+
+static switch_status_t rtp_batch_recv(rtp_batch_io_t *io, switch_sockaddr_t *from, void *buf, switch_size_t *bytes)
+{
+	uint32_t tail = io->rx_tail;
+
+	while (switch_atomic_read(&io->rx_head) != tail) {
+		rtp_batch_pkt_t *pkt = &io->rx[tail % RTP_BATCH_RING];
+		switch_size_t len = pkt->len;
+
+		if (len) {
+			if (len > *bytes) {
+				len = *bytes;
+			}
+			memcpy(buf, pkt->data, len);
+			switch_sockaddr_raw_set(from, &pkt->addr, pkt->addrlen);
+		}
+
+		switch_atomic_set(&io->rx_tail, ++tail);
+
+		if (len) {
+			*bytes = len;
+			return SWITCH_STATUS_SUCCESS;
+		}
+	}
+
+	*bytes = 0;
+	return SWITCH_STATUS_BREAK;
+}
+
+static switch_status_t rtp_batch_send(rtp_batch_io_t *io, switch_sockaddr_t *to, const void *buf, switch_size_t len)
+{
+	rtp_batch_engine_t *engine = io->engine;
+	const void *addr;
+	uint32_t addrlen;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	if (!engine || len > RTP_BATCH_PKT_LEN) {
+		return status;
+	}
+
+	addr = switch_sockaddr_raw_get(to, &addrlen);
+
+	switch_mutex_lock(engine->tx_mutex);
+	if (io->engine == engine && io->tx_len[io->tx_cur] >= RTP_BATCH_TXQ) {
+		struct mmsghdr msgs[RTP_BATCH_TXQ];
+		struct iovec iov[RTP_BATCH_TXQ];
+
+		/* the queue is full (a 2833 burst), send it now so this packet cannot overtake it.
+		   send_mutex waits out a flush of the other half that is already on the wire. */
+		switch_mutex_unlock(engine->tx_mutex);
+		switch_mutex_lock(engine->send_mutex);
+		switch_mutex_lock(engine->tx_mutex);
+		if (io->engine == engine) {
+			rtp_batch_send_slot(engine, io, io->tx_cur, msgs, iov);
+		}
+		switch_mutex_unlock(engine->send_mutex);
+	}
+
+	if (io->engine == engine && io->tx_len[io->tx_cur] < RTP_BATCH_TXQ && addrlen <= sizeof(struct sockaddr_storage)) {
+		rtp_batch_pkt_t *pkt = &io->tx[io->tx_cur][io->tx_len[io->tx_cur]++];
+
+		memcpy(pkt->data, buf, len);
+		pkt->len = (uint32_t) len;
+		memcpy(&pkt->addr, addr, addrlen);
+		pkt->addrlen = addrlen;
+
+		if (!io->tx_queued) {
+			io->tx_next = engine->tx_list;
+			engine->tx_list = io;
+			io->tx_queued = 1;
+		}
+
+		status = SWITCH_STATUS_SUCCESS;
+	}
+	switch_mutex_unlock(engine->tx_mutex);
+
+	return status;
+}
+
+#endif
+
+static switch_status_t rtp_recvfrom(switch_rtp_t *rtp_session, void *buf, switch_size_t *bytes)
+{
+#ifdef RTP_BATCH_IO
+	if (rtp_session->batch && rtp_session->batch->engine) {
+		return rtp_batch_recv(rtp_session->batch, rtp_session->from_addr, buf, bytes);
+	}
+#endif
+	return switch_socket_recvfrom(rtp_session->from_addr, rtp_session->sock_input, 0, buf, bytes);
+}
+
+static switch_status_t rtp_sendto(switch_rtp_t *rtp_session, switch_sockaddr_t *to, void *buf, switch_size_t *bytes)
+{
+#ifdef RTP_BATCH_IO
+	/* only queue on the bound socket, a separate output socket can be swapped out from under the engine */
+	if (rtp_session->batch && rtp_session->batch->engine && rtp_session->sock_output == rtp_session->sock_input &&
+		rtp_batch_send(rtp_session->batch, to, buf, *bytes) == SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+#endif
+	return switch_socket_sendto(rtp_session->sock_output, to, 0, buf, bytes);
+}
+
+static switch_status_t rtp_poll_input(switch_rtp_t *rtp_session)
+{
+	int fdr = 0;
+
+#ifdef RTP_BATCH_IO
+	if (rtp_session->batch && rtp_session->batch->engine) {
+		return switch_atomic_read(&rtp_session->batch->rx_head) != rtp_session->batch->rx_tail ? SWITCH_STATUS_SUCCESS : SWITCH_STATUS_TIMEOUT;
+	}
+#endif
+	return switch_poll(rtp_session->read_pollfd, 1, &fdr, 0);
+}
+
 
 static switch_status_t do_stun_ping(switch_rtp_t *rtp_session)
 {
@@ -627,6 +1183,10 @@ SWITCH_DECLARE(void) switch_rtp_init(switch_memory_pool_t *pool)
 #endif
 	srtp_init();
 	switch_mutex_init(&port_lock, SWITCH_MUTEX_NESTED, pool);
+#ifdef RTP_BATCH_IO
+	BATCH.pool = pool;
+	switch_mutex_init(&BATCH.mutex, SWITCH_MUTEX_NESTED, pool);
+#endif
 	global_init = 1;
 }
 
@@ -656,6 +1216,10 @@ SWITCH_DECLARE(void) switch_rtp_shutdown(void)
 	switch_core_hash_destroy(&alloc_hash);
 	switch_mutex_unlock(port_lock);
 
+#ifdef RTP_BATCH_IO
+	rtp_batch_stop();
+#endif
+
 #ifdef ENABLE_ZRTP
 	if (zrtp_on) {
 		zrtp_status_t status = zrtp_status_ok;
@@ -715,10 +1279,13 @@ SWITCH_DECLARE(void) switch_rtp_release_port(const char *ip, switch_port_t port)
 	}
 
 	switch_mutex_lock(port_lock);
-	if ((alloc = switch_core_hash_find(alloc_hash, ip))) {
+	alloc = switch_core_hash_find(alloc_hash, ip);
+	switch_mutex_unlock(port_lock);
+
+	/* allocators live until shutdown and are safe to use without the lock */
+	if (alloc) {
 		switch_core_port_allocator_free_port(alloc, port);
 	}
-	switch_mutex_unlock(port_lock);
 
 }
 
@@ -731,20 +1298,49 @@ SWITCH_DECLARE(switch_port_t) switch_rtp_request_port(const char *ip)
 	alloc = switch_core_hash_find(alloc_hash, ip);
 	if (!alloc) {
 		if (switch_core_port_allocator_new(START_PORT, END_PORT, SPF_EVEN, &alloc) != SWITCH_STATUS_SUCCESS) {
-			abort();
+			switch_mutex_unlock(port_lock);
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Cannot create rtp port allocator for %s with range %d-%d!\n",
+							  ip, START_PORT, END_PORT);
+			return 0;
 		}
 
 		switch_core_hash_insert(alloc_hash, ip, alloc);
 	}
+	switch_mutex_unlock(port_lock);
 
 	if (switch_core_port_allocator_request_port(alloc, &port) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "No rtp ports left on %s!\n", ip);
 		port = 0;
 	}
 
-	switch_mutex_unlock(port_lock);
 	return port;
 }
 
+SWITCH_DECLARE(void) switch_rtp_port_usage(switch_stream_handle_t *stream)
+{
+	switch_core_port_allocator_t *alloc;
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+	uint32_t total, used, quarantined;
+
+	switch_mutex_lock(port_lock);
+
+	for (hi = switch_hash_first(NULL, alloc_hash); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, &var, NULL, &val);
+		if ((alloc = (switch_core_port_allocator_t *) val)) {
+			switch_core_port_allocator_get_stats(alloc, &total, &used, &quarantined);
+			stream->write_function(stream, "%u/%u rtp port(s) in use on %s, %u quarantined\n", used, total, (char *) var, quarantined);
+		}
+	}
+
+	switch_mutex_unlock(port_lock);
+
+#ifdef RTP_BATCH_IO
+	rtp_batch_usage(stream);
+#endif
+}
+
 SWITCH_DECLARE(void) switch_rtp_intentional_bugs(switch_rtp_t *rtp_session, switch_rtp_bug_flag_t bugs)
 {
 	rtp_session->rtp_bugs = bugs;
@@ -840,6 +1436,12 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_set_local_address(switch_rtp_t *rtp_s
 
 	switch_socket_create_pollset(&rtp_session->read_pollfd, rtp_session->sock_input, SWITCH_POLLIN | SWITCH_POLLERR, rtp_session->pool);
 
+#ifdef RTP_BATCH_IO
+	if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_BATCH_IO) && switch_test_flag(rtp_session, SWITCH_RTP_FLAG_USE_TIMER)) {
+		rtp_batch_attach(rtp_session);
+	}
+#endif
+
 	status = SWITCH_STATUS_SUCCESS;
 	*err = "Success";
 	switch_set_flag_locked(rtp_session, SWITCH_RTP_FLAG_IO);
@@ -1434,6 +2036,9 @@ SWITCH_DECLARE(void) switch_rtp_kill_socket(switch_rtp_t *rtp_session)
 {
 	switch_assert(rtp_session != NULL);
 	switch_mutex_lock(rtp_session->flag_mutex);
+#ifdef RTP_BATCH_IO
+	rtp_batch_detach(rtp_session);
+#endif
 	if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_IO)) {
 		switch_clear_flag(rtp_session, SWITCH_RTP_FLAG_IO);
 		if (rtp_session->sock_input) {
@@ -1759,7 +2364,7 @@ static void do_flush(switch_rtp_t *rtp_session)
 		do {
 			if (switch_rtp_ready(rtp_session)) {
 				bytes = sizeof(rtp_msg_t);
-				status = switch_socket_recvfrom(rtp_session->from_addr, rtp_session->sock_input, 0, (void *) &rtp_session->recv_msg, &bytes);
+				status = rtp_recvfrom(rtp_session, (void *) &rtp_session->recv_msg, &bytes);
 				if (bytes) {
 					rtp_session->stats.inbound.raw_bytes += bytes;
 					rtp_session->stats.inbound.flush_packet_count++;
@@ -1789,7 +2394,7 @@ static switch_status_t read_rtp_packet(switch_rtp_t *rtp_session, switch_size_t
 	switch_assert(bytes);
 
 	*bytes = sizeof(rtp_msg_t);
-	status = switch_socket_recvfrom(rtp_session->from_addr, rtp_session->sock_input, 0, (void *) &rtp_session->recv_msg, bytes);
+	status = rtp_recvfrom(rtp_session, (void *) &rtp_session->recv_msg, bytes);
 
 	if (*bytes) {
 		rtp_session->stats.inbound.raw_bytes += *bytes;
@@ -1876,7 +2481,7 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 		if (rtp_session->timer.interval) {
 			if ((switch_test_flag(rtp_session, SWITCH_RTP_FLAG_AUTOFLUSH) || switch_test_flag(rtp_session, SWITCH_RTP_FLAG_STICKY_FLUSH)) &&
 				rtp_session->read_pollfd) {
-				if (switch_poll(rtp_session->read_pollfd, 1, &fdr, 0) == SWITCH_STATUS_SUCCESS) {
+				if (rtp_poll_input(rtp_session) == SWITCH_STATUS_SUCCESS) {
 					rtp_session->hot_hits += rtp_session->samples_per_interval;
 
 					if (rtp_session->hot_hits >= rtp_session->samples_per_second * 5) {
@@ -2328,9 +2933,8 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 
 		if (do_cng) {
 			uint8_t *data = (uint8_t *) rtp_session->recv_msg.body;
-			int fdr;
 
-			if ((poll_status = switch_poll(rtp_session->read_pollfd, 1, &fdr, 0)) == SWITCH_STATUS_SUCCESS) {
+			if ((poll_status = rtp_poll_input(rtp_session)) == SWITCH_STATUS_SUCCESS) {
 				goto recvfrom;
 			}
 
@@ -2901,7 +3505,7 @@ static int rtp_common_write(switch_rtp_t *rtp_session,
 		}
 
 
-		if (switch_socket_sendto(rtp_session->sock_output, rtp_session->remote_addr, 0, (void *) send_msg, &bytes) != SWITCH_STATUS_SUCCESS) {
+		if (rtp_sendto(rtp_session, rtp_session->remote_addr, (void *) send_msg, &bytes) != SWITCH_STATUS_SUCCESS) {
 			rtp_session->seq--;
 			ret = -1;
 			goto end;
@@ -3036,7 +3640,7 @@ SWITCH_DECLARE(int) switch_rtp_write_frame(switch_rtp_t *rtp_session, switch_fra
 		}
 		*/
 
-		if (switch_socket_sendto(rtp_session->sock_output, rtp_session->remote_addr, 0, frame->packet, &bytes) != SWITCH_STATUS_SUCCESS) {
+		if (rtp_sendto(rtp_session, rtp_session->remote_addr, frame->packet, &bytes) != SWITCH_STATUS_SUCCESS) {
 			return -1;
 		}
 
@@ -3224,7 +3828,7 @@ SWITCH_DECLARE(int) switch_rtp_write_manual(switch_rtp_t *rtp_session,
 	}
 #endif
 
-	if (switch_socket_sendto(rtp_session->sock_output, rtp_session->remote_addr, 0, (void *) &rtp_session->write_msg, &bytes) != SWITCH_STATUS_SUCCESS) {
+	if (rtp_sendto(rtp_session, rtp_session->remote_addr, (void *) &rtp_session->write_msg, &bytes) != SWITCH_STATUS_SUCCESS) {
 		rtp_session->seq--;
 		ret = -1;
 		goto end;
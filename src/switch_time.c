@@ -35,6 +35,12 @@
 #include <stdio.h>
 #include "private/switch_core_pvt.h"
 
+#if defined(HAVE_TIMERFD_CREATE) && defined(HAVE_EPOLL_CREATE)
+#define HAVE_TIMERFD_WHEELS
+#include <sys/timerfd.h>
+#include <sys/epoll.h>
+#endif
+
 //#if defined(DARWIN)
 #define DISABLE_1MS_COND
 //#endif
@@ -100,11 +106,25 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(softtimer_shutdown);
 SWITCH_MODULE_RUNTIME_FUNCTION(softtimer_runtime);
 SWITCH_MODULE_DEFINITION(CORE_SOFTTIMER_MODULE, softtimer_load, softtimer_shutdown, softtimer_runtime);
 
+#define MAX_TIMER_QUEUES 16
+
+/* Timers of one interval are spread over up to one wait queue per cpu so a tick only wakes
+   the timers of that interval and each broadcast only contends with a slice of them. */
+struct timer_queue {
+	uint32_t count;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	uint64_t wakeups;
+	uint64_t spurious;
+};
+typedef struct timer_queue timer_queue_t;
+
 struct timer_private {
 	switch_size_t reference;
 	switch_size_t start;
 	uint32_t roll;
 	uint32_t ready;
+	timer_queue_t *queue;
 };
 typedef struct timer_private timer_private_t;
 
@@ -115,6 +135,10 @@ struct timer_matrix {
 	switch_mutex_t *mutex;
 	switch_thread_cond_t *cond;
 	switch_thread_rwlock_t *rwlock;
+	timer_queue_t *queues;
+	uint32_t queue_count;
+	uint32_t next_queue;
+	uint64_t broadcasts;
 };
 typedef struct timer_matrix timer_matrix_t;
 
@@ -422,6 +446,29 @@ SWITCH_DECLARE(void) switch_cond_yield(switch_interval_time_t t)
 
 }
 
+static void timer_matrix_wake(timer_matrix_t *matrix)
+{
+	uint32_t x;
+
+	if (!matrix->queues) {
+		return;
+	}
+
+	for (x = 0; x < matrix->queue_count; x++) {
+		timer_queue_t *queue = &matrix->queues[x];
+
+		if (!queue->count) {
+			continue;
+		}
+
+		/* a missed broadcast would cost a whole interval so don't trylock here, the waiters only hold it to test the tick */
+		switch_mutex_lock(queue->mutex);
+		switch_thread_cond_broadcast(queue->cond);
+		switch_mutex_unlock(queue->mutex);
+		matrix->broadcasts++;
+	}
+}
+
 static switch_status_t timer_init(switch_timer_t *timer)
 {
 	timer_private_t *private_info;
@@ -439,12 +486,32 @@ static switch_status_t timer_init(switch_timer_t *timer)
 	}
 
 	if ((private_info = switch_core_alloc(timer->memory_pool, sizeof(*private_info)))) {
+		timer_matrix_t *matrix = &TIMER_MATRIX[timer->interval];
+
 		switch_mutex_lock(globals.mutex);
-		if (!TIMER_MATRIX[timer->interval].mutex) {
-			switch_mutex_init(&TIMER_MATRIX[timer->interval].mutex, SWITCH_MUTEX_NESTED, module_pool);
-			switch_thread_cond_create(&TIMER_MATRIX[timer->interval].cond, module_pool);
+		if (!matrix->mutex) {
+			switch_mutex_init(&matrix->mutex, SWITCH_MUTEX_NESTED, module_pool);
+			switch_thread_cond_create(&matrix->cond, module_pool);
 		}
-		TIMER_MATRIX[timer->interval].count++;
+		if (!matrix->queues) {
+			uint32_t x;
+
+			matrix->queue_count = switch_core_cpu_count();
+			if (matrix->queue_count > MAX_TIMER_QUEUES) {
+				matrix->queue_count = MAX_TIMER_QUEUES;
+			} else if (matrix->queue_count < 1) {
+				matrix->queue_count = 1;
+			}
+
+			matrix->queues = switch_core_alloc(module_pool, sizeof(timer_queue_t) * matrix->queue_count);
+			for (x = 0; x < matrix->queue_count; x++) {
+				switch_mutex_init(&matrix->queues[x].mutex, SWITCH_MUTEX_NESTED, module_pool);
+				switch_thread_cond_create(&matrix->queues[x].cond, module_pool);
+			}
+		}
+		private_info->queue = &matrix->queues[matrix->next_queue++ % matrix->queue_count];
+		private_info->queue->count++;
+		matrix->count++;
 		switch_mutex_unlock(globals.mutex);
 		timer->private_info = private_info;
 		private_info->start = private_info->reference = TIMER_MATRIX[timer->interval].tick;
@@ -525,12 +592,7 @@ static switch_status_t timer_sync(switch_timer_t *timer)
 static switch_status_t timer_next(switch_timer_t *timer)
 {
 	timer_private_t *private_info = timer->private_info;
-
-#ifdef DISABLE_1MS_COND
-	int cond_index = timer->interval;
-#else
-	int cond_index = 1;
-#endif
+	timer_queue_t *queue = private_info->queue;
 	int delta = (int) (private_info->reference - TIMER_MATRIX[timer->interval].tick);
 
 	/* sync up timer if it's not been called for a while otherwise it will return instantly several times until it catches up */
@@ -552,11 +614,15 @@ static switch_status_t timer_next(switch_timer_t *timer)
 			globals.use_cond_yield = 0;
 		} else {
 			if (globals.use_cond_yield == 1) {
-				switch_mutex_lock(TIMER_MATRIX[cond_index].mutex);
+				switch_mutex_lock(queue->mutex);
 				if (TIMER_MATRIX[timer->interval].tick < private_info->reference) {
-					switch_thread_cond_wait(TIMER_MATRIX[cond_index].cond, TIMER_MATRIX[cond_index].mutex);
+					switch_thread_cond_wait(queue->cond, queue->mutex);
+					queue->wakeups++;
+					if (TIMER_MATRIX[timer->interval].tick < private_info->reference) {
+						queue->spurious++;
+					}
 				}
-				switch_mutex_unlock(TIMER_MATRIX[cond_index].mutex);
+				switch_mutex_unlock(queue->mutex);
 			} else {
 				do_sleep(1000);
 			}
@@ -601,6 +667,9 @@ static switch_status_t timer_destroy(switch_timer_t *timer)
 	timer_private_t *private_info = timer->private_info;
 	if (timer->interval < MAX_ELEMENTS) {
 		switch_mutex_lock(globals.mutex);
+		if (private_info && private_info->queue) {
+			private_info->queue->count--;
+		}
 		TIMER_MATRIX[timer->interval].count--;
 		if (TIMER_MATRIX[timer->interval].count == 0) {
 			TIMER_MATRIX[timer->interval].tick = 0;
@@ -623,6 +692,554 @@ static switch_status_t timer_destroy(switch_timer_t *timer)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+#ifdef HAVE_TIMERFD_WHEELS
+
+/* timerfd wheels
+   Timers are grouped by interval on a per cpu wheel.  Each group is backed by one periodic timerfd and each
+   wheel thread sleeps in epoll until one of its groups expires, so nothing spins on the 1ms tick.
+   Waiters park on their own condition and the wheel only wakes the ones whose reference tick has come due.
+*/
+
+#define TFD_MAX_WHEELS 64
+#define TFD_MAX_EVENTS 64
+
+typedef struct tfd_waiter tfd_waiter_t;
+typedef struct tfd_group tfd_group_t;
+
+struct tfd_group {
+	int fd;
+	uint32_t interval;
+	uint32_t count;
+	switch_size_t tick;
+	uint32_t roll;
+	switch_mutex_t *mutex;
+	tfd_waiter_t *waiters;
+	uint64_t signals;
+	uint64_t wakeups;
+	uint64_t spurious;
+};
+
+struct tfd_waiter {
+	timer_private_t *private_info;
+	switch_thread_cond_t *cond;
+	tfd_group_t *group;
+	uint8_t waiting;
+	tfd_waiter_t *prev;
+	tfd_waiter_t *next;
+};
+
+typedef struct {
+	int epfd;
+	uint32_t id;
+	tfd_group_t *groups[MAX_ELEMENTS + 1];
+	switch_thread_t *thread;
+} tfd_wheel_t;
+
+static struct {
+	tfd_wheel_t *wheels[TFD_MAX_WHEELS];
+	uint32_t wheel_count;
+	uint32_t next_wheel;
+	int32_t running;
+	switch_mutex_t *mutex;
+} TFD;
+
+static void tfd_unlink_waiter(tfd_waiter_t *waiter)
+{
+	tfd_group_t *group = waiter->group;
+
+	if (waiter->prev) {
+		waiter->prev->next = waiter->next;
+	} else {
+		group->waiters = waiter->next;
+	}
+
+	if (waiter->next) {
+		waiter->next->prev = waiter->prev;
+	}
+
+	waiter->prev = waiter->next = NULL;
+	waiter->waiting = 0;
+}
+
+static void tfd_group_tick(tfd_group_t *group, uint64_t expirations)
+{
+	tfd_waiter_t *waiter, *next;
+
+	switch_mutex_lock(group->mutex);
+
+	group->tick += (switch_size_t) expirations;
+
+	if (group->tick >= MAX_TICK) {
+		group->tick = 0;
+		group->roll++;
+	}
+
+	for (waiter = group->waiters; waiter; waiter = next) {
+		next = waiter->next;
+		if (!TFD.running || waiter->private_info->reference <= group->tick || waiter->private_info->roll < group->roll) {
+			tfd_unlink_waiter(waiter);
+			switch_thread_cond_signal(waiter->cond);
+			group->signals++;
+		}
+	}
+
+	switch_mutex_unlock(group->mutex);
+}
+
+static void *SWITCH_THREAD_FUNC tfd_wheel_thread(switch_thread_t *thread, void *obj)
+{
+	tfd_wheel_t *wheel = (tfd_wheel_t *) obj;
+	struct epoll_event events[TFD_MAX_EVENTS];
+	uint64_t expirations;
+	int x, r;
+
+	while (TFD.running) {
+		if ((r = epoll_wait(wheel->epfd, events, TFD_MAX_EVENTS, 100)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Timer wheel %u epoll error: %s\n", wheel->id, strerror(errno));
+			break;
+		}
+
+		for (x = 0; x < r; x++) {
+			tfd_group_t *group = (tfd_group_t *) events[x].data.ptr;
+
+			if (read(group->fd, &expirations, sizeof(expirations)) != sizeof(expirations) || !expirations) {
+				continue;
+			}
+
+			if (expirations > 1) {
+				/* the wheel was descheduled or the host stalled, catch the group up in one step */
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG10, "Timer wheel %u interval %u overran by %u tick(s)\n",
+								  wheel->id, group->interval, (uint32_t) expirations - 1);
+			}
+
+			tfd_group_tick(group, expirations);
+		}
+	}
+
+	return NULL;
+}
+
+static switch_status_t tfd_start(void)
+{
+	switch_threadattr_t *thd_attr;
+	uint32_t x;
+
+	TFD.wheel_count = switch_core_cpu_count();
+
+	if (TFD.wheel_count > TFD_MAX_WHEELS) {
+		TFD.wheel_count = TFD_MAX_WHEELS;
+	}
+
+	TFD.running = 1;
+
+	for (x = 0; x < TFD.wheel_count; x++) {
+		tfd_wheel_t *wheel = switch_core_alloc(module_pool, sizeof(*wheel));
+
+		wheel->id = x;
+
+		if ((wheel->epfd = epoll_create(MAX_ELEMENTS)) < 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot create epoll for timer wheel %u: %s\n", x, strerror(errno));
+			TFD.wheel_count = x;
+			break;
+		}
+
+		TFD.wheels[x] = wheel;
+
+		switch_threadattr_create(&thd_attr, module_pool);
+		switch_threadattr_detach_set(thd_attr, 0);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_threadattr_priority_increase(thd_attr);
+		switch_thread_create(&wheel->thread, thd_attr, tfd_wheel_thread, wheel, module_pool);
+	}
+
+	if (!TFD.wheel_count) {
+		TFD.running = 0;
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Started %u timerfd timer wheel(s)\n", TFD.wheel_count);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void tfd_stop(void)
+{
+	uint32_t x, i;
+	switch_status_t st;
+
+	if (!TFD.running) {
+		return;
+	}
+
+	switch_mutex_lock(TFD.mutex);
+	TFD.running = 0;
+	switch_mutex_unlock(TFD.mutex);
+
+	for (x = 0; x < TFD.wheel_count; x++) {
+		tfd_wheel_t *wheel = TFD.wheels[x];
+
+		switch_thread_join(&st, wheel->thread);
+
+		for (i = 0; i <= MAX_ELEMENTS; i++) {
+			if (wheel->groups[i]) {
+				/* release anybody still parked */
+				tfd_group_tick(wheel->groups[i], 0);
+				close(wheel->groups[i]->fd);
+			}
+		}
+
+		close(wheel->epfd);
+	}
+}
+
+static tfd_group_t *tfd_get_group(tfd_wheel_t *wheel, uint32_t interval)
+{
+	tfd_group_t *group;
+	struct itimerspec its = { {0} };
+	struct epoll_event e = { 0 };
+
+	if ((group = wheel->groups[interval])) {
+		return group;
+	}
+
+	group = switch_core_alloc(module_pool, sizeof(*group));
+	group->interval = interval;
+
+	if ((group->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK)) < 0) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot create timerfd: %s\n", strerror(errno));
+		return NULL;
+	}
+
+	its.it_interval.tv_sec = interval / 1000;
+	its.it_interval.tv_nsec = (interval % 1000) * 1000000;
+	its.it_value = its.it_interval;
+
+	if (timerfd_settime(group->fd, 0, &its, NULL) < 0) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot arm timerfd: %s\n", strerror(errno));
+		close(group->fd);
+		return NULL;
+	}
+
+	switch_mutex_init(&group->mutex, SWITCH_MUTEX_NESTED, module_pool);
+
+	e.events = EPOLLIN;
+	e.data.ptr = group;
+
+	if (epoll_ctl(wheel->epfd, EPOLL_CTL_ADD, group->fd, &e) < 0) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot add timerfd to wheel %u: %s\n", wheel->id, strerror(errno));
+		close(group->fd);
+		return NULL;
+	}
+
+	wheel->groups[interval] = group;
+
+	return group;
+}
+
+static switch_status_t tfd_timer_init(switch_timer_t *timer)
+{
+	timer_private_t *private_info;
+	tfd_waiter_t *waiter;
+	tfd_wheel_t *wheel;
+	tfd_group_t *group;
+
+	if (globals.RUNNING != 1 || timer->interval < 1 || timer->interval > MAX_ELEMENTS) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(TFD.mutex);
+
+	if (!TFD.running && tfd_start() != SWITCH_STATUS_SUCCESS) {
+		switch_mutex_unlock(TFD.mutex);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	/* spread the timers over the wheels, timers of the same interval on the same wheel share a timerfd */
+	wheel = TFD.wheels[TFD.next_wheel++ % TFD.wheel_count];
+
+	if (!(group = tfd_get_group(wheel, timer->interval))) {
+		switch_mutex_unlock(TFD.mutex);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	group->count++;
+	switch_mutex_unlock(TFD.mutex);
+
+	private_info = switch_core_alloc(timer->memory_pool, sizeof(*private_info));
+	waiter = switch_core_alloc(timer->memory_pool, sizeof(*waiter));
+	switch_thread_cond_create(&waiter->cond, timer->memory_pool);
+	waiter->private_info = private_info;
+	waiter->group = group;
+
+	switch_mutex_lock(group->mutex);
+	private_info->start = private_info->reference = group->tick;
+	private_info->roll = group->roll;
+	private_info->ready = 1;
+	switch_mutex_unlock(group->mutex);
+
+	timer->private_info = waiter;
+
+	switch_mutex_lock(globals.mutex);
+	globals.timer_count++;
+	if (globals.timer_count == (runtime.tipping_point + 1)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Crossed tipping point of %u, shifting into high-gear.\n", runtime.tipping_point);
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define tfd_check_roll() if (private_info->roll < group->roll) {		\
+		private_info->roll++;											\
+		private_info->reference = private_info->start = group->tick;	\
+	}																	\
+
+
+static switch_status_t tfd_timer_step(switch_timer_t *timer)
+{
+	tfd_waiter_t *waiter = timer->private_info;
+	timer_private_t *private_info = waiter->private_info;
+	tfd_group_t *group = waiter->group;
+	uint64_t samples;
+
+	if (!TFD.running || private_info->ready == 0) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	tfd_check_roll();
+	samples = timer->samples * (private_info->reference - private_info->start);
+
+	if (samples > UINT32_MAX) {
+		private_info->start = private_info->reference;
+		samples = timer->samples;
+	}
+
+	timer->samplecount = (uint32_t) samples;
+	private_info->reference++;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t tfd_timer_sync(switch_timer_t *timer)
+{
+	tfd_waiter_t *waiter = timer->private_info;
+	timer_private_t *private_info = waiter->private_info;
+
+	if (!TFD.running || private_info->ready == 0) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	private_info->reference = timer->tick = waiter->group->tick;
+
+	if (tfd_timer_step(timer) == SWITCH_STATUS_SUCCESS) {
+		private_info->reference++;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t tfd_timer_next(switch_timer_t *timer)
+{
+	tfd_waiter_t *waiter = timer->private_info;
+	timer_private_t *private_info = waiter->private_info;
+	tfd_group_t *group = waiter->group;
+	int delta = (int) (private_info->reference - group->tick);
+
+	/* sync up timer if it's not been called for a while otherwise it will return instantly several times until it catches up */
+	if (delta < -1) {
+		private_info->reference = timer->tick = group->tick;
+	}
+	tfd_timer_step(timer);
+
+	switch_mutex_lock(group->mutex);
+	while (TFD.running && private_info->ready && group->tick < private_info->reference) {
+		tfd_check_roll();
+
+		if (!waiter->waiting) {
+			waiter->waiting = 1;
+			waiter->prev = NULL;
+			if ((waiter->next = group->waiters)) {
+				group->waiters->prev = waiter;
+			}
+			group->waiters = waiter;
+		}
+
+		switch_thread_cond_wait(waiter->cond, group->mutex);
+		group->wakeups++;
+		if (group->tick < private_info->reference) {
+			group->spurious++;
+		}
+	}
+
+	if (waiter->waiting) {
+		tfd_unlink_waiter(waiter);
+	}
+	switch_mutex_unlock(group->mutex);
+
+	timer->tick = group->tick;
+
+	return TFD.running ? SWITCH_STATUS_SUCCESS : SWITCH_STATUS_FALSE;
+}
+
+static switch_status_t tfd_timer_check(switch_timer_t *timer, switch_bool_t step)
+{
+	tfd_waiter_t *waiter = timer->private_info;
+	timer_private_t *private_info = waiter->private_info;
+	tfd_group_t *group = waiter->group;
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+	if (!TFD.running || !private_info->ready) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	tfd_check_roll();
+
+	timer->tick = group->tick;
+
+	if (timer->tick < private_info->reference) {
+		timer->diff = private_info->reference - timer->tick;
+	} else {
+		timer->diff = 0;
+	}
+
+	if (timer->diff) {
+		status = SWITCH_STATUS_FALSE;
+	} else if (step) {
+		tfd_timer_step(timer);
+	}
+
+	return status;
+}
+
+static switch_status_t tfd_timer_destroy(switch_timer_t *timer)
+{
+	tfd_waiter_t *waiter = timer->private_info;
+
+	if (waiter) {
+		tfd_group_t *group = waiter->group;
+
+		switch_mutex_lock(group->mutex);
+		waiter->private_info->ready = 0;
+		if (waiter->waiting) {
+			tfd_unlink_waiter(waiter);
+		}
+		switch_mutex_unlock(group->mutex);
+
+		switch_mutex_lock(TFD.mutex);
+		group->count--;
+		switch_mutex_unlock(TFD.mutex);
+	}
+
+	switch_mutex_lock(globals.mutex);
+	if (globals.timer_count) {
+		globals.timer_count--;
+		if (globals.timer_count == (runtime.tipping_point - 1)) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Fell Below tipping point of %u, shifting into low-gear.\n", runtime.tipping_point);
+		}
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#endif
+
+SWITCH_DECLARE(void) switch_time_get_wakeup_stats(uint64_t *wakeups, uint64_t *spurious)
+{
+	uint64_t w = 0, sp = 0;
+	uint32_t x, i;
+
+	for (x = 1; x <= MAX_ELEMENTS; x++) {
+		if (!TIMER_MATRIX[x].queues) {
+			continue;
+		}
+		for (i = 0; i < TIMER_MATRIX[x].queue_count; i++) {
+			w += TIMER_MATRIX[x].queues[i].wakeups;
+			sp += TIMER_MATRIX[x].queues[i].spurious;
+		}
+	}
+
+#ifdef HAVE_TIMERFD_WHEELS
+	for (i = 0; i < TFD.wheel_count; i++) {
+		for (x = 1; x <= MAX_ELEMENTS; x++) {
+			if (TFD.wheels[i]->groups[x]) {
+				w += TFD.wheels[i]->groups[x]->wakeups;
+				sp += TFD.wheels[i]->groups[x]->spurious;
+			}
+		}
+	}
+#endif
+
+	if (wakeups) {
+		*wakeups = w;
+	}
+
+	if (spurious) {
+		*spurious = sp;
+	}
+}
+
+SWITCH_DECLARE(void) switch_time_dump_timer_stats(switch_stream_handle_t *stream, const char *delim)
+{
+	uint32_t x, i;
+
+	if (zstr(delim)) {
+		delim = ",";
+	}
+
+	stream->write_function(stream, "type%sinterval%stimers%squeues%sticks%sbroadcasts%swakeups%sspurious\n",
+						   delim, delim, delim, delim, delim, delim, delim);
+
+	for (x = 1; x <= MAX_ELEMENTS; x++) {
+		timer_matrix_t *matrix = &TIMER_MATRIX[x];
+		uint64_t wakeups = 0, spurious = 0;
+		uint32_t timers = 0;
+
+		if (!matrix->queues) {
+			continue;
+		}
+
+		for (i = 0; i < matrix->queue_count; i++) {
+			timers += matrix->queues[i].count;
+			wakeups += matrix->queues[i].wakeups;
+			spurious += matrix->queues[i].spurious;
+		}
+
+		stream->write_function(stream, "soft%s%u%s%u%s%u%s%" SWITCH_SIZE_T_FMT "%s%" SWITCH_UINT64_T_FMT "%s%" SWITCH_UINT64_T_FMT "%s%" SWITCH_UINT64_T_FMT "\n",
+							   delim, x, delim, timers, delim, matrix->queue_count, delim, matrix->tick, delim, matrix->broadcasts,
+							   delim, wakeups, delim, spurious);
+	}
+
+#ifdef HAVE_TIMERFD_WHEELS
+	for (x = 1; x <= MAX_ELEMENTS; x++) {
+		uint64_t signals = 0, wakeups = 0, spurious = 0;
+		uint32_t timers = 0, groups = 0;
+		switch_size_t ticks = 0;
+
+		for (i = 0; i < TFD.wheel_count; i++) {
+			tfd_group_t *group = TFD.wheels[i]->groups[x];
+
+			if (group) {
+				groups++;
+				timers += group->count;
+				ticks = group->tick;
+				signals += group->signals;
+				wakeups += group->wakeups;
+				spurious += group->spurious;
+			}
+		}
+
+		if (groups) {
+			stream->write_function(stream, "timerfd%s%u%s%u%s%u%s%" SWITCH_SIZE_T_FMT "%s%" SWITCH_UINT64_T_FMT "%s%" SWITCH_UINT64_T_FMT "%s%" SWITCH_UINT64_T_FMT "\n",
+								   delim, x, delim, timers, delim, groups, delim, ticks, delim, signals, delim, wakeups, delim, spurious);
+		}
+	}
+#endif
+}
+
 SWITCH_MODULE_RUNTIME_FUNCTION(softtimer_runtime)
 {
 	switch_time_t too_late = STEP_MIC * 1000;
@@ -777,13 +1394,7 @@ SWITCH_MODULE_RUNTIME_FUNCTION(softtimer_runtime)
 				if ((current_ms % x) == 0) {
 					if (TIMER_MATRIX[x].count) {
 						TIMER_MATRIX[x].tick++;
-#ifdef DISABLE_1MS_COND
-
-						if (TIMER_MATRIX[x].mutex && switch_mutex_trylock(TIMER_MATRIX[x].mutex) == SWITCH_STATUS_SUCCESS) {
-							switch_thread_cond_broadcast(TIMER_MATRIX[x].cond);
-							switch_mutex_unlock(TIMER_MATRIX[x].mutex);
-						}
-#endif
+						timer_matrix_wake(&TIMER_MATRIX[x]);
 						if (TIMER_MATRIX[x].tick == MAX_TICK) {
 							TIMER_MATRIX[x].tick = 0;
 							TIMER_MATRIX[x].roll++;
@@ -805,6 +1416,7 @@ SWITCH_MODULE_RUNTIME_FUNCTION(softtimer_runtime)
 			switch_thread_cond_broadcast(TIMER_MATRIX[x].cond);
 			switch_mutex_unlock(TIMER_MATRIX[x].mutex);
 		}
+		timer_matrix_wake(&TIMER_MATRIX[x]);
 	}
 
 
@@ -1020,6 +1632,20 @@ SWITCH_MODULE_LOAD_FUNCTION(softtimer_load)
 	timer_interface->timer_check = timer_check;
 	timer_interface->timer_destroy = timer_destroy;
 
+#ifdef HAVE_TIMERFD_WHEELS
+	memset(&TFD, 0, sizeof(TFD));
+	switch_mutex_init(&TFD.mutex, SWITCH_MUTEX_NESTED, module_pool);
+
+	timer_interface = switch_loadable_module_create_interface(*module_interface, SWITCH_TIMER_INTERFACE);
+	timer_interface->interface_name = "timerfd";
+	timer_interface->timer_init = tfd_timer_init;
+	timer_interface->timer_next = tfd_timer_next;
+	timer_interface->timer_step = tfd_timer_step;
+	timer_interface->timer_sync = tfd_timer_sync;
+	timer_interface->timer_check = tfd_timer_check;
+	timer_interface->timer_destroy = tfd_timer_destroy;
+#endif
+
 	if (!switch_test_flag((&runtime), SCF_USE_CLOCK_RT)) {
 		switch_time_set_nanosleep(SWITCH_FALSE);
 	}
@@ -1043,6 +1669,10 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(softtimer_shutdown)
 {
 	globals.use_cond_yield = 0;
 
+#ifdef HAVE_TIMERFD_WHEELS
+	tfd_stop();
+#endif
+
 	if (globals.RUNNING == 1) {
 		switch_mutex_lock(globals.mutex);
 		globals.RUNNING = -1;
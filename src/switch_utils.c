@@ -42,6 +42,7 @@ struct switch_network_node {
 	uint32_t ip;
 	uint32_t mask;
 	uint32_t bits;
+	uint32_t seq;
 	switch_bool_t ok;
 	char *token;
 	char *str;
@@ -49,13 +50,123 @@ struct switch_network_node {
 };
 typedef struct switch_network_node switch_network_node_t;
 
+/*
+ * Path compressed binary trie over the contiguous prefixes of a list, a node exists for every prefix and for every
+ * branching point between them so a lookup visits at most 33 nodes no matter how many entries the list holds.
+ */
+struct switch_network_trie {
+	uint32_t prefix;
+	uint32_t bits;
+	switch_network_node_t *node;
+	struct switch_network_trie *child[2];
+};
+typedef struct switch_network_trie switch_network_trie_t;
+
 struct switch_network_list {
+	/* entries with a non contiguous mask (host/mask pairs), these can't live in the trie */
 	struct switch_network_node *node_head;
+	switch_network_trie_t *trie;
+	uint32_t seq;
 	switch_bool_t default_type;
 	switch_memory_pool_t *pool;
 	char *name;
 };
 
+#define NETWORK_MASK(_bits) ((_bits) ? 0xFFFFFFFF << (32 - (_bits)) : 0)
+#define NETWORK_BIT(_ip, _pos) (((_ip) >> (31 - (_pos))) & 1)
+
+static uint32_t network_common_bits(uint32_t a, uint32_t b, uint32_t max)
+{
+	uint32_t bits = 0, diff = a ^ b;
+
+	while (bits < max && !(diff & 0x80000000)) {
+		diff <<= 1;
+		bits++;
+	}
+
+	return bits;
+}
+
+static switch_network_trie_t *network_trie_new(switch_network_list_t *list, uint32_t prefix, uint32_t bits, switch_network_node_t *node)
+{
+	switch_network_trie_t *tn = switch_core_alloc(list->pool, sizeof(*tn));
+
+	tn->prefix = prefix & NETWORK_MASK(bits);
+	tn->bits = bits;
+	tn->node = node;
+
+	return tn;
+}
+
+static void network_trie_insert(switch_network_list_t *list, switch_network_node_t *node)
+{
+	switch_network_trie_t **tp = &list->trie, *tn, *nn;
+	uint32_t key = node->ip & node->mask, bits = node->bits, common;
+
+	for (;;) {
+		if (!(tn = *tp)) {
+			*tp = network_trie_new(list, key, bits, node);
+			return;
+		}
+
+		common = network_common_bits(key, tn->prefix, bits < tn->bits ? bits : tn->bits);
+
+		if (common == tn->bits) {
+			if (bits == tn->bits) {
+				/* same prefix added again, the newest entry wins like it always did */
+				tn->node = node;
+				return;
+			}
+			tp = &tn->child[NETWORK_BIT(key, tn->bits)];
+			continue;
+		}
+
+		if (common == bits) {
+			nn = network_trie_new(list, key, bits, node);
+		} else {
+			nn = network_trie_new(list, key, common, NULL);
+			nn->child[NETWORK_BIT(key, common)] = network_trie_new(list, key, bits, node);
+		}
+
+		nn->child[NETWORK_BIT(tn->prefix, common)] = tn;
+		*tp = nn;
+		return;
+	}
+}
+
+static switch_network_node_t *network_trie_find(switch_network_list_t *list, uint32_t ip)
+{
+	switch_network_trie_t *tn = list->trie;
+	switch_network_node_t *best = NULL;
+
+	while (tn && ((ip ^ tn->prefix) & NETWORK_MASK(tn->bits)) == 0) {
+		if (tn->node) {
+			best = tn->node;
+		}
+
+		if (tn->bits == 32) {
+			break;
+		}
+
+		tn = tn->child[NETWORK_BIT(ip, tn->bits)];
+	}
+
+	return best;
+}
+
+static void network_list_add_node(switch_network_list_t *list, switch_network_node_t *node)
+{
+	node->seq = ++list->seq;
+
+	/* a zero length prefix never won a lookup, the list default applies to everything it would cover */
+	if (node->bits && node->mask == NETWORK_MASK(node->bits)) {
+		network_trie_insert(list, node);
+	} else {
+		node->next = list->node_head;
+		list->node_head = node;
+	}
+}
+
 #ifndef WIN32
 SWITCH_DECLARE(int) switch_inet_pton(int af, const char *src, void *dst)
 {
@@ -142,27 +253,26 @@ SWITCH_DECLARE(switch_status_t) switch_network_list_create(switch_network_list_t
 
 SWITCH_DECLARE(switch_bool_t) switch_network_list_validate_ip_token(switch_network_list_t *list, uint32_t ip, const char **token)
 {
-	switch_network_node_t *node;
-	switch_bool_t ok = list->default_type;
-	uint32_t bits = 0;
+	switch_network_node_t *node, *best;
+
+	best = network_trie_find(list, ip);
 
 	for (node = list->node_head; node; node = node->next) {
-		if (node->bits > bits && switch_test_subnet(ip, node->ip, node->mask)) {
-			if (node->ok) {
-				ok = SWITCH_TRUE;
-			} else {
-				ok = SWITCH_FALSE;
-			}
+		if (node->bits && switch_test_subnet(ip, node->ip, node->mask) &&
+			(!best || node->bits > best->bits || (node->bits == best->bits && node->seq > best->seq))) {
+			best = node;
+		}
+	}
 
-			bits = node->bits;
+	if (!best) {
+		return list->default_type;
+	}
 
-			if (token) {
-				*token = node->token;
-			}
-		}
+	if (token) {
+		*token = best->token;
 	}
 
-	return ok;
+	return best->ok ? SWITCH_TRUE : SWITCH_FALSE;
 }
 
 SWITCH_DECLARE(switch_status_t) switch_network_list_perform_add_cidr_token(switch_network_list_t *list, const char *cidr_str, switch_bool_t ok,
@@ -189,8 +299,7 @@ SWITCH_DECLARE(switch_status_t) switch_network_list_perform_add_cidr_token(switc
 		node->token = switch_core_strdup(list->pool, token);
 	}
 
-	node->next = list->node_head;
-	list->node_head = node;
+	network_list_add_node(list, node);
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Adding %s (%s) [%s] to list %s\n",
 					  cidr_str, ok ? "allow" : "deny", switch_str_nil(token), list->name);
@@ -245,8 +354,7 @@ SWITCH_DECLARE(switch_status_t) switch_network_list_add_host_mask(switch_network
 	node->bits = (((mask + (mask >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
 	node->str = switch_core_sprintf(list->pool, "%s:%s", host, mask_str);
 
-	node->next = list->node_head;
-	list->node_head = node;
+	network_list_add_node(list, node);
 
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -276,7 +384,7 @@ SWITCH_DECLARE(int) switch_parse_cidr(const char *string, uint32_t *ip, uint32_t
 	switch_inet_pton(AF_INET, host, ip);
 	*ip = htonl(*ip);
 
-	*mask = 0xFFFFFFFF & ~(0xFFFFFFFF >> bits);
+	*mask = NETWORK_MASK(bits);
 
 	*bitp = bits;
 
@@ -135,9 +135,11 @@ struct switch_xml_binding {
 	struct switch_xml_binding *next;
 };
 
+typedef struct xml_dir_index xml_dir_index_t;
 
 static switch_xml_binding_t *BINDINGS = NULL;
 static switch_xml_t MAIN_XML_ROOT = NULL;
+static xml_dir_index_t *MAIN_DIR_INDEX = NULL;
 static switch_memory_pool_t *XML_MEMORY_POOL = NULL;
 static switch_thread_rwlock_t *RWLOCK = NULL;
 static switch_thread_rwlock_t *B_RWLOCK = NULL;
@@ -1541,6 +1543,260 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
 	return xml;
 }
 
+/*
+ * Directory index for the main xml root.  It is built next to each new root in switch_xml_open_root and swapped
+ * with it under the same write lock, so anyone holding the root through switch_xml_root() sees the matching index.
+ * Lookups keep the semantics of the linear walk: users containers are searched in document order (each group's
+ * <users> and then the domain itself) and inside a container the first user matching any of the search attributes
+ * wins, including the user_type test find_user_in_tag adds to every search.  Like the strcasecmp of the walk, all
+ * the hashes are case insensitive.
+ */
+#define XML_DIR_NONE 0xFFFFFFFF
+
+typedef struct xml_dir_user {
+	switch_xml_t user;
+	uint32_t tag;
+	uint32_t pos;
+	struct xml_dir_user *next;
+} xml_dir_user_t;
+
+typedef struct {
+	xml_dir_user_t *head;
+	xml_dir_user_t *tail;
+} xml_dir_list_t;
+
+typedef struct {
+	uint32_t tag_count;
+	switch_xml_t *groups;
+	/* first user whose type attribute is set and is not "pointer", these match every default search */
+	switch_xml_t *typed;
+	uint32_t *typed_pos;
+	switch_hash_t *users;
+	switch_hash_t *ips;
+	switch_xml_t domain;
+} xml_dir_domain_t;
+
+struct xml_dir_index {
+	switch_memory_pool_t *pool;
+	switch_hash_t *domains;
+};
+
+static void xml_dir_index_add(switch_memory_pool_t *pool, switch_hash_t *hash, const char *key, switch_xml_t user, uint32_t tag, uint32_t pos)
+{
+	xml_dir_list_t *list;
+	xml_dir_user_t *np;
+
+	if (zstr(key)) {
+		return;
+	}
+
+	if (!(list = switch_core_hash_find(hash, key))) {
+		list = switch_core_alloc(pool, sizeof(*list));
+		switch_core_hash_insert(hash, key, list);
+	}
+
+	np = switch_core_alloc(pool, sizeof(*np));
+	np->user = user;
+	np->tag = tag;
+	np->pos = pos;
+
+	if (list->tail) {
+		list->tail->next = np;
+	} else {
+		list->head = np;
+	}
+	list->tail = np;
+}
+
+static void xml_dir_index_tag(xml_dir_index_t *index, xml_dir_domain_t *dd, switch_xml_t tag, switch_xml_t group)
+{
+	switch_xml_t x_user;
+	uint32_t t = dd->tag_count++, pos = 0;
+
+	dd->groups[t] = group;
+	dd->typed[t] = NULL;
+	dd->typed_pos[t] = XML_DIR_NONE;
+
+	for (x_user = switch_xml_child(tag, "user"); x_user; x_user = x_user->next, pos++) {
+		const char *type = switch_xml_attr(x_user, "type");
+
+		if (type && strcasecmp(type, "pointer") && !dd->typed[t]) {
+			dd->typed[t] = x_user;
+			dd->typed_pos[t] = pos;
+		}
+
+		xml_dir_index_add(index->pool, dd->users, switch_xml_attr(x_user, "id"), x_user, t, pos);
+		xml_dir_index_add(index->pool, dd->users, switch_xml_attr(x_user, "number-alias"), x_user, t, pos);
+		xml_dir_index_add(index->pool, dd->ips, switch_xml_attr(x_user, "ip"), x_user, t, pos);
+	}
+}
+
+static xml_dir_index_t *xml_dir_index_build(switch_xml_t root)
+{
+	switch_memory_pool_t *pool = NULL;
+	xml_dir_index_t *index;
+	switch_xml_t section, x_domain, groups, group, users;
+
+	if (!(section = switch_xml_find_child(root, "section", "name", "directory"))) {
+		return NULL;
+	}
+
+	switch_core_new_memory_pool(&pool);
+	index = switch_core_alloc(pool, sizeof(*index));
+	index->pool = pool;
+	switch_core_hash_init_nocase(&index->domains, pool);
+
+	for (x_domain = switch_xml_child(section, "domain"); x_domain; x_domain = x_domain->next) {
+		const char *name = switch_xml_attr(x_domain, "name");
+		xml_dir_domain_t *dd;
+		uint32_t tags = 1;
+
+		if (zstr(name) || switch_core_hash_find(index->domains, name)) {
+			continue;
+		}
+
+		if ((groups = switch_xml_child(x_domain, "groups"))) {
+			for (group = switch_xml_child(groups, "group"); group; group = group->next) {
+				tags++;
+			}
+		}
+
+		dd = switch_core_alloc(pool, sizeof(*dd));
+		dd->domain = x_domain;
+		dd->groups = switch_core_alloc(pool, sizeof(switch_xml_t) * tags);
+		dd->typed = switch_core_alloc(pool, sizeof(switch_xml_t) * tags);
+		dd->typed_pos = switch_core_alloc(pool, sizeof(uint32_t) * tags);
+		switch_core_hash_init_nocase(&dd->users, pool);
+		switch_core_hash_init_nocase(&dd->ips, pool);
+
+		if (groups) {
+			for (group = switch_xml_child(groups, "group"); group; group = group->next) {
+				if ((users = switch_xml_child(group, "users"))) {
+					xml_dir_index_tag(index, dd, users, group);
+				}
+			}
+		}
+
+		xml_dir_index_tag(index, dd, x_domain, NULL);
+		switch_core_hash_insert(index->domains, name, dd);
+	}
+
+	return index;
+}
+
+static void xml_dir_index_destroy(xml_dir_index_t **index)
+{
+	switch_hash_index_t *hi;
+	void *val;
+	switch_memory_pool_t *pool;
+
+	if (!index || !*index) {
+		return;
+	}
+
+	for (hi = switch_hash_first(NULL, (*index)->domains); hi; hi = switch_hash_next(hi)) {
+		xml_dir_domain_t *dd;
+
+		switch_hash_this(hi, NULL, NULL, &val);
+		dd = (xml_dir_domain_t *) val;
+		switch_core_hash_destroy(&dd->users);
+		switch_core_hash_destroy(&dd->ips);
+	}
+
+	switch_core_hash_destroy(&(*index)->domains);
+	pool = (*index)->pool;
+	*index = NULL;
+	switch_core_destroy_memory_pool(&pool);
+}
+
+/* first user in container t from an index list, or from the typed users when they take part in the search */
+static switch_xml_t xml_dir_first(xml_dir_user_t **cursor, xml_dir_domain_t *dd, uint32_t t, switch_bool_t typed)
+{
+	xml_dir_user_t *np = *cursor;
+	switch_xml_t found = NULL;
+	uint32_t pos = XML_DIR_NONE;
+
+	while (np && np->tag < t) {
+		np = np->next;
+	}
+	*cursor = np;
+
+	if (np && np->tag == t) {
+		found = np->user;
+		pos = np->pos;
+	}
+
+	if (typed && dd->typed[t] && dd->typed_pos[t] < pos) {
+		found = dd->typed[t];
+	}
+
+	return found;
+}
+
+/* returns SWITCH_STATUS_NOTIMPL when the search needs the linear walk */
+static switch_status_t xml_dir_find_user(xml_dir_index_t *index, switch_xml_t domain, const char *ip, const char *user_name,
+										 const char *key, switch_event_t *params, switch_xml_t *user, switch_xml_t *ingroup)
+{
+	switch_bool_t typed = SWITCH_TRUE;
+	xml_dir_domain_t *dd;
+	xml_dir_list_t *list;
+	xml_dir_user_t *ip_cursor = NULL, *name_cursor = NULL;
+	const char *val, *name;
+	uint32_t t;
+
+	if (!index || strcasecmp(key, "id") || (ip && !*ip) || (user_name && !*user_name)) {
+		return SWITCH_STATUS_NOTIMPL;
+	}
+
+	if (params && (val = switch_event_get_header(params, "user_type"))) {
+		if (!strcasecmp(val, "any")) {
+			typed = SWITCH_FALSE;
+		} else if (strcasecmp(val, "!pointer")) {
+			return SWITCH_STATUS_NOTIMPL;
+		}
+	}
+
+	if (!(name = switch_xml_attr(domain, "name")) || !(dd = switch_core_hash_find(index->domains, name)) || dd->domain != domain) {
+		return SWITCH_STATUS_NOTIMPL;
+	}
+
+	if (ip && (list = switch_core_hash_find(dd->ips, ip))) {
+		ip_cursor = list->head;
+	}
+
+	if (user_name && (list = switch_core_hash_find(dd->users, user_name))) {
+		name_cursor = list->head;
+	}
+
+	for (t = 0; t < dd->tag_count; t++) {
+		if ((ip && (*user = xml_dir_first(&ip_cursor, dd, t, typed))) || (user_name && (*user = xml_dir_first(&name_cursor, dd, t, typed)))) {
+			if (ingroup) {
+				*ingroup = dd->groups[t];
+			}
+			return SWITCH_STATUS_SUCCESS;
+		}
+	}
+
+	return SWITCH_STATUS_FALSE;
+}
+
+static switch_xml_t xml_find_tag(switch_xml_t xml, const char *section, const char *tag_name, const char *key_name, const char *key_value)
+{
+	switch_xml_t conf;
+
+	if (xml == MAIN_XML_ROOT && MAIN_DIR_INDEX && !zstr(key_value) && !strcasecmp(section, "directory") &&
+		!strcasecmp(tag_name, "domain") && !strcasecmp(key_name, "name")) {
+		xml_dir_domain_t *dd = switch_core_hash_find(MAIN_DIR_INDEX->domains, key_value);
+		return dd ? dd->domain : NULL;
+	}
+
+	if ((conf = switch_xml_find_child(xml, "section", "name", section))) {
+		return switch_xml_find_child(conf, tag_name, key_name, key_value);
+	}
+
+	return NULL;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_xml_locate(const char *section,
 												  const char *tag_name,
 												  const char *key_name,
@@ -1598,7 +1854,7 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate(const char *section,
 			}
 		}
 
-		if ((conf = switch_xml_find_child(xml, "section", "name", section)) && (tag = switch_xml_find_child(conf, tag_name, key_name, key_value))) {
+		if ((tag = xml_find_tag(xml, section, tag_name, key_name, key_value))) {
 			if (clone) {
 				char *x = switch_xml_toxml(tag, SWITCH_FALSE);
 				switch_assert(x);
@@ -1865,6 +2121,13 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_user(const char *key,
 		search_params = params;
 	}
 
+	if (*root == MAIN_XML_ROOT &&
+		(status = xml_dir_find_user(MAIN_DIR_INDEX, *domain, ip, user_name, key, params, user, ingroup)) != SWITCH_STATUS_NOTIMPL) {
+		goto end;
+	}
+
+	status = SWITCH_STATUS_FALSE;
+
 	if ((groups = switch_xml_child(*domain, "groups"))) {
 		for (group = switch_xml_child(groups, "group"); group; group = group->next) {
 			if ((users = switch_xml_child(group, "users"))) {
@@ -1969,11 +2232,15 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_open_root(uint8_t reload, const char **e
 			errcnt++;
 		} else {
 			switch_xml_t old_root;
+			xml_dir_index_t *old_index;
 			*err = "Success";
 			old_root = MAIN_XML_ROOT;
+			old_index = MAIN_DIR_INDEX;
+			MAIN_DIR_INDEX = xml_dir_index_build(new_main);
 			MAIN_XML_ROOT = new_main;
 			switch_set_flag(MAIN_XML_ROOT, SWITCH_XML_ROOT);
 			switch_xml_free(old_root);
+			xml_dir_index_destroy(&old_index);
 			/* switch_xml_free_in_thread(old_root); */
 		}
 	} else {
@@ -2032,6 +2299,7 @@ SWITCH_DECLARE(switch_status_t) switch_xml_destroy(void)
 		switch_xml_t xml = MAIN_XML_ROOT;
 		MAIN_XML_ROOT = NULL;
 		switch_xml_free(xml);
+		xml_dir_index_destroy(&MAIN_DIR_INDEX);
 		status = SWITCH_STATUS_SUCCESS;
 	}
 